@@ -13,6 +13,7 @@ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
 See the License for the specific language governing permissions and
 limitations under the License.
 */
+#include <sys/stat.h>
 #include "nlohmann/json.hpp"
 #include "oneflow/api/common/variable_tensor_mgr.h"
 #include "oneflow/api/cpp/env_impl.h"
@@ -25,6 +26,7 @@ limitations under the License.
 #include "oneflow/api/cpp/embedding/embedding.h"
 #include "oneflow/api/common/job_build_and_infer_ctx.h"
 #include "oneflow/api/python/job_build/job_build_and_infer.h"
+#include "oneflow/core/common/blocking_counter.h"
 #include "oneflow/core/common/data_type.pb.h"
 #include "oneflow/core/common/singleton.h"
 #include "oneflow/core/common/hash_container.h"
@@ -59,6 +61,8 @@ limitations under the License.
 #include "oneflow/core/operator/interface_blob_conf.pb.h"
 #include "oneflow/core/operator/op_conf.pb.h"
 #include "oneflow/core/register/logical_blob_id.pb.h"
+#include "oneflow/core/platform/include/pthread_fork.h"
+#include "oneflow/core/thread/thread_pool.h"
 #include "oneflow/core/vm/vm_util.h"
 
 namespace oneflow_api {
@@ -112,6 +116,140 @@ Shape OfShapeToOfApiShape(const of::Shape& of_shape) {
   return Shape(dims);
 }
 
+std::string GetVariableFilename(const std::string& model_path,
+                                const std::string& variable_op_name) {
+  return model_path + "/" + variable_op_name + "/out";
+}
+
+// Variables loaded from the same file to the same device are shared by the graphs in this process
+// if ONEFLOW_SERVING_SHARE_VARIABLES is set, the inference graphs never modify them.
+class SharedVariableMgr final {
+ public:
+  static SharedVariableMgr* Get() {
+    static SharedVariableMgr mgr;
+    return &mgr;
+  }
+
+  std::shared_ptr<of::one::Tensor> Find(const std::string& key) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = key2variable_.find(key);
+    if (it == key2variable_.end()) { return nullptr; }
+    std::shared_ptr<of::one::Tensor> variable = it->second.lock();
+    if (!variable) { key2variable_.erase(it); }
+    return variable;
+  }
+
+  void Add(const std::string& key, const std::shared_ptr<of::one::Tensor>& variable) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    key2variable_[key] = variable;
+  }
+
+ private:
+  SharedVariableMgr() = default;
+
+  std::mutex mutex_;
+  of::HashMap<std::string, std::weak_ptr<of::one::Tensor>> key2variable_;
+};
+
+#ifdef __linux__
+
+// Chunks of the variable files paged in by the threads of the thread pool
+constexpr size_t kVariablePageInChunkSize = 64 * 1024 * 1024;
+
+void PageInVariableChunk(const char* ptr, size_t size) {
+  PCHECK(madvise(const_cast<char*>(ptr), size, MADV_WILLNEED) == 0);
+  // Touch every page to read it on this thread rather than in the copy
+  volatile char sum = 0;
+  for (size_t i = 0; i < size; i += 4096) { sum += ptr[i]; }
+}
+
+#endif  // __linux__
+
+// On linux, the variable files are mapped and paged in on the thread pool in the order of the
+// variables, while every variable paged in is copied on this thread without staging buffers and
+// its mapping is released.
+of::Maybe<void> LoadVariables(const std::vector<std::string>& filenames,
+                              const std::vector<std::shared_ptr<of::one::Tensor>>& variables) {
+  CHECK_EQ_OR_RETURN(filenames.size(), variables.size());
+  std::vector<size_t> sizes(variables.size());
+  for (size_t i = 0; i < variables.size(); ++i) {
+    sizes[i] = variables[i]->shape()->elem_cnt()
+               * of::GetSizeOfDataType(variables[i]->dtype()->data_type());
+  }
+#ifdef __linux__
+  std::vector<of::embedding::PosixMappedFile> files(variables.size());
+  for (size_t i = 0; i < variables.size(); ++i) {
+    CHECK_OR_RETURN(of::embedding::PosixFile::FileExists(filenames[i]))
+        << "variable file " << filenames[i] << " does not exist";
+    of::embedding::PosixFile file(filenames[i], O_RDONLY, 0644);
+    CHECK_EQ_OR_RETURN(file.Size(), sizes[i])
+        << "the size of variable file " << filenames[i] << " mismatches the variable";
+    if (sizes[i] == 0) { continue; }
+    files[i] = of::embedding::PosixMappedFile(std::move(file), sizes[i], PROT_READ, MAP_PRIVATE);
+  }
+  // The copies fault the pages in themselves if there is no thread pool
+  of::ThreadPool* thread_pool = of::pthread_fork::IsForkedSubProcess()
+                                    ? nullptr
+                                    : of::Singleton<of::ThreadPool>::Get();
+  // the number of chunks of every variable not paged in yet
+  std::vector<std::unique_ptr<of::BlockingCounter>> chunk_counters(variables.size());
+  for (size_t i = 0; i < variables.size(); ++i) {
+    size_t chunk_num = 0;
+    if (thread_pool != nullptr) {
+      chunk_num = of::RoundUp(sizes[i], kVariablePageInChunkSize) / kVariablePageInChunkSize;
+    }
+    chunk_counters[i].reset(new of::BlockingCounter(chunk_num));
+    for (size_t offset = 0; offset < chunk_num * kVariablePageInChunkSize;
+         offset += kVariablePageInChunkSize) {
+      const char* ptr = static_cast<const char*>(files[i].ptr()) + offset;
+      const size_t size = std::min(kVariablePageInChunkSize, sizes[i] - offset);
+      of::BlockingCounter* counter = chunk_counters[i].get();
+      thread_pool->AddWork([ptr, size, counter]() {
+        PageInVariableChunk(ptr, size);
+        counter->Decrease();
+      });
+    }
+  }
+#endif  // __linux__
+  const auto& CopyVariables = [&]() -> of::Maybe<void> {
+    for (size_t i = 0; i < variables.size(); ++i) {
+#ifdef __linux__
+      if (sizes[i] == 0) { continue; }
+      chunk_counters[i]->WaitForeverUntilCntEqualZero();
+      const char* buffer = static_cast<const char*>(files[i].ptr());
+#else
+      const std::string content = [&]() {
+        std::ifstream variable_file(filenames[i], std::ios::binary);
+        CHECK(variable_file.is_open());
+        std::stringstream ss;
+        ss << variable_file.rdbuf();
+        return ss.str();
+      }();
+      CHECK_EQ_OR_RETURN(content.size(), sizes[i])
+          << "the size of variable file " << filenames[i] << " mismatches the variable";
+      const char* buffer = content.data();
+#endif  // __linux__
+      const auto& callback = [&](of::ep::Stream* stream,
+                                 const std::shared_ptr<of::vm::EagerBlobObject>& blob_object) {
+        of::AutoMemcpy(stream, blob_object->mut_dptr(), buffer, sizes[i], blob_object->mem_case(),
+                       of::memory::MakeHostMemCase());
+      };
+      JUST(of::one::SyncAccessTensorWithTimeOut(variables[i], callback, "mut"));
+#ifdef __linux__
+      // Unmap the file once it is copied
+      files[i] = of::embedding::PosixMappedFile();
+#endif  // __linux__
+    }
+    return of::Maybe<void>::Ok();
+  };
+  const of::Maybe<void> copied = CopyVariables();
+#ifdef __linux__
+  // The page-in works read the mappings
+  for (const auto& counter : chunk_counters) { counter->WaitForeverUntilCntEqualZero(); }
+#endif  // __linux__
+  return copied;
+}
+
 #ifdef __linux__
 
 void LoadOneEmbedding(const std::string& model_path, const Device& device) {
@@ -152,6 +290,7 @@ class Graph::GraphImpl final {
 
   InputOutputInfos GetInputInfos();
   InputOutputInfos GetOutputInfos();
+  std::unordered_map<std::string, Tensor> GetVariables();
   std::vector<Tensor> Forward(const std::vector<Tensor>& inputs);
   void set_batch_size(int batch_size) { batch_size_ = batch_size; }
 
@@ -167,6 +306,7 @@ class Graph::GraphImpl final {
   of::Maybe<void> LoadCheckpoint();
   of::Maybe<void> RegisterTensors(const std::vector<Tensor>& inputs);
   of::Maybe<of::Job> ApplyJobPasses(const of::Job& job);
+  of::Maybe<std::string> GetSharedVariableKey(const std::string& variable_op_name) const;
 
   std::shared_ptr<of::NNGraph> graph_ = nullptr;
   std::string model_path_;
@@ -179,6 +319,10 @@ class Graph::GraphImpl final {
   InputOutputInfos output_infos_;
   of::HashMap<std::string, std::shared_ptr<of::one::Tensor>> output_name_to_tensor_;
   of::HashMap<std::string, std::shared_ptr<of::one::Tensor>> variable_op_name_to_tensor_;
+  bool share_variables_ = false;
+  // variables loaded by other graphs
+  of::HashSet<std::string> shared_variable_op_names_;
+  of::HashMap<std::string, std::string> variable_op_name_to_shared_key_;
   std::shared_ptr<of::one::TensorTuple> output_tensor_tuple_;
   std::shared_ptr<of::one::TensorTuple> parameter_tensor_tuple_;
   std::vector<std::function<std::string(const std::string&)>> registered_job_passes_;
@@ -201,6 +345,8 @@ InputOutputInfos Graph::GetInputInfos() { return graph_->GetInputInfos(); }
 
 InputOutputInfos Graph::GetOutputInfos() { return graph_->GetOutputInfos(); }
 
+std::unordered_map<std::string, Tensor> Graph::GetVariables() { return graph_->GetVariables(); }
+
 void Graph::RegisterJobPass(const std::function<std::string(const std::string& job)>& pass_fn) {
   CHECK_JUST(graph_->RegisterJobPass(pass_fn));
 }
@@ -242,6 +388,7 @@ Graph::GraphImpl::GraphImpl(const std::string& model_path, const Device& device)
   CHECK_JUST(of::LoadJobFromIR(&job_, model_path + "/model.mlir"));
   CollectInputOutputInfos();
   if (of::ParseBooleanFromEnv("ONEFLOW_SERVING_DEBUG", false)) { LOG(ERROR) << job_.DebugString(); }
+  share_variables_ = of::ParseBooleanFromEnv("ONEFLOW_SERVING_SHARE_VARIABLES", false);
   job_.mutable_job_conf()->mutable_predict_conf();
   job_.mutable_job_conf()->set_job_name(job_.mutable_job_conf()->job_name() + of::NewUniqueId());
 }
@@ -250,6 +397,14 @@ InputOutputInfos Graph::GraphImpl::GetInputInfos() { return input_infos_; }
 
 InputOutputInfos Graph::GraphImpl::GetOutputInfos() { return output_infos_; }
 
+std::unordered_map<std::string, Tensor> Graph::GraphImpl::GetVariables() {
+  std::unordered_map<std::string, Tensor> variables;
+  for (const auto& pair : variable_op_name_to_tensor_) {
+    variables.emplace(pair.first, Tensor(pair.second));
+  }
+  return variables;
+}
+
 of::Maybe<void> Graph::GraphImpl::CollectInputOutputInfos() {
   const of::OpGraph op_graph(job_);
   size_t input_order = 0;
@@ -350,10 +505,22 @@ of::Maybe<void> Graph::GraphImpl::BuildGraph() {
       if (op_conf.has_variable_conf()) {
         const of::LazyMode::Guard lazy_mode_disabled_guard{false};
         const of::VariableOpConf& variable_conf = op_conf.variable_conf();
-        variable_op_name_to_tensor_[op_conf.name()] = JUST(of::one::functional::Empty(
-            of::Shape(variable_conf.shape()),
-            JUST(of::DType::Get(static_cast<of::DataType>(variable_conf.data_type()))),
-            *device_.device_, /*pin_memory=*/false));
+        const of::Shape shape(variable_conf.shape());
+        const auto data_type = static_cast<of::DataType>(variable_conf.data_type());
+        std::shared_ptr<of::one::Tensor> variable;
+        if (share_variables_) {
+          const std::string key = JUST(GetSharedVariableKey(op_conf.name()));
+          variable_op_name_to_shared_key_[op_conf.name()] = key;
+          variable = SharedVariableMgr::Get()->Find(key);
+        }
+        if (variable && *variable->shape() == shape
+            && variable->dtype()->data_type() == data_type) {
+          shared_variable_op_names_.insert(op_conf.name());
+        } else {
+          variable = JUST(of::one::functional::Empty(shape, JUST(of::DType::Get(data_type)),
+                                                     *device_.device_, /*pin_memory=*/false));
+        }
+        variable_op_name_to_tensor_[op_conf.name()] = variable;
       }
       return of::Maybe<void>::Ok();
     });
@@ -392,26 +559,40 @@ of::Maybe<void> Graph::GraphImpl::BuildGraph() {
   return of::Maybe<void>::Ok();
 }
 
+// The identity and the modification time of the file are a part of the key, so that a model
+// rewritten in place is not shared with the graphs which loaded the old one.
+of::Maybe<std::string> Graph::GraphImpl::GetSharedVariableKey(
+    const std::string& variable_op_name) const {
+  const std::string filename = GetVariableFilename(model_path_, variable_op_name);
+  struct stat file_stat {};
+  CHECK_EQ_OR_RETURN(stat(filename.c_str(), &file_stat), 0)
+      << "variable file " << filename << " does not exist";
+  std::ostringstream key;
+  key << filename << "@" << (*device_.device_)->ToString() << "#" << file_stat.st_dev << ":"
+      << file_stat.st_ino << ":" << file_stat.st_size << ":" << file_stat.st_mtime;
+#ifdef __linux__
+  key << "." << file_stat.st_mtim.tv_nsec;
+#endif  // __linux__
+  return key.str();
+}
+
 of::Maybe<void> Graph::GraphImpl::LoadCheckpoint() {
+  std::vector<std::string> variable_op_names;
+  std::vector<std::string> variable_filenames;
+  std::vector<std::shared_ptr<of::one::Tensor>> variable_tensors;
   for (const auto& variable_op_name_and_tensor : variable_op_name_to_tensor_) {
     const auto& variable_op_name = variable_op_name_and_tensor.first;
-    const auto& variable_tensor = variable_op_name_and_tensor.second;
-    const std::string variable_filename = model_path_ + "/" + variable_op_name + "/out";
-    const std::string buffer = [&]() {
-      std::ifstream variable_file(variable_filename, std::ios::binary);
-      CHECK(variable_file.is_open());
-      std::stringstream ss;
-      ss << variable_file.rdbuf();
-      return ss.str();
-    }();
-    const auto& callback = [&](of::ep::Stream* stream,
-                               const std::shared_ptr<of::vm::EagerBlobObject>& eager_blob_object) {
-      of::AutoMemcpy(stream, eager_blob_object->mut_dptr(), buffer.data(),
-                     variable_tensor->shape()->elem_cnt()
-                         * of::GetSizeOfDataType(variable_tensor->dtype()->data_type()),
-                     eager_blob_object->mem_case(), of::memory::MakeHostMemCase());
-    };
-    JUST(of::one::SyncAccessTensorWithTimeOut(variable_tensor, callback, "mut"));
+    if (shared_variable_op_names_.count(variable_op_name) > 0) { continue; }
+    variable_op_names.emplace_back(variable_op_name);
+    variable_filenames.emplace_back(GetVariableFilename(model_path_, variable_op_name));
+    variable_tensors.emplace_back(variable_op_name_and_tensor.second);
+  }
+  JUST(LoadVariables(variable_filenames, variable_tensors));
+  if (share_variables_) {
+    for (size_t i = 0; i < variable_op_names.size(); ++i) {
+      SharedVariableMgr::Get()->Add(variable_op_name_to_shared_key_.at(variable_op_names[i]),
+                                    variable_tensors[i]);
+    }
   }
   const auto& pair = Unzip(variable_op_name_to_tensor_);
   JUST(of::FillVariableTensorMgr(pair.first, pair.second));
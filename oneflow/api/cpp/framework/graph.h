@@ -62,6 +62,8 @@ class Graph {
 
   InputOutputInfos GetInputInfos();
   InputOutputInfos GetOutputInfos();
+  // The variables by op name, loaded by the first Forward.
+  std::unordered_map<std::string, Tensor> GetVariables();
   IValue Forward(const IValue& inputs);
   void set_batch_size(int batch_size);
 
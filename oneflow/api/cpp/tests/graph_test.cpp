@@ -19,6 +19,7 @@ limitations under the License.
 #include <array>
 #include <chrono>
 #include <cstdint>
+#include <cstdlib>
 #include <functional>
 #include <iostream>
 #include <thread>
@@ -159,6 +160,34 @@ TEST(Api, graph_thread_test) {
   for (auto& thread : threads) { thread.join(); }
 }
 
+TEST(Api, graph_share_variables_test) {
+  EnvScope scope;
+  setenv("ONEFLOW_SERVING_SHARE_VARIABLES", "1", 1);
+
+  Device device("cpu");
+  Graph graph = LoadGraph(device);
+  Forward(graph, device, 1);
+  // shares the variables loaded by the graph above
+  Graph graph1 = LoadGraph(device);
+  Forward(graph1, device, 1);
+
+  unsetenv("ONEFLOW_SERVING_SHARE_VARIABLES");
+  Graph graph2 = LoadGraph(device);
+  Forward(graph2, device, 1);
+  Forward(graph, device, 1);
+
+  const auto variables = graph.GetVariables();
+  const auto variables1 = graph1.GetVariables();
+  const auto variables2 = graph2.GetVariables();
+  ASSERT_FALSE(variables.empty());
+  ASSERT_EQ(variables1.size(), variables.size());
+  ASSERT_EQ(variables2.size(), variables.size());
+  for (const auto& pair : variables) {
+    ASSERT_EQ(variables1.at(pair.first).__internal_tensor(), pair.second.__internal_tensor());
+    ASSERT_NE(variables2.at(pair.first).__internal_tensor(), pair.second.__internal_tensor());
+  }
+}
+
 TEST(Api, graph_input_order_test) {
   EnvScope scope;
 
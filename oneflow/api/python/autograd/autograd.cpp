@@ -31,6 +31,7 @@ limitations under the License.
 #include "oneflow/core/common/util.h"
 #include "oneflow/core/common/container_util.h"
 #include "oneflow/core/framework/saved_tensor_hooks.h"
+#include "oneflow/core/autograd/saved_tensor_policy.h"
 #include "oneflow/extension/stack/python/stack_getter.h"
 
 namespace oneflow {
@@ -149,46 +150,69 @@ class PySavedTensorHook final : public one::SavedTensorHook {
 
 class PySavedTensorHookCreator final : public one::SavedTensorHookCreator {
  public:
+  PySavedTensorHookCreator(const py::function& pack_hook, const py::function& unpack_hook)
+      : pack_hook_(pack_hook), unpack_hook_(unpack_hook) {}
+
   std::unique_ptr<one::SavedTensorHook> new_saved_tensor_hook() const override {
-    if (hooks_.empty()) { return nullptr; }
-    return std::make_unique<PySavedTensorHook>(hooks_.back().first, hooks_.back().second);
-  }
-  void append_new_hooks(const py::function& pack_hook, const py::function& unpack_hook) {
-    hooks_.emplace_back(pack_hook, unpack_hook);
-  }
-  void pop_hooks() {
-    CHECK_OR_THROW(!hooks_.empty()) << "pop_hooks should not be called when there are no hooks";
-    hooks_.pop_back();
+    return std::make_unique<PySavedTensorHook>(pack_hook_, unpack_hook_);
   }
 
  private:
-  small_vector<std::pair<py::function, py::function>, 1> hooks_;
+  py::function pack_hook_;
+  py::function unpack_hook_;
 };
 
+one::SavedTensorHookCreatorStack* GetSavedTensorHookCreatorStack(const std::string& caller) {
+  auto* stack = dynamic_cast<one::SavedTensorHookCreatorStack*>(
+      Singleton<one::SavedTensorHookCreator>::Get());
+  CHECK_NOTNULL_OR_THROW(stack) << "`register_saved_tensors_hook_manager` should be called "
+                                   "before calling `"
+                                << caller << "`";
+  return stack;
+}
+
 ONEFLOW_API_PYBIND11_MODULE("autograd", m) {
   m.def("backward", &Backward);
   m.def("grad", &Grad);
-  m.def_submodule("graph")
+  py::module graph = m.def_submodule("graph");
+  py::class_<one::OffloadSavedTensorHookCreator,
+             std::shared_ptr<one::OffloadSavedTensorHookCreator>>(graph, "OffloadHooks")
+      .def_property_readonly("num_offloaded", &one::OffloadSavedTensorHookCreator::num_offloaded);
+  graph
       .def("register_saved_tensors_hook_manager",
            []() {
-             Singleton<one::SavedTensorHookCreator>::SetAllocated(new PySavedTensorHookCreator());
+             Singleton<one::SavedTensorHookCreator>::SetAllocated(
+                 new one::SavedTensorHookCreatorStack());
            })
       .def("append_new_hooks",
            [](const py::function& pack_hook, const py::function& unpack_hook) {
-             PySavedTensorHookCreator* creator = dynamic_cast<PySavedTensorHookCreator*>(
-                 Singleton<one::SavedTensorHookCreator>::Get());
-             CHECK_NOTNULL_OR_THROW(creator)
-                 << "`register_saved_tensors_hook_manager` should be called "
-                    "before calling `append_new_hooks`";
-             creator->append_new_hooks(pack_hook, unpack_hook);
+             GetSavedTensorHookCreatorStack("append_new_hooks")
+                 ->push(std::make_shared<PySavedTensorHookCreator>(pack_hook, unpack_hook));
+           })
+      .def("append_offload_hooks",
+           [](bool pin_memory, bool compress_to_bf16, int64_t prefetch_depth, int64_t min_bytes) {
+             auto hooks = std::make_shared<one::OffloadSavedTensorHookCreator>(
+                 pin_memory, compress_to_bf16, prefetch_depth, min_bytes);
+             GetSavedTensorHookCreatorStack("append_offload_hooks")->push(hooks);
+             return hooks;
+           })
+      .def("append_recompute_hooks",
+           [](const py::function& forward) {
+             // the segment may be released by backward without holding the GIL
+             std::shared_ptr<py::function> function(new py::function(forward),
+                                                    [](py::function* f) {
+                                                      py::gil_scoped_acquire acquire;
+                                                      delete f;
+                                                    });
+             GetSavedTensorHookCreatorStack("append_recompute_hooks")
+                 ->push(std::make_shared<one::RecomputeSavedTensorHookCreator>(
+                     [function]() -> Maybe<void> {
+                       py::gil_scoped_acquire acquire;
+                       (*function)();
+                       return Maybe<void>::Ok();
+                     }));
            })
-      .def("pop_hooks", []() {
-        PySavedTensorHookCreator* creator =
-            dynamic_cast<PySavedTensorHookCreator*>(Singleton<one::SavedTensorHookCreator>::Get());
-        CHECK_NOTNULL_OR_THROW(creator) << "`register_saved_tensors_hook_manager` should be called "
-                                           "before calling `pop_hooks`";
-        creator->pop_hooks();
-      });
+      .def("pop_hooks", []() { GetSavedTensorHookCreatorStack("pop_hooks")->pop(); });
 }
 
 }  // namespace autograd
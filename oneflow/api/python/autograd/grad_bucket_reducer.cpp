@@ -0,0 +1,46 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include <pybind11/pybind11.h>
+#include <pybind11/stl.h>
+#include "oneflow/api/python/of_api_registry.h"
+#include "oneflow/core/autograd/grad_bucket_reducer.h"
+#include "oneflow/core/framework/tensor.h"
+
+namespace py = pybind11;
+
+namespace oneflow {
+
+ONEFLOW_API_PYBIND11_MODULE("", m) {
+  py::class_<one::GradBucketReducer, std::shared_ptr<one::GradBucketReducer>>(
+      m, "GradBucketReducer")
+      .def(py::init([](const std::vector<std::shared_ptr<one::Tensor>>& params,
+                       int64_t max_params_per_bucket, int64_t bucket_cap_bytes) {
+        one::TensorTuple param_tuple(params.size());
+        for (int i = 0; i < params.size(); ++i) { param_tuple[i] = params[i]; }
+        return one::GradBucketReducer::New(param_tuple, max_params_per_bucket, bucket_cap_bytes)
+            .GetPtrOrThrow();
+      }))
+      .def("reset", &one::GradBucketReducer::Reset)
+      .def_property_readonly("buckets", [](const one::GradBucketReducer& reducer) {
+        std::vector<std::vector<size_t>> buckets;
+        for (size_t i = 0; i < reducer.num_buckets(); ++i) {
+          buckets.emplace_back(reducer.bucket_param_indices(i));
+        }
+        return buckets;
+      });
+}
+
+}  // namespace oneflow
@@ -16,6 +16,7 @@ limitations under the License.
 #include <pybind11/pybind11.h>
 #include "oneflow/api/python/of_api_registry.h"
 #include "oneflow/core/vm/vm_util.h"
+#include "oneflow/core/vm/elementwise_fusion.h"
 #include "oneflow/core/eager/dev_vm_dep_object_consume_mode.h"
 
 ONEFLOW_API_PYBIND11_MODULE("eager", m) {
@@ -30,6 +31,8 @@ ONEFLOW_API_PYBIND11_MODULE("eager", m) {
              std::shared_ptr<one::DevVmDepObjectConsumeModeGuard>>(
       m, "DevVmDepObjectConsumeModeGuard");
 
+  m.def("fused_elementwise_instruction_count", &vm::FusedElementwiseInstructionCount);
+
   m.def("SourceOpOnlyResourceDependenceModeGuard", []() {
     return std::make_shared<one::DevVmDepObjectConsumeModeGuard>(
         one::DevVmDepObjectConsumeMode::NONE);
@@ -19,6 +19,7 @@ limitations under the License.
 #include <string>
 #include "oneflow/api/python/job_build/job_build_and_infer.h"
 #include "oneflow/api/python/of_api_registry.h"
+#include "oneflow/core/auto_parallel/sbp_constructor.h"
 #include "oneflow/core/framework/multi_client_session_context.h"
 #include "oneflow/core/framework/tensor.h"
 #include "oneflow/core/framework/nn_graph.h"
@@ -112,12 +113,16 @@ ONEFLOW_API_PYBIND11_MODULE("nn.graph.", m) {
       .def("build_with_new_input_from_shared_graph", &NNGraph::BuildWithNewInputFromSharedGraph)
       .def("compile_plan_for_runtime", &NNGraph::CompilePlanForRuntime)
       .def("init_runtime", &NNGraph::InitRuntime)
+      .def("analyze_execution", &NNGraph::AnalyzeExecution)
+      .def("analyze_roofline", &NNGraph::AnalyzeRoofline)
+      .def("record_auto_parallel_cost", &NNGraph::RecordAutoParallelCost)
       .def("get_current_job_str", &APINNGraphGetCurrentSerializedJob);
 
   m.def("RunLazyNNGraph", &RunLazyNNGraph);
   m.def("RunLazyNNGraphByVM", &one::InterpretJob);
   m.def("SoftSyncNNGraphBuffers", &SoftSyncNNGraphBuffers);
   m.def("AddTensorAsGraphLoss", &AddTensorAsGraphLoss);
+  m.def("GetAutoParallelLastSearchReusedOpNum", &auto_parallel::LastSearchReusedOpNum);
   m.def("MarkVariableGradients", [](const std::vector<std::shared_ptr<one::Tensor>>& variables,
                                     const std::vector<std::shared_ptr<one::Tensor>>& gradients) {
     one::TensorTuple variable_tuple(variables.size());
@@ -61,13 +61,15 @@ ONEFLOW_FUNCTION_LIBRARY(m) {
       [](const std::shared_ptr<OpExpr>& op, const std::string& data_dir, int32_t data_part_num,
          const std::string& part_name_prefix, int32_t part_name_suffix_length, int32_t batch_size,
          int32_t shuffle_buffer_size, bool random_shuffle, bool shuffle_after_epoch, int64_t seed,
+         bool use_index, int64_t start_sample,
          const Optional<Symbol<Device>>& device) -> Maybe<Tensor> {
         auto& attrs = THREAD_CACHED_MUTABLE_ATTR_MAP(
             "data_dir", "data_part_num", "part_name_prefix", "part_name_suffix_length",
-            "batch_size", "shuffle_buffer_size", "random_shuffle", "shuffle_after_epoch", "seed");
+            "batch_size", "shuffle_buffer_size", "random_shuffle", "shuffle_after_epoch", "seed",
+            "use_index", "start_sample");
         attrs.SetAllAttrs(data_dir, data_part_num, part_name_prefix, part_name_suffix_length,
                           batch_size, shuffle_buffer_size, random_shuffle, shuffle_after_epoch,
-                          seed);
+                          seed, use_index, start_sample);
         return OpInterpUtil::Dispatch<Tensor>(*op, {}, OpExprInterpContext(attrs, JUST(device)));
       });
   m.add_functor(
@@ -75,15 +77,15 @@ ONEFLOW_FUNCTION_LIBRARY(m) {
       [](const std::shared_ptr<OpExpr>& op, const std::string& data_dir, int32_t data_part_num,
          const std::string& part_name_prefix, int32_t part_name_suffix_length, int32_t batch_size,
          int32_t shuffle_buffer_size, bool random_shuffle, bool shuffle_after_epoch, int64_t seed,
-         const Symbol<ParallelDesc>& placement,
+         bool use_index, int64_t start_sample, const Symbol<ParallelDesc>& placement,
          const std::vector<Symbol<SbpParallel>>& sbp_tuple) -> Maybe<Tensor> {
         auto& attrs = THREAD_CACHED_MUTABLE_ATTR_MAP(
             "data_dir", "data_part_num", "part_name_prefix", "part_name_suffix_length",
             "batch_size", "shuffle_buffer_size", "random_shuffle", "shuffle_after_epoch", "seed",
-            "nd_sbp");
+            "use_index", "start_sample", "nd_sbp");
         attrs.SetAllAttrs(data_dir, data_part_num, part_name_prefix, part_name_suffix_length,
                           batch_size, shuffle_buffer_size, random_shuffle, shuffle_after_epoch,
-                          seed, *JUST(GetNdSbpStrList(sbp_tuple)));
+                          seed, use_index, start_sample, *JUST(GetNdSbpStrList(sbp_tuple)));
         auto nd_sbp = JUST(GetNdSbp(sbp_tuple));
         return OpInterpUtil::Dispatch<Tensor>(*op, {},
                                               OpExprInterpContext(attrs, placement, nd_sbp));
@@ -166,6 +168,23 @@ ONEFLOW_FUNCTION_LIBRARY(m) {
                           random_aspect_ratio);
         return OpInterpUtil::Dispatch<Tensor>(*op, {input}, attrs);
       });
+  m.add_functor(
+      "DispatchOfrecordImageDecoderRandomCropResizeNormalize",
+      [](const std::shared_ptr<OpExpr>& op, const TensorTuple& input, const std::string& name,
+         int64_t target_width, int64_t target_height, const std::vector<float>& mean,
+         const std::vector<float>& std, const std::string& color_space,
+         const std::string& output_layout, const std::string& interpolation_type,
+         const std::vector<float>& random_area, const std::vector<float>& random_aspect_ratio,
+         int32_t num_attempts, int64_t seed, bool has_seed) -> Maybe<Tensor> {
+        auto& attrs = THREAD_CACHED_MUTABLE_ATTR_MAP(
+            "name", "color_space", "num_attempts", "seed", "has_seed", "random_area",
+            "random_aspect_ratio", "target_width", "target_height", "interpolation_type",
+            "output_layout", "mean", "std");
+        attrs.SetAllAttrs(name, color_space, num_attempts, seed, has_seed, random_area,
+                          random_aspect_ratio, target_width, target_height, interpolation_type,
+                          output_layout, mean, std);
+        return OpInterpUtil::Dispatch<Tensor>(*op, input, attrs);
+      });
   m.add_functor("DispatchOfrecordImageDecoder",
                 [](const std::shared_ptr<OpExpr>& op, const std::shared_ptr<Tensor>& input,
                    const std::string& name, const std::string& color_space) -> Maybe<Tensor> {
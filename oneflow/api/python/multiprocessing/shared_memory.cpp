@@ -37,6 +37,26 @@ ONEFLOW_API_PYBIND11_MODULE("multiprocessing", m) {
                              })
       .def_property_readonly("name", &ipc::SharedMemory::name)
       .def_property_readonly("size", &ipc::SharedMemory::size);
+  py::class_<ipc::SharedMemorySlab, std::shared_ptr<ipc::SharedMemorySlab>>(m, "SharedMemorySlab")
+      .def(py::init([](const std::string& name, bool create, size_t slot_num, size_t slot_size) {
+             if (create) {
+               return ipc::SharedMemorySlab::Create(slot_num, slot_size).GetPtrOrThrow();
+             }
+             return ipc::SharedMemorySlab::Open(name).GetPtrOrThrow();
+           }),
+           py::arg("name") = "", py::arg("create") = false, py::arg("slot_num") = 0,
+           py::arg("slot_size") = 0)
+      .def("acquire_slot", &ipc::SharedMemorySlab::AcquireSlot)
+      .def("release_slot", &ipc::SharedMemorySlab::ReleaseSlot)
+      .def("slot_buf",
+           [](ipc::SharedMemorySlab* slab, int64_t slot_id) {
+             char* buf = slab->MutSlotBuf(slot_id).GetOrThrow();
+             return py::memoryview::from_memory(buf, slab->slot_size());
+           })
+      .def("unlink", &ipc::SharedMemorySlab::Unlink)
+      .def_property_readonly("name", &ipc::SharedMemorySlab::name)
+      .def_property_readonly("slot_num", &ipc::SharedMemorySlab::slot_num)
+      .def_property_readonly("slot_size", &ipc::SharedMemorySlab::slot_size);
   m.def("unlink_all_shared_memory",
         []() { return ipc::SharedMemoryManager::get().UnlinkAllShms(); });
 }
@@ -0,0 +1,237 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "oneflow/core/auto_parallel/cost_database.h"
+#include <fcntl.h>
+#include <sys/file.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include "nlohmann/json.hpp"
+#include "oneflow/core/framework/nd_sbp.h"
+#include "oneflow/core/framework/to_string.h"
+#include "oneflow/core/job/parallel_desc.h"
+#include "oneflow/core/job/plan_util.h"
+#include "oneflow/core/operator/operator.h"
+#include "oneflow/core/register/blob_desc.h"
+
+namespace oneflow {
+namespace auto_parallel {
+
+namespace {
+
+std::string OpTypeKey(const OperatorConf& op_conf) {
+  if (op_conf.has_user_conf()) { return op_conf.user_conf().op_type_name(); }
+  return "system_" + std::to_string(op_conf.op_type_case());
+}
+
+std::string BlobKey(const Shape& shape, DataType data_type) {
+  return shape.ToString() + ":" + DataType_Name(data_type);
+}
+
+std::string PlacementKey(const ParallelDesc& parallel_desc) {
+  return parallel_desc.device_tag() + parallel_desc.hierarchy()->ToString();
+}
+
+std::string OpKeyImpl(const std::string& op_type, const std::string& placement,
+                      const PbRpf<std::string>& input_bns, const PbRpf<std::string>& output_bns,
+                      const std::function<std::string(const std::string&)>& BlobKey4Bn,
+                      const NdSbpSignature& nd_sbp_signature) {
+  std::string key = op_type + "|" + placement;
+  const auto& AppendBn = [&](const std::string& bn) {
+    key += "|" + bn + "=" + BlobKey4Bn(bn) + "@";
+    const auto it = nd_sbp_signature.bn_in_op2nd_sbp().find(bn);
+    if (it != nd_sbp_signature.bn_in_op2nd_sbp().end()) { key += NdSbpToString(it->second); }
+  };
+  for (const auto& bn : input_bns) { AppendBn(bn); }
+  for (const auto& bn : output_bns) { AppendBn(bn); }
+  return key;
+}
+
+std::string BoxingKeyImpl(const std::string& blob, const std::string& src_placement,
+                          const NdSbp& src_nd_sbp, const std::string& dst_placement,
+                          const NdSbp& dst_nd_sbp) {
+  return blob + "|" + src_placement + NdSbpToString(src_nd_sbp) + "|" + dst_placement
+         + NdSbpToString(dst_nd_sbp);
+}
+
+// Holds the lock taken on the file for its lifetime.
+class ScopedFileLock final {
+ public:
+  OF_DISALLOW_COPY_AND_MOVE(ScopedFileLock);
+  explicit ScopedFileLock(int fd) : fd_(fd) {}
+  // closing the file releases the lock
+  ~ScopedFileLock() { close(fd_); }
+
+ private:
+  int fd_;
+};
+
+}  // namespace
+
+/*static*/ std::string CostDatabase::OpKey(
+    const Operator& op, const NdSbpSignature& nd_sbp_signature,
+    const std::function<const BlobDesc&(const std::string&)>& BlobDesc4Bn,
+    const ParallelDesc& parallel_desc) {
+  return OpKeyImpl(
+      OpTypeKey(op.op_conf()), PlacementKey(parallel_desc), op.input_bns(), op.output_bns(),
+      [&](const std::string& bn) {
+        const BlobDesc& blob_desc = BlobDesc4Bn(bn);
+        return BlobKey(blob_desc.shape(), blob_desc.data_type());
+      },
+      nd_sbp_signature);
+}
+
+/*static*/ std::string CostDatabase::BoxingKey(const BlobDesc& logical_blob_desc,
+                                               const NdSbp& src_nd_sbp, const NdSbp& dst_nd_sbp,
+                                               const ParallelDesc& src_parallel_desc,
+                                               const ParallelDesc& dst_parallel_desc) {
+  return BoxingKeyImpl(BlobKey(logical_blob_desc.shape(), logical_blob_desc.data_type()),
+                       PlacementKey(src_parallel_desc), src_nd_sbp,
+                       PlacementKey(dst_parallel_desc), dst_nd_sbp);
+}
+
+Maybe<void> CostDatabase::Load(const std::string& path) {
+  using json = nlohmann::json;
+  std::ifstream in(path);
+  CHECK_OR_RETURN(in.is_open()) << "Cannot open the auto parallel cost database " << path;
+  json database;
+  in >> database;
+  const auto& LoadTimes = [&](const std::string& name, HashMap<std::string, MeasuredTime>* times) {
+    if (!database.contains(name)) { return; }
+    for (const auto& item : database.at(name).items()) {
+      MeasuredTime* time = &(*times)[item.key()];
+      time->total_us += item.value().at("total_us").get<double>();
+      time->count += item.value().at("count").get<int64_t>();
+    }
+  };
+  LoadTimes("ops", &op_key2time_);
+  LoadTimes("boxing", &boxing_key2time_);
+  return Maybe<void>::Ok();
+}
+
+Maybe<void> CostDatabase::Save(const std::string& path) const {
+  using json = nlohmann::json;
+  const auto& TimesJson = [](const HashMap<std::string, MeasuredTime>& times) {
+    json j = json::object();
+    for (const auto& pair : times) {
+      j[pair.first] = {{"total_us", pair.second.total_us}, {"count", pair.second.count}};
+    }
+    return j;
+  };
+  json database{{"ops", TimesJson(op_key2time_)}, {"boxing", TimesJson(boxing_key2time_)}};
+  const std::string tmp_path = path + ".tmp" + std::to_string(getpid());
+  {
+    std::ofstream out(tmp_path);
+    CHECK_OR_RETURN(out.is_open()) << "Cannot write the auto parallel cost database " << tmp_path;
+    out << database.dump(1);
+    CHECK_OR_RETURN(out.flush().good())
+        << "Cannot write the auto parallel cost database " << tmp_path;
+  }
+  CHECK_EQ_OR_RETURN(std::rename(tmp_path.c_str(), path.c_str()), 0)
+      << "Cannot replace the auto parallel cost database " << path << ": " << strerror(errno);
+  return Maybe<void>::Ok();
+}
+
+/*static*/ Maybe<void> CostDatabase::UpdateFile(
+    const std::string& path, const std::function<Maybe<void>(CostDatabase*)>& Update) {
+  const std::string lock_path = path + ".lock";
+  const int fd = open(lock_path.c_str(), O_RDWR | O_CREAT, 0644);
+  CHECK_OR_RETURN(fd != -1) << "Cannot create " << lock_path << ": " << strerror(errno);
+  ScopedFileLock lock(fd);
+  CHECK_EQ_OR_RETURN(flock(fd, LOCK_EX), 0)
+      << "Cannot lock " << lock_path << ": " << strerror(errno);
+  CostDatabase database;
+  if (std::ifstream(path).good()) { JUST(database.Load(path)); }
+  JUST(Update(&database));
+  return database.Save(path);
+}
+
+Maybe<void> CostDatabase::AddKernelTimes(
+    const Plan& plan, int64_t machine_id,
+    const HashMap<std::pair<int64_t, int64_t>, std::vector<int64_t>>& actor_kernel2durations) {
+  HashMap<int64_t, const TaskProto*> task_id2task;
+  for (const TaskProto& task : plan.task()) {
+    if (task.machine_id() == machine_id) { task_id2task.emplace(task.task_id(), &task); }
+  }
+  // The kernels on cuda streams are timed by cuda events, the kernels on other devices are
+  // launched asynchronously and their recorded times are device times only if every kernel is
+  // synchronized after its launch.
+  const bool kernel_synced = ParseBooleanFromEnv("ONEFLOW_DEBUG_KERNEL_SYNC_CHECK", false);
+  for (const auto& pair : actor_kernel2durations) {
+    const auto task_it = task_id2task.find(pair.first.first);
+    if (task_it == task_id2task.end() || pair.second.empty()) { continue; }
+    const auto& exec_nodes = task_it->second->exec_sequence().exec_node();
+    if (pair.first.second >= exec_nodes.size()) { continue; }
+    const OpAttribute& op_attribute =
+        exec_nodes.Get(pair.first.second).kernel_conf().op_attribute();
+    const OperatorConf& op_conf = op_attribute.op_conf();
+    std::string key;
+    HashMap<std::string, MeasuredTime>* key2time = nullptr;
+    if (op_conf.has_nccl_send_recv_boxing_conf()) {
+      const auto& conf = op_conf.nccl_send_recv_boxing_conf();
+      key = BoxingKeyImpl(BlobKey(Shape(conf.logical_shape()), conf.data_type()),
+                          PlacementKey(ParallelDesc(conf.src_parallel_conf())), conf.src_nd_sbp(),
+                          PlacementKey(ParallelDesc(conf.dst_parallel_conf())), conf.dst_nd_sbp());
+      key2time = &boxing_key2time_;
+    } else if (op_attribute.has_nd_sbp_signature()
+               && op_attribute.has_logical_blob_desc_signature()
+               && op_attribute.parallel_conf_signature().has_op_parallel_conf()) {
+      const auto& bn2blob_desc = op_attribute.logical_blob_desc_signature().bn_in_op2blob_desc();
+      key = OpKeyImpl(
+          OpTypeKey(op_conf),
+          PlacementKey(ParallelDesc(op_attribute.parallel_conf_signature().op_parallel_conf())),
+          op_attribute.input_bns(), op_attribute.output_bns(),
+          [&](const std::string& bn) -> std::string {
+            const auto it = bn2blob_desc.find(bn);
+            if (it == bn2blob_desc.end()) { return ""; }
+            return BlobKey(Shape(it->second.shape()), it->second.data_type());
+          },
+          op_attribute.nd_sbp_signature());
+      key2time = &op_key2time_;
+    } else {
+      continue;
+    }
+    const DeviceType device_type =
+        PlanUtil::GetStreamId(*task_it->second).device_id().device_type();
+    CHECK_OR_RETURN(device_type == DeviceType::kCPU || device_type == DeviceType::kCUDA
+                    || kernel_synced)
+        << "The recorded times of " << *JUST(DeviceTag4DeviceType(device_type))
+        << " kernels are launch times, set ONEFLOW_DEBUG_KERNEL_SYNC_CHECK=1 when running the "
+           "graph to measure them";
+    MeasuredTime* time = &(*key2time)[key];
+    for (int64_t duration_ns : pair.second) { time->total_us += duration_ns / 1000.0; }
+    time->count += pair.second.size();
+  }
+  return Maybe<void>::Ok();
+}
+
+/*static*/ double CostDatabase::MeanTime(const HashMap<std::string, MeasuredTime>& key2time,
+                                         const std::string& key) {
+  const auto it = key2time.find(key);
+  if (it == key2time.end() || it->second.count == 0) { return -1.0; }
+  return it->second.total_us / it->second.count;
+}
+
+double CostDatabase::OpTime(const std::string& key) const { return MeanTime(op_key2time_, key); }
+
+double CostDatabase::BoxingTime(const std::string& key) const {
+  return MeanTime(boxing_key2time_, key);
+}
+
+}  // namespace auto_parallel
+}  // namespace oneflow
@@ -0,0 +1,88 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#ifndef ONEFLOW_CORE_AUTO_PARALLEL_COST_DATABASE_H_
+#define ONEFLOW_CORE_AUTO_PARALLEL_COST_DATABASE_H_
+
+#include "oneflow/core/common/util.h"
+#include "oneflow/core/common/maybe.h"
+#include "oneflow/core/job/plan.pb.h"
+#include "oneflow/core/job/sbp_parallel.pb.h"
+
+namespace oneflow {
+
+class BlobDesc;
+class Operator;
+class ParallelDesc;
+
+namespace auto_parallel {
+
+// The times of ops and boxing measured on the actual machine, in us per kernel launch. An op is
+// keyed by its type, placement, logical shapes and sbp signature, a boxing by the logical shape
+// and the placement and sbp of both sides. The database is recorded from the traced runs of
+// graphs and stored as json on disk.
+class CostDatabase final {
+ public:
+  OF_DISALLOW_COPY_AND_MOVE(CostDatabase);
+  CostDatabase() = default;
+  ~CostDatabase() = default;
+
+  Maybe<void> Load(const std::string& path);
+  // The file is replaced by a rename, so that it is never read half written.
+  Maybe<void> Save(const std::string& path) const;
+
+  // Loads the database at `path` if it exists, applies `Update` and saves it back. An exclusive
+  // flock on `path`.lock serializes the ranks and processes which update the same file, so that
+  // none of them loses the times added by the others.
+  static Maybe<void> UpdateFile(const std::string& path,
+                                const std::function<Maybe<void>(CostDatabase*)>& Update);
+
+  // Adds the durations recorded for the kernels of `machine_id`, keyed by actor id and kernel
+  // index. Only the kernels of ops with a sbp signature and of nccl send/recv boxing are measured.
+  Maybe<void> AddKernelTimes(
+      const Plan& plan, int64_t machine_id,
+      const HashMap<std::pair<int64_t, int64_t>, std::vector<int64_t>>& actor_kernel2durations);
+
+  // Return the mean measured time, or a negative value if the key is not measured.
+  double OpTime(const std::string& key) const;
+  double BoxingTime(const std::string& key) const;
+
+  size_t op_size() const { return op_key2time_.size(); }
+  size_t boxing_size() const { return boxing_key2time_.size(); }
+
+  static std::string OpKey(const Operator& op, const NdSbpSignature& nd_sbp_signature,
+                           const std::function<const BlobDesc&(const std::string&)>& BlobDesc4Bn,
+                           const ParallelDesc& parallel_desc);
+  static std::string BoxingKey(const BlobDesc& logical_blob_desc, const NdSbp& src_nd_sbp,
+                               const NdSbp& dst_nd_sbp, const ParallelDesc& src_parallel_desc,
+                               const ParallelDesc& dst_parallel_desc);
+
+ private:
+  struct MeasuredTime {
+    double total_us = 0;
+    int64_t count = 0;
+  };
+
+  static double MeanTime(const HashMap<std::string, MeasuredTime>& key2time,
+                         const std::string& key);
+
+  HashMap<std::string, MeasuredTime> op_key2time_;
+  HashMap<std::string, MeasuredTime> boxing_key2time_;
+};
+
+}  // namespace auto_parallel
+}  // namespace oneflow
+
+#endif  // ONEFLOW_CORE_AUTO_PARALLEL_COST_DATABASE_H_
@@ -15,15 +15,20 @@ limitations under the License.
 */
 
 #include "oneflow/core/auto_parallel/sbp_constructor.h"
+#include <algorithm>
+#include <tuple>
+#include <mutex>
 #include "oneflow/core/auto_parallel/auto_memory.h"
 #include "oneflow/core/auto_parallel/sbp_node.h"
 #include "oneflow/core/auto_parallel/sbp_util.h"
+#include "oneflow/core/common/hash.h"
 #include "oneflow/core/common/singleton.h"
 #include "oneflow/core/device/cuda_util.h"
 #include "oneflow/core/framework/sbp_infer_util.h"
 #include "oneflow/core/graph/op_graph.h"
 #include "oneflow/core/job/job_conf.pb.h"
 #include "oneflow/core/job/job_desc.h"
+#include "oneflow/core/job/lazy_mode.h"
 #include "oneflow/core/job/sbp_parallel.h"
 #include "oneflow/core/framework/nd_sbp.h"
 #include "oneflow/core/job/job.pb.h"
@@ -62,6 +67,40 @@ double UpdateMemoryRatio() {
   }
 }
 
+// The measured times are in us while the analytic costs are in their own unit. Convert the times
+// by the median ratio between the analytic cost and the measured time of all the measured
+// entries, so that the measured costs stay comparable to the costs which are not measured.
+double MedianCostPerUs(const std::vector<std::pair<double, double>>& analytic_cost7measured_us) {
+  std::vector<double> ratios;
+  for (const auto& pair : analytic_cost7measured_us) {
+    if (pair.second > 0.0) { ratios.push_back(pair.first / pair.second); }
+  }
+  if (ratios.empty()) { return 0.0; }
+  std::nth_element(ratios.begin(), ratios.begin() + ratios.size() / 2, ratios.end());
+  return ratios[ratios.size() / 2];
+}
+
+// The sbp signature found by the last search of an op in this process
+struct SearchedSbpSignature {
+  size_t fingerprint;
+  int32_t sbp_sig_id;
+};
+
+std::mutex* SearchedSbpSignatureMutex() {
+  static std::mutex mutex;
+  return &mutex;
+}
+
+HashMap<std::string, SearchedSbpSignature>* MutOpName2SearchedSbpSignature() {
+  static HashMap<std::string, SearchedSbpSignature> op_name2searched_sbp_signature;
+  return &op_name2searched_sbp_signature;
+}
+
+int64_t* MutLastSearchReusedOpNum() {
+  static int64_t reused_op_num = 0;
+  return &reused_op_num;
+}
+
 }  // namespace
 
 double kMemoryRatio;
@@ -76,10 +115,16 @@ Maybe<void> SbpConstructor::InitSbpGraph(const OpGraph& op_graph, const Job& job
   nccl_use_compute_stream_ = Singleton<ResourceDesc, ForSession>::Get()->nccl_use_compute_stream();
   ams = job.job_conf().enable_auto_memory();
   kMemoryRatio = UpdateMemoryRatio();
+  const std::string& cost_database_path = job.job_conf().auto_parallel_cost_database_path();
+  if (!cost_database_path.empty()) {
+    cost_database_.reset(new CostDatabase());
+    JUST(cost_database_->Load(cost_database_path));
+  }
   // TODO: process local node
   JUST(GenerateNodeAndEdge(op_graph, job));
   JUST(FillSbpSignatureForOpNode(op_graph, job));
   JUST(InitComputationCost(op_graph));
+  if (cost_database_) { JUST(ApplyMeasuredComputationCost(op_graph)); }
   if (enable_trunk_algo_) { JUST(ApplyTrunkAlgo()); }
   // Load logical blobs on all sbp edges.
   LoadLbi2SbpEdge(op_graph);
@@ -96,6 +141,8 @@ Maybe<void> SbpConstructor::InitSbpGraph(const OpGraph& op_graph, const Job& job
   }
 
   JUST(InitCopyAndMemoryCost(op_graph));
+  // The sbp proxies of the collector carry the copy cost of several consumers
+  if (cost_database_ && !use_sbp_collector_) { JUST(ApplyMeasuredCopyCost(op_graph)); }
   // We need to store the original cost and memory after the initialization (InitComputationCost(),
   // InitMemory(), InitCopyAndMemoryCost()) and before the usage of them (InitWeightedCost())
   sbp_graph_.StoreOriginMemory();
@@ -114,6 +161,11 @@ Maybe<void> SbpConstructor::InitSbpGraph(const OpGraph& op_graph, const Job& job
     ori_cost = sbp_graph_.ComputeCost();
     LOG(INFO) << "OpGraph cost: " << ori_cost;
   }
+  if (incremental_search_) {
+    ApplyLastSearch();
+    ori_cost = sbp_graph_.ComputeCost();
+    LOG(INFO) << "Last search cost: " << ori_cost;
+  }
   return Maybe<void>::Ok();
 }
 
@@ -130,7 +182,11 @@ Maybe<void> SbpConstructor::FindBestSbpSignature() {
 
   int32_t step = 1;
   while (true) {
-    sbp_graph_.GreedyStrategy(/*nbh_num=*/4);
+    if (concurrent_search_) {
+      sbp_graph_.ConcurrentGreedyStrategy(/*nbh_num=*/4);
+    } else {
+      sbp_graph_.GreedyStrategy(/*nbh_num=*/4);
+    }
     double curr_memory = sbp_graph_.GetMemory();
     double total_weighted_cost = sbp_graph_.ComputeWeightedCost();
     LOG(INFO) << "The " << step << "-th try, memory ratio: " << kMemoryRatio
@@ -148,6 +204,7 @@ Maybe<void> SbpConstructor::FindBestSbpSignature() {
     sbp_graph_.ReComputeWeightedCost();
   }
   sbp_graph_.FinalizeSbp();
+  if (incremental_search_) { StoreSearchResult(); }
 
   double final_cost = sbp_graph_.ComputeCost();
   LOG(INFO) << "Final cost: " << final_cost;
@@ -313,6 +370,103 @@ Maybe<void> SbpConstructor::InitComputationCost(const OpGraph& op_graph) {
   return Maybe<void>::Ok();
 }
 
+Maybe<void> SbpConstructor::ApplyMeasuredComputationCost(const OpGraph& op_graph) {
+  std::vector<std::pair<double*, double>> cost7measured_us;
+  std::vector<std::pair<double, double>> analytic_cost7measured_us;
+  JUST(op_graph.TopoForEachNodeWithErrorCaptured([&](OpNode* op_node) -> Maybe<void> {
+    SbpNode* sbp_node = op_name2sbp_node_[op_node->op().op_name()];
+    auto LogicalBlobDesc4Bn = [&](const std::string& bn) -> const BlobDesc& {
+      return op_node->LogicalBlobDesc4Lbi(op_node->op().BnInOp2Lbi(bn));
+    };
+    // The kernel is launched once for each element of the time shape
+    const double time_shape_elem_cnt =
+        JUST(op_node->op().GetInputOutputFastestTimeShape())->elem_cnt();
+    for (int32_t sbp_id = 0; sbp_id < sbp_node->sbp_sig_list_.size(); sbp_id++) {
+      const double measured_us = cost_database_->OpTime(
+          CostDatabase::OpKey(op_node->op(), sbp_node->sbp_sig_list_[sbp_id], LogicalBlobDesc4Bn,
+                              op_node->parallel_desc()));
+      if (measured_us < 0.0) { continue; }
+      double* cost = &sbp_node->cost_[sbp_id];
+      cost7measured_us.emplace_back(cost, time_shape_elem_cnt * measured_us);
+      if (*cost > 0.0 && *cost < GetValidMaxCopyCost()) {
+        analytic_cost7measured_us.emplace_back(*cost, time_shape_elem_cnt * measured_us);
+      }
+    }
+    return Maybe<void>::Ok();
+  }));
+  const double cost_per_us = MedianCostPerUs(analytic_cost7measured_us);
+  if (cost_per_us <= 0.0) { return Maybe<void>::Ok(); }
+  for (const auto& pair : cost7measured_us) {
+    // Keep the sbp signatures which are forbidden
+    if (*pair.first < GetValidMaxCopyCost()) { *pair.first = cost_per_us * pair.second; }
+  }
+  LOG(INFO) << "Auto parallel uses " << cost7measured_us.size()
+            << " measured computation costs, cost per us: " << cost_per_us;
+  return Maybe<void>::Ok();
+}
+
+Maybe<void> SbpConstructor::ApplyMeasuredCopyCost(const OpGraph& op_graph) {
+  // The edge cost, the analytic copy cost and the measured time of each measured boxing
+  std::vector<std::tuple<double*, double, double>> measured_boxings;
+  std::vector<std::pair<double, double>> analytic_cost7measured_us;
+  LazyMode::Guard enable_lazy_mode(true);
+  JUST(op_graph.TopoForEachNodeWithErrorCaptured([&](OpNode* consumer) -> Maybe<void> {
+    SbpNode* sbp_node_consumer = op_name2sbp_node_[consumer->op().op_name()];
+    for (const OpEdge* op_edge : consumer->in_edges()) {
+      const OpNode* producer = op_edge->src_node();
+      const SbpNode* sbp_node_producer = op_name2sbp_node_[producer->op().op_name()];
+      SbpEdge* sbp_edge = nullptr;
+      for (auto* edge_in : sbp_node_consumer->edges_in_) {
+        if (edge_in->start_node_ == sbp_node_producer) { sbp_edge = edge_in; }
+      }
+      if (sbp_edge == nullptr) { continue; }
+      const double time_shape_elem_cnt = JUST(producer->op().GetOpTimeShape())->elem_cnt();
+      for (const auto& lbi7ibns : op_edge->lbi2ibns()) {
+        const LogicalBlobId& lbi = lbi7ibns.first;
+        const std::string& obn = op_edge->lbi2obn().at(lbi);
+        const BlobDesc& logical_blob_desc = producer->LogicalBlobDesc4Lbi(lbi);
+        const ParallelDesc& producer_parallel_desc =
+            *JUST(producer->op().GetParallelDesc4BnInOp(obn));
+        for (const std::string& ibn : lbi7ibns.second) {
+          const ParallelDesc& consumer_parallel_desc =
+              *JUST(consumer->op().GetParallelDesc4BnInOp(ibn));
+          const bool require_same_sbp = RequireSameSbp(consumer, ibn);
+          for (int32_t i = 0; i < sbp_node_producer->sbp_sig_list_.size(); ++i) {
+            const NdSbp& sbp_producer =
+                sbp_node_producer->sbp_sig_list_[i].bn_in_op2nd_sbp().at(obn);
+            for (int32_t j = 0; j < sbp_node_consumer->sbp_sig_list_.size(); ++j) {
+              const NdSbp& sbp_consumer =
+                  sbp_node_consumer->sbp_sig_list_[j].bn_in_op2nd_sbp().at(ibn);
+              const double measured_us = cost_database_->BoxingTime(
+                  CostDatabase::BoxingKey(logical_blob_desc, sbp_producer, sbp_consumer,
+                                          producer_parallel_desc, consumer_parallel_desc));
+              if (measured_us < 0.0) { continue; }
+              const double copy_cost = JUST(ComputeCopyCostWithMiddleNodes(
+                  sbp_producer, sbp_consumer, logical_blob_desc, producer_parallel_desc,
+                  consumer_parallel_desc, require_same_sbp));
+              if (copy_cost <= 0.0 || copy_cost >= GetValidMaxCopyCost()) { continue; }
+              measured_boxings.emplace_back(&sbp_edge->cost_[i][j],
+                                            time_shape_elem_cnt * copy_cost,
+                                            time_shape_elem_cnt * measured_us);
+              analytic_cost7measured_us.emplace_back(copy_cost, measured_us);
+            }
+          }
+        }
+      }
+    }
+    return Maybe<void>::Ok();
+  }));
+  const double cost_per_us = MedianCostPerUs(analytic_cost7measured_us);
+  if (cost_per_us <= 0.0) { return Maybe<void>::Ok(); }
+  for (const auto& boxing : measured_boxings) {
+    // The edge cost sums up the copy cost of all the blobs it carries, only replace this one.
+    *std::get<0>(boxing) += cost_per_us * std::get<2>(boxing) - std::get<1>(boxing);
+  }
+  LOG(INFO) << "Auto parallel uses " << measured_boxings.size()
+            << " measured copy costs, cost per us: " << cost_per_us;
+  return Maybe<void>::Ok();
+}
+
 // Init copy cost and memory for edges
 Maybe<void> SbpConstructor::InitCopyAndMemoryCost(const OpGraph& op_graph) {
   bool nccl_not_use_compute_stream = !nccl_use_compute_stream_;
@@ -344,6 +498,64 @@ Maybe<void> SbpConstructor::InitCopyAndMemoryCost(const OpGraph& op_graph) {
   return Maybe<void>::Ok();
 }
 
+void SbpConstructor::ApplyLastSearch() {
+  std::unique_lock<std::mutex> lock(*SearchedSbpSignatureMutex());
+  const auto& op_name2searched_sbp_signature = *MutOpName2SearchedSbpSignature();
+  int32_t reused_num = 0;
+  for (auto* sbp_node : sbp_graph_.node_list_) {
+    // sbp_collectors do not have op_node
+    if (!sbp_node->op_node_) { continue; }
+    const std::string& op_name = sbp_node->op_node_->op().op_name();
+    const size_t fingerprint = Fingerprint4SbpNode(sbp_node);
+    op_name2fingerprint_[op_name] = fingerprint;
+    const auto& it = op_name2searched_sbp_signature.find(op_name);
+    if (it == op_name2searched_sbp_signature.end() || it->second.fingerprint != fingerprint) {
+      continue;
+    }
+    // Same candidates, the same sbp signature id
+    sbp_node->final_sbp_sig_id_ = it->second.sbp_sig_id;
+    sbp_node->modified_ = false;
+    reused_num++;
+  }
+  *MutLastSearchReusedOpNum() = reused_num;
+  LOG(INFO) << "Reuse the last search for " << reused_num << " of "
+            << op_name2fingerprint_.size() << " ops";
+}
+
+void SbpConstructor::StoreSearchResult() const {
+  std::unique_lock<std::mutex> lock(*SearchedSbpSignatureMutex());
+  auto* op_name2searched_sbp_signature = MutOpName2SearchedSbpSignature();
+  for (const auto& pair : op_name2fingerprint_) {
+    (*op_name2searched_sbp_signature)[pair.first] =
+        SearchedSbpSignature{pair.second, op_name2sbp_node_.at(pair.first)->final_sbp_sig_id_};
+  }
+}
+
+// The search result of an op could be reused if its candidates, its costs and the costs of its
+// incoming edges are not changed. A change of the outgoing edges changes the consumers.
+size_t SbpConstructor::Fingerprint4SbpNode(const SbpNode* sbp_node) const {
+  size_t fingerprint = 0;
+  for (const auto& sbp_signature : sbp_node->sbp_sig_list_) {
+    AddHash(&fingerprint, sbp_signature);
+  }
+  for (double cost : sbp_node->cost_) { AddHash(&fingerprint, cost); }
+  for (const auto* sbp_edge : sbp_node->edges_in_) {
+    // sbp_collectors do not have op_node
+    if (sbp_edge->start_node_->op_node_) {
+      AddHash(&fingerprint, sbp_edge->start_node_->op_node_->op().op_name());
+    }
+    for (const auto& cost_row : sbp_edge->cost_) {
+      for (double cost : cost_row) { AddHash(&fingerprint, cost); }
+    }
+  }
+  return fingerprint;
+}
+
+int64_t LastSearchReusedOpNum() {
+  std::unique_lock<std::mutex> lock(*SearchedSbpSignatureMutex());
+  return *MutLastSearchReusedOpNum();
+}
+
 Maybe<void> SbpConstructor::ApplyTrunkAlgo() {
   // TODO: Remove this
   auto OpNode2MutableOpCtrlDeps = JUST(GetMutableOpCtrlDeps(*op_graph_));
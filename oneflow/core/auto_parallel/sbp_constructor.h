@@ -19,6 +19,7 @@ limitations under the License.
 
 #include "oneflow/core/common/util.h"
 #include "oneflow/core/auto_parallel/sbp_graph.h"
+#include "oneflow/core/auto_parallel/cost_database.h"
 #include "oneflow/core/job/global_for.h"
 
 namespace oneflow {
@@ -39,6 +40,8 @@ class SbpConstructor final {
   SbpConstructor(const OpGraph& op_graph, Job* job)
       : cost_ratio_(job->job_conf().auto_parallel_computation_cost_ratio()),
         enable_trunk_algo_(job->job_conf().enable_auto_parallel_trunk_algo()),
+        concurrent_search_(job->job_conf().enable_auto_parallel_concurrent_search()),
+        incremental_search_(job->job_conf().enable_auto_parallel_incremental_search()),
         use_sbp_collector_(!Singleton<ResourceDesc, ForSession>::Get()
                                 ->resource()
                                 .disable_group_boxing_by_dst_parallel()
@@ -64,7 +67,15 @@ class SbpConstructor final {
   Maybe<void> StealSbpSignatureFromOpNode(const OpGraph& op_graph, const Job& job);
   Maybe<void> InitComputationCost(const OpGraph& op_graph);
   Maybe<void> InitCopyAndMemoryCost(const OpGraph& op_graph);
+  // Replace the analytic costs of the ops and boxing measured in the cost database
+  Maybe<void> ApplyMeasuredComputationCost(const OpGraph& op_graph);
+  Maybe<void> ApplyMeasuredCopyCost(const OpGraph& op_graph);
   Maybe<void> ApplyTrunkAlgo();
+  // Start from the sbp signatures found by the last search of the same ops, and only search the
+  // neighborhoods of the other ops
+  void ApplyLastSearch();
+  void StoreSearchResult() const;
+  size_t Fingerprint4SbpNode(const SbpNode* sbp_node) const;
   Maybe<HashMap<const OpNode*, HashSet<std::string>>> GetMutableOpCtrlDeps(const OpGraph& op_graph);
   void InitAvailableMemory();
   void InitWeightedCost();
@@ -73,14 +84,23 @@ class SbpConstructor final {
 
   double cost_ratio_;
   bool enable_trunk_algo_;
+  bool concurrent_search_;
+  bool incremental_search_;
   bool use_sbp_collector_;
   SbpGraph sbp_graph_;
   const OpGraph* op_graph_;
   HashMap<std::string, SbpNode*> op_name2sbp_node_;
   bool nccl_use_compute_stream_;
   int64_t available_memory_;
+  std::unique_ptr<CostDatabase> cost_database_;
+  // The fingerprints of the ops before eliminations, used by the incremental search
+  HashMap<std::string, size_t> op_name2fingerprint_;
 };
 
+// The number of ops for which the last incremental search of this process reused the sbp
+// signatures found by the search before it.
+int64_t LastSearchReusedOpNum();
+
 }  // namespace auto_parallel
 }  // namespace oneflow
 
@@ -216,6 +216,9 @@ void SbpEdge::DuplicateCost(
 
 // Compute the weighted sum of the time and memory cost
 void SbpEdge::ComputeWeightedCost() {
+  if (weighted_cost_cached_) { return; }
+  // Whether any component has memory cost
+  bool with_memory = in_memory_support_;
   if (edge_list_.empty()) {
     // If this edge does not contain any sub edges, it should have original cost
     weighted_cost_ = cost_;
@@ -230,8 +233,14 @@ void SbpEdge::ComputeWeightedCost() {
     }
   } else {
     // Compute the weighted cost for sub components
-    for (auto& sbp_edge : edge_list_) { sbp_edge->ComputeWeightedCost(); }
-    if (mid_node_) { mid_node_->ComputeWeightedCost(); }
+    for (auto& sbp_edge : edge_list_) {
+      sbp_edge->ComputeWeightedCost();
+      with_memory |= !sbp_edge->weighted_cost_cached_;
+    }
+    if (mid_node_) {
+      mid_node_->ComputeWeightedCost();
+      with_memory |= !mid_node_->weighted_cost_cached_;
+    }
     // Generate relationship if two vertices are merged nodes
     // For example, we have 4 nodes: A, B, C, D
     // and two edges: 1: A->B, 2: A->B
@@ -244,6 +253,7 @@ void SbpEdge::ComputeWeightedCost() {
     // Re-compute the weighted cost
     SummarizeCost();
   }
+  weighted_cost_cached_ = !with_memory;
 }
 
 void SbpEdge::FinalizeSbp() {
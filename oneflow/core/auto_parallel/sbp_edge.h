@@ -163,6 +163,9 @@ class SbpEdge final {
   std::vector<std::vector<int64_t>> memory_;
   // The weighted sum of time cost and memory cost
   std::vector<std::vector<double>> weighted_cost_;
+  // The weighted cost without any memory cost does not change with kMemoryRatio, we compute it
+  // only once.
+  bool weighted_cost_cached_ = false;
 };
 
 }  // namespace auto_parallel
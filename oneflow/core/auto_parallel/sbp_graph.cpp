@@ -21,6 +21,7 @@ limitations under the License.
 #include "oneflow/core/auto_parallel/sbp_edge.h"
 #include "oneflow/core/auto_parallel/sbp_node.h"
 #include "oneflow/core/auto_parallel/algorithm_util.h"
+#include "oneflow/core/thread/thread_manager.h"
 
 namespace oneflow {
 namespace auto_parallel {
@@ -111,6 +112,8 @@ void SbpGraph::ReComputeWeightedCost() {
   for (const auto& this_node : node_list_) {
     this_node->ComputeWeightedCost();
     for (const auto& edge_out : this_node->edges_out_) { edge_out->ComputeWeightedCost(); }
+    // The whole graph should be searched again for the new weighted cost
+    this_node->modified_ = true;
   }
 }
 
@@ -150,6 +153,9 @@ int32_t SbpGraph::NodeElimination(SbpNode* this_node) {
 
     SbpEdge* e = new SbpEdge(two_nodes[0], this_node, two_nodes[1], two_edges[0], two_edges[1]);
     e->SummarizeCost();
+    // The sbp signature of this node is decided by the two nodes now
+    two_nodes[0]->modified_ |= this_node->modified_;
+    two_nodes[1]->modified_ |= this_node->modified_;
     // check and remove the edge_in with new edge in graph
     for (int32_t i = 0; i < edges_in_size; i++) {
       CheckAndRemoveFrom<SbpEdge*>(two_nodes[i]->edges_out_, two_edges[i]);
@@ -329,17 +335,18 @@ double SbpGraph::GreedyStrategy(int32_t nbh_num) const {
   std::vector<int32_t> nbh_id2node_list_id;
   // Not accept a number lower than 1
   if (nbh_num < 1) { nbh_num = 1; }
-  nbh_id2node_list_id.resize(nbh_num);
   std::vector<int32_t> original_sbp_sig_id(nbh_num);
   // store all the node_list_id whose corresponding nodes will be visited
   // We can use unordered_map to do this but vector is faster
   std::vector<int32_t> pre_visit_node_list(node_list_.size() + 1);
-  for (int32_t nbh_id = 0; nbh_id < node_list_.size(); nbh_id++) {
-    pre_visit_node_list[nbh_id] = nbh_id;
-  }
-  int32_t head = 0, tail = node_list_.size();
   // whether a node_list_id is in pre_visit_node_list
-  std::vector<bool> pre_visit_tags(node_list_.size(), true);
+  std::vector<bool> pre_visit_tags(node_list_.size(), false);
+  int32_t head = 0, tail = 0;
+  // Visit the neighborhoods of the modified nodes
+  for (int32_t node_list_id : ModifiedNeighborhoods()) {
+    pre_visit_node_list[tail++] = node_list_id;
+    pre_visit_tags[node_list_id] = true;
+  }
   int32_t step = 0;
   // 1 ring neighborhood buffer
   std::vector<int32_t> nbh_1ring(nbh_num);
@@ -349,44 +356,8 @@ double SbpGraph::GreedyStrategy(int32_t nbh_num) const {
   std::vector<int32_t> nbh_1ring_buffer;
 
   while (head != tail && step < node_list_.size()) {
-    auto* this_node = node_list_[pre_visit_node_list[head]];
-    if (nbh_num <= 1) {
-      // Greedy strategy on nodes, here we use nbh_1ring to store the nbh_id2node_list_id
-      // information for reutilization
-      nbh_1ring[0] = this_node->node_list_id_;
-      // store the original sbp signature of the 1-ring neighborhood for comparison
-      original_sbp_sig_id[0] = this_node->final_sbp_sig_id_;
-      cost_reduction = NbhGreedyStrategy(nbh_1ring);
-    } else {
-      // Use GreedyStrategy on the one ring neighborhood of this node.
-      this_node->OneRingNeighborhood(nbh_1ring);
-      // store the original sbp signature of the 1-ring neighborhood for comparison
-      original_sbp_sig_id.resize(nbh_1ring.size());
-      for (int32_t nbh_id = 0; nbh_id < nbh_1ring.size(); nbh_id++) {
-        original_sbp_sig_id[nbh_id] = node_list_[nbh_1ring[nbh_id]]->final_sbp_sig_id_;
-      }
-      if (nbh_1ring.size() <= nbh_num) {
-        cost_reduction = NbhGreedyStrategy(nbh_1ring);
-      } else {
-        // Use GreedyStrategy on part of the one ring neighborhood.
-        // Loop through the neighborhood. Each loop should contain the centroid.
-
-        // Initialize part of the one ring neighborhood
-        int32_t nbh_1ring_id = nbh_1ring.size() - nbh_num;
-        for (int32_t nbh_id = 1; nbh_id < nbh_num; ++nbh_id) {
-          nbh_id2node_list_id[nbh_id] = nbh_1ring[++nbh_1ring_id];
-        }
-        // loop through the one ring neighborhood
-        cost_reduction = 0;
-        int32_t nbh_id = 0;
-        for (nbh_1ring_id = 0; nbh_1ring_id < nbh_1ring.size(); ++nbh_1ring_id) {
-          nbh_id2node_list_id[nbh_id] = nbh_1ring[nbh_1ring_id];
-          cost_reduction += NbhGreedyStrategy(nbh_id2node_list_id);
-          // nbh_id for the next step
-          if (++nbh_id >= nbh_num) { nbh_id = 1; }
-        }
-      }
-    }
+    cost_reduction = CentroidGreedyStrategy(pre_visit_node_list[head], nbh_num, nbh_1ring,
+                                            nbh_id2node_list_id, original_sbp_sig_id);
     // change of strategies
     if (cost_reduction != 0) {
       // Add neighborhood into pre-visited node list for each node with changing strategy
@@ -421,6 +392,156 @@ double SbpGraph::GreedyStrategy(int32_t nbh_num) const {
   return total_cost_reduction;
 }
 
+double SbpGraph::ConcurrentGreedyStrategy(int32_t nbh_num) const {
+  // Not accept a number lower than 1
+  if (nbh_num < 1) { nbh_num = 1; }
+  const int32_t node_num = node_list_.size();
+  // The adjustment of a neighborhood changes the sbp signatures in the one ring neighborhood of the
+  // centroid and reads the sbp signatures in the two ring neighborhood. Two centroids could be
+  // adjusted at the same time if they are at least 4 hops away, or 2 hops away if we only adjust
+  // the centroids.
+  const int32_t conflict_ring = nbh_num <= 1 ? 1 : 3;
+  std::vector<int32_t> node_list_id2color(node_num, -1);
+  int32_t color_num = 0;
+  std::vector<int32_t> nbh_n_ring;
+  std::vector<int32_t> nbh_1ring_buffer;
+  std::vector<bool> node_tags(node_num, false);
+  std::vector<bool> color_used;
+  for (int32_t node_list_id = 0; node_list_id < node_num; node_list_id++) {
+    node_list_[node_list_id]->NRingNeighborhood(conflict_ring, nbh_n_ring, nbh_1ring_buffer,
+                                                node_list_, node_tags);
+    color_used.assign(color_num + 1, false);
+    for (int32_t nbh_node_list_id : nbh_n_ring) {
+      if (node_list_id2color[nbh_node_list_id] >= 0) {
+        color_used[node_list_id2color[nbh_node_list_id]] = true;
+      }
+    }
+    int32_t color = 0;
+    while (color_used[color]) { color++; }
+    node_list_id2color[node_list_id] = color;
+    color_num = std::max(color_num, color + 1);
+  }
+
+  double total_cost_reduction = 0;
+  std::vector<bool> to_visit(node_num, false);
+  for (int32_t node_list_id : ModifiedNeighborhoods()) { to_visit[node_list_id] = true; }
+  std::vector<std::vector<int32_t>> color2centroids(color_num);
+  // Visit the nodes color by color, and the nodes with the same color at the same time.
+  // The result does not depend on the number of threads.
+  for (int32_t step = 0; step < node_num; step++) {
+    bool any_centroid = false;
+    for (auto& centroids : color2centroids) { centroids.clear(); }
+    for (int32_t node_list_id = 0; node_list_id < node_num; node_list_id++) {
+      if (to_visit[node_list_id]) {
+        color2centroids[node_list_id2color[node_list_id]].push_back(node_list_id);
+        to_visit[node_list_id] = false;
+        any_centroid = true;
+      }
+    }
+    if (!any_centroid) { break; }
+    for (const auto& centroids : color2centroids) {
+      std::vector<double> cost_reductions(centroids.size(), 0);
+      std::vector<std::vector<int32_t>> changed_node_list_ids(centroids.size());
+      MultiThreadLoop(centroids.size(), [&](size_t i) {
+        std::vector<int32_t> nbh_1ring;
+        std::vector<int32_t> nbh_id2node_list_id;
+        std::vector<int32_t> original_sbp_sig_id;
+        cost_reductions[i] = CentroidGreedyStrategy(centroids[i], nbh_num, nbh_1ring,
+                                                    nbh_id2node_list_id, original_sbp_sig_id);
+        if (cost_reductions[i] == 0) { return; }
+        for (int32_t nbh_id = 0; nbh_id < nbh_1ring.size(); nbh_id++) {
+          if (original_sbp_sig_id[nbh_id] != node_list_[nbh_1ring[nbh_id]]->final_sbp_sig_id_) {
+            changed_node_list_ids[i].push_back(nbh_1ring[nbh_id]);
+          }
+        }
+      });
+      for (int32_t i = 0; i < centroids.size(); i++) {
+        total_cost_reduction += cost_reductions[i];
+        // schedule to visit the neighborhood of the changing nodes in the next step
+        for (int32_t changed_node_list_id : changed_node_list_ids[i]) {
+          node_list_[changed_node_list_id]->NRingNeighborhood(2, nbh_n_ring, nbh_1ring_buffer,
+                                                              node_list_, node_tags);
+          for (int32_t nbh_node_list_id : nbh_n_ring) { to_visit[nbh_node_list_id] = true; }
+        }
+      }
+    }
+  }
+  return total_cost_reduction;
+}
+
+std::vector<int32_t> SbpGraph::ModifiedNeighborhoods() const {
+  std::vector<int32_t> node_list_ids;
+  if (std::all_of(node_list_.begin(), node_list_.end(),
+                  [](SbpNode* sbp_node) { return sbp_node->modified_; })) {
+    node_list_ids.resize(node_list_.size());
+    for (int32_t node_list_id = 0; node_list_id < node_list_.size(); node_list_id++) {
+      node_list_ids[node_list_id] = node_list_id;
+    }
+    return node_list_ids;
+  }
+  std::vector<bool> node_tags(node_list_.size(), false);
+  std::vector<bool> collected(node_list_.size(), false);
+  std::vector<int32_t> nbh_2ring;
+  std::vector<int32_t> nbh_1ring_buffer;
+  for (SbpNode* this_node : node_list_) {
+    if (!this_node->modified_) { continue; }
+    // The adjustment of the nodes in the two ring neighborhood might be affected
+    this_node->NRingNeighborhood(2, nbh_2ring, nbh_1ring_buffer, node_list_, node_tags);
+    for (int32_t nbh_node_list_id : nbh_2ring) {
+      if (!collected[nbh_node_list_id]) {
+        collected[nbh_node_list_id] = true;
+        node_list_ids.push_back(nbh_node_list_id);
+      }
+    }
+  }
+  std::sort(node_list_ids.begin(), node_list_ids.end());
+  return node_list_ids;
+}
+
+double SbpGraph::CentroidGreedyStrategy(int32_t node_list_id, int32_t nbh_num,
+                                        std::vector<int32_t>& nbh_1ring,
+                                        std::vector<int32_t>& nbh_id2node_list_id,
+                                        std::vector<int32_t>& original_sbp_sig_id) const {
+  auto* this_node = node_list_[node_list_id];
+  if (nbh_num <= 1) {
+    // Greedy strategy on nodes, here we use nbh_1ring to store the nbh_id2node_list_id
+    // information for reutilization
+    nbh_1ring.resize(1);
+    nbh_1ring[0] = node_list_id;
+    // store the original sbp signature of the 1-ring neighborhood for comparison
+    original_sbp_sig_id.resize(1);
+    original_sbp_sig_id[0] = this_node->final_sbp_sig_id_;
+    return NbhGreedyStrategy(nbh_1ring);
+  }
+  // Use GreedyStrategy on the one ring neighborhood of this node.
+  this_node->OneRingNeighborhood(nbh_1ring);
+  // store the original sbp signature of the 1-ring neighborhood for comparison
+  original_sbp_sig_id.resize(nbh_1ring.size());
+  for (int32_t nbh_id = 0; nbh_id < nbh_1ring.size(); nbh_id++) {
+    original_sbp_sig_id[nbh_id] = node_list_[nbh_1ring[nbh_id]]->final_sbp_sig_id_;
+  }
+  if (nbh_1ring.size() <= nbh_num) { return NbhGreedyStrategy(nbh_1ring); }
+  // Use GreedyStrategy on part of the one ring neighborhood.
+  // Loop through the neighborhood. Each loop should contain the centroid.
+
+  // Initialize part of the one ring neighborhood
+  nbh_id2node_list_id.resize(nbh_num);
+  int32_t nbh_1ring_id = nbh_1ring.size() - nbh_num;
+  for (int32_t nbh_id = 1; nbh_id < nbh_num; ++nbh_id) {
+    nbh_id2node_list_id[nbh_id] = nbh_1ring[++nbh_1ring_id];
+  }
+  // loop through the one ring neighborhood
+  double cost_reduction = 0;
+  int32_t nbh_id = 0;
+  for (nbh_1ring_id = 0; nbh_1ring_id < nbh_1ring.size(); ++nbh_1ring_id) {
+    nbh_id2node_list_id[nbh_id] = nbh_1ring[nbh_1ring_id];
+    cost_reduction += NbhGreedyStrategy(nbh_id2node_list_id);
+    // nbh_id for the next step
+    if (++nbh_id >= nbh_num) { nbh_id = 1; }
+  }
+  return cost_reduction;
+}
+
 void SbpGraph::DfsAddNbhCost(std::vector<int32_t>& nbh_id2node_list_id,
                              std::unordered_map<int32_t, int32_t>& node_list_id2nbh_id,
                              std::vector<int32_t>& order2nbh_id, std::vector<int32_t>& nbh_id2order,
@@ -539,6 +660,8 @@ Maybe<void> SbpGraph::Find1Strategy4Greedy() const {
   // Combining deep first search and pruning based on cut ratio
   CHECK(DfsFindReasonableCost(nbh_id2node_list_id, node_list_id2nbh_id, nbh_id2order, /*nbh_id=*/0))
       << "Can't find a reasonable strategy!";
+  // The strategy might be changed everywhere
+  for (SbpNode* this_node : node_list_) { this_node->modified_ = true; }
   return Maybe<void>::Ok();
 }
 
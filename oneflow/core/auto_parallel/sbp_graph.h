@@ -69,6 +69,10 @@ class SbpGraph final {
   double GreedyStrategy(bool for_node) const;
   // Use greedy strategy on the one ring neighborhood with the maximum number of points nbh_num.
   double GreedyStrategy(int32_t nbh_num = 4) const;
+  // The same as GreedyStrategy(nbh_num), but adjust the independent neighborhoods concurrently.
+  // The nodes are colored so that the neighborhoods of the nodes with the same color do not
+  // affect each other.
+  double ConcurrentGreedyStrategy(int32_t nbh_num = 4) const;
 
   // Find one strategy with finite cost for adjustment
   Maybe<void> Find1Strategy4Greedy() const;
@@ -127,6 +131,15 @@ class SbpGraph final {
   // Select two nodes and merge them
   int32_t PickAndMerge();
 
+  // Use greedy strategy on the one ring neighborhood of a node, store the one ring neighborhood and
+  // their original sbp signature ids.
+  double CentroidGreedyStrategy(int32_t node_list_id, int32_t nbh_num,
+                                std::vector<int32_t>& nbh_1ring,
+                                std::vector<int32_t>& nbh_id2node_list_id,
+                                std::vector<int32_t>& original_sbp_sig_id) const;
+  // The sorted node list ids of the two ring neighborhood of the modified nodes
+  std::vector<int32_t> ModifiedNeighborhoods() const;
+
   void DfsAddNbhCost(std::vector<int32_t>& nbh_id2node_list_id,
                      std::unordered_map<int32_t, int32_t>& node_list_id2nbh_id,
                      std::vector<int32_t>& order2nbh_id, std::vector<int32_t>& nbh_id2order,
@@ -43,6 +43,7 @@ SbpNode::SbpNode(SbpNode* first, SbpNode* second) {
   half_node_.resize(2);
   half_node_[0] = first;
   half_node_[1] = second;
+  modified_ = first->modified_ || second->modified_;
 
   // Get the edge between first and second
   // NOTE: It must zero or one edge between them
@@ -174,6 +175,8 @@ void SbpNode::PointTo(SbpNode* end_node) { StartPointToEnd(this, end_node); };
 
 void SbpNode::SummarizeCost() {
   if (children_.size() == child_node_sbp_sig_.size()) { return; }
+  // New children might carry memory cost
+  weighted_cost_cached_ = false;
   int32_t previous_children_size = child_node_sbp_sig_.size();
   child_node_sbp_sig_.resize(children_.size());
   in_memory_support_ =
@@ -226,12 +229,14 @@ bool SbpNode::EliminateItselfAsChild() {
       // edge in graph: father -> this_node
       SbpNode* father = edges_in_[0]->start_node_;
       father->children_.emplace_back(this);
+      father->modified_ |= modified_;
       CheckAndRemoveFrom<SbpEdge*>(father->edges_out_, edges_in_[0]);
       father->SummarizeCost();
     } else {
       // edge in graph: this_node -> father
       SbpNode* father = edges_out_[0]->end_node_;
       father->children_.emplace_back(this);
+      father->modified_ |= modified_;
       CheckAndRemoveFrom<SbpEdge*>(father->edges_in_, edges_out_[0]);
       father->SummarizeCost();
     }
@@ -244,6 +249,9 @@ bool SbpNode::EliminateItselfAsChild() {
 
 // Compute the weighted sum of the time and memory cost
 void SbpNode::ComputeWeightedCost() {
+  if (weighted_cost_cached_) { return; }
+  // Whether any component has memory cost
+  bool with_memory = in_memory_support_;
   if (half_node_.empty()) {
     // If this node is not generated from merging, it should have original cost
     // weighted_cost_ = cost_;
@@ -257,6 +265,7 @@ void SbpNode::ComputeWeightedCost() {
   } else {
     half_node_[0]->ComputeWeightedCost();
     half_node_[1]->ComputeWeightedCost();
+    with_memory |= !half_node_[0]->weighted_cost_cached_ || !half_node_[1]->weighted_cost_cached_;
     // The edge between two half nodes
     SbpEdge* edge_found = nullptr;
     if (!half_node_[0]->edges_in_.empty()) {
@@ -264,7 +273,10 @@ void SbpNode::ComputeWeightedCost() {
     } else if (!half_node_[0]->edges_out_.empty()) {
       edge_found = half_node_[0]->edges_out_[0];
     }
-    if (edge_found != nullptr) { edge_found->ComputeWeightedCost(); }
+    if (edge_found != nullptr) {
+      edge_found->ComputeWeightedCost();
+      with_memory |= !edge_found->weighted_cost_cached_;
+    }
     // Compute the weighted cost form half nodes
     for (int32_t merged_sig_id = 0; merged_sig_id < merged_sig_id2half_sig_id_.size();
          merged_sig_id++) {
@@ -289,12 +301,20 @@ void SbpNode::ComputeWeightedCost() {
   // Compute the weighted cost for children
   for (auto& child_node : children_) {
     child_node->ComputeWeightedCost();
-    for (auto& in_edge : child_node->edges_in_) { in_edge->ComputeWeightedCost(); }
-    for (auto* out_edge : child_node->edges_out_) { out_edge->ComputeWeightedCost(); }
+    with_memory |= !child_node->weighted_cost_cached_;
+    for (auto& in_edge : child_node->edges_in_) {
+      in_edge->ComputeWeightedCost();
+      with_memory |= !in_edge->weighted_cost_cached_;
+    }
+    for (auto* out_edge : child_node->edges_out_) {
+      out_edge->ComputeWeightedCost();
+      with_memory |= !out_edge->weighted_cost_cached_;
+    }
   }
   // Compute the weighted cost from children
   child_node_sbp_sig_.clear();
   SummarizeCost();
+  weighted_cost_cached_ = !with_memory;
 }
 
 // Generate the relationship between this merged node and its components
@@ -219,6 +219,12 @@ class SbpNode final {
   // We do not add any weight for the time cost since we need to judge if a cost is less than
   // GetValidMaxCopyCost().
   std::vector<double> weighted_cost_;
+  // The weighted cost without any memory cost does not change with kMemoryRatio, we compute it
+  // only once.
+  bool weighted_cost_cached_ = false;
+  // Whether this node or any node eliminated into it is modified since the last search of the
+  // same ops. The greedy strategy only starts from the neighborhoods of the modified nodes.
+  bool modified_ = true;
   // Relationship between a merged node and its components
   HashMap<SbpNode*, std::vector<int32_t>> component2merged_sig_id2component_sig_id_;
 
@@ -14,9 +14,11 @@ See the License for the specific language governing permissions and
 limitations under the License.
 */
 
+#include <algorithm>
+#include <atomic>
+#include <limits>
 #include <memory>
 #include <stack>
-#include <queue>
 #include "fmt/core.h"
 #include "fmt/format.h"
 #include "oneflow/core/autograd/autograd_engine.h"
@@ -34,6 +36,7 @@ limitations under the License.
 #include "oneflow/core/framework/global_param_grad_sync_mode.h"
 #include "oneflow/core/job/lazy_mode.h"
 #include "oneflow/core/profiler/profiler.h"
+#include "oneflow/core/common/env_var/autograd.h"
 #include "oneflow/core/common/env_var/debug_mode.h"
 #include "oneflow/core/persistence/tee_persistent_log_stream.h"
 
@@ -117,6 +120,11 @@ Maybe<void> CheckGlobalTensorsMeta(const TensorTuple& tensor_tuple) {
   return Maybe<void>::Ok();
 }
 
+uint64_t NewFunctionNodeSequenceNr() {
+  static std::atomic<uint64_t> sequence_nr(0);
+  return sequence_nr.fetch_add(1, std::memory_order_relaxed);
+}
+
 std::string GetDebugGraphFileName(const std::string& mode, const std::string& suffix) {
   return fmt::format("autograd_{}_rank{}_suffix_graph.dot", mode, GlobalProcessCtx::Rank(), suffix);
 }
@@ -144,6 +152,13 @@ Maybe<TensorTuple> AutogradEngine::RunBackwardAndReturnInputsTensorGradIf(
                                               create_graph);
 }
 
+FunctionNode::FunctionNode(const std::string& name,
+                           const std::shared_ptr<BackwardFunction>& backward_fn)
+    : name_(name),
+      sequence_nr_(NewFunctionNodeSequenceNr()),
+      backward_fn_(backward_fn),
+      scope_(nullptr) {}
+
 Maybe<void> FunctionNode::AccGrad4RetainGradTensor(bool create_graph) {
   for (const std::shared_ptr<AutogradMeta>& out : output_meta_data_) {
     if (out->retain_grad()) { JUST(CopyOrAccGrad(out.get(), create_graph)); }
@@ -323,24 +338,33 @@ Maybe<void> GraphTask::WriteGraphToDotFile(const std::string& file_name) const {
   return Maybe<void>::Ok();
 }
 
+GraphTask::ExecInfo* GraphTask::MutExecInfo(FunctionNode* node) {
+  ExecInfo* exec_info = &grad_fn2exec_info_[node];
+  exec_info->node = node;
+  return exec_info;
+}
+
 // Computes the number of dependencies for each FunctionNode
 Maybe<void> GraphTask::ComputeDependencies() {
   HashSet<FunctionNode*> seen;
   std::stack<FunctionNode*> stack;
   for (FunctionNode* node : roots_) {
     stack.push(node);
-    grad_fn2exec_info_[node].need_execute = true;
+    MutExecInfo(node)->need_execute = true;
   }
 
   while (!stack.empty()) {
     FunctionNode* node = stack.top();
     stack.pop();
     if (/*bool has_seen=*/!seen.insert(node).second) { continue; }
+    ExecInfo* node_exec_info = MutExecInfo(node);
+    node_exec_info->next_exec_infos.reserve(node->next_functions().size());
     for (const auto& next_grad_fn : node->next_functions()) {
       FunctionNode* next_node = next_grad_fn.get();
-      ExecInfo& exec_info = grad_fn2exec_info_[next_node];
-      exec_info.dependencies += 1;
-      exec_info.need_execute = true;
+      ExecInfo* exec_info = MutExecInfo(next_node);
+      exec_info->dependencies += 1;
+      exec_info->need_execute = true;
+      node_exec_info->next_exec_infos.emplace_back(exec_info);
       if (seen.find(next_node) == seen.end()) { stack.push(next_node); }
     }
   }
@@ -351,8 +375,10 @@ Maybe<void> GraphTask::ComputeDependencies() {
 // according to input tensors
 Maybe<void> GraphTask::ComputeDependenciesAndPruneNode(const TensorTuple& inputs) {
   struct NodeFrame {
-    explicit NodeFrame(FunctionNode* node) : node_(node), next_function_idx_(0) {}
+    NodeFrame(FunctionNode* node, ExecInfo* exec_info)
+        : node_(node), exec_info_(exec_info), next_function_idx_(0) {}
     FunctionNode* node_;
+    ExecInfo* exec_info_;
     size_t next_function_idx_;
 
     FunctionNode* GetNextFunction() {
@@ -370,19 +396,20 @@ Maybe<void> GraphTask::ComputeDependenciesAndPruneNode(const TensorTuple& inputs
   for (int idx = 0; idx < inputs.size(); idx++) {
     const auto& input = inputs[idx];
     CHECK_NOTNULL_OR_RETURN(input->mut_grad_fn_node().get());  //  NOLINT(maybe-need-error-msg)
-    ExecInfo& exec_info = grad_fn2exec_info_[input->mut_grad_fn_node().get()];
-    exec_info.need_execute = true;
-    if (!exec_info.capture_indices) {
-      exec_info.capture_indices = std::make_unique<std::vector<std::pair<size_t, size_t>>>();
+    ExecInfo* exec_info = MutExecInfo(input->mut_grad_fn_node().get());
+    exec_info->need_execute = true;
+    if (!exec_info->capture_indices) {
+      exec_info->capture_indices = std::make_unique<std::vector<std::pair<size_t, size_t>>>();
     }
-    exec_info.capture_indices->emplace_back(std::make_pair(input->get_grad_fn_output_index(), idx));
+    exec_info->capture_indices->emplace_back(
+        std::make_pair(input->get_grad_fn_output_index(), idx));
   }
 
   HashSet<FunctionNode*> seen;
   std::stack<NodeFrame> stack;
 
   // Note: dfs to determine each FunctionNode should execute or not.
-  for (const auto& root : roots_) { stack.push(NodeFrame(root)); }
+  for (const auto& root : roots_) { stack.push(NodeFrame(root, MutExecInfo(root))); }
   while (!stack.empty()) {
     NodeFrame& frame = stack.top();
     if (/*bool has_seen=*/seen.find(frame.node_) != seen.end()) {
@@ -390,17 +417,17 @@ Maybe<void> GraphTask::ComputeDependenciesAndPruneNode(const TensorTuple& inputs
       continue;
     }
     if (FunctionNode* node = frame.GetNextFunction()) {
-      grad_fn2exec_info_[node].dependencies += 1;
+      ExecInfo* exec_info = MutExecInfo(node);
+      exec_info->dependencies += 1;
+      frame.exec_info_->next_exec_infos.emplace_back(exec_info);
       if (seen.find(node) == seen.end()) {
-        stack.push(NodeFrame(node));
+        stack.push(NodeFrame(node, exec_info));
         continue;  // recurse
       }
     } else {
-      grad_fn2exec_info_[frame.node_].need_execute |=
-          std::any_of(frame.node_->next_functions().begin(), frame.node_->next_functions().end(),
-                      [&](const std::shared_ptr<FunctionNode>& fn) {
-                        return grad_fn2exec_info_[fn.get()].need_execute;
-                      });
+      frame.exec_info_->need_execute |= std::any_of(
+          frame.exec_info_->next_exec_infos.begin(), frame.exec_info_->next_exec_infos.end(),
+          [](const ExecInfo* exec_info) { return exec_info->need_execute; });
       seen.insert(frame.node_);
       stack.pop();
     }
@@ -409,15 +436,40 @@ Maybe<void> GraphTask::ComputeDependenciesAndPruneNode(const TensorTuple& inputs
 }
 
 Maybe<void> GraphTask::Apply(bool save_grad_for_leaf) {
-  std::queue<FunctionNode*> queue;
+  // With the priority schedule the most recently created ready node runs first, so backward goes
+  // depth first through a branch and releases its saved tensors and partial grads before walking
+  // the next branch. Nodes without next functions, e.g. accumulating grads of leaf tensors, only
+  // release memory and run as soon as they are ready.
+  const bool priority_schedule = ThreadLocalEnvBool<ONEFLOW_AUTOGRAD_PRIORITY_SCHEDULE>();
+  const auto Priority = [](const ExecInfo* exec_info) -> uint64_t {
+    if (exec_info->node->next_functions().empty()) { return std::numeric_limits<uint64_t>::max(); }
+    return exec_info->node->sequence_nr();
+  };
+  const auto HasLowerPriority = [&](const ExecInfo* lhs, const ExecInfo* rhs) {
+    return Priority(lhs) < Priority(rhs);
+  };
+  // a max heap by priority, or a first in first out queue starting from ready_front
+  std::vector<ExecInfo*> ready;
+  size_t ready_front = 0;
+  const auto PushReady = [&](ExecInfo* exec_info) {
+    ready.emplace_back(exec_info);
+    if (priority_schedule) { std::push_heap(ready.begin(), ready.end(), HasLowerPriority); }
+  };
+  const auto PopReady = [&]() -> ExecInfo* {
+    if (!priority_schedule) { return ready[ready_front++]; }
+    std::pop_heap(ready.begin(), ready.end(), HasLowerPriority);
+    ExecInfo* exec_info = ready.back();
+    ready.pop_back();
+    return exec_info;
+  };
   for (FunctionNode* node : roots_) {
-    if (grad_fn2exec_info_[node].dependencies == 0) { queue.push(node); }
+    ExecInfo* exec_info = MutExecInfo(node);
+    if (exec_info->dependencies == 0) { PushReady(exec_info); }
   }
 
-  while (!queue.empty()) {
-    FunctionNode* node = queue.front();
-    queue.pop();
-    auto& exec_info = grad_fn2exec_info_[node];
+  while (ready_front < ready.size()) {
+    ExecInfo& exec_info = *PopReady();
+    FunctionNode* node = exec_info.node;
 
     if (!exec_info.need_execute) {
       node->ReleaseOutTensorArgs();
@@ -438,11 +490,9 @@ Maybe<void> GraphTask::Apply(bool save_grad_for_leaf) {
     node->ReleaseOutTensorArgs();
     if (!retain_graph_) { node->ReleaseData(); }
 
-    for (const auto& next_grad_fn : node->next_functions()) {
-      FunctionNode* next_node = next_grad_fn.get();
-      int32_t& dependencies = grad_fn2exec_info_[next_node].dependencies;
-      dependencies -= 1;
-      if (dependencies == 0) { queue.push(next_node); }
+    for (ExecInfo* next_exec_info : exec_info.next_exec_infos) {
+      next_exec_info->dependencies -= 1;
+      if (next_exec_info->dependencies == 0) { PushReady(next_exec_info); }
     }
   }
   return Maybe<void>::Ok();
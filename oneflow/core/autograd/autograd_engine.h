@@ -58,6 +58,8 @@ class FunctionNode {
     return next_functions_;
   }
   const std::string& name() const { return name_; }
+  // Increases with the creation order, so a node is always created after its next functions
+  uint64_t sequence_nr() const { return sequence_nr_; }
 
   const std::shared_ptr<Scope>& scope() const { return scope_; }
   void set_scope(const std::shared_ptr<Scope>& scope) { scope_ = scope; }
@@ -69,10 +71,10 @@ class FunctionNode {
  protected:
   friend class GraphTask;
   explicit FunctionNode(const std::string& name,
-                        const std::shared_ptr<BackwardFunction>& backward_fn)
-      : name_(name), backward_fn_(backward_fn), scope_(nullptr) {}
+                        const std::shared_ptr<BackwardFunction>& backward_fn);
 
   const std::string name_;
+  const uint64_t sequence_nr_;
   std::vector<std::shared_ptr<FunctionNode>> next_functions_;
 
   std::vector<std::shared_ptr<AutogradMeta>> input_meta_data_;
@@ -156,11 +158,16 @@ class GraphTask final {
 
     int32_t dependencies = 0;
     bool need_execute = false;
+    FunctionNode* node = nullptr;
+    // ExecInfos of node->next_functions(), which saves the hash lookups while applying
+    std::vector<ExecInfo*> next_exec_infos;
     // Used in autograd.grad interface, to record which grad of tensor will be captured.
     // The pair means: <output index of this Node, the index of captured_grads_ to be saved>
     std::unique_ptr<std::vector<std::pair<size_t, size_t>>> capture_indices;
   };
 
+  ExecInfo* MutExecInfo(FunctionNode* node);
+
   bool retain_graph_;
   bool create_graph_;
   std::vector<FunctionNode*> roots_;
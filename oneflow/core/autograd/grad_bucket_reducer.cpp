@@ -0,0 +1,149 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "oneflow/core/autograd/grad_bucket_reducer.h"
+#include "oneflow/core/autograd/autograd_engine.h"
+#include "oneflow/core/autograd/autograd_meta.h"
+#include "oneflow/core/autograd/autograd_mode.h"
+#include "oneflow/core/ep/include/device.h"
+#include "oneflow/core/framework/tensor.h"
+#include "oneflow/core/functional/functional.h"
+#include "oneflow/core/rpc/include/global_process_ctx.h"
+
+namespace oneflow {
+
+namespace one {
+
+/*static*/ Maybe<GradBucketReducer> GradBucketReducer::New(const TensorTuple& params,
+                                                           int64_t max_params_per_bucket,
+                                                           int64_t bucket_cap_bytes) {
+  std::shared_ptr<GradBucketReducer> reducer(new GradBucketReducer());
+  JUST(reducer->Init(params, max_params_per_bucket, bucket_cap_bytes));
+  return reducer;
+}
+
+Maybe<void> GradBucketReducer::Init(const TensorTuple& params, int64_t max_params_per_bucket,
+                                    int64_t bucket_cap_bytes) {
+  CHECK_GT_OR_RETURN(max_params_per_bucket, 0)
+      << "the number of parameters per bucket must be positive";
+  scale_ = 1.0 / GlobalProcessCtx::WorldSize();
+  params_.assign(params.begin(), params.end());
+  grad_views_.resize(params.size());
+  param_index2bucket_index_.resize(params.size());
+  grad_ready_.resize(params.size());
+  if (params.empty()) { return Maybe<void>::Ok(); }
+  const Symbol<DType> dtype = params.at(0)->dtype();
+  const Symbol<Device> device = JUST(params.at(0)->device());
+  const int64_t elem_size = GetSizeOfDataType(dtype->data_type());
+  // every grad view starts at a max aligned offset of its bucket
+  const int64_t align_elem_cnt = ep::kMaxAlignmentRequirement / elem_size;
+  std::vector<int64_t> offsets(params.size());
+  int64_t bucket_elem_cnt = 0;
+  for (int64_t i = params.size() - 1; i >= 0; --i) {
+    const auto& param = params.at(i);
+    CHECK_OR_RETURN(param->is_leaf() && param->requires_grad())
+        << "only the grads of leaf tensors which require grad can be reduced";
+    CHECK_OR_RETURN(param->dtype() == dtype) << "all the parameters must have the same dtype";
+    CHECK_OR_RETURN(JUST(param->device()) == device)
+        << "all the parameters must be on the same device";
+    const int64_t elem_cnt = RoundUp(param->shape()->elem_cnt(), align_elem_cnt);
+    const bool bucket_full =
+        !buckets_.empty()
+        && (buckets_.back().param_indices.size() >= static_cast<size_t>(max_params_per_bucket)
+            || (bucket_cap_bytes > 0
+                && (bucket_elem_cnt + elem_cnt) * elem_size > bucket_cap_bytes));
+    if (buckets_.empty() || bucket_full) {
+      buckets_.emplace_back();
+      bucket_elem_cnt = 0;
+    }
+    buckets_.back().param_indices.emplace_back(i);
+    param_index2bucket_index_[i] = buckets_.size() - 1;
+    offsets[i] = bucket_elem_cnt;
+    bucket_elem_cnt += elem_cnt;
+  }
+  std::weak_ptr<GradBucketReducer> weak_reducer = shared_from_this();
+  for (auto& bucket : buckets_) {
+    const size_t last_param_index = bucket.param_indices.back();
+    const int64_t elem_cnt =
+        offsets[last_param_index]
+        + RoundUp(params.at(last_param_index)->shape()->elem_cnt(), align_elem_cnt);
+    bucket.flat_grad = JUST(functional::Constant(Shape({elem_cnt}), Scalar(0), dtype, device));
+    for (size_t param_index : bucket.param_indices) {
+      const auto& param = params.at(param_index);
+      const int64_t offset = offsets[param_index];
+      grad_views_[param_index] = JUST(functional::View(
+          JUST(functional::SliceView1dContiguous(bucket.flat_grad, offset,
+                                                 offset + param->shape()->elem_cnt())),
+          *param->shape()));
+      if (!param->grad_fn_node()) { JUST(AddAccumulateFunctionNode(param)); }
+      // accumulates the grad into the bucket, unless the grad is set already
+      param->mut_autograd_meta()->add_hook(
+          [weak_reducer, param_index](
+              const std::shared_ptr<const Tensor>& grad) -> std::shared_ptr<Tensor> {
+            if (auto reducer = weak_reducer.lock()) {
+              CHECK_JUST(reducer->SetGradView(param_index));
+            }
+            return nullptr;
+          });
+      param->mut_autograd_meta()->add_post_grad_accumulation_hook(
+          [weak_reducer, param_index](
+              const std::shared_ptr<const Tensor>& grad) -> std::shared_ptr<Tensor> {
+            if (auto reducer = weak_reducer.lock()) {
+              CHECK_JUST(reducer->MarkGradReady(param_index));
+            }
+            return nullptr;
+          });
+    }
+  }
+  Reset();
+  return Maybe<void>::Ok();
+}
+
+void GradBucketReducer::Reset() {
+  std::fill(grad_ready_.begin(), grad_ready_.end(), false);
+  for (auto& bucket : buckets_) { bucket.num_pending = bucket.param_indices.size(); }
+  next_bucket_index_ = 0;
+}
+
+Maybe<void> GradBucketReducer::SetGradView(size_t param_index) {
+  const auto& param = params_.at(param_index).lock();
+  if (param && !param->mut_autograd_meta()->acc_grad()) {
+    // the grad was set to None, the view still holds the reduced grad of the former step
+    autograd::AutoGradMode mode(false);
+    const auto& grad_view = grad_views_.at(param_index);
+    JUST(functional::Fill(grad_view, Scalar(0)));
+    JUST(param->mut_autograd_meta()->set_acc_grad(grad_view));
+  }
+  return Maybe<void>::Ok();
+}
+
+Maybe<void> GradBucketReducer::MarkGradReady(size_t param_index) {
+  // a grad accumulated again before the next forward, e.g. by a second backward, is not reduced
+  if (grad_ready_.at(param_index)) { return Maybe<void>::Ok(); }
+  grad_ready_.at(param_index) = true;
+  buckets_.at(param_index2bucket_index_.at(param_index)).num_pending -= 1;
+  autograd::AutoGradMode mode(false);
+  while (next_bucket_index_ < buckets_.size() && buckets_[next_bucket_index_].num_pending == 0) {
+    const auto& flat_grad = buckets_[next_bucket_index_].flat_grad;
+    JUST(functional::ScalarMul(flat_grad, Scalar(scale_), /*inplace=*/true));
+    JUST(functional::LocalAllReduce(flat_grad, /*inplace=*/true));
+    next_bucket_index_ += 1;
+  }
+  return Maybe<void>::Ok();
+}
+
+}  // namespace one
+
+}  // namespace oneflow
@@ -0,0 +1,84 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#ifndef ONEFLOW_CORE_AUTOGRAD_GRAD_BUCKET_REDUCER_H_
+#define ONEFLOW_CORE_AUTOGRAD_GRAD_BUCKET_REDUCER_H_
+
+#include <memory>
+#include <vector>
+
+#include "oneflow/core/common/util.h"
+#include "oneflow/core/common/maybe.h"
+#include "oneflow/core/framework/tensor_tuple.h"
+
+namespace oneflow {
+
+namespace one {
+
+class Tensor;
+
+// Reduces the grads of the parameters of an eager data parallel module while backward runs.
+// The parameters are packed in reverse order, which is roughly the order in which backward
+// accumulates their grads, into buckets of flat grad tensors, and the grad of every parameter is
+// a view of its bucket. Once all the grads of a bucket are accumulated, the bucket is scaled by
+// 1 / world_size and all-reduced in place asynchronously while backward continues. Buckets are
+// launched strictly in order, so all ranks issue the collectives in the same order.
+class GradBucketReducer final : public std::enable_shared_from_this<GradBucketReducer> {
+ public:
+  OF_DISALLOW_COPY_AND_MOVE(GradBucketReducer);
+  ~GradBucketReducer() = default;
+
+  // `params` are in the order of Module.parameters(). A bucket holds at most
+  // `max_params_per_bucket` parameters and, if `bucket_cap_bytes` > 0, at most `bucket_cap_bytes`
+  // bytes of grads unless it only has a single parameter.
+  static Maybe<GradBucketReducer> New(const TensorTuple& params, int64_t max_params_per_bucket,
+                                      int64_t bucket_cap_bytes);
+
+  // Marks all the grads as not accumulated yet, to be called once per forward.
+  void Reset();
+
+  size_t num_buckets() const { return buckets_.size(); }
+  // indices in `params` of the parameters of the bucket `bucket_index`
+  const std::vector<size_t>& bucket_param_indices(size_t bucket_index) const {
+    return buckets_.at(bucket_index).param_indices;
+  }
+
+ private:
+  struct Bucket {
+    std::vector<size_t> param_indices;
+    std::shared_ptr<Tensor> flat_grad;
+    size_t num_pending = 0;
+  };
+
+  GradBucketReducer() = default;
+  Maybe<void> Init(const TensorTuple& params, int64_t max_params_per_bucket,
+                   int64_t bucket_cap_bytes);
+  Maybe<void> SetGradView(size_t param_index);
+  Maybe<void> MarkGradReady(size_t param_index);
+
+  std::vector<std::weak_ptr<Tensor>> params_;
+  std::vector<std::shared_ptr<Tensor>> grad_views_;
+  std::vector<size_t> param_index2bucket_index_;
+  std::vector<bool> grad_ready_;
+  std::vector<Bucket> buckets_;
+  size_t next_bucket_index_ = 0;
+  double scale_ = 1.0;
+};
+
+}  // namespace one
+
+}  // namespace oneflow
+
+#endif  // ONEFLOW_CORE_AUTOGRAD_GRAD_BUCKET_REDUCER_H_
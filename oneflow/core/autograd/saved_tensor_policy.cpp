@@ -0,0 +1,259 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "oneflow/core/autograd/saved_tensor_policy.h"
+#include "oneflow/core/autograd/autograd_mode.h"
+#include "oneflow/core/common/singleton.h"
+#include "oneflow/core/framework/device.h"
+#include "oneflow/core/framework/dtype.h"
+#include "oneflow/core/framework/tensor.h"
+#include "oneflow/core/framework/tensor_tuple.h"
+#include "oneflow/core/functional/functional.h"
+
+namespace oneflow {
+namespace one {
+
+namespace {
+
+struct OffloadedTensor {
+  int64_t index;
+  Symbol<Device> device;
+  Symbol<DType> dtype;
+  std::shared_ptr<Tensor> host_tensor;
+  std::shared_ptr<Tensor> prefetched;
+};
+
+Maybe<Tensor> CopyBack(const OffloadedTensor& offloaded) {
+  autograd::AutoGradMode mode(false);
+  auto tensor = JUST(functional::Copy(offloaded.host_tensor, offloaded.device, false));
+  return functional::Cast(tensor, offloaded.dtype, false);
+}
+
+}  // namespace
+
+class OffloadedTensorQueue final {
+ public:
+  OffloadedTensorQueue(bool pin_memory, bool compress_to_bf16, int64_t prefetch_depth,
+                       int64_t min_bytes)
+      : pin_memory_(pin_memory),
+        compress_to_bf16_(compress_to_bf16),
+        prefetch_depth_(prefetch_depth),
+        min_bytes_(min_bytes) {}
+  ~OffloadedTensorQueue() = default;
+
+  int64_t num_offloaded() const { return offloaded_.size(); }
+
+  // Leaves `offloaded` null if `tensor` is kept on device.
+  Maybe<void> Offload(const std::shared_ptr<Tensor>& tensor,
+                      std::shared_ptr<OffloadedTensor>* offloaded) {
+    if (!tensor->is_local() || !tensor->is_eager()) { return Maybe<void>::Ok(); }
+    if (tensor->is_leaf() && tensor->requires_grad()) { return Maybe<void>::Ok(); }
+    Symbol<Device> device = JUST(tensor->device());
+    if (device->type() == "cpu") { return Maybe<void>::Ok(); }
+    const int64_t bytes =
+        tensor->shape()->elem_cnt() * GetSizeOfDataType(tensor->dtype()->data_type());
+    if (bytes < min_bytes_) { return Maybe<void>::Ok(); }
+
+    autograd::AutoGradMode mode(false);
+    auto entry = std::make_shared<OffloadedTensor>();
+    entry->index = offloaded_.size();
+    entry->device = device;
+    entry->dtype = tensor->dtype();
+    std::shared_ptr<Tensor> packed = tensor;
+    if (compress_to_bf16_ && IsFloatingDataType(tensor->dtype()->data_type())
+        && GetSizeOfDataType(tensor->dtype()->data_type()) > 2) {
+      packed = JUST(functional::Cast(packed, DType::BFloat16(), false));
+    }
+    entry->host_tensor = JUST(functional::Copy(packed, JUST(Device::New("cpu")), pin_memory_));
+    offloaded_.emplace_back(entry);
+    *offloaded = std::move(entry);
+    return Maybe<void>::Ok();
+  }
+
+  Maybe<Tensor> Reload(const std::shared_ptr<OffloadedTensor>& offloaded) {
+    std::shared_ptr<Tensor> tensor = std::move(offloaded->prefetched);
+    // the host copy is kept for another backward through a retained graph, it is released with
+    // the saved tensor hook
+    if (!tensor) { tensor = JUST(CopyBack(*offloaded)); }
+    // start copying back the tensors that backward is about to unpack
+    for (int64_t i = offloaded->index - 1;
+         i >= 0 && i >= offloaded->index - prefetch_depth_; --i) {
+      const auto& next = offloaded_[i].lock();
+      if (next && !next->prefetched) { next->prefetched = JUST(CopyBack(*next)); }
+    }
+    return tensor;
+  }
+
+ private:
+  bool pin_memory_;
+  bool compress_to_bf16_;
+  int64_t prefetch_depth_;
+  int64_t min_bytes_;
+  std::vector<std::weak_ptr<OffloadedTensor>> offloaded_;
+};
+
+namespace {
+
+class OffloadSavedTensorHook final : public SavedTensorHook {
+ public:
+  explicit OffloadSavedTensorHook(const std::shared_ptr<OffloadedTensorQueue>& queue)
+      : queue_(queue) {}
+  ~OffloadSavedTensorHook() override = default;
+
+  void pack(const std::shared_ptr<Tensor>& tensor) override {
+    CHECK_JUST(queue_->Offload(tensor, &offloaded_));
+    if (!offloaded_) { tensor_ = tensor; }
+  }
+  std::shared_ptr<Tensor> unpack() override {
+    if (!offloaded_) { return tensor_; }
+    return CHECK_JUST(queue_->Reload(offloaded_));
+  }
+
+ private:
+  std::shared_ptr<OffloadedTensorQueue> queue_;
+  std::shared_ptr<OffloadedTensor> offloaded_;
+  std::shared_ptr<Tensor> tensor_;
+};
+
+}  // namespace
+
+OffloadSavedTensorHookCreator::OffloadSavedTensorHookCreator(bool pin_memory,
+                                                             bool compress_to_bf16,
+                                                             int64_t prefetch_depth,
+                                                             int64_t min_bytes)
+    : queue_(std::make_shared<OffloadedTensorQueue>(pin_memory, compress_to_bf16, prefetch_depth,
+                                                    min_bytes)) {}
+
+std::unique_ptr<SavedTensorHook> OffloadSavedTensorHookCreator::new_saved_tensor_hook() const {
+  return std::make_unique<OffloadSavedTensorHook>(queue_);
+}
+
+int64_t OffloadSavedTensorHookCreator::num_offloaded() const { return queue_->num_offloaded(); }
+
+class RecomputeSegment final {
+ public:
+  explicit RecomputeSegment(const std::function<Maybe<void>()>& forward)
+      : forward_(forward), num_packed_(0), recomputed_(false) {}
+  ~RecomputeSegment() = default;
+
+  size_t Pack() { return num_packed_++; }
+  void Collect(const std::shared_ptr<Tensor>& tensor) { recomputed_tensors_.push_back(tensor); }
+  Maybe<Tensor> Unpack(size_t index);
+
+ private:
+  Maybe<void> Recompute();
+
+  std::function<Maybe<void>()> forward_;
+  size_t num_packed_;
+  bool recomputed_;
+  TensorTuple recomputed_tensors_;
+};
+
+namespace {
+
+class RecomputeSavedTensorHook final : public SavedTensorHook {
+ public:
+  explicit RecomputeSavedTensorHook(const std::shared_ptr<RecomputeSegment>& segment)
+      : segment_(segment), index_(0) {}
+  ~RecomputeSavedTensorHook() override = default;
+
+  void pack(const std::shared_ptr<Tensor>& tensor) override { index_ = segment_->Pack(); }
+  std::shared_ptr<Tensor> unpack() override { return CHECK_JUST(segment_->Unpack(index_)); }
+
+ private:
+  std::shared_ptr<RecomputeSegment> segment_;
+  size_t index_;
+};
+
+// Hands the tensors saved while a segment is recomputed over to the segment.
+class RecomputedTensorCollectHook final : public SavedTensorHook {
+ public:
+  explicit RecomputedTensorCollectHook(RecomputeSegment* segment) : segment_(segment) {}
+  ~RecomputedTensorCollectHook() override = default;
+
+  void pack(const std::shared_ptr<Tensor>& tensor) override { segment_->Collect(tensor); }
+  std::shared_ptr<Tensor> unpack() override {
+    THROW(RuntimeError) << "Backward of a recomputed segment is called, it is never exposed.";
+    return nullptr;
+  }
+
+ private:
+  RecomputeSegment* segment_;
+};
+
+class RecomputedTensorCollector final : public SavedTensorHookCreator {
+ public:
+  explicit RecomputedTensorCollector(RecomputeSegment* segment) : segment_(segment) {}
+  ~RecomputedTensorCollector() override = default;
+
+  std::unique_ptr<SavedTensorHook> new_saved_tensor_hook() const override {
+    return std::make_unique<RecomputedTensorCollectHook>(segment_);
+  }
+
+ private:
+  RecomputeSegment* segment_;
+};
+
+class SavedTensorHookCreatorGuard final {
+ public:
+  SavedTensorHookCreatorGuard(SavedTensorHookCreatorStack* stack,
+                              const std::shared_ptr<SavedTensorHookCreator>& creator)
+      : stack_(stack) {
+    stack_->push(creator);
+  }
+  ~SavedTensorHookCreatorGuard() { stack_->pop(); }
+
+ private:
+  SavedTensorHookCreatorStack* stack_;
+};
+
+}  // namespace
+
+Maybe<void> RecomputeSegment::Recompute() {
+  auto* stack =
+      dynamic_cast<SavedTensorHookCreatorStack*>(Singleton<SavedTensorHookCreator>::Get());
+  CHECK_NOTNULL_OR_RETURN(stack) << "saved tensor hooks are not registered";
+  {
+    SavedTensorHookCreatorGuard guard(stack, std::make_shared<RecomputedTensorCollector>(this));
+    autograd::AutoGradMode mode(true);
+    JUST(forward_());
+  }
+  // release the inputs captured by the segment
+  forward_ = nullptr;
+  CHECK_EQ_OR_RETURN(recomputed_tensors_.size(), num_packed_)
+      << "The recomputed segment saved " << recomputed_tensors_.size()
+      << " tensors for backward, but " << num_packed_ << " were saved by its forward";
+  return Maybe<void>::Ok();
+}
+
+Maybe<Tensor> RecomputeSegment::Unpack(size_t index) {
+  if (!recomputed_) {
+    recomputed_ = true;
+    JUST(Recompute());
+  }
+  CHECK_LT_OR_RETURN(index, recomputed_tensors_.size());
+  return recomputed_tensors_[index];
+}
+
+RecomputeSavedTensorHookCreator::RecomputeSavedTensorHookCreator(
+    const std::function<Maybe<void>()>& forward)
+    : segment_(std::make_shared<RecomputeSegment>(forward)) {}
+
+std::unique_ptr<SavedTensorHook> RecomputeSavedTensorHookCreator::new_saved_tensor_hook() const {
+  return std::make_unique<RecomputeSavedTensorHook>(segment_);
+}
+
+}  // namespace one
+}  // namespace oneflow
@@ -0,0 +1,69 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#ifndef ONEFLOW_CORE_AUTOGRAD_SAVED_TENSOR_POLICY_H_
+#define ONEFLOW_CORE_AUTOGRAD_SAVED_TENSOR_POLICY_H_
+
+#include <functional>
+#include "oneflow/core/common/maybe.h"
+#include "oneflow/core/framework/saved_tensor_hooks.h"
+
+namespace oneflow {
+namespace one {
+
+class OffloadedTensorQueue;
+class RecomputeSegment;
+
+// Copies the device tensors saved for backward to host memory when they are packed, so that the
+// device memory of activations is released during forward, and copies them back when backward
+// unpacks them. The copies run on the device to host and host to device streams. Floating tensors
+// are cast to bfloat16 before being copied out if `compress_to_bf16` is set, which is lossy.
+// Backward unpacks saved tensors in about the reverse order they were packed, so unpacking one
+// of them also starts copying back the `prefetch_depth` ones packed right before it.
+// Parameters and tensors smaller than `min_bytes` are kept on device.
+class OffloadSavedTensorHookCreator final : public SavedTensorHookCreator {
+ public:
+  OffloadSavedTensorHookCreator(bool pin_memory, bool compress_to_bf16, int64_t prefetch_depth,
+                                int64_t min_bytes);
+  ~OffloadSavedTensorHookCreator() override = default;
+
+  std::unique_ptr<SavedTensorHook> new_saved_tensor_hook() const override;
+
+  // the number of saved tensors copied to host memory so far
+  int64_t num_offloaded() const;
+
+ private:
+  std::shared_ptr<OffloadedTensorQueue> queue_;
+};
+
+// Drops the tensors saved for backward by a forward segment and calls `forward` again, with grad
+// mode enabled, the first time backward unpacks one of them. The tensors saved by the recomputed
+// segment replace the dropped ones in order. They are kept until backward releases the graph, so
+// that a graph retained for another backward does not recompute the segment again.
+class RecomputeSavedTensorHookCreator final : public SavedTensorHookCreator {
+ public:
+  explicit RecomputeSavedTensorHookCreator(const std::function<Maybe<void>()>& forward);
+  ~RecomputeSavedTensorHookCreator() override = default;
+
+  std::unique_ptr<SavedTensorHook> new_saved_tensor_hook() const override;
+
+ private:
+  std::shared_ptr<RecomputeSegment> segment_;
+};
+
+}  // namespace one
+}  // namespace oneflow
+
+#endif  // ONEFLOW_CORE_AUTOGRAD_SAVED_TENSOR_POLICY_H_
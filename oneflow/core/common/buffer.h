@@ -33,6 +33,7 @@ class Buffer final {
   BufferStatus Push(U&& item);
   BufferStatus Pull(T* item);
   BufferStatus TryReceive(T* item);
+  void SetMaxLen(size_t max_len);
   void Close();
 
  private:
@@ -75,6 +76,13 @@ BufferStatus Buffer<T>::TryReceive(T* item) {
   return kBufferStatusSuccess;
 }
 
+template<typename T>
+void Buffer<T>::SetMaxLen(size_t max_len) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  max_len_ = max_len;
+  cond_.notify_all();
+}
+
 template<typename T>
 void Buffer<T>::Close() {
   std::unique_lock<std::mutex> lock(mutex_);
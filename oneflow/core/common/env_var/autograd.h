@@ -0,0 +1,30 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#ifndef ONEFLOW_CORE_COMMON_ENV_VAR_AUTOGRAD_H_
+#define ONEFLOW_CORE_COMMON_ENV_VAR_AUTOGRAD_H_
+
+#include "oneflow/core/common/env_var/env_var.h"
+
+namespace oneflow {
+
+// NOTE: use env variable 'ONEFLOW_AUTOGRAD_PRIORITY_SCHEDULE' indicate whether backward runs the
+// ready FunctionNodes in reverse creation order (depth first) instead of first in first out, which
+// releases the saved tensors of a branch before walking the next one. Off by default until its
+// effect on peak memory has been measured on standard models.
+DEFINE_THREAD_LOCAL_ENV_BOOL(ONEFLOW_AUTOGRAD_PRIORITY_SCHEDULE, false);
+
+}  // namespace oneflow
+#endif  // ONEFLOW_CORE_COMMON_ENV_VAR_AUTOGRAD_H_
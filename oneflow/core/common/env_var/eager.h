@@ -28,5 +28,9 @@ DEFINE_THREAD_LOCAL_ENV_BOOL(ONEFLOW_EAGER_ENABLE_LOCAL_INFER_CACHE, true);
 // infer cache in op interpret.
 DEFINE_THREAD_LOCAL_ENV_INTEGER(ONEFLOW_EAGER_TENSOR_INFER_CACHE_SIZE, 128 * 1024);
 
+// NOTE: use env variable 'ONEFLOW_EAGER_ENABLE_ELEMENTWISE_FUSION' indicate whether consecutive
+// cpu elementwise op calls fused by vm are computed chunk by chunk in a single pass.
+DEFINE_THREAD_LOCAL_ENV_BOOL(ONEFLOW_EAGER_ENABLE_ELEMENTWISE_FUSION, false);
+
 }  // namespace oneflow
 #endif  // ONEFLOW_CORE_COMMON_ENV_VAR_EAGER_H_
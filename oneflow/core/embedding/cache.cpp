@@ -16,6 +16,7 @@ limitations under the License.
 #include "oneflow/core/embedding/cache.h"
 #include "oneflow/core/embedding/full_cache.h"
 #include "oneflow/core/embedding/lru_cache.h"
+#include "oneflow/core/embedding/lfu_cache.h"
 
 namespace oneflow {
 
@@ -30,6 +31,9 @@ std::unique_ptr<Cache> NewCache(const CacheOptions& options) {
     return NewLruCache(options);
   } else if (options.policy == CacheOptions::Policy::kFull) {
     return NewFullCache(options);
+  } else if (options.policy == CacheOptions::Policy::kLFU
+             || options.policy == CacheOptions::Policy::kTinyLFU) {
+    return NewLfuCache(options);
   } else {
     UNIMPLEMENTED();
     return nullptr;
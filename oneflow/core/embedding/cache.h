@@ -29,6 +29,12 @@ struct CacheOptions {
   enum class Policy {
     kLRU,
     kFull,
+    // Evicts the least frequently used line of a set, frequencies are halved periodically so that
+    // formerly hot keys age out.
+    kLFU,
+    // kLFU with a count-min sketch and doorkeeper admission filter, a missing key only replaces the
+    // victim line if it has been seen more often than the victim.
+    kTinyLFU,
   };
   enum class MemoryKind {
     kDevice,
@@ -41,6 +47,22 @@ struct CacheOptions {
   uint32_t value_size{};
   DataType value_type{};
   float load_factor = 0.75;
+  // Number of put keys between two frequency halvings of kLFU and kTinyLFU caches, 0 means 10 times
+  // the capacity.
+  uint64_t frequency_decay_interval{};
+  // Counts the CacheStats in Get and Put, off by default as it adds atomics to every query.
+  bool enable_stats = false;
+};
+
+struct CacheStats {
+  uint64_t num_queries{};
+  uint64_t num_hits{};
+  uint64_t num_evictions{};
+  uint64_t num_rejected_admissions{};
+
+  double HitRatio() const {
+    return num_queries == 0 ? 0.0 : static_cast<double>(num_hits) / num_queries;
+  }
 };
 
 class Cache {
@@ -73,11 +95,27 @@ class Cache {
                                   void* evicted_values) {
     UNIMPLEMENTED();
   }
+  // Put of values that are known to equal the ones of the next level store, e.g. values that were
+  // just read from it. Keys rejected by an admission policy are dropped instead of being returned
+  // as evicted, since writing them back would not change the store.
+  virtual void PutUnmodified(ep::Stream* stream, uint32_t n_keys, const void* keys,
+                             const void* values, uint32_t* n_evicted, void* evicted_keys,
+                             void* evicted_values) {
+    Put(stream, n_keys, keys, values, n_evicted, evicted_keys, evicted_values);
+  }
+  // Removes `keys` from the cache without writing them anywhere, absent keys are ignored.
+  virtual void Delete(ep::Stream* stream, uint32_t n_keys, const void* keys) { UNIMPLEMENTED(); }
   virtual void Dump(ep::Stream* stream, uint64_t start_key_index, uint64_t end_key_index,
                     uint32_t* n_dumped, void* keys, void* values) = 0;
 
   virtual void ClearDirtyFlags() = 0;
 
+  // Counters accumulated by Get and Put since the creation of the cache or the last ResetStats,
+  // GetStats synchronizes the stream. Caches that do not count, or were created without
+  // CacheOptions::enable_stats, report zeros.
+  virtual void GetStats(ep::Stream* stream, CacheStats* stats) { *stats = CacheStats(); }
+  virtual void ResetStats(ep::Stream* stream) {}
+
   virtual void Clear() = 0;
 };
 
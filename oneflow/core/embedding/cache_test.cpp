@@ -17,6 +17,10 @@ limitations under the License.
 #include "oneflow/core/device/cuda_util.h"
 #include <gtest/gtest.h>
 #include "oneflow/core/ep/include/device_manager_registry.h"
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <numeric>
 
 namespace oneflow {
 
@@ -83,6 +87,7 @@ void TestCache(Cache* cache, uint32_t line_size) {
   std::iota(random_keys.begin(), random_keys.end(), 1);
   std::random_device rd;
   std::mt19937 g(rd());
+  CacheStats expect_stats{};
   for (size_t iter = 0; iter < n_iter; ++iter) {
     std::shuffle(random_keys.begin(), random_keys.end(), g);
     std::copy(random_keys.begin(), random_keys.begin() + n_keys, keys);
@@ -140,6 +145,8 @@ void TestCache(Cache* cache, uint32_t line_size) {
     }
     ASSERT_EQ(get_missing_keys_set, expect_missing_keys_set);
     ASSERT_EQ(get_missing_indices_set, expect_missing_indices_set);
+    expect_stats.num_queries += n_keys;
+    expect_stats.num_hits += n_keys - expect_n_missing;
     for (size_t i = 0; i < n_keys; ++i) {
       if (get_missing_keys_set.count(keys[i]) == 0) {
         for (size_t j = 0; j < line_size; ++j) {
@@ -172,6 +179,17 @@ void TestCache(Cache* cache, uint32_t line_size) {
     }
     for (size_t i = 0; i < n_keys; ++i) { in_cache.emplace(keys[i]); }
     for (size_t i = 0; i < *n_evicted; ++i) { in_cache.erase(evicted_keys[i]); }
+    expect_stats.num_evictions += *n_evicted;
+  }
+  if (cache->Policy() != CacheOptions::Policy::kFull) {
+    CacheStats stats{};
+    cache->GetStats(stream, &stats);
+    ASSERT_EQ(stats.num_queries, expect_stats.num_queries);
+    ASSERT_EQ(stats.num_hits, expect_stats.num_hits);
+    ASSERT_EQ(stats.num_evictions + stats.num_rejected_admissions, expect_stats.num_evictions);
+    if (cache->Policy() != CacheOptions::Policy::kTinyLFU) {
+      ASSERT_EQ(stats.num_rejected_admissions, 0);
+    }
   }
   const uint64_t dump_capacity = cache->DumpCapacity();
   for (size_t start_key_index = 0; start_key_index < dump_capacity; start_key_index += n_keys) {
@@ -236,12 +254,272 @@ TEST(Cache, LruCache) {
   options.capacity = 65536;
   options.key_size = 8;
   options.value_memory_kind = CacheOptions::MemoryKind::kDevice;
+  options.enable_stats = true;
+
+  std::unique_ptr<Cache> cache(NewCache(options));
+  cache->ReserveQueryLength(65536);
+  TestCache(cache.get(), line_size);
+}
+
+TEST(Cache, LfuCache) {
+  if (!HasCudaDevice()) { return; }
+
+  CacheOptions options{};
+  options.policy = CacheOptions::Policy::kLFU;
+  const uint32_t line_size = 128;
+  options.value_size = 512;
+  options.capacity = 16384;
+  options.key_size = 8;
+  options.value_memory_kind = CacheOptions::MemoryKind::kDevice;
+  options.frequency_decay_interval = 8192;
+  options.enable_stats = true;
 
   std::unique_ptr<Cache> cache(NewCache(options));
   cache->ReserveQueryLength(65536);
   TestCache(cache.get(), line_size);
 }
 
+TEST(Cache, TinyLfuCache) {
+  if (!HasCudaDevice()) { return; }
+
+  CacheOptions options{};
+  options.policy = CacheOptions::Policy::kTinyLFU;
+  const uint32_t line_size = 128;
+  options.value_size = 512;
+  options.capacity = 16384;
+  options.key_size = 8;
+  options.value_memory_kind = CacheOptions::MemoryKind::kDevice;
+  options.frequency_decay_interval = 8192;
+  options.enable_stats = true;
+
+  std::unique_ptr<Cache> cache(NewCache(options));
+  cache->ReserveQueryLength(65536);
+  TestCache(cache.get(), line_size);
+}
+
+TEST(Cache, TinyLfuCacheDropsUnmodifiedRejectedKeys) {
+  if (!HasCudaDevice()) { return; }
+
+  CacheOptions options{};
+  options.policy = CacheOptions::Policy::kTinyLFU;
+  const uint32_t line_size = 4;
+  options.value_size = line_size * sizeof(float);
+  // a single set
+  options.capacity = 32;
+  options.key_size = 8;
+  options.value_memory_kind = CacheOptions::MemoryKind::kDevice;
+  options.enable_stats = true;
+  std::unique_ptr<Cache> cache(NewCache(options));
+  const uint32_t n_keys = 32;
+  cache->ReserveQueryLength(n_keys);
+
+  std::unique_ptr<ep::DeviceManagerRegistry> device_manager_registry(
+      new ep::DeviceManagerRegistry());
+  auto device = device_manager_registry->GetDevice(DeviceType::kCUDA, 0);
+  ep::Stream* stream = device->CreateStream();
+  const size_t keys_size = n_keys * sizeof(int64_t);
+  const size_t values_size = n_keys * line_size * sizeof(float);
+  int64_t* d_keys;
+  float* d_values;
+  uint32_t* d_n_evicted;
+  int64_t* d_evicted_keys;
+  float* d_evicted_values;
+  OF_CUDA_CHECK(cudaMalloc(&d_keys, keys_size));
+  OF_CUDA_CHECK(cudaMalloc(&d_values, values_size));
+  OF_CUDA_CHECK(cudaMalloc(&d_n_evicted, sizeof(uint32_t)));
+  OF_CUDA_CHECK(cudaMalloc(&d_evicted_keys, keys_size));
+  OF_CUDA_CHECK(cudaMalloc(&d_evicted_values, values_size));
+  OF_CUDA_CHECK(cudaMemset(d_values, 0, values_size));
+  std::vector<int64_t> keys(n_keys);
+  auto PutKeys = [&](int64_t first_key, bool unmodified) -> uint32_t {
+    std::iota(keys.begin(), keys.end(), first_key);
+    OF_CUDA_CHECK(cudaMemcpy(d_keys, keys.data(), keys_size, cudaMemcpyDefault));
+    if (unmodified) {
+      cache->PutUnmodified(stream, n_keys, d_keys, d_values, d_n_evicted, d_evicted_keys,
+                           d_evicted_values);
+    } else {
+      cache->Put(stream, n_keys, d_keys, d_values, d_n_evicted, d_evicted_keys, d_evicted_values);
+    }
+    CHECK_JUST(stream->Sync());
+    uint32_t n_evicted = 0;
+    OF_CUDA_CHECK(cudaMemcpy(&n_evicted, d_n_evicted, sizeof(uint32_t), cudaMemcpyDefault));
+    return n_evicted;
+  };
+  // fill the set with keys seen several times
+  for (int i = 0; i < 4; ++i) { ASSERT_EQ(PutKeys(1, false), 0); }
+  // keys seen once are rejected, and dropped since the next level store already holds them
+  ASSERT_EQ(PutKeys(1001, true), 0);
+  CacheStats stats{};
+  cache->GetStats(stream, &stats);
+  ASSERT_EQ(stats.num_rejected_admissions, n_keys);
+  ASSERT_EQ(stats.num_evictions, 0);
+  // modified values of rejected keys are written back
+  ASSERT_EQ(PutKeys(1001, false), n_keys);
+  std::vector<int64_t> evicted_keys(n_keys);
+  OF_CUDA_CHECK(cudaMemcpy(evicted_keys.data(), d_evicted_keys, keys_size, cudaMemcpyDefault));
+  std::sort(evicted_keys.begin(), evicted_keys.end());
+  ASSERT_EQ(evicted_keys, keys);
+
+  OF_CUDA_CHECK(cudaFree(d_keys));
+  OF_CUDA_CHECK(cudaFree(d_values));
+  OF_CUDA_CHECK(cudaFree(d_n_evicted));
+  OF_CUDA_CHECK(cudaFree(d_evicted_keys));
+  OF_CUDA_CHECK(cudaFree(d_evicted_values));
+  device->DestroyStream(stream);
+}
+
+TEST(Cache, StatsAreOffByDefault) {
+  if (!HasCudaDevice()) { return; }
+
+  CacheOptions options{};
+  options.policy = CacheOptions::Policy::kLRU;
+  options.value_size = 512;
+  options.capacity = 65536;
+  options.key_size = 8;
+  options.value_memory_kind = CacheOptions::MemoryKind::kDevice;
+  std::unique_ptr<Cache> cache(NewCache(options));
+  std::unique_ptr<ep::DeviceManagerRegistry> device_manager_registry(
+      new ep::DeviceManagerRegistry());
+  auto device = device_manager_registry->GetDevice(DeviceType::kCUDA, 0);
+  ep::Stream* stream = device->CreateStream();
+  CacheStats stats{};
+  stats.num_queries = 1;
+  cache->GetStats(stream, &stats);
+  ASSERT_EQ(stats.num_queries, 0);
+  cache->ResetStats(stream);
+  device->DestroyStream(stream);
+}
+
+// Batches of unique keys, read from the file named by ONEFLOW_TEST_CACHE_TRACE_FILE (one key per
+// line, a blank line ends a batch) or drawn from a zipfian distribution mixed with one-off keys.
+std::vector<std::vector<int64_t>> LoadOrGenerateTrace(uint32_t batch_size) {
+  std::vector<std::vector<int64_t>> trace;
+  const char* trace_file = std::getenv("ONEFLOW_TEST_CACHE_TRACE_FILE");
+  if (trace_file != nullptr) {
+    std::ifstream in(trace_file);
+    CHECK(in.is_open()) << trace_file;
+    std::vector<int64_t> batch;
+    std::unordered_set<int64_t> batch_set;
+    std::string line;
+    const auto FlushBatch = [&]() {
+      if (!batch.empty()) { trace.emplace_back(std::move(batch)); }
+      batch.clear();
+      batch_set.clear();
+    };
+    while (std::getline(in, line)) {
+      if (line.empty()) {
+        FlushBatch();
+        continue;
+      }
+      const int64_t key = std::stoll(line);
+      if (batch_set.emplace(key).second) { batch.push_back(key); }
+      if (batch.size() == batch_size) { FlushBatch(); }
+    }
+    FlushBatch();
+    return trace;
+  }
+  const size_t n_batches = 512;
+  const size_t n_ids = 1 << 22;
+  const double skew = 1.05;
+  const double one_off_ratio = 0.3;
+  std::vector<double> cdf(n_ids);
+  double sum = 0;
+  for (size_t i = 0; i < n_ids; ++i) {
+    sum += 1.0 / std::pow(static_cast<double>(i + 1), skew);
+    cdf[i] = sum;
+  }
+  std::mt19937_64 g(0);
+  std::uniform_real_distribution<double> dist(0, 1);
+  int64_t next_one_off_id = n_ids + 1;
+  for (size_t b = 0; b < n_batches; ++b) {
+    std::vector<int64_t> batch;
+    std::unordered_set<int64_t> batch_set;
+    while (batch.size() < batch_size) {
+      int64_t key = 0;
+      if (dist(g) < one_off_ratio) {
+        key = next_one_off_id++;
+      } else {
+        key = std::lower_bound(cdf.begin(), cdf.end(), dist(g) * sum) - cdf.begin() + 1;
+      }
+      if (batch_set.emplace(key).second) { batch.push_back(key); }
+    }
+    trace.emplace_back(std::move(batch));
+  }
+  return trace;
+}
+
+TEST(Cache, TraceReplayBenchmark) {
+  if (!HasCudaDevice()) { return; }
+  if (std::getenv("ONEFLOW_TEST_CACHE_BENCHMARK") == nullptr) { return; }
+
+  const uint32_t batch_size = 65536;
+  const uint32_t line_size = 32;
+  const std::vector<std::vector<int64_t>> trace = LoadOrGenerateTrace(batch_size);
+  const size_t n_warmup_batches = trace.size() / 10;
+  std::unique_ptr<ep::DeviceManagerRegistry> device_manager_registry(
+      new ep::DeviceManagerRegistry());
+  auto device = device_manager_registry->GetDevice(DeviceType::kCUDA, 0);
+  ep::Stream* stream = device->CreateStream();
+  const size_t keys_size = batch_size * sizeof(int64_t);
+  const size_t values_size = batch_size * line_size * sizeof(float);
+  int64_t* d_keys;
+  int64_t* d_missing_keys;
+  uint32_t* d_missing_indices;
+  uint32_t* d_n_missing;
+  float* d_values;
+  float* d_evicted_values;
+  OF_CUDA_CHECK(cudaMalloc(&d_keys, keys_size));
+  OF_CUDA_CHECK(cudaMalloc(&d_missing_keys, keys_size));
+  OF_CUDA_CHECK(cudaMalloc(&d_missing_indices, batch_size * sizeof(uint32_t)));
+  OF_CUDA_CHECK(cudaMalloc(&d_n_missing, sizeof(uint32_t)));
+  OF_CUDA_CHECK(cudaMalloc(&d_values, values_size));
+  OF_CUDA_CHECK(cudaMalloc(&d_evicted_values, values_size));
+  OF_CUDA_CHECK(cudaMemset(d_values, 0, values_size));
+  for (const auto& policy_and_name :
+       std::vector<std::pair<CacheOptions::Policy, std::string>>{
+           {CacheOptions::Policy::kLRU, "lru"},
+           {CacheOptions::Policy::kLFU, "lfu"},
+           {CacheOptions::Policy::kTinyLFU, "tinylfu"}}) {
+    CacheOptions options{};
+    options.policy = policy_and_name.first;
+    options.value_size = line_size * sizeof(float);
+    options.capacity = 1 << 20;
+    options.key_size = 8;
+    options.value_memory_kind = CacheOptions::MemoryKind::kDevice;
+    options.enable_stats = true;
+    std::unique_ptr<Cache> cache(NewCache(options));
+    cache->ReserveQueryLength(batch_size);
+    double elapsed_ms = 0;
+    for (size_t b = 0; b < trace.size(); ++b) {
+      if (b == n_warmup_batches) { cache->ResetStats(stream); }
+      const uint32_t n_keys = trace.at(b).size();
+      OF_CUDA_CHECK(cudaMemcpy(d_keys, trace.at(b).data(), n_keys * sizeof(int64_t),
+                               cudaMemcpyDefault));
+      const auto start = std::chrono::steady_clock::now();
+      cache->Get(stream, n_keys, d_keys, d_values, d_n_missing, d_missing_keys, d_missing_indices);
+      cache->Put(stream, n_keys, d_keys, d_values, d_n_missing, d_missing_keys, d_evicted_values);
+      CHECK_JUST(stream->Sync());
+      if (b >= n_warmup_batches) {
+        elapsed_ms += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now()
+                                                                - start)
+                          .count();
+      }
+    }
+    CacheStats stats{};
+    cache->GetStats(stream, &stats);
+    std::cout << "policy " << policy_and_name.second << " hit_ratio " << stats.HitRatio()
+              << " evictions " << stats.num_evictions << " rejected_admissions "
+              << stats.num_rejected_admissions << " time_ms " << elapsed_ms << std::endl;
+  }
+  OF_CUDA_CHECK(cudaFree(d_keys));
+  OF_CUDA_CHECK(cudaFree(d_missing_keys));
+  OF_CUDA_CHECK(cudaFree(d_missing_indices));
+  OF_CUDA_CHECK(cudaFree(d_n_missing));
+  OF_CUDA_CHECK(cudaFree(d_values));
+  OF_CUDA_CHECK(cudaFree(d_evicted_values));
+  device->DestroyStream(stream);
+}
+
 #endif  // WITH_CUDA
 
 }  // namespace
@@ -93,12 +93,15 @@ class CacheKeyValueStoreImpl : public KeyValueStore {
   void Get(ep::Stream* stream, uint32_t num_keys, const void* keys, void* values,
            uint8_t* mask) override;
   void Put(ep::Stream* stream, uint32_t num_keys, const void* keys, const void* values) override;
+  void PutUnmodified(ep::Stream* stream, uint32_t num_keys, const void* keys,
+                     const void* values) override;
   void FusedHalfUpdatePut(ep::Stream* stream, uint32_t n_keys, const void* keys, const void* values,
                           const void* update, const float* lr, float scale) override;
   bool IsFusionSupported() override {
     return cache_->Policy() == CacheOptions::Policy::kFull
            && cache_->ValueType() == DataType::kFloat;
   }
+  void Delete(ep::Stream* stream, uint32_t num_keys, const void* keys) override;
   bool SnapshotExists(const std::string& name) override;
   void LoadSnapshot(const std::string& name) override;
   void SaveSnapshot(const std::string& name) override;
@@ -106,6 +109,8 @@ class CacheKeyValueStoreImpl : public KeyValueStore {
                     const std::function<void(KVIterator* iter)>& Hook) override;
 
  private:
+  void PutToCache(ep::Stream* stream, uint32_t num_keys, const void* keys, const void* values,
+                  bool unmodified);
   void SyncCacheToStore();
 
   std::unique_ptr<KeyValueStore> store_;
@@ -170,17 +175,38 @@ void CacheKeyValueStoreImpl<Key, Elem>::Get(ep::Stream* stream, uint32_t num_key
 template<typename Key, typename Elem>
 void CacheKeyValueStoreImpl<Key, Elem>::Put(ep::Stream* stream, uint32_t num_keys, const void* keys,
                                             const void* values) {
+  PutToCache(stream, num_keys, keys, values, false);
+}
+
+template<typename Key, typename Elem>
+void CacheKeyValueStoreImpl<Key, Elem>::PutUnmodified(ep::Stream* stream, uint32_t num_keys,
+                                                      const void* keys, const void* values) {
+  PutToCache(stream, num_keys, keys, values, true);
+}
+
+// The evicted lines are written to the store. With `unmodified`, keys rejected by the admission
+// policy of the cache are not among them, as the store already holds their values.
+template<typename Key, typename Elem>
+void CacheKeyValueStoreImpl<Key, Elem>::PutToCache(ep::Stream* stream, uint32_t num_keys,
+                                                   const void* keys, const void* values,
+                                                   bool unmodified) {
   std::lock_guard<std::recursive_mutex> lock(mutex_);
   synced_ = false;
   auto cuda_stream = stream->As<ep::CudaStream>();
   if (cache_->Policy() != CacheOptions::Policy::kFull) {
     OF_CUDA_CHECK(cudaMemsetAsync(num_buffer_, 0, sizeof(uint32_t), cuda_stream->cuda_stream()));
   }
-  cache_->Put(stream, num_keys, keys, values, num_buffer_, keys_buffer_, values_buffer_);
+  if (unmodified) {
+    cache_->PutUnmodified(stream, num_keys, keys, values, num_buffer_, keys_buffer_,
+                          values_buffer_);
+  } else {
+    cache_->Put(stream, num_keys, keys, values, num_buffer_, keys_buffer_, values_buffer_);
+  }
   if (cache_->Policy() == CacheOptions::Policy::kFull) { return; }
   OF_CUDA_CHECK(cudaMemcpyAsync(host_num_buffer_, num_buffer_, sizeof(uint32_t), cudaMemcpyDefault,
                                 cuda_stream->cuda_stream()));
   CHECK_JUST(cuda_stream->Sync());
+  if (*host_num_buffer_ == 0) { return; }
   store_->Put(stream, *host_num_buffer_, keys_buffer_, values_buffer_);
 }
 
@@ -202,6 +228,17 @@ void CacheKeyValueStoreImpl<Key, Elem>::FusedHalfUpdatePut(ep::Stream* stream, u
                              keys_buffer_, values_buffer_);
 }
 
+template<typename Key, typename Elem>
+void CacheKeyValueStoreImpl<Key, Elem>::Delete(ep::Stream* stream, uint32_t num_keys,
+                                               const void* keys) {
+  CHECK(cache_->Policy() != CacheOptions::Policy::kFull)
+      << "Deleting keys is not supported with the full cache policy, whose slots are never freed; "
+         "use the lru, lfu or tinylfu cache policy instead";
+  std::lock_guard<std::recursive_mutex> lock(mutex_);
+  cache_->Delete(stream, num_keys, keys);
+  store_->Delete(stream, num_keys, keys);
+}
+
 template<typename Key, typename Elem>
 bool CacheKeyValueStoreImpl<Key, Elem>::SnapshotExists(const std::string& name) {
   return store_->SnapshotExists(name);
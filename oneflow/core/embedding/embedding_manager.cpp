@@ -514,12 +514,29 @@ void EmbeddingManager::CreateKeyValueStore(const KeyValueStoreOptions& key_value
       key_value_store_options.PersistentTablePaths();
   CHECK_EQ(persistent_table_paths.size(), world_size);
   options.table_options.path = persistent_table_paths.at(rank_id);
+  options.table_options.value_paths =
+      key_value_store_options.PersistentTableValuePaths().at(rank_id);
   options.table_options.value_size = line_size * key_value_store_options.ValueTypeSize();
   options.table_options.key_size = key_value_store_options.KeyTypeSize();
   options.table_options.physical_block_size =
       key_value_store_options.PersistentTablePhysicalBlockSize();
   options.table_options.target_chunk_size_mb = 4 * 1024;
   options.table_options.capacity_hint = key_value_store_options.PersistentTableCapacityHint();
+  options.table_options.storage_format = key_value_store_options.PersistentTableStorageFormat();
+  options.table_options.reduced_precision_dim =
+      key_value_store_options.PersistentTableReducedPrecisionDim();
+  if (key_value_store_options.PersistentTableServingMode()) {
+    options.table_options.read_only = true;
+    options.table_options.mmap_values = true;
+    options.table_options.mmap_populate = ParseBooleanFromEnv(
+        "ONEFLOW_ONE_EMBEDDING_PERSISTENT_TABLE_SERVING_MAP_POPULATE", false);
+  }
+  options.table_options.save_sorted_index =
+      key_value_store_options.PersistentTableSaveSortedIndex();
+  options.table_options.expiry_ttl_seconds =
+      key_value_store_options.PersistentTableExpiryTtlSeconds();
+  options.table_options.eviction_min_count =
+      key_value_store_options.PersistentTableEvictionMinCount();
   store = NewPersistentTableKeyValueStore(options);
   const std::vector<CacheOptions>& cache_options = key_value_store_options.GetCachesOptions();
   for (int i = cache_options.size() - 1; i >= 0; --i) {
@@ -514,6 +514,11 @@ class CacheImpl : public Cache {
   void Dump(ep::Stream* stream, uint64_t start_key_index, uint64_t end_key_index,
             uint32_t* n_dumped, void* keys, void* values) override;
 
+  void Delete(ep::Stream* stream, uint32_t n_keys, const void* keys) override {
+    UNIMPLEMENTED() << "Delete is not supported by the full cache, whose slots are never freed; "
+                       "use the lru, lfu or tinylfu cache policy instead";
+  }
+
   void ClearDirtyFlags() override;
 
   void Clear() override;
@@ -42,12 +42,20 @@ class KeyValueStore {
     UNIMPLEMENTED();
   }
   virtual void Put(ep::Stream* stream, uint32_t num_keys, const void* keys, const void* values) = 0;
+  // Put of values that were just read from the store, or initialized for missing keys, so that
+  // stores in front of another one may skip writing them through.
+  virtual void PutUnmodified(ep::Stream* stream, uint32_t num_keys, const void* keys,
+                             const void* values) {
+    Put(stream, num_keys, keys, values);
+  }
   virtual void FusedHalfUpdatePut(ep::Stream* stream, uint32_t n_keys, const void* keys,
                                   const void* values, const void* update, const float* lr,
                                   float scale) {
     UNIMPLEMENTED();
   }
   virtual bool IsFusionSupported() { return false; }
+  // Removes `keys` from the store, absent keys are ignored.
+  virtual void Delete(ep::Stream* stream, uint32_t num_keys, const void* keys) = 0;
   virtual bool SnapshotExists(const std::string& name) = 0;
   virtual void LoadSnapshot(const std::string& name) = 0;
   virtual void LoadSnapshot(const std::string& name,
@@ -18,6 +18,7 @@ limitations under the License.
 #include "nlohmann/json.hpp"
 #include "oneflow/core/job/resource_desc.h"
 #include "oneflow/core/embedding/cache.h"
+#include "oneflow/core/embedding/persistent_table.h"
 
 namespace oneflow {
 namespace embedding {
@@ -34,9 +35,23 @@ void ParseCacheOptions(const nlohmann::json& cache_obj, CacheOptions* cache_opti
     cache_options->policy = CacheOptions::Policy::kLRU;
   } else if (policy == "full") {
     cache_options->policy = CacheOptions::Policy::kFull;
+  } else if (policy == "lfu") {
+    cache_options->policy = CacheOptions::Policy::kLFU;
+  } else if (policy == "tinylfu") {
+    cache_options->policy = CacheOptions::Policy::kTinyLFU;
   } else {
     UNIMPLEMENTED() << "Unsupported cache policy";
   }
+  if (cache_obj.contains("frequency_decay_interval")) {
+    CHECK(cache_obj["frequency_decay_interval"].is_number());
+    const int64_t frequency_decay_interval = cache_obj["frequency_decay_interval"].get<int64_t>();
+    CHECK_GE(frequency_decay_interval, 0);
+    cache_options->frequency_decay_interval = frequency_decay_interval;
+  }
+  if (cache_obj.contains("enable_stats")) {
+    CHECK(cache_obj["enable_stats"].is_boolean());
+    cache_options->enable_stats = cache_obj["enable_stats"].get<bool>();
+  }
   int64_t capacity = 0;
   if (cache_obj.contains("capacity")) {
     CHECK(cache_obj["capacity"].is_number());
@@ -128,14 +143,21 @@ class KeyValueStoreOptions final {
       }
     } else {
       std::string root_path = path.get<std::string>();
-      const std::string& num_rank = std::to_string(parallel_num);
-      const int64_t rank_id_suffix_length = num_rank.size();
       for (int i = 0; i < parallel_num; ++i) {
-        const std::string& rank_id = std::to_string(i);
-        const std::string rank_i_path = root_path + "/"
-                                        + std::string(rank_id_suffix_length - rank_id.size(), '0')
-                                        + rank_id + "-" + num_rank;
-        persistent_table_paths_.push_back(rank_i_path);
+        persistent_table_paths_.push_back(RankPath(root_path, i, parallel_num));
+      }
+    }
+    persistent_table_value_paths_.resize(parallel_num);
+    if (persistent_table.contains("value_paths")) {
+      auto value_paths = persistent_table["value_paths"];
+      CHECK(value_paths.is_array());
+      for (int j = 0; j < value_paths.size(); ++j) {
+        CHECK(value_paths.at(j).is_string());
+        const std::string root_value_path = value_paths.at(j).get<std::string>();
+        for (int i = 0; i < parallel_num; ++i) {
+          persistent_table_value_paths_.at(i).push_back(
+              RankPath(root_value_path, i, parallel_num));
+        }
       }
     }
     CHECK(persistent_table.contains("physical_block_size"));
@@ -147,6 +169,53 @@ class KeyValueStoreOptions final {
     } else {
       persistent_table_capacity_hint_ = 0;
     }
+    persistent_table_storage_format_ = PersistentTableOptions::StorageFormat::kRaw;
+    if (persistent_table.contains("storage_format")) {
+      CHECK(persistent_table["storage_format"].is_string());
+      const std::string storage_format = persistent_table["storage_format"].get<std::string>();
+      if (storage_format == "fp16") {
+        persistent_table_storage_format_ = PersistentTableOptions::StorageFormat::kFloat16;
+      } else if (storage_format == "bf16") {
+        persistent_table_storage_format_ = PersistentTableOptions::StorageFormat::kBFloat16;
+      } else if (storage_format == "int8") {
+        persistent_table_storage_format_ = PersistentTableOptions::StorageFormat::kInt8;
+      } else if (storage_format != "fp32") {
+        UNIMPLEMENTED() << "Unsupported persistent table storage_format";
+      }
+    }
+    if (persistent_table.contains("reduced_precision_dim")) {
+      CHECK(persistent_table["reduced_precision_dim"].is_number());
+      persistent_table_reduced_precision_dim_ =
+          persistent_table["reduced_precision_dim"].get<int64_t>();
+      CHECK_GE(persistent_table_reduced_precision_dim_, 0);
+      CHECK_LE(persistent_table_reduced_precision_dim_, line_size_);
+    } else {
+      persistent_table_reduced_precision_dim_ = 0;
+    }
+    persistent_table_serving_mode_ = false;
+    if (persistent_table.contains("serving_mode")) {
+      CHECK(persistent_table["serving_mode"].is_boolean());
+      persistent_table_serving_mode_ = persistent_table["serving_mode"].get<bool>();
+    }
+    persistent_table_save_sorted_index_ = false;
+    if (persistent_table.contains("save_sorted_index")) {
+      CHECK(persistent_table["save_sorted_index"].is_boolean());
+      persistent_table_save_sorted_index_ = persistent_table["save_sorted_index"].get<bool>();
+    }
+    if (persistent_table.contains("expiry_ttl_seconds")) {
+      CHECK(persistent_table["expiry_ttl_seconds"].is_number());
+      persistent_table_expiry_ttl_seconds_ = persistent_table["expiry_ttl_seconds"].get<int64_t>();
+      CHECK_GE(persistent_table_expiry_ttl_seconds_, 0);
+    } else {
+      persistent_table_expiry_ttl_seconds_ = 0;
+    }
+    if (persistent_table.contains("eviction_min_count")) {
+      CHECK(persistent_table["eviction_min_count"].is_number());
+      persistent_table_eviction_min_count_ = persistent_table["eviction_min_count"].get<int64_t>();
+      CHECK_GE(persistent_table_eviction_min_count_, 0);
+    } else {
+      persistent_table_eviction_min_count_ = 0;
+    }
   }
   ~KeyValueStoreOptions() = default;
   int64_t KeyTypeSize() const { return key_type_size_; }
@@ -156,8 +225,21 @@ class KeyValueStoreOptions final {
   int64_t LineSize() const { return line_size_; }
   const std::vector<CacheOptions>& GetCachesOptions() const { return cache_options_; }
   const std::vector<std::string>& PersistentTablePaths() const { return persistent_table_paths_; }
+  const std::vector<std::vector<std::string>>& PersistentTableValuePaths() const {
+    return persistent_table_value_paths_;
+  }
   int64_t PersistentTablePhysicalBlockSize() const { return persistent_table_physical_block_size_; }
   int64_t PersistentTableCapacityHint() const { return persistent_table_capacity_hint_; }
+  PersistentTableOptions::StorageFormat PersistentTableStorageFormat() const {
+    return persistent_table_storage_format_;
+  }
+  int64_t PersistentTableReducedPrecisionDim() const {
+    return persistent_table_reduced_precision_dim_;
+  }
+  bool PersistentTableServingMode() const { return persistent_table_serving_mode_; }
+  bool PersistentTableSaveSortedIndex() const { return persistent_table_save_sorted_index_; }
+  int64_t PersistentTableExpiryTtlSeconds() const { return persistent_table_expiry_ttl_seconds_; }
+  int64_t PersistentTableEvictionMinCount() const { return persistent_table_eviction_min_count_; }
   bool IsFullCache() const {
     if (cache_options_.size() > 0 && cache_options_.at(0).policy == CacheOptions::Policy::kFull) {
       return true;
@@ -166,14 +248,28 @@ class KeyValueStoreOptions final {
   }
 
  private:
+  static std::string RankPath(const std::string& root_path, int64_t rank_id, int64_t parallel_num) {
+    const std::string& num_rank = std::to_string(parallel_num);
+    const std::string& rank_id_str = std::to_string(rank_id);
+    return root_path + "/" + std::string(num_rank.size() - rank_id_str.size(), '0') + rank_id_str
+           + "-" + num_rank;
+  }
+
   int64_t key_type_size_;
   int64_t value_type_size_;
   DataType value_type_;
   std::string name_;
   int64_t line_size_;
   std::vector<std::string> persistent_table_paths_;
+  std::vector<std::vector<std::string>> persistent_table_value_paths_;
   int64_t persistent_table_physical_block_size_;
   int64_t persistent_table_capacity_hint_;
+  PersistentTableOptions::StorageFormat persistent_table_storage_format_;
+  int64_t persistent_table_reduced_precision_dim_;
+  bool persistent_table_serving_mode_;
+  bool persistent_table_save_sorted_index_;
+  int64_t persistent_table_expiry_ttl_seconds_;
+  int64_t persistent_table_eviction_min_count_;
   std::vector<CacheOptions> cache_options_;
 };
 
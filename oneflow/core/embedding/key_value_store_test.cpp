@@ -21,6 +21,12 @@ limitations under the License.
 #include <gtest/gtest.h>
 #include "oneflow/core/ep/include/device_manager_registry.h"
 #include "oneflow/core/embedding/posix_file.h"
+#include <dirent.h>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <memory>
 
 namespace oneflow {
 
@@ -39,6 +45,18 @@ std::string CreateTempDirectory() {
   return std::string(path);
 }
 
+// The number of value files written into the value path of a table
+size_t CountValueFiles(const std::string& value_path) {
+  DIR* dir = opendir(PosixFile::JoinPath(value_path, "values").c_str());
+  PCHECK(dir != nullptr);
+  size_t count = 0;
+  while (struct dirent* entry = readdir(dir)) {
+    if (std::strncmp(entry->d_name, "value-", 6) == 0) { count += 1; }
+  }
+  closedir(dir);
+  return count;
+}
+
 bool HasCudaDevice() {
   int device_count = 0;
   if (cudaGetDeviceCount(&device_count) != cudaSuccess) { return false; }
@@ -171,6 +189,171 @@ void TestKeyValueStore(KeyValueStore* store, size_t num_embeddings, size_t test_
   device->DestroyStream(stream);
 }
 
+// Puts rows of distinct values into a table stored in `storage_format`, reopens it and checks
+// the meta files and that the values round trip within the error bound of the format. Only the
+// leading `reduced_precision_dim` columns are converted, the others must come back unchanged.
+void TestReducedPrecisionStorage(PersistentTableOptions::StorageFormat storage_format) {
+  Singleton<ep::DeviceManagerRegistry>::New();
+  const uint32_t value_length = 128;
+  const uint32_t reduced_precision_dim = value_length / 2;
+  const size_t num_embeddings = 1024;
+  const size_t batch_size = 128;
+  PersistentTableKeyValueStoreOptions options{};
+  std::string path = CreateTempDirectory();
+  options.table_options.path = path;
+  options.table_options.value_size = value_length * sizeof(float);
+  options.table_options.key_size = GetSizeOfDataType(DataType::kUInt64);
+  options.table_options.physical_block_size = 512;
+  options.table_options.storage_format = storage_format;
+  options.table_options.reduced_precision_dim = reduced_precision_dim;
+
+  auto device = Singleton<ep::DeviceManagerRegistry>::Get()->GetDevice(DeviceType::kCUDA, 0);
+  ep::Stream* stream = device->CreateStream();
+  uint64_t* keys = nullptr;
+  float* values = nullptr;
+  uint32_t* n_missing = nullptr;
+  uint32_t* missing_indices = nullptr;
+  OF_CUDA_CHECK(cudaMallocManaged(&keys, num_embeddings * sizeof(uint64_t)));
+  OF_CUDA_CHECK(cudaMallocManaged(&values, num_embeddings * value_length * sizeof(float)));
+  OF_CUDA_CHECK(cudaMallocManaged(&n_missing, sizeof(uint32_t)));
+  OF_CUDA_CHECK(cudaMallocManaged(&missing_indices, batch_size * sizeof(uint32_t)));
+  auto ExpectedValue = [](uint64_t key, size_t j) {
+    const float sign = (j % 3 == 0) ? -1.0F : 1.0F;
+    return sign * (static_cast<float>(key % 97) + 0.37F * static_cast<float>(j + 1)) / 7.0F;
+  };
+  for (size_t i = 0; i < num_embeddings; ++i) {
+    keys[i] = i + 1;
+    for (size_t j = 0; j < value_length; ++j) {
+      values[i * value_length + j] = ExpectedValue(keys[i], j);
+    }
+  }
+
+  std::unique_ptr<KeyValueStore> store = NewPersistentTableKeyValueStore(options);
+  store->ReserveQueryLength(batch_size);
+  for (size_t offset = 0; offset < num_embeddings; offset += batch_size) {
+    store->Put(stream, batch_size, keys + offset, values + offset * value_length);
+  }
+  CHECK_JUST(stream->Sync());
+  store->SaveSnapshot("final");
+  store.reset();
+
+  auto ReadMetaValue = [&](const std::string& name) {
+    const std::string pathname = PosixFile::JoinPath(path, name);
+    CHECK(PosixFile::FileExists(pathname)) << pathname;
+    std::ifstream ifs(pathname);
+    int64_t value = -1;
+    ifs >> value;
+    return value;
+  };
+  ASSERT_EQ(ReadMetaValue("STORAGE_FORMAT"), static_cast<int64_t>(storage_format));
+  ASSERT_EQ(ReadMetaValue("REDUCED_PRECISION_DIM"), static_cast<int64_t>(reduced_precision_dim));
+
+  store = NewPersistentTableKeyValueStore(options);
+  store->ReserveQueryLength(batch_size);
+  store->LoadSnapshot("final");
+  std::memset(values, 0, num_embeddings * value_length * sizeof(float));
+  for (size_t offset = 0; offset < num_embeddings; offset += batch_size) {
+    store->Get(stream, batch_size, keys + offset, values + offset * value_length, n_missing,
+               missing_indices);
+    CHECK_JUST(stream->Sync());
+    ASSERT_EQ(*n_missing, 0);
+  }
+  for (size_t i = 0; i < num_embeddings; ++i) {
+    float row_max_abs = 0;
+    for (size_t j = 0; j < reduced_precision_dim; ++j) {
+      row_max_abs = std::max(row_max_abs, std::abs(ExpectedValue(keys[i], j)));
+    }
+    for (size_t j = 0; j < value_length; ++j) {
+      const float expected = ExpectedValue(keys[i], j);
+      const float value = values[i * value_length + j];
+      if (j >= reduced_precision_dim) {
+        ASSERT_EQ(value, expected) << "key " << keys[i] << " column " << j;
+        continue;
+      }
+      float tolerance = 0;
+      if (storage_format == PersistentTableOptions::StorageFormat::kFloat16) {
+        tolerance = std::abs(expected) / 1024;
+      } else if (storage_format == PersistentTableOptions::StorageFormat::kBFloat16) {
+        tolerance = std::abs(expected) / 128;
+      } else {
+        // half of the quantization step of the row
+        tolerance = row_max_abs / 127 / 2 * 1.001F;
+      }
+      ASSERT_LE(std::abs(value - expected), tolerance) << "key " << keys[i] << " column " << j;
+    }
+  }
+  store.reset();
+
+  OF_CUDA_CHECK(cudaFree(keys));
+  OF_CUDA_CHECK(cudaFree(values));
+  OF_CUDA_CHECK(cudaFree(n_missing));
+  OF_CUDA_CHECK(cudaFree(missing_indices));
+  device->DestroyStream(stream);
+  PosixFile::RecursiveDelete(path);
+  Singleton<ep::DeviceManagerRegistry>::Delete();
+}
+
+// Puts `num_embeddings` keys, deletes the first `num_deleted` ones, optionally calls `Expire` to
+// move the store clock past the TTL, and checks the expected keys are missing before and after a
+// snapshot round trip.
+void TestKeyValueStoreDelete(KeyValueStore* store, size_t num_embeddings, size_t num_deleted,
+                             size_t embedding_vec_size,
+                             const std::function<void()>& Expire = nullptr) {
+  auto device = Singleton<ep::DeviceManagerRegistry>::Get()->GetDevice(DeviceType::kCUDA, 0);
+  ep::Stream* stream = device->CreateStream();
+  const size_t batch_size = 128;
+  uint64_t* keys = nullptr;
+  uint64_t* keys_host = nullptr;
+  float* values = nullptr;
+  uint32_t* n_missing = nullptr;
+  uint32_t* host_n_missing = nullptr;
+  uint32_t* missing_indices = nullptr;
+  OF_CUDA_CHECK(cudaMalloc(&keys, num_embeddings * sizeof(uint64_t)));
+  OF_CUDA_CHECK(cudaMallocHost(&keys_host, num_embeddings * sizeof(uint64_t)));
+  OF_CUDA_CHECK(cudaMalloc(&values, num_embeddings * embedding_vec_size * sizeof(float)));
+  OF_CUDA_CHECK(cudaMalloc(&n_missing, sizeof(uint32_t)));
+  OF_CUDA_CHECK(cudaMallocHost(&host_n_missing, sizeof(uint32_t)));
+  OF_CUDA_CHECK(cudaMalloc(&missing_indices, batch_size * sizeof(uint32_t)));
+  for (size_t i = 0; i < num_embeddings; ++i) { keys_host[i] = i + 1; }
+  OF_CUDA_CHECK(cudaMemcpy(keys, keys_host, num_embeddings * sizeof(uint64_t), cudaMemcpyDefault));
+  OF_CUDA_CHECK(cudaMemset(values, 0, num_embeddings * embedding_vec_size * sizeof(float)));
+  for (size_t offset = 0; offset < num_embeddings; offset += batch_size) {
+    const size_t num_keys = std::min(batch_size, num_embeddings - offset);
+    store->Put(stream, num_keys, keys + offset, values + offset * embedding_vec_size);
+  }
+  for (size_t offset = 0; offset < num_deleted; offset += batch_size) {
+    store->Delete(stream, std::min(batch_size, num_deleted - offset), keys + offset);
+  }
+  CHECK_JUST(stream->Sync());
+  auto CountMissing = [&]() {
+    size_t total_missing = 0;
+    for (size_t offset = 0; offset < num_embeddings; offset += batch_size) {
+      const size_t num_keys = std::min(batch_size, num_embeddings - offset);
+      store->Get(stream, num_keys, keys + offset, values + offset * embedding_vec_size, n_missing,
+                 missing_indices);
+      OF_CUDA_CHECK(cudaMemcpyAsync(host_n_missing, n_missing, sizeof(uint32_t), cudaMemcpyDefault,
+                                    stream->As<ep::CudaStream>()->cuda_stream()));
+      CHECK_JUST(stream->Sync());
+      total_missing += *host_n_missing;
+    }
+    return total_missing;
+  };
+  ASSERT_EQ(CountMissing(), num_deleted);
+  if (Expire) { Expire(); }
+  const size_t expected_missing = Expire ? num_embeddings : num_deleted;
+  store->SaveSnapshot("deleted");
+  ASSERT_EQ(CountMissing(), expected_missing);
+  store->LoadSnapshot("deleted");
+  ASSERT_EQ(CountMissing(), expected_missing);
+  OF_CUDA_CHECK(cudaFree(keys));
+  OF_CUDA_CHECK(cudaFreeHost(keys_host));
+  OF_CUDA_CHECK(cudaFree(values));
+  OF_CUDA_CHECK(cudaFree(n_missing));
+  OF_CUDA_CHECK(cudaFreeHost(host_n_missing));
+  OF_CUDA_CHECK(cudaFree(missing_indices));
+  device->DestroyStream(stream);
+}
+
 TEST(PersistentTableKeyValueStore, PersistentTableKeyValueStore) {
   if (!HasCudaDevice()) { return; }
   Singleton<ep::DeviceManagerRegistry>::New();
@@ -191,6 +374,174 @@ TEST(PersistentTableKeyValueStore, PersistentTableKeyValueStore) {
   Singleton<ep::DeviceManagerRegistry>::Delete();
 }
 
+TEST(PersistentTableKeyValueStore, Float16Storage) {
+  if (!HasCudaDevice()) { return; }
+  Singleton<ep::DeviceManagerRegistry>::New();
+  PersistentTableKeyValueStoreOptions options{};
+  uint32_t value_length = 128;
+
+  std::string path = CreateTempDirectory();
+  options.table_options.path = path;
+  options.table_options.value_size = value_length * sizeof(float);
+  options.table_options.key_size = GetSizeOfDataType(DataType::kUInt64);
+  options.table_options.physical_block_size = 512;
+  options.table_options.storage_format = PersistentTableOptions::StorageFormat::kFloat16;
+  options.table_options.reduced_precision_dim = value_length / 2;
+
+  std::unique_ptr<KeyValueStore> store = NewPersistentTableKeyValueStore(options);
+  store->ReserveQueryLength(128);
+  // keys up to 1024 are exactly representable in float16
+  TestKeyValueStore(store.get(), 1024, 1024, value_length);
+  store.reset();
+  PosixFile::RecursiveDelete(path);
+  Singleton<ep::DeviceManagerRegistry>::Delete();
+}
+
+TEST(PersistentTableKeyValueStore, Float16StorageReopen) {
+  if (!HasCudaDevice()) { return; }
+  TestReducedPrecisionStorage(PersistentTableOptions::StorageFormat::kFloat16);
+}
+
+TEST(PersistentTableKeyValueStore, BFloat16Storage) {
+  if (!HasCudaDevice()) { return; }
+  TestReducedPrecisionStorage(PersistentTableOptions::StorageFormat::kBFloat16);
+}
+
+TEST(PersistentTableKeyValueStore, Int8Storage) {
+  if (!HasCudaDevice()) { return; }
+  TestReducedPrecisionStorage(PersistentTableOptions::StorageFormat::kInt8);
+}
+
+TEST(PersistentTableKeyValueStore, ServingMode) {
+  if (!HasCudaDevice()) { return; }
+  Singleton<ep::DeviceManagerRegistry>::New();
+  PersistentTableKeyValueStoreOptions options{};
+  uint32_t value_length = 128;
+  const size_t num_embeddings = 1024;
+  const size_t batch_size = 128;
+
+  std::string path = CreateTempDirectory();
+  options.table_options.path = path;
+  options.table_options.value_size = value_length * sizeof(float);
+  options.table_options.key_size = GetSizeOfDataType(DataType::kUInt64);
+  options.table_options.physical_block_size = 512;
+  options.table_options.save_sorted_index = true;
+
+  std::unique_ptr<KeyValueStore> store = NewPersistentTableKeyValueStore(options);
+  store->ReserveQueryLength(batch_size);
+  TestKeyValueStore(store.get(), num_embeddings, num_embeddings, value_length);
+  store.reset();
+
+  options.table_options.read_only = true;
+  options.table_options.mmap_values = true;
+  options.table_options.save_sorted_index = false;
+  for (const bool populate : {false, true}) {
+    options.table_options.mmap_populate = populate;
+    std::unique_ptr<KeyValueStore> serving_store = NewPersistentTableKeyValueStore(options);
+    serving_store->ReserveQueryLength(batch_size);
+    serving_store->LoadSnapshot("final");
+    auto device = Singleton<ep::DeviceManagerRegistry>::Get()->GetDevice(DeviceType::kCUDA, 0);
+    ep::Stream* stream = device->CreateStream();
+    uint64_t* keys = nullptr;
+    float* values = nullptr;
+    uint32_t* n_missing = nullptr;
+    uint32_t* missing_indices = nullptr;
+    OF_CUDA_CHECK(cudaMallocManaged(&keys, batch_size * sizeof(uint64_t)));
+    OF_CUDA_CHECK(cudaMallocManaged(&values, batch_size * value_length * sizeof(float)));
+    OF_CUDA_CHECK(cudaMallocManaged(&n_missing, sizeof(uint32_t)));
+    OF_CUDA_CHECK(cudaMallocManaged(&missing_indices, batch_size * sizeof(uint32_t)));
+    // the last batch asks for keys which were never put
+    for (size_t offset = 0; offset <= num_embeddings; offset += batch_size) {
+      for (size_t i = 0; i < batch_size; ++i) { keys[i] = offset + i + 1; }
+      serving_store->Get(stream, batch_size, keys, values, n_missing, missing_indices);
+      CHECK_JUST(stream->Sync());
+      const size_t num_present = std::min(batch_size, num_embeddings - offset);
+      ASSERT_EQ(*n_missing, batch_size - num_present);
+      for (size_t i = 0; i < num_present; ++i) {
+        for (size_t j = 0; j < value_length; ++j) {
+          ASSERT_EQ(values[i * value_length + j], keys[i]);
+        }
+      }
+    }
+    OF_CUDA_CHECK(cudaFree(keys));
+    OF_CUDA_CHECK(cudaFree(values));
+    OF_CUDA_CHECK(cudaFree(n_missing));
+    OF_CUDA_CHECK(cudaFree(missing_indices));
+    device->DestroyStream(stream);
+  }
+  PosixFile::RecursiveDelete(path);
+  Singleton<ep::DeviceManagerRegistry>::Delete();
+}
+
+TEST(PersistentTableKeyValueStore, StripedValuePaths) {
+  if (!HasCudaDevice()) { return; }
+  Singleton<ep::DeviceManagerRegistry>::New();
+  PersistentTableKeyValueStoreOptions options{};
+  uint32_t value_length = 128;
+
+  std::string path = CreateTempDirectory();
+  std::vector<std::string> value_paths{CreateTempDirectory(), CreateTempDirectory()};
+  options.table_options.path = path;
+  options.table_options.value_paths = value_paths;
+  options.table_options.value_size = value_length * sizeof(float);
+  options.table_options.key_size = GetSizeOfDataType(DataType::kUInt64);
+  options.table_options.physical_block_size = 512;
+  // 1MB chunks, so that the 2MB of values span chunks in both value paths
+  options.table_options.target_chunk_size_mb = 1;
+
+  std::unique_ptr<KeyValueStore> store = NewPersistentTableKeyValueStore(options);
+  store->ReserveQueryLength(128);
+  TestKeyValueStore(store.get(), 4096, 4096, value_length);
+  store.reset();
+  for (const auto& value_path : value_paths) { EXPECT_GT(CountValueFiles(value_path), 0); }
+  PosixFile::RecursiveDelete(path);
+  for (const auto& value_path : value_paths) { PosixFile::RecursiveDelete(value_path); }
+  Singleton<ep::DeviceManagerRegistry>::Delete();
+}
+
+TEST(PersistentTableKeyValueStore, Delete) {
+  if (!HasCudaDevice()) { return; }
+  Singleton<ep::DeviceManagerRegistry>::New();
+  PersistentTableKeyValueStoreOptions options{};
+  uint32_t value_length = 128;
+
+  std::string path = CreateTempDirectory();
+  options.table_options.path = path;
+  options.table_options.value_size = value_length * sizeof(float);
+  options.table_options.key_size = GetSizeOfDataType(DataType::kUInt64);
+  options.table_options.physical_block_size = 512;
+
+  std::unique_ptr<KeyValueStore> store = NewPersistentTableKeyValueStore(options);
+  store->ReserveQueryLength(128);
+  TestKeyValueStoreDelete(store.get(), 1024, 384, value_length);
+  store.reset();
+  PosixFile::RecursiveDelete(path);
+  Singleton<ep::DeviceManagerRegistry>::Delete();
+}
+
+TEST(PersistentTableKeyValueStore, ExpiryTtl) {
+  if (!HasCudaDevice()) { return; }
+  Singleton<ep::DeviceManagerRegistry>::New();
+  PersistentTableKeyValueStoreOptions options{};
+  uint32_t value_length = 128;
+
+  std::string path = CreateTempDirectory();
+  options.table_options.path = path;
+  options.table_options.value_size = value_length * sizeof(float);
+  options.table_options.key_size = GetSizeOfDataType(DataType::kUInt64);
+  options.table_options.physical_block_size = 512;
+  options.table_options.expiry_ttl_seconds = 1;
+  auto now = std::make_shared<uint32_t>(1000);
+  options.table_options.clock = [now]() { return *now; };
+
+  std::unique_ptr<KeyValueStore> store = NewPersistentTableKeyValueStore(options);
+  store->ReserveQueryLength(128);
+  TestKeyValueStoreDelete(store.get(), 1024, 384, value_length, [now]() { *now += 3; });
+  store.reset();
+  PosixFile::RecursiveDelete(path);
+  Singleton<ep::DeviceManagerRegistry>::Delete();
+}
+
 TEST(CachedKeyValueStore, LRU) {
   if (!HasCudaDevice()) { return; }
   Singleton<ep::DeviceManagerRegistry>::New();
@@ -218,6 +569,34 @@ TEST(CachedKeyValueStore, LRU) {
   Singleton<ep::DeviceManagerRegistry>::Delete();
 }
 
+TEST(CachedKeyValueStore, LRUDelete) {
+  if (!HasCudaDevice()) { return; }
+  Singleton<ep::DeviceManagerRegistry>::New();
+  PersistentTableKeyValueStoreOptions store_options{};
+  std::string path = CreateTempDirectory();
+  store_options.table_options.path = path;
+  uint32_t value_length = 128;
+  store_options.table_options.value_size = value_length * sizeof(float);
+  store_options.table_options.key_size = GetSizeOfDataType(DataType::kUInt64);
+  store_options.table_options.physical_block_size = 512;
+  std::unique_ptr<KeyValueStore> store = NewPersistentTableKeyValueStore(store_options);
+  CacheOptions cache_options{};
+  cache_options.policy = CacheOptions::Policy::kLRU;
+  cache_options.value_memory_kind = CacheOptions::MemoryKind::kDevice;
+  cache_options.value_size = 512;
+  cache_options.capacity = 512;
+  cache_options.key_size = 8;
+  std::unique_ptr<Cache> cache = NewCache(cache_options);
+  std::unique_ptr<KeyValueStore> cached_store =
+      NewCachedKeyValueStore(std::move(store), std::move(cache));
+  cached_store->ReserveQueryLength(128);
+  // half of the keys live in the cache and half in the store
+  TestKeyValueStoreDelete(cached_store.get(), 1024, 640, value_length);
+  cached_store.reset();
+  PosixFile::RecursiveDelete(path);
+  Singleton<ep::DeviceManagerRegistry>::Delete();
+}
+
 TEST(CachedKeyValueStore, Full) {
   if (!HasCudaDevice()) { return; }
   Singleton<ep::DeviceManagerRegistry>::New();
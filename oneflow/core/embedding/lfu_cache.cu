@@ -0,0 +1,761 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+// Set associative layout and warp cooperative kernels follow lru_cache.cu, the per line ages are
+// replaced by access frequencies. The admission filter of kTinyLFU follows
+// TinyLFU: A Highly Efficient Cache Admission Policy (https://arxiv.org/abs/1512.00727).
+
+#include "oneflow/core/embedding/lfu_cache.h"
+#include "oneflow/core/embedding/set_associative_cache.cuh"
+#include "oneflow/core/embedding/hash_functions.cuh"
+
+namespace oneflow {
+
+namespace embedding {
+
+namespace {
+
+constexpr uint32_t kMaxFrequency = 0xFFFFFFFFU;
+constexpr int kSketchDepth = 4;
+constexpr int kDoorkeeperNumHashes = 2;
+constexpr uint64_t kMinSketchWidth = 1024;
+constexpr uint64_t kDefaultDecayIntervalFactor = 10;
+
+template<typename Key, typename Elem>
+struct LfuCacheContext {
+  Key* keys;
+  Elem* lines;
+  // 0 marks an empty line.
+  uint32_t* frequencies;
+  void* mutex;
+  // kSketchDepth rows of sketch_width counters, only allocated with admission.
+  uint32_t* sketch;
+  // Bloom filter of sketch_width * 4 bits that absorbs the first access of a key, so that one-off
+  // keys never reach the sketch.
+  uint32_t* doorkeeper;
+  unsigned long long int* stats;
+  uint64_t n_set;
+  uint64_t sketch_width;
+  uint32_t line_size;
+  bool admission;
+  CacheOptions::MemoryKind value_memory_kind;
+};
+
+__device__ void FrequencySketchHashes(uint64_t key, uint32_t* h1, uint32_t* h2) {
+  const uint64_t hash = FrequencySketchHash()(key);
+  *h1 = static_cast<uint32_t>(hash);
+  *h2 = static_cast<uint32_t>(hash >> 32U) | 1U;
+}
+
+template<typename Key, typename Elem>
+__device__ uint64_t DoorkeeperBit(const LfuCacheContext<Key, Elem>& cache_ctx, uint32_t h1,
+                                  uint32_t h2, int i) {
+  return (h1 + static_cast<uint64_t>(kSketchDepth + i) * h2) & (cache_ctx.sketch_width * 4 - 1);
+}
+
+template<typename Key, typename Elem>
+__device__ uint64_t SketchIndex(const LfuCacheContext<Key, Elem>& cache_ctx, uint32_t h1,
+                                uint32_t h2, int row) {
+  return row * cache_ctx.sketch_width
+         + ((h1 + static_cast<uint64_t>(row) * h2) & (cache_ctx.sketch_width - 1));
+}
+
+template<typename Key, typename Elem>
+__device__ void RecordAccess(const LfuCacheContext<Key, Elem>& cache_ctx, Key key) {
+  uint32_t h1 = 0;
+  uint32_t h2 = 0;
+  FrequencySketchHashes(static_cast<uint64_t>(key), &h1, &h2);
+  bool in_doorkeeper = true;
+  for (int i = 0; i < kDoorkeeperNumHashes; ++i) {
+    const uint64_t bit = DoorkeeperBit(cache_ctx, h1, h2, i);
+    const uint32_t mask = 1U << (bit % 32);
+    const uint32_t old = atomicOr(cache_ctx.doorkeeper + bit / 32, mask);
+    if ((old & mask) == 0) { in_doorkeeper = false; }
+  }
+  if (!in_doorkeeper) { return; }
+  for (int row = 0; row < kSketchDepth; ++row) {
+    uint32_t* counter = cache_ctx.sketch + SketchIndex(cache_ctx, h1, h2, row);
+    if (*counter != kMaxFrequency) { atomicAdd(counter, 1U); }
+  }
+}
+
+template<typename Key, typename Elem>
+__device__ uint32_t EstimateFrequency(const LfuCacheContext<Key, Elem>& cache_ctx, Key key) {
+  uint32_t h1 = 0;
+  uint32_t h2 = 0;
+  FrequencySketchHashes(static_cast<uint64_t>(key), &h1, &h2);
+  uint32_t frequency = kMaxFrequency;
+  for (int row = 0; row < kSketchDepth; ++row) {
+    frequency = min(frequency, cache_ctx.sketch[SketchIndex(cache_ctx, h1, h2, row)]);
+  }
+  bool in_doorkeeper = true;
+  for (int i = 0; i < kDoorkeeperNumHashes; ++i) {
+    const uint64_t bit = DoorkeeperBit(cache_ctx, h1, h2, i);
+    if ((cache_ctx.doorkeeper[bit / 32] & (1U << (bit % 32))) == 0) { in_doorkeeper = false; }
+  }
+  if (in_doorkeeper && frequency != kMaxFrequency) { frequency += 1; }
+  return frequency;
+}
+
+template<typename Key, typename Elem>
+size_t GetSketchSize(const LfuCacheContext<Key, Elem>& ctx) {
+  return kSketchDepth * ctx.sketch_width * sizeof(uint32_t);
+}
+
+template<typename Key, typename Elem>
+size_t GetDoorkeeperSize(const LfuCacheContext<Key, Elem>& ctx) {
+  return ctx.sketch_width * 4 / 8;
+}
+
+template<typename Key, typename Elem>
+void ClearLfuCacheContext(LfuCacheContext<Key, Elem>* ctx) {
+  OF_CUDA_CHECK(cudaMemset(ctx->keys, 0, ctx->n_set * kWarpSize * sizeof(Key)));
+  OF_CUDA_CHECK(cudaMemset(ctx->frequencies, 0, ctx->n_set * kWarpSize * sizeof(uint32_t)));
+  if (ctx->admission) {
+    OF_CUDA_CHECK(cudaMemset(ctx->sketch, 0, GetSketchSize(*ctx)));
+    OF_CUDA_CHECK(cudaMemset(ctx->doorkeeper, 0, GetDoorkeeperSize(*ctx)));
+  }
+  InitCacheSetMutex<<<(ctx->n_set - 1 + 256) / 256, 256>>>(ctx->n_set, ctx->mutex);
+}
+
+uint64_t RoundUpToPowerOfTwo(uint64_t n) {
+  uint64_t power = 1;
+  while (power < n) { power <<= 1U; }
+  return power;
+}
+
+template<typename Key, typename Elem>
+void InitLfuCacheContext(const CacheOptions& options, LfuCacheContext<Key, Elem>* ctx) {
+  const size_t keys_size_per_set = kWarpSize * sizeof(Key);
+  const uint32_t line_size = options.value_size / sizeof(Elem);
+  const size_t lines_size_per_set = kWarpSize * line_size * sizeof(Elem);
+  const size_t frequencies_size_per_set = kWarpSize * sizeof(uint32_t);
+  int device = 0;
+  OF_CUDA_CHECK(cudaGetDevice(&device));
+  const size_t mutex_size_per_set = GetWarpMutexSize(device);
+  const size_t n_set = (options.capacity - 1 + kWarpSize) / kWarpSize;
+  CHECK_GT(n_set, 0);
+  ctx->n_set = n_set;
+  ctx->line_size = line_size;
+  const size_t keys_size = n_set * keys_size_per_set;
+  OF_CUDA_CHECK(cudaMalloc(&(ctx->keys), keys_size));
+  const size_t lines_size = n_set * lines_size_per_set;
+  if (options.value_memory_kind == CacheOptions::MemoryKind::kDevice) {
+    OF_CUDA_CHECK(cudaMalloc(&(ctx->lines), lines_size));
+  } else if (options.value_memory_kind == CacheOptions::MemoryKind::kHost) {
+    if (ParseBooleanFromEnv("ONEFLOW_ONE_EMBEDDING_DISABLE_NUMA_AWARE_ALLOCATION", false)) {
+      OF_CUDA_CHECK(cudaMallocHost(&(ctx->lines), lines_size));
+    } else {
+      OF_CUDA_CHECK(
+          NumaAwareCudaMallocHost(device, reinterpret_cast<void**>(&ctx->lines), lines_size));
+    }
+  } else {
+    UNIMPLEMENTED();
+  }
+  ctx->value_memory_kind = options.value_memory_kind;
+  const size_t frequencies_size = n_set * frequencies_size_per_set;
+  OF_CUDA_CHECK(cudaMalloc(&(ctx->frequencies), frequencies_size));
+  const size_t mutex_size = n_set * mutex_size_per_set;
+  OF_CUDA_CHECK(cudaMalloc(&(ctx->mutex), mutex_size));
+  ctx->admission = (options.policy == CacheOptions::Policy::kTinyLFU);
+  ctx->sketch_width = std::max(RoundUpToPowerOfTwo(n_set * kWarpSize), kMinSketchWidth);
+  if (ctx->admission) {
+    OF_CUDA_CHECK(cudaMalloc(&(ctx->sketch), GetSketchSize(*ctx)));
+    OF_CUDA_CHECK(cudaMalloc(&(ctx->doorkeeper), GetDoorkeeperSize(*ctx)));
+  } else {
+    ctx->sketch = nullptr;
+    ctx->doorkeeper = nullptr;
+  }
+  ctx->stats = NewCacheStats(options);
+
+  ClearLfuCacheContext(ctx);
+}
+
+template<typename Key, typename Elem>
+void DestroyLfuCacheContext(LfuCacheContext<Key, Elem>* ctx) {
+  OF_CUDA_CHECK(cudaFree(ctx->keys));
+  if (ctx->value_memory_kind == CacheOptions::MemoryKind::kDevice) {
+    OF_CUDA_CHECK(cudaFree(ctx->lines));
+  } else if (ctx->value_memory_kind == CacheOptions::MemoryKind::kHost) {
+    OF_CUDA_CHECK(cudaFreeHost(ctx->lines));
+  } else {
+    UNIMPLEMENTED();
+  }
+  OF_CUDA_CHECK(cudaFree(ctx->frequencies));
+  OF_CUDA_CHECK(cudaFree(ctx->mutex));
+  if (ctx->admission) {
+    OF_CUDA_CHECK(cudaFree(ctx->sketch));
+    OF_CUDA_CHECK(cudaFree(ctx->doorkeeper));
+  }
+  DestroyCacheStats(ctx->stats);
+}
+
+template<typename Key, typename Elem>
+struct SetContext : public SetContextBase<Key, Elem> {
+  using SetContextBase<Key, Elem>::keys;
+
+  __device__ SetContext(const LfuCacheContext<Key, Elem>& ctx, uint32_t set_id)
+      : SetContextBase<Key, Elem>(ctx, set_id), frequencies(ctx.frequencies + set_id * kWarpSize) {}
+
+  __device__ int Lookup(const ThreadContext& thread_ctx, Key key) {
+    const Key lane_key = keys[thread_ctx.lane_id];
+    const uint32_t lane_frequency = frequencies[thread_ctx.lane_id];
+    const bool lane_hit = (lane_key == key && lane_frequency != 0);
+    const unsigned hit_mask = __ballot_sync(kFullMask, lane_hit);
+    if (hit_mask != 0) {
+      return __ffs(static_cast<int>(hit_mask)) - 1;
+    } else {
+      return -1;
+    }
+  }
+
+  // Bumps the frequency of a hit line or fills an empty line with `frequency`, returns -1 if the
+  // key is missing and the set is full.
+  __device__ int InsertWithoutEvicting(const LfuCacheContext<Key, Elem>& cache_ctx,
+                                       const ThreadContext& thread_ctx, Key key,
+                                       uint32_t frequency) {
+    int insert_way = -1;
+    const Key lane_key = keys[thread_ctx.lane_id];
+    const uint32_t lane_frequency = frequencies[thread_ctx.lane_id];
+    const unsigned hit_mask = __ballot_sync(kFullMask, lane_key == key && lane_frequency != 0);
+    if (hit_mask != 0) {
+      insert_way = __ffs(static_cast<int>(hit_mask)) - 1;
+      if (thread_ctx.lane_id == insert_way && lane_frequency != kMaxFrequency) {
+        frequencies[insert_way] = lane_frequency + 1;
+      }
+    } else {
+      const unsigned valid_mask = __ballot_sync(kFullMask, lane_frequency != 0);
+      if (valid_mask != kFullMask) {
+        insert_way = __ffs(static_cast<int>(~valid_mask)) - 1;
+        if (thread_ctx.lane_id == insert_way) {
+          keys[insert_way] = key;
+          frequencies[insert_way] = frequency;
+        }
+      }
+    }
+    __syncwarp();
+    return insert_way;
+  }
+
+  // Returns the least frequently used way of a full set, ties go to the lowest way.
+  __device__ int FindVictim(const ThreadContext& thread_ctx, Key* victim_key) {
+    const Key lane_key = keys[thread_ctx.lane_id];
+    const uint32_t lane_frequency = frequencies[thread_ctx.lane_id];
+    uint32_t min_frequency = lane_frequency;
+    for (int offset = kWarpSize / 2; offset > 0; offset /= 2) {
+      min_frequency = min(min_frequency, __shfl_xor_sync(kFullMask, min_frequency, offset));
+    }
+    const int victim_way =
+        __ffs(static_cast<int>(__ballot_sync(kFullMask, lane_frequency == min_frequency))) - 1;
+    *victim_key = __shfl_sync(kFullMask, lane_key, victim_way);
+    return victim_way;
+  }
+
+  __device__ void Delete(const ThreadContext& thread_ctx, Key key) {
+    const int way = Lookup(thread_ctx, key);
+    if (thread_ctx.lane_id == way) { frequencies[way] = 0; }
+    __syncwarp();
+  }
+
+  __device__ void Replace(const ThreadContext& thread_ctx, int way, Key key, uint32_t frequency) {
+    if (thread_ctx.lane_id == way) {
+      keys[way] = key;
+      frequencies[way] = frequency;
+    }
+    __syncwarp();
+  }
+
+  uint32_t* frequencies;
+};
+
+template<typename Key, typename Elem, bool test_only>
+__global__ void GetKernel(LfuCacheContext<Key, Elem> cache_ctx, uint32_t num_keys, const Key* keys,
+                          Elem* values, uint32_t* n_missing_keys, Key* missing_keys,
+                          uint32_t* missing_indices) {
+  ThreadContext thread_ctx{};
+  __shared__ Key block_keys[kNumWarpPerBlock][kWarpSize];
+  __shared__ size_t block_set_ids[kNumWarpPerBlock][kWarpSize];
+  for (uint32_t batch_offset = thread_ctx.global_warp_id * kWarpSize; batch_offset < num_keys;
+       batch_offset += thread_ctx.num_warps * kWarpSize) {
+    const uint32_t n_batch_keys = min(kWarpSize, num_keys - batch_offset);
+    if (thread_ctx.lane_id < n_batch_keys) {
+      const Key key = keys[batch_offset + thread_ctx.lane_id];
+      const size_t hash = LfuCacheHash()(key);
+      const uint32_t set_id = hash % cache_ctx.n_set;
+      block_keys[thread_ctx.warp_id_in_block][thread_ctx.lane_id] = key;
+      block_set_ids[thread_ctx.warp_id_in_block][thread_ctx.lane_id] = set_id;
+    }
+    __syncwarp();
+    uint32_t n_warp_missing = 0;
+    Key warp_missing_key = 0;
+    uint32_t warp_missing_index = 0;
+    for (uint32_t i = 0; i < n_batch_keys; ++i) {
+      const uint32_t key_idx = batch_offset + i;
+      const Key key = block_keys[thread_ctx.warp_id_in_block][i];
+      const size_t set_id = block_set_ids[thread_ctx.warp_id_in_block][i];
+      SetContext<Key, Elem> set_ctx(cache_ctx, set_id);
+      const int way = set_ctx.Lookup(thread_ctx, key);
+      if (way < 0) {
+        if (thread_ctx.lane_id == n_warp_missing) {
+          warp_missing_key = key;
+          warp_missing_index = key_idx;
+        }
+        __syncwarp();
+        n_warp_missing += 1;
+      } else if (!test_only) {
+        set_ctx.Read(cache_ctx, thread_ctx, way, values + key_idx * cache_ctx.line_size);
+      }
+    }
+    if (!test_only && cache_ctx.stats != nullptr && thread_ctx.lane_id == 0) {
+      atomicAdd(cache_ctx.stats + kStatQueries, static_cast<unsigned long long int>(n_batch_keys));
+      atomicAdd(cache_ctx.stats + kStatHits,
+                static_cast<unsigned long long int>(n_batch_keys - n_warp_missing));
+    }
+    if (n_warp_missing > 0) {
+      uint32_t base_missing_idx = 0;
+      if (thread_ctx.lane_id == 0) { base_missing_idx = atomicAdd(n_missing_keys, n_warp_missing); }
+      __syncwarp();
+      base_missing_idx = __shfl_sync(kFullMask, base_missing_idx, 0);
+      if (thread_ctx.lane_id < n_warp_missing) {
+        missing_keys[base_missing_idx + thread_ctx.lane_id] = warp_missing_key;
+        missing_indices[base_missing_idx + thread_ctx.lane_id] = warp_missing_index;
+      }
+      __syncwarp();
+    }
+    __syncwarp();
+  }
+}
+
+// Every looked up key is put back after the update, so accesses are counted here rather than in
+// GetKernel, which keeps Get free of writes to the cache metadata.
+template<typename Key, typename Elem>
+__global__ void PutWithoutEvictingKernel(LfuCacheContext<Key, Elem> cache_ctx, uint32_t num_keys,
+                                         const Key* keys, const Elem* values, uint32_t* n_missing,
+                                         Key* missing_keys, uint32_t* missing_indices) {
+  ThreadContext thread_ctx{};
+  __shared__ Key block_keys[kNumWarpPerBlock][kWarpSize];
+  __shared__ size_t block_set_ids[kNumWarpPerBlock][kWarpSize];
+  for (uint32_t batch_offset = thread_ctx.global_warp_id * kWarpSize; batch_offset < num_keys;
+       batch_offset += thread_ctx.num_warps * kWarpSize) {
+    const uint32_t n_batch_keys = min(kWarpSize, num_keys - batch_offset);
+    if (thread_ctx.lane_id < n_batch_keys) {
+      const Key key = keys[batch_offset + thread_ctx.lane_id];
+      const size_t hash = LfuCacheHash()(key);
+      const uint32_t set_id = hash % cache_ctx.n_set;
+      block_keys[thread_ctx.warp_id_in_block][thread_ctx.lane_id] = key;
+      block_set_ids[thread_ctx.warp_id_in_block][thread_ctx.lane_id] = set_id;
+      if (cache_ctx.admission) { RecordAccess(cache_ctx, key); }
+    }
+    __syncwarp();
+    uint32_t n_warp_missing = 0;
+    Key warp_missing_key = 0;
+    uint32_t warp_missing_index = 0;
+    for (uint32_t i = 0; i < n_batch_keys; ++i) {
+      const uint32_t key_idx = batch_offset + i;
+      const Key key = block_keys[thread_ctx.warp_id_in_block][i];
+      const size_t set_id = block_set_ids[thread_ctx.warp_id_in_block][i];
+      SetContext<Key, Elem> set_ctx(cache_ctx, set_id);
+      set_ctx.Lock(thread_ctx);
+      const int insert_way = set_ctx.InsertWithoutEvicting(cache_ctx, thread_ctx, key, 1);
+      if (insert_way >= 0) {
+        set_ctx.Write(cache_ctx, thread_ctx, insert_way, values + cache_ctx.line_size * key_idx);
+      } else {
+        if (thread_ctx.lane_id == n_warp_missing) {
+          warp_missing_key = key;
+          warp_missing_index = key_idx;
+        }
+        __syncwarp();
+        n_warp_missing += 1;
+      }
+      set_ctx.Unlock(thread_ctx);
+    }
+    if (n_warp_missing > 0) {
+      uint32_t base_missing_idx = 0;
+      if (thread_ctx.lane_id == 0) { base_missing_idx = atomicAdd(n_missing, n_warp_missing); }
+      __syncwarp();
+      base_missing_idx = __shfl_sync(kFullMask, base_missing_idx, 0);
+      if (thread_ctx.lane_id < n_warp_missing) {
+        missing_keys[base_missing_idx + thread_ctx.lane_id] = warp_missing_key;
+        missing_indices[base_missing_idx + thread_ctx.lane_id] = warp_missing_index;
+      }
+      __syncwarp();
+    }
+  }
+}
+
+// Replaces the least frequently used line of the set of each missing key. With admission, a key
+// whose estimated frequency does not exceed the one of the victim is rejected. A rejected key is
+// returned as evicted together with its own value, so that it is written to the next level store
+// instead, unless `drop_rejected` tells that its value is unmodified.
+template<typename Key, typename Elem>
+__global__ void EvictKernel(LfuCacheContext<Key, Elem> cache_ctx, const Key* keys,
+                            const uint32_t* indices, const Elem* values, const uint32_t* n_evict,
+                            bool drop_rejected, uint32_t* n_evicted, Key* evicted_keys,
+                            Elem* evicted_values) {
+  ThreadContext thread_ctx{};
+  uint32_t num_evict = *n_evict;
+  __shared__ Key block_keys[kNumWarpPerBlock][kWarpSize];
+  __shared__ size_t block_set_ids[kNumWarpPerBlock][kWarpSize];
+  for (uint32_t batch_offset = thread_ctx.global_warp_id * kWarpSize; batch_offset < num_evict;
+       batch_offset += thread_ctx.num_warps * kWarpSize) {
+    const uint32_t n_batch_keys = min(kWarpSize, num_evict - batch_offset);
+    if (thread_ctx.lane_id < n_batch_keys) {
+      const Key key = keys[batch_offset + thread_ctx.lane_id];
+      const size_t hash = LfuCacheHash()(key);
+      const uint32_t set_id = hash % cache_ctx.n_set;
+      block_keys[thread_ctx.warp_id_in_block][thread_ctx.lane_id] = key;
+      block_set_ids[thread_ctx.warp_id_in_block][thread_ctx.lane_id] = set_id;
+    }
+    __syncwarp();
+    uint32_t n_warp_rejected = 0;
+    for (uint32_t i = 0; i < n_batch_keys; ++i) {
+      const uint32_t key_idx = batch_offset + i;
+      const Key key = block_keys[thread_ctx.warp_id_in_block][i];
+      const uint32_t set_id = block_set_ids[thread_ctx.warp_id_in_block][i];
+      const Elem* value = values + cache_ctx.line_size * indices[key_idx];
+      SetContext<Key, Elem> set_ctx(cache_ctx, set_id);
+      set_ctx.Lock(thread_ctx);
+      Key victim_key = 0;
+      const int victim_way = set_ctx.FindVictim(thread_ctx, &victim_key);
+      bool admit = true;
+      uint32_t frequency = 1;
+      if (cache_ctx.admission) {
+        uint32_t key_frequency = 0;
+        uint32_t victim_frequency = 0;
+        if (thread_ctx.lane_id == 0) {
+          key_frequency = EstimateFrequency(cache_ctx, key);
+          victim_frequency = EstimateFrequency(cache_ctx, victim_key);
+        }
+        key_frequency = __shfl_sync(kFullMask, key_frequency, 0);
+        victim_frequency = __shfl_sync(kFullMask, victim_frequency, 0);
+        admit = key_frequency > victim_frequency;
+        frequency = max(key_frequency, 1U);
+      }
+      if (!admit) { n_warp_rejected += 1; }
+      if (admit || !drop_rejected) {
+        uint32_t evicted_idx = 0;
+        if (thread_ctx.lane_id == 0) {
+          evicted_idx = atomicAdd(n_evicted, 1U);
+          evicted_keys[evicted_idx] = admit ? victim_key : key;
+        }
+        evicted_idx = __shfl_sync(kFullMask, evicted_idx, 0);
+        Elem* evicted_value = evicted_values + cache_ctx.line_size * evicted_idx;
+        if (admit) {
+          set_ctx.Read(cache_ctx, thread_ctx, victim_way, evicted_value);
+        } else {
+          for (int j = thread_ctx.lane_id; j < cache_ctx.line_size; j += kWarpSize) {
+            evicted_value[j] = value[j];
+          }
+        }
+      }
+      if (admit) {
+        set_ctx.Replace(thread_ctx, victim_way, key, frequency);
+        set_ctx.Write(cache_ctx, thread_ctx, victim_way, value);
+      }
+      set_ctx.Unlock(thread_ctx);
+    }
+    if (cache_ctx.stats != nullptr && thread_ctx.lane_id == 0) {
+      atomicAdd(cache_ctx.stats + kStatEvictions,
+                static_cast<unsigned long long int>(n_batch_keys - n_warp_rejected));
+      atomicAdd(cache_ctx.stats + kStatRejectedAdmissions,
+                static_cast<unsigned long long int>(n_warp_rejected));
+    }
+  }
+}
+
+template<typename Key, typename Elem>
+__global__ void DeleteKernel(LfuCacheContext<Key, Elem> cache_ctx, uint32_t num_keys,
+                             const Key* keys) {
+  ThreadContext thread_ctx{};
+  __shared__ Key block_keys[kNumWarpPerBlock][kWarpSize];
+  __shared__ size_t block_set_ids[kNumWarpPerBlock][kWarpSize];
+  for (uint32_t batch_offset = thread_ctx.global_warp_id * kWarpSize; batch_offset < num_keys;
+       batch_offset += thread_ctx.num_warps * kWarpSize) {
+    const uint32_t n_batch_keys = min(kWarpSize, num_keys - batch_offset);
+    if (thread_ctx.lane_id < n_batch_keys) {
+      const Key key = keys[batch_offset + thread_ctx.lane_id];
+      const size_t hash = LfuCacheHash()(key);
+      const uint32_t set_id = hash % cache_ctx.n_set;
+      block_keys[thread_ctx.warp_id_in_block][thread_ctx.lane_id] = key;
+      block_set_ids[thread_ctx.warp_id_in_block][thread_ctx.lane_id] = set_id;
+    }
+    __syncwarp();
+    for (uint32_t i = 0; i < n_batch_keys; ++i) {
+      const Key key = block_keys[thread_ctx.warp_id_in_block][i];
+      const size_t set_id = block_set_ids[thread_ctx.warp_id_in_block][i];
+      SetContext<Key, Elem> set_ctx(cache_ctx, set_id);
+      set_ctx.Lock(thread_ctx);
+      set_ctx.Delete(thread_ctx, key);
+      set_ctx.Unlock(thread_ctx);
+    }
+    __syncwarp();
+  }
+}
+
+// Halves all line frequencies and sketch counters, valid lines keep a frequency of at least 1.
+__global__ void DecayKernel(uint64_t n_lines, uint32_t* frequencies, uint64_t n_counters,
+                            uint32_t* sketch) {
+  CUDA_1D_KERNEL_LOOP_T(uint64_t, i, n_lines) {
+    const uint32_t frequency = frequencies[i];
+    if (frequency > 1) { frequencies[i] = frequency >> 1U; }
+  }
+  CUDA_1D_KERNEL_LOOP_T(uint64_t, i, n_counters) { sketch[i] >>= 1U; }
+}
+
+template<typename Key, typename Elem>
+__global__ void DumpKernel(LfuCacheContext<Key, Elem> cache_ctx, size_t start_key_index,
+                           size_t end_key_index, uint32_t* n_dumped, Key* keys, Elem* values) {
+  ThreadContext thread_ctx{};
+  __shared__ Key warp_keys[kNumWarpPerBlock][kWarpSize];
+  __shared__ uint32_t warp_frequencies[kNumWarpPerBlock][kWarpSize];
+  for (uint32_t warp_start_key_index = start_key_index + thread_ctx.global_warp_id * kWarpSize;
+       warp_start_key_index < end_key_index;
+       warp_start_key_index += thread_ctx.num_warps * kWarpSize) {
+    Key lane_key = 0;
+    uint32_t lane_frequency = 0;
+    if (warp_start_key_index + thread_ctx.lane_id < end_key_index) {
+      lane_key = cache_ctx.keys[warp_start_key_index + thread_ctx.lane_id];
+      lane_frequency = cache_ctx.frequencies[warp_start_key_index + thread_ctx.lane_id];
+    }
+    __syncwarp();
+    warp_keys[thread_ctx.warp_id_in_block][thread_ctx.lane_id] = lane_key;
+    warp_frequencies[thread_ctx.warp_id_in_block][thread_ctx.lane_id] = lane_frequency;
+    const int key_count = __popc(__ballot_sync(kFullMask, lane_frequency != 0));
+    if (key_count == 0) { continue; }
+    uint32_t offset = 0;
+    if (thread_ctx.lane_id == 0) { offset = atomicAdd(n_dumped, key_count); }
+    offset = __shfl_sync(kFullMask, offset, 0);
+    __syncwarp();
+    for (uint32_t i = 0; i < kWarpSize; ++i) {
+      const Key key = warp_keys[thread_ctx.warp_id_in_block][i];
+      const uint32_t frequency = warp_frequencies[thread_ctx.warp_id_in_block][i];
+      if (frequency == 0) { continue; }
+      if (thread_ctx.lane_id == 0) { keys[offset] = key; }
+      __syncwarp();
+      for (uint32_t j = thread_ctx.lane_id; j < cache_ctx.line_size; j += kWarpSize) {
+        values[offset * cache_ctx.line_size + j] =
+            cache_ctx
+                .lines[static_cast<size_t>(warp_start_key_index + i) * cache_ctx.line_size + j];
+      }
+      __syncwarp();
+      offset += 1;
+    }
+  }
+}
+
+template<typename Key, typename Elem>
+class LfuCache : public Cache {
+ public:
+  OF_DISALLOW_COPY_AND_MOVE(LfuCache);
+  explicit LfuCache(const CacheOptions& options)
+      : device_index_{},
+        max_query_length_(0),
+        query_indices_buffer_(nullptr),
+        query_keys_buffer_(nullptr),
+        value_type_(options.value_type),
+        policy_(options.policy),
+        decay_interval_(options.frequency_decay_interval),
+        n_put_keys_since_decay_(0) {
+    OF_CUDA_CHECK(cudaGetDevice(&device_index_));
+    InitLfuCacheContext(options, &ctx_);
+    OF_CUDA_CHECK(cudaMalloc(&n_query_missing_, sizeof(uint32_t)));
+    if (decay_interval_ == 0) { decay_interval_ = kDefaultDecayIntervalFactor * Capacity(); }
+  }
+  ~LfuCache() override {
+    CudaCurrentDeviceGuard guard(device_index_);
+    if (max_query_length_ != 0) {
+      OF_CUDA_CHECK(cudaFree(query_indices_buffer_));
+      OF_CUDA_CHECK(cudaFree(query_keys_buffer_));
+    }
+    OF_CUDA_CHECK(cudaFree(n_query_missing_));
+    DestroyLfuCacheContext(&ctx_);
+  }
+
+  uint32_t KeySize() const override { return sizeof(Key); }
+  uint32_t ValueSize() const override { return sizeof(Elem) * ctx_.line_size; }
+  DataType ValueType() const override { return value_type_; }
+  uint64_t Capacity() const override { return ctx_.n_set * kWarpSize; }
+  uint32_t MaxQueryLength() const override { return max_query_length_; }
+
+  void ReserveQueryLength(uint32_t query_length) override {
+    CudaCurrentDeviceGuard guard(device_index_);
+    if (query_length < max_query_length_) { return; }
+    if (max_query_length_ != 0) {
+      OF_CUDA_CHECK(cudaFree(query_indices_buffer_));
+      OF_CUDA_CHECK(cudaFree(query_keys_buffer_));
+    }
+    OF_CUDA_CHECK(cudaMalloc(&query_indices_buffer_, query_length * sizeof(uint32_t)));
+    OF_CUDA_CHECK(cudaMalloc(&query_keys_buffer_, query_length * sizeof(Key)));
+    max_query_length_ = query_length;
+  }
+
+  CacheOptions::Policy Policy() const override { return policy_; }
+
+  void Test(ep::Stream* stream, uint32_t n_keys, const void* keys, uint32_t* n_missing,
+            void* missing_keys, uint32_t* missing_indices) override {
+    CHECK_LE(n_keys, max_query_length_);
+    auto cuda_stream = stream->As<ep::CudaStream>();
+    OF_CUDA_CHECK(cudaMemsetAsync(n_missing, 0, sizeof(uint32_t), cuda_stream->cuda_stream()));
+    if (n_keys == 0) { return; }
+    cuda_stream->LaunchKernel(GetKernel<Key, Elem, true>, GetLaunchConfig(n_keys), ctx_, n_keys,
+                              static_cast<const Key*>(keys), nullptr, n_missing,
+                              static_cast<Key*>(missing_keys), missing_indices);
+  }
+
+  using Cache::Get;
+  void Get(ep::Stream* stream, uint32_t n_keys, const void* keys, void* values, uint32_t* n_missing,
+           void* missing_keys, uint32_t* missing_indices) override {
+    CHECK_LE(n_keys, max_query_length_);
+    auto cuda_stream = stream->As<ep::CudaStream>();
+    OF_CUDA_CHECK(cudaMemsetAsync(n_missing, 0, sizeof(uint32_t), cuda_stream->cuda_stream()));
+    if (n_keys == 0) { return; }
+    cuda_stream->LaunchKernel(GetKernel<Key, Elem, false>, GetLaunchConfig(n_keys), ctx_, n_keys,
+                              static_cast<const Key*>(keys), static_cast<Elem*>(values), n_missing,
+                              static_cast<Key*>(missing_keys), missing_indices);
+  }
+
+  void Put(ep::Stream* stream, uint32_t n_keys, const void* keys, const void* values,
+           uint32_t* n_evicted, void* evicted_keys, void* evicted_values) override {
+    PutAndEvict(stream, n_keys, keys, values, false, n_evicted, evicted_keys, evicted_values);
+  }
+
+  void PutUnmodified(ep::Stream* stream, uint32_t n_keys, const void* keys, const void* values,
+                     uint32_t* n_evicted, void* evicted_keys, void* evicted_values) override {
+    PutAndEvict(stream, n_keys, keys, values, true, n_evicted, evicted_keys, evicted_values);
+  }
+
+  void Delete(ep::Stream* stream, uint32_t n_keys, const void* keys) override {
+    if (n_keys == 0) { return; }
+    stream->As<ep::CudaStream>()->LaunchKernel(DeleteKernel<Key, Elem>, GetLaunchConfig(n_keys),
+                                               ctx_, n_keys, static_cast<const Key*>(keys));
+  }
+
+  void Dump(ep::Stream* stream, uint64_t start_key_index, uint64_t end_key_index,
+            uint32_t* n_dumped, void* keys, void* values) override {
+    auto cuda_stream = stream->As<ep::CudaStream>();
+    OF_CUDA_CHECK(cudaMemsetAsync(n_dumped, 0, sizeof(uint32_t), cuda_stream->cuda_stream()));
+    const uint64_t max_dump_keys = end_key_index - start_key_index;
+    cuda_stream->LaunchKernel(
+        DumpKernel<Key, Elem>,
+        ep::CudaLaunchConfig((max_dump_keys + kNumWarpPerBlock - 1) / kNumWarpPerBlock, kBlockSize,
+                             0),
+        ctx_, start_key_index, end_key_index, n_dumped, static_cast<Key*>(keys),
+        static_cast<Elem*>(values));
+  }
+
+  void ClearDirtyFlags() override {
+    // do nothing.
+    return;
+  }
+
+  void Clear() override {
+    ClearLfuCacheContext<Key, Elem>(&ctx_);
+    n_put_keys_since_decay_ = 0;
+  }
+
+  void GetStats(ep::Stream* stream, CacheStats* stats) override {
+    GetCacheStats(stream, ctx_.stats, stats);
+  }
+
+  void ResetStats(ep::Stream* stream) override { ResetCacheStats(stream, ctx_.stats); }
+
+ private:
+  void PutAndEvict(ep::Stream* stream, uint32_t n_keys, const void* keys, const void* values,
+                   bool drop_rejected, uint32_t* n_evicted, void* evicted_keys,
+                   void* evicted_values) {
+    CHECK_LE(n_keys, max_query_length_);
+    auto cuda_stream = stream->As<ep::CudaStream>();
+    OF_CUDA_CHECK(cudaMemsetAsync(n_evicted, 0, sizeof(uint32_t), cuda_stream->cuda_stream()));
+    if (n_keys == 0) { return; }
+    OF_CUDA_CHECK(
+        cudaMemsetAsync(n_query_missing_, 0, sizeof(uint32_t), cuda_stream->cuda_stream()));
+    cuda_stream->LaunchKernel(PutWithoutEvictingKernel<Key, Elem>, GetLaunchConfig(n_keys), ctx_,
+                              n_keys, static_cast<const Key*>(keys),
+                              static_cast<const Elem*>(values), n_query_missing_,
+                              query_keys_buffer_, query_indices_buffer_);
+    cuda_stream->LaunchKernel(EvictKernel<Key, Elem>, GetLaunchConfig(n_keys), ctx_,
+                              query_keys_buffer_, query_indices_buffer_,
+                              static_cast<const Elem*>(values), n_query_missing_, drop_rejected,
+                              n_evicted, static_cast<Key*>(evicted_keys),
+                              static_cast<Elem*>(evicted_values));
+    n_put_keys_since_decay_ += n_keys;
+    if (n_put_keys_since_decay_ >= decay_interval_) {
+      Decay(cuda_stream);
+      n_put_keys_since_decay_ = 0;
+    }
+  }
+
+  void Decay(ep::CudaStream* cuda_stream) {
+    const uint64_t n_lines = Capacity();
+    const uint64_t n_counters = ctx_.admission ? kSketchDepth * ctx_.sketch_width : 0;
+    cuda_stream->LaunchKernelDefaultWaves(DecayKernel, std::max(n_lines, n_counters), n_lines,
+                                          ctx_.frequencies, n_counters, ctx_.sketch);
+    if (ctx_.admission) {
+      OF_CUDA_CHECK(cudaMemsetAsync(ctx_.doorkeeper, 0, GetDoorkeeperSize(ctx_),
+                                    cuda_stream->cuda_stream()));
+    }
+  }
+
+  int device_index_;
+  uint32_t max_query_length_;
+  LfuCacheContext<Key, Elem> ctx_;
+  uint32_t* query_indices_buffer_;
+  Key* query_keys_buffer_;
+  // Number of keys left for EvictKernel by PutWithoutEvictingKernel.
+  uint32_t* n_query_missing_{};
+  DataType value_type_;
+  CacheOptions::Policy policy_;
+  uint64_t decay_interval_;
+  uint64_t n_put_keys_since_decay_;
+};
+
+template<typename Key>
+std::unique_ptr<Cache> DispatchValueType(const CacheOptions& options) {
+  if (options.value_size % sizeof(ulonglong2) == 0) {
+    return std::unique_ptr<Cache>(new LfuCache<Key, ulonglong2>(options));
+  } else if (options.value_size % sizeof(uint64_t) == 0) {
+    return std::unique_ptr<Cache>(new LfuCache<Key, uint64_t>(options));
+  } else if (options.value_size % sizeof(uint32_t) == 0) {
+    return std::unique_ptr<Cache>(new LfuCache<Key, uint32_t>(options));
+  } else if (options.value_size % sizeof(uint16_t) == 0) {
+    return std::unique_ptr<Cache>(new LfuCache<Key, uint16_t>(options));
+  } else {
+    return std::unique_ptr<Cache>(new LfuCache<Key, uint8_t>(options));
+  }
+}
+
+std::unique_ptr<Cache> DispatchKeyType(const CacheOptions& options) {
+  if (options.key_size == sizeof(uint32_t)) {
+    return DispatchValueType<uint32_t>(options);
+  } else if (options.key_size == sizeof(uint64_t)) {
+    return DispatchValueType<uint64_t>(options);
+  } else {
+    UNIMPLEMENTED();
+    return nullptr;
+  }
+}
+
+}  // namespace
+
+std::unique_ptr<Cache> NewLfuCache(const CacheOptions& options) {
+  CHECK(options.policy == CacheOptions::Policy::kLFU
+        || options.policy == CacheOptions::Policy::kTinyLFU);
+  return DispatchKeyType(options);
+}
+
+}  // namespace embedding
+
+}  // namespace oneflow
@@ -17,15 +17,8 @@ limitations under the License.
 // Inspired by https://github.com/NVIDIA-Merlin/HugeCTR/blob/master/gpu_cache/src/nv_gpu_cache.cu
 
 #include "oneflow/core/embedding/lru_cache.h"
-#include "oneflow/core/device/cuda_util.h"
+#include "oneflow/core/embedding/set_associative_cache.cuh"
 #include "oneflow/core/embedding/hash_functions.cuh"
-#include <new>
-#include <cuda.h>
-
-#if CUDA_VERSION >= 11000 && ((!defined(__CUDA_ARCH__)) || (__CUDA_ARCH__ >= 700)) \
-    && !(defined(__clang__) && defined(__CUDA__))
-#include <cuda/std/semaphore>
-#endif
 
 namespace oneflow {
 
@@ -33,103 +26,18 @@ namespace embedding {
 
 namespace {
 
-constexpr int kWarpSize = 32;
-constexpr int kNumWarpPerBlock = 4;
-constexpr int kBlockSize = kNumWarpPerBlock * kWarpSize;
-constexpr uint32_t kFullMask = 0xFFFFFFFFU;
-
-ep::CudaLaunchConfig GetLaunchConfig(uint32_t n_keys) {
-  return ep::CudaLaunchConfig((n_keys + kNumWarpPerBlock - 1) / kNumWarpPerBlock,
-                              kWarpSize * kNumWarpPerBlock, 0);
-}
-
-struct ThreadContext {
-  __device__ ThreadContext() {
-    const uint32_t global_thread_id = blockIdx.x * blockDim.x + threadIdx.x;
-    global_warp_id = global_thread_id / kWarpSize;
-    warp_id_in_block = global_warp_id % kNumWarpPerBlock;  // NOLINT
-    num_warps = gridDim.x * kNumWarpPerBlock;              // NOLINT
-    lane_id = global_thread_id % kWarpSize;
-  }
-
-  uint32_t global_warp_id;
-  uint32_t warp_id_in_block;
-  uint32_t num_warps;
-  uint32_t lane_id;
-};
-
-class WarpMutexAtomicImpl {
- public:
-  OF_DISALLOW_COPY_AND_MOVE(WarpMutexAtomicImpl);
-  __device__ WarpMutexAtomicImpl() : flag_(0) {}
-  __device__ ~WarpMutexAtomicImpl() = default;
-
-  __device__ void Lock(const ThreadContext& thread_ctx) {
-    if (thread_ctx.lane_id == 0) {
-      while (atomicCAS(&flag_, 0, 1) != 0)
-        ;
-    }
-    __threadfence();
-    __syncwarp();
-  }
-
-  __device__ void Unlock(const ThreadContext& thread_ctx) {
-    __syncwarp();
-    __threadfence();
-    if (thread_ctx.lane_id == 0) { atomicExch(&flag_, 0); }
-  }
-
- private:
-  int32_t flag_;
-};
-
-#if CUDA_VERSION >= 11000 && ((!defined(__CUDA_ARCH__)) || (__CUDA_ARCH__ >= 700)) \
-    && !(defined(__clang__) && defined(__CUDA__))
-
-class WarpMutexSemaphoreImpl {
- public:
-  OF_DISALLOW_COPY_AND_MOVE(WarpMutexSemaphoreImpl);
-  __device__ WarpMutexSemaphoreImpl() : semaphore_(1) {}
-  __device__ ~WarpMutexSemaphoreImpl() = default;
-
-  __device__ void Lock(const ThreadContext& thread_ctx) {
-    if (thread_ctx.lane_id == 0) { semaphore_.acquire(); }
-    __syncwarp();
-  }
-
-  __device__ void Unlock(const ThreadContext& thread_ctx) {
-    __syncwarp();
-    if (thread_ctx.lane_id == 0) { semaphore_.release(); }
-  }
-
- private:
-  cuda::binary_semaphore<cuda::thread_scope_device> semaphore_;
-};
-
-#endif
-
 template<typename Key, typename Elem>
 struct LruCacheContext {
   Key* keys;
   Elem* lines;
   uint8_t* ages;
   void* mutex;
+  unsigned long long int* stats;
   uint64_t n_set;
   uint32_t line_size;
   CacheOptions::MemoryKind value_memory_kind;
 };
 
-__global__ void InitCacheSetMutex(uint32_t n_set, void* mutex) {
-#if CUDA_VERSION >= 11000 && __CUDA_ARCH__ >= 700 && !(defined(__clang__) && defined(__CUDA__))
-  using WarpMutex = WarpMutexSemaphoreImpl;
-#else
-  using WarpMutex = WarpMutexAtomicImpl;
-#endif  // CUDA_VERSION >= 11000 && __CUDA_ARCH__ >= 700 && !(defined(__clang__) &&
-        // defined(__CUDA__))
-  const uint32_t idx = blockIdx.x * blockDim.x + threadIdx.x;
-  if (idx < n_set) { new (reinterpret_cast<WarpMutex*>(mutex) + idx) WarpMutex; }
-}
-
 template<typename Key, typename Elem>
 void ClearLruCacheContext(LruCacheContext<Key, Elem>* ctx) {
   OF_CUDA_CHECK(cudaMemset(ctx->keys, 0, ctx->n_set * kWarpSize * sizeof(Key)));
@@ -145,22 +53,7 @@ void InitLruCacheContext(const CacheOptions& options, LruCacheContext<Key, Elem>
   const size_t ages_size_per_set = kWarpSize * sizeof(uint8_t);
   int device = 0;
   OF_CUDA_CHECK(cudaGetDevice(&device));
-  int major = 0;
-  OF_CUDA_CHECK(cudaDeviceGetAttribute(&major, cudaDevAttrComputeCapabilityMajor, device));
-  size_t mutex_size_per_set = 0;
-#if CUDA_VERSION >= 11000 && !(defined(__clang__) && defined(__CUDA__))
-  if (major >= 7) {
-#if !defined(__CUDA_ARCH__)
-    mutex_size_per_set = sizeof(WarpMutexSemaphoreImpl);
-#else
-    UNIMPLEMENTED();
-#endif
-  } else {
-    mutex_size_per_set = sizeof(WarpMutexAtomicImpl);
-  }
-#else
-  mutex_size_per_set = sizeof(WarpMutexAtomicImpl);
-#endif  // CUDA_VERSION >= 11000 && !(defined(__clang__) && defined(__CUDA__))
+  const size_t mutex_size_per_set = GetWarpMutexSize(device);
   const size_t n_set = (options.capacity - 1 + kWarpSize) / kWarpSize;
   CHECK_GT(n_set, 0);
   ctx->n_set = n_set;
@@ -185,6 +78,7 @@ void InitLruCacheContext(const CacheOptions& options, LruCacheContext<Key, Elem>
   OF_CUDA_CHECK(cudaMalloc(&(ctx->ages), ages_size));
   const size_t mutex_size = n_set * mutex_size_per_set;
   OF_CUDA_CHECK(cudaMalloc(&(ctx->mutex), mutex_size));
+  ctx->stats = NewCacheStats(options);
 
   ClearLruCacheContext(ctx);
 }
@@ -201,21 +95,15 @@ void DestroyLruCacheContext(LruCacheContext<Key, Elem>* ctx) {
   }
   OF_CUDA_CHECK(cudaFree(ctx->ages));
   OF_CUDA_CHECK(cudaFree(ctx->mutex));
+  DestroyCacheStats(ctx->stats);
 }
 
 template<typename Key, typename Elem>
-struct SetContext {
-#if CUDA_VERSION >= 11000 && __CUDA_ARCH__ >= 700 && !(defined(__clang__) && defined(__CUDA__))
-  using WarpMutex = WarpMutexSemaphoreImpl;
-#else
-  using WarpMutex = WarpMutexAtomicImpl;
-#endif  // CUDA_VERSION >= 11000 && __CUDA_ARCH__ >= 700 && !(defined(__clang__) &&
-        // defined(__CUDA__))
+struct SetContext : public SetContextBase<Key, Elem> {
+  using SetContextBase<Key, Elem>::keys;
+
   __device__ SetContext(const LruCacheContext<Key, Elem>& ctx, uint32_t set_id)
-      : keys(ctx.keys + set_id * kWarpSize),
-        mutex(reinterpret_cast<WarpMutex*>(ctx.mutex) + set_id),
-        ages(ctx.ages + set_id * kWarpSize),
-        lines(ctx.lines + static_cast<size_t>(set_id) * kWarpSize * ctx.line_size) {}
+      : SetContextBase<Key, Elem>(ctx, set_id), ages(ctx.ages + set_id * kWarpSize) {}
 
   __device__ int Lookup(const ThreadContext& thread_ctx, Key key) {
     const Key lane_key = keys[thread_ctx.lane_id];
@@ -229,14 +117,6 @@ struct SetContext {
     }
   }
 
-  __device__ void Read(const LruCacheContext<Key, Elem>& cache_ctx, const ThreadContext& thread_ctx,
-                       int way, Elem* line) {
-    const Elem* from_line = lines + way * cache_ctx.line_size;
-    for (int i = thread_ctx.lane_id; i < cache_ctx.line_size; i += kWarpSize) {
-      line[i] = from_line[i];
-    }
-  }
-
   __device__ int InsertWithoutEvicting(const LruCacheContext<Key, Elem>& cache_ctx,
                                        const ThreadContext& thread_ctx, Key key) {
     int insert_way = -1;
@@ -256,7 +136,7 @@ struct SetContext {
     if (insert_way == -1) {
       const unsigned valid_mask = __ballot_sync(kFullMask, lane_age != 0);
       if (valid_mask != kFullMask) {
-        insert_way = __popc(static_cast<int>(valid_mask));
+        insert_way = __ffs(static_cast<int>(~valid_mask)) - 1;
         if (lane_age > 0) {
           lane_age -= 1;
         } else if (thread_ctx.lane_id == insert_way) {
@@ -287,22 +167,26 @@ struct SetContext {
     *way = insert_way;
   }
 
-  __device__ void Write(const LruCacheContext<Key, Elem>& cache_ctx,
-                        const ThreadContext& thread_ctx, int way, const Elem* line) {
-    Elem* to_line = lines + way * cache_ctx.line_size;
-    for (int i = thread_ctx.lane_id; i < cache_ctx.line_size; i += kWarpSize) {
-      to_line[i] = line[i];
+  // Invalidates the line of `key` and moves the lines older than it one step younger, so that the
+  // ages of the valid lines remain the top range that InsertWithoutEvicting and Evict rely on.
+  __device__ void Delete(const ThreadContext& thread_ctx, Key key) {
+    const Key lane_key = keys[thread_ctx.lane_id];
+    int lane_age = ages[thread_ctx.lane_id];
+    const unsigned hit_mask = __ballot_sync(kFullMask, lane_key == key && lane_age != 0);
+    if (hit_mask != 0) {
+      const int delete_way = __ffs(static_cast<int>(hit_mask)) - 1;
+      const int delete_way_age = __shfl_sync(kFullMask, lane_age, delete_way);
+      if (thread_ctx.lane_id == delete_way) {
+        lane_age = 0;
+      } else if (lane_age != 0 && lane_age < delete_way_age) {
+        lane_age += 1;
+      }
+      __syncwarp();
+      ages[thread_ctx.lane_id] = lane_age;
     }
   }
 
-  __device__ void Lock(const ThreadContext& thread_ctx) { mutex->Lock(thread_ctx); }
-
-  __device__ void Unlock(const ThreadContext& thread_ctx) { mutex->Unlock(thread_ctx); }
-
-  Key* keys;
-  Elem* lines;
   uint8_t* ages;
-  WarpMutex* mutex;
 };
 
 template<typename Key, typename Elem, bool test_only>
@@ -343,6 +227,11 @@ __global__ void GetKernel(LruCacheContext<Key, Elem> cache_ctx, uint32_t num_key
         set_ctx.Read(cache_ctx, thread_ctx, way, values + key_idx * cache_ctx.line_size);
       }
     }
+    if (!test_only && cache_ctx.stats != nullptr && thread_ctx.lane_id == 0) {
+      atomicAdd(cache_ctx.stats + kStatQueries, static_cast<unsigned long long int>(n_batch_keys));
+      atomicAdd(cache_ctx.stats + kStatHits,
+                static_cast<unsigned long long int>(n_batch_keys - n_warp_missing));
+    }
     if (n_warp_missing > 0) {
       uint32_t base_missing_idx = 0;
       if (thread_ctx.lane_id == 0) { base_missing_idx = atomicAdd(n_missing_keys, n_warp_missing); }
@@ -424,6 +313,10 @@ __global__ void EvictKernel(LruCacheContext<Key, Elem> cache_ctx, const Key* key
   for (uint32_t batch_offset = thread_ctx.global_warp_id * kWarpSize; batch_offset < num_evict;
        batch_offset += thread_ctx.num_warps * kWarpSize) {
     const uint32_t n_batch_keys = min(kWarpSize, num_evict - batch_offset);
+    if (cache_ctx.stats != nullptr && thread_ctx.lane_id == 0) {
+      atomicAdd(cache_ctx.stats + kStatEvictions,
+                static_cast<unsigned long long int>(n_batch_keys));
+    }
     if (thread_ctx.lane_id < n_batch_keys) {
       const Key key = keys[batch_offset + thread_ctx.lane_id];
       const size_t hash = LruCacheHash()(key);
@@ -452,6 +345,35 @@ __global__ void EvictKernel(LruCacheContext<Key, Elem> cache_ctx, const Key* key
   }
 }
 
+template<typename Key, typename Elem>
+__global__ void DeleteKernel(LruCacheContext<Key, Elem> cache_ctx, uint32_t num_keys,
+                             const Key* keys) {
+  ThreadContext thread_ctx{};
+  __shared__ Key block_keys[kNumWarpPerBlock][kWarpSize];
+  __shared__ size_t block_set_ids[kNumWarpPerBlock][kWarpSize];
+  for (uint32_t batch_offset = thread_ctx.global_warp_id * kWarpSize; batch_offset < num_keys;
+       batch_offset += thread_ctx.num_warps * kWarpSize) {
+    const uint32_t n_batch_keys = min(kWarpSize, num_keys - batch_offset);
+    if (thread_ctx.lane_id < n_batch_keys) {
+      const Key key = keys[batch_offset + thread_ctx.lane_id];
+      const size_t hash = LruCacheHash()(key);
+      const uint32_t set_id = hash % cache_ctx.n_set;
+      block_keys[thread_ctx.warp_id_in_block][thread_ctx.lane_id] = key;
+      block_set_ids[thread_ctx.warp_id_in_block][thread_ctx.lane_id] = set_id;
+    }
+    __syncwarp();
+    for (uint32_t i = 0; i < n_batch_keys; ++i) {
+      const Key key = block_keys[thread_ctx.warp_id_in_block][i];
+      const size_t set_id = block_set_ids[thread_ctx.warp_id_in_block][i];
+      SetContext<Key, Elem> set_ctx(cache_ctx, set_id);
+      set_ctx.Lock(thread_ctx);
+      set_ctx.Delete(thread_ctx, key);
+      set_ctx.Unlock(thread_ctx);
+    }
+    __syncwarp();
+  }
+}
+
 template<typename Key, typename Elem>
 __global__ void DumpKernel(LruCacheContext<Key, Elem> cache_ctx, size_t start_key_index,
                            size_t end_key_index, uint32_t* n_dumped, Key* keys, Elem* values) {
@@ -574,6 +496,12 @@ class LruCache : public Cache {
                               static_cast<Key*>(evicted_keys), static_cast<Elem*>(evicted_values));
   }
 
+  void Delete(ep::Stream* stream, uint32_t n_keys, const void* keys) override {
+    if (n_keys == 0) { return; }
+    stream->As<ep::CudaStream>()->LaunchKernel(DeleteKernel<Key, Elem>, GetLaunchConfig(n_keys),
+                                               ctx_, n_keys, static_cast<const Key*>(keys));
+  }
+
   void Dump(ep::Stream* stream, uint64_t start_key_index, uint64_t end_key_index,
             uint32_t* n_dumped, void* keys, void* values) override {
     auto cuda_stream = stream->As<ep::CudaStream>();
@@ -594,6 +522,12 @@ class LruCache : public Cache {
 
   void Clear() override { ClearLruCacheContext<Key, Elem>(&ctx_); }
 
+  void GetStats(ep::Stream* stream, CacheStats* stats) override {
+    GetCacheStats(stream, ctx_.stats, stats);
+  }
+
+  void ResetStats(ep::Stream* stream) override { ResetCacheStats(stream, ctx_.stats); }
+
  private:
   int device_index_;
   uint32_t max_query_length_;
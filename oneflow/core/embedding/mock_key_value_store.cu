@@ -132,6 +132,7 @@ class KeyValueStoreImpl : public KeyValueStore {
   void Get(ep::Stream* stream, uint32_t num_keys, const void* keys, void* values,
            uint32_t* n_missing, uint32_t* missing_indices) override;
   void Put(ep::Stream* stream, uint32_t num_keys, const void* keys, const void* values) override;
+  void Delete(ep::Stream* stream, uint32_t num_keys, const void* keys) override;
   bool SnapshotExists(const std::string& name) override;
   void LoadSnapshot(const std::string& name) override;
   void LoadSnapshot(const std::string& name,
@@ -203,6 +204,18 @@ void KeyValueStoreImpl<Key>::Put(ep::Stream* stream, uint32_t num_keys, const vo
   }
 }
 
+template<typename Key>
+void KeyValueStoreImpl<Key>::Delete(ep::Stream* stream, uint32_t num_keys, const void* keys) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto cuda_stream = stream->As<ep::CudaStream>();
+  CHECK_LE(num_keys, max_query_length_);
+  if (num_keys == 0) { return; }
+  OF_CUDA_CHECK(cudaMemcpyAsync(host_query_keys_, keys, key_size_ * num_keys, cudaMemcpyDefault,
+                                cuda_stream->cuda_stream()));
+  CHECK_JUST(cuda_stream->Sync());
+  for (uint32_t i = 0; i < num_keys; ++i) { store_.erase(host_query_keys_[i]); }
+}
+
 template<typename Key>
 bool KeyValueStoreImpl<Key>::SnapshotExists(const std::string& name) {
   return snapshots_.find(name) != snapshots_.end();
@@ -15,6 +15,7 @@ limitations under the License.
 */
 #include "oneflow/core/embedding/persistent_table.h"
 #include "oneflow/core/common/util.h"
+#include "oneflow/core/common/data_type.h"
 #include "oneflow/core/embedding/hash_functions.cuh"
 
 #ifdef __linux__
@@ -29,6 +30,7 @@ limitations under the License.
 #include <sys/syscall.h>
 #include <linux/aio_abi.h>
 #include <unistd.h>
+#include <ctime>
 #ifdef WITH_LIBURING
 #include <liburing.h>
 #endif  // WITH_LIBURING
@@ -51,16 +53,22 @@ constexpr uint32_t kChunkNameSuffixLength = 12;
 constexpr char const* kKeyFileNamePrefix = "key-";
 constexpr char const* kIndexFileNamePrefix = "index-";
 constexpr char const* kValueFileNamePrefix = "value-";
+constexpr char const* kStatsFileNamePrefix = "stats-";
 constexpr char const* kLockFileName = "LOCK";
 constexpr char const* kKeySizeFileName = "KEY_SIZE";
 constexpr char const* kValueSizeFileName = "VALUE_SIZE";
 constexpr char const* kPhysicalBlockSizeFileName = "PHYSICAL_BLOCK_SIZE";
 constexpr char const* kNumLogicalBlocksPerChunkFileName = "NUM_LOGICAL_BLOCKS_PER_CHUNK";
+constexpr char const* kStorageFormatFileName = "STORAGE_FORMAT";
+constexpr char const* kReducedPrecisionDimFileName = "REDUCED_PRECISION_DIM";
+constexpr char const* kNumValueDirsFileName = "NUM_VALUE_DIRS";
 constexpr char const* kKeysDirName = "keys";
 constexpr char const* kValuesDirName = "values";
 constexpr char const* kSnapshotsDirName = "snapshots";
 constexpr char const* kSnapshotListFileName = "LIST";
+constexpr char const* kSortedIndexFileName = "SORTED_INDEX";
 constexpr size_t kParallelForStride = 256;
+constexpr uint64_t kInvalidRowId = std::numeric_limits<uint64_t>::max();
 
 template<typename T>
 T* BytesOffset(T* ptr, size_t bytes) {
@@ -87,6 +95,17 @@ void InitOrCheckMetaValue(const std::string& pathname, int64_t expected, bool in
   }
 }
 
+// Tables created before the meta value was introduced have no file for it and are treated as if
+// they had been created with `default_value`.
+void InitOrCheckOptionalMetaValue(const std::string& pathname, int64_t expected,
+                                  int64_t default_value, bool init) {
+  if (!init && !PosixFile::FileExists(pathname)) {
+    if (expected != default_value) { LOG(FATAL) << "Check failed: " << pathname; }
+    return;
+  }
+  InitOrCheckMetaValue(pathname, expected, init);
+}
+
 std::string GetChunkName(uint64_t chunk_id) {
   const std::string chunk_name_wo_leading_zero = std::to_string(chunk_id);
   CHECK_LE(chunk_name_wo_leading_zero.size(), kChunkNameSuffixLength);
@@ -120,11 +139,122 @@ void ListChunkFiles(const std::string& base, const std::string& prefix,
   PCHECK(closedir(dir) == 0);
 }
 
+uint32_t SystemNowSeconds() { return static_cast<uint32_t>(std::time(nullptr)); }
+
+// Per row bookkeeping for TTL and frequency based eviction, saved to the snapshot next to the
+// index file in the same order.
+struct RowStats {
+  uint32_t update_time;
+  uint32_t update_count;
+};
+
 uint32_t GetLogicalBlockSize(uint32_t physical_block_size, uint32_t value_size) {
   return physical_block_size >= value_size ? physical_block_size
                                            : RoundUp(value_size, physical_block_size);
 }
 
+void FloatToHalf(const float* src, uint32_t n, float16* dst) {
+  for (uint32_t i = 0; i < n; ++i) { dst[i] = static_cast<float16>(src[i]); }
+}
+
+void HalfToFloat(const float16* src, uint32_t n, float* dst) {
+  for (uint32_t i = 0; i < n; ++i) { dst[i] = static_cast<float>(src[i]); }
+}
+
+void FloatToBFloat16(const float* src, uint32_t n, bfloat16* dst) {
+  for (uint32_t i = 0; i < n; ++i) { dst[i] = static_cast<bfloat16>(src[i]); }
+}
+
+void BFloat16ToFloat(const bfloat16* src, uint32_t n, float* dst) {
+  for (uint32_t i = 0; i < n; ++i) { dst[i] = static_cast<float>(src[i]); }
+}
+
+float FloatToInt8(const float* src, uint32_t n, int8_t* dst) {
+  float max_abs = 0;
+  for (uint32_t i = 0; i < n; ++i) { max_abs = std::max(max_abs, std::abs(src[i])); }
+  const float scale = max_abs / 127.0F;
+  const float inv_scale = scale == 0 ? 0 : 1.0F / scale;
+  for (uint32_t i = 0; i < n; ++i) {
+    dst[i] = static_cast<int8_t>(std::min(std::max(std::nearbyint(src[i] * inv_scale), -127.0F),
+                                          127.0F));
+  }
+  return scale;
+}
+
+void Int8ToFloat(const int8_t* src, uint32_t n, float scale, float* dst) {
+  for (uint32_t i = 0; i < n; ++i) { dst[i] = static_cast<float>(src[i]) * scale; }
+}
+
+// Converts value rows to and from the row layout stored in the value files, which is
+// [reduced precision part][rest as is]. The reduced precision part of kInt8 is [float scale][int8].
+class ValueCodec final {
+ public:
+  OF_DISALLOW_COPY_AND_MOVE(ValueCodec);
+  ValueCodec(PersistentTableOptions::StorageFormat format, uint32_t value_size,
+             uint32_t reduced_precision_dim)
+      : format_(format), value_size_(value_size), reduced_dim_(0), stored_reduced_size_(0) {
+    if (format_ != PersistentTableOptions::StorageFormat::kRaw) {
+      CHECK_EQ(value_size_ % sizeof(float), 0);
+      const uint32_t num_elems = value_size_ / sizeof(float);
+      reduced_dim_ = reduced_precision_dim == 0 ? num_elems : reduced_precision_dim;
+      CHECK_LE(reduced_dim_, num_elems);
+      if (format_ == PersistentTableOptions::StorageFormat::kFloat16
+          || format_ == PersistentTableOptions::StorageFormat::kBFloat16) {
+        stored_reduced_size_ = reduced_dim_ * sizeof(uint16_t);
+      } else if (format_ == PersistentTableOptions::StorageFormat::kInt8) {
+        stored_reduced_size_ = sizeof(float) + reduced_dim_ * sizeof(int8_t);
+      } else {
+        UNIMPLEMENTED();
+      }
+    }
+    rest_size_ = value_size_ - reduced_dim_ * sizeof(float);
+    stored_value_size_ = stored_reduced_size_ + rest_size_;
+  }
+  ~ValueCodec() = default;
+
+  bool IsRaw() const { return format_ == PersistentTableOptions::StorageFormat::kRaw; }
+  uint32_t ValueSize() const { return value_size_; }
+  uint32_t StoredValueSize() const { return stored_value_size_; }
+  uint32_t ReducedPrecisionDim() const { return reduced_dim_; }
+
+  void Encode(const void* value, void* stored) const {
+    const float* src = static_cast<const float*>(value);
+    if (format_ == PersistentTableOptions::StorageFormat::kFloat16) {
+      FloatToHalf(src, reduced_dim_, static_cast<float16*>(stored));
+    } else if (format_ == PersistentTableOptions::StorageFormat::kBFloat16) {
+      FloatToBFloat16(src, reduced_dim_, static_cast<bfloat16*>(stored));
+    } else if (format_ == PersistentTableOptions::StorageFormat::kInt8) {
+      const float scale =
+          FloatToInt8(src, reduced_dim_, BytesOffset(static_cast<int8_t*>(stored), sizeof(float)));
+      std::memcpy(stored, &scale, sizeof(float));
+    }
+    MemcpyOffset(stored, stored_reduced_size_, src, reduced_dim_ * sizeof(float), rest_size_);
+  }
+
+  void Decode(const void* stored, void* value) const {
+    float* dst = static_cast<float*>(value);
+    if (format_ == PersistentTableOptions::StorageFormat::kFloat16) {
+      HalfToFloat(static_cast<const float16*>(stored), reduced_dim_, dst);
+    } else if (format_ == PersistentTableOptions::StorageFormat::kBFloat16) {
+      BFloat16ToFloat(static_cast<const bfloat16*>(stored), reduced_dim_, dst);
+    } else if (format_ == PersistentTableOptions::StorageFormat::kInt8) {
+      float scale = 0;
+      std::memcpy(&scale, stored, sizeof(float));
+      Int8ToFloat(BytesOffset(static_cast<const int8_t*>(stored), sizeof(float)), reduced_dim_,
+                  scale, dst);
+    }
+    MemcpyOffset(dst, reduced_dim_ * sizeof(float), stored, stored_reduced_size_, rest_size_);
+  }
+
+ private:
+  PersistentTableOptions::StorageFormat format_;
+  uint32_t value_size_;
+  uint32_t reduced_dim_;
+  uint32_t stored_reduced_size_;
+  uint32_t rest_size_;
+  uint32_t stored_value_size_;
+};
+
 class AlignedBuffer final {
  public:
   OF_DISALLOW_COPY_AND_MOVE(AlignedBuffer);
@@ -150,11 +280,12 @@ template<typename Key>
 class ChunkIteratorImpl : public PersistentTable::Iterator {
  public:
   OF_DISALLOW_COPY_AND_MOVE(ChunkIteratorImpl);
-  ChunkIteratorImpl(uint32_t value_size, uint32_t logical_block_size, uint32_t num_values_per_block,
-                    uint64_t num_values_per_chunk, uint64_t chunk_id, uint64_t n,
-                    const Key* chunk_keys, const uint64_t* chunk_indices, const void* chunk_values)
+  ChunkIteratorImpl(const ValueCodec* codec, uint32_t logical_block_size,
+                    uint32_t num_values_per_block, uint64_t num_values_per_chunk, uint64_t chunk_id,
+                    uint64_t n, const Key* chunk_keys, const uint64_t* chunk_indices,
+                    const void* chunk_values)
       : pos_(0),
-        value_size_(value_size),
+        codec_(codec),
         logical_block_size_(logical_block_size),
         num_values_per_block_(num_values_per_block),
         num_values_per_chunk_(num_values_per_chunk),
@@ -172,10 +303,15 @@ class ChunkIteratorImpl : public PersistentTable::Iterator {
       static_cast<Key*>(keys)[count] = chunk_keys_[index_in_chunk];
       const uint64_t block_in_chunk = index_in_chunk / num_values_per_block_;
       const uint32_t index_in_block = index_in_chunk - block_in_chunk * num_values_per_block_;
-      const uint32_t value_offset =
-          block_in_chunk * logical_block_size_ + index_in_block * value_size_;
-      std::memcpy(static_cast<char*>(values) + count * value_size_,
-                  static_cast<const char*>(chunk_values_) + value_offset, value_size_);
+      const uint64_t value_offset =
+          block_in_chunk * logical_block_size_ + index_in_block * codec_->StoredValueSize();
+      if (codec_->IsRaw()) {
+        std::memcpy(static_cast<char*>(values) + count * codec_->ValueSize(),
+                    static_cast<const char*>(chunk_values_) + value_offset, codec_->ValueSize());
+      } else {
+        codec_->Decode(BytesOffset(chunk_values_, value_offset),
+                       BytesOffset(values, count * codec_->ValueSize()));
+      }
       count++;
       pos_++;
     }
@@ -186,7 +322,7 @@ class ChunkIteratorImpl : public PersistentTable::Iterator {
 
  private:
   uint64_t pos_;
-  uint32_t value_size_;
+  const ValueCodec* codec_;
   uint32_t logical_block_size_;
   uint32_t num_values_per_block_;
   uint64_t num_values_per_chunk_;
@@ -353,6 +489,7 @@ class PersistentTableImpl : public PersistentTable {
            uint32_t* missing_indices) override;
   void PutBlocks(uint32_t num_keys, const void* keys, const void* blocks) override;
   void Put(uint32_t num_keys, const void* keys, const void* values) override;
+  void Delete(uint32_t num_keys, const void* keys) override;
   bool SnapshotExists(const std::string& name) override;
   void LoadSnapshot(const std::string& name) override;
   void LoadSnapshot(const std::string& name,
@@ -365,25 +502,43 @@ class PersistentTableImpl : public PersistentTable {
   std::string KeyFilePath(uint64_t chunk_id) const;
   std::string ValueFilePath(uint64_t chunk_id) const;
   std::string IndexFilePath(const std::string& name, uint64_t chunk_id) const;
+  std::string StatsFilePath(const std::string& name, uint64_t chunk_id) const;
   std::string SnapshotDirPath(const std::string& name) const;
   std::string SnapshotListFilePath(const std::string& name) const;
   void LoadSnapshotImpl(const std::string& name);
+  bool LoadSortedIndex(const std::string& name);
+  void SaveSortedIndex(const std::string& name);
+  bool FindRowId(Key key, uint64_t* id) const;
+  void GetMapped(uint32_t num_keys, const void* keys, void* values, uint32_t* n_missing,
+                 uint32_t* missing_indices);
   void SaveSnapshotImpl(const std::string& name);
+  void LoadRowStats(const std::string& name, uint64_t chunk_id, size_t n_entries, const Key* keys,
+                    const uint64_t* indices);
+  void EvictRows();
+  void ReleaseUnreferencedChunks();
+  size_t ValueDirIndex(uint64_t chunk_id) const { return chunk_id % values_dirs_.size(); }
+  void ReadBlock(Engine* engine, uint64_t id, void* block, uint32_t* offset);
   void ParallelFor(size_t total, const ForRange<Engine>& for_range);
 
   std::string root_dir_;
   std::string keys_dir_;
-  std::string values_dir_;
+  std::vector<std::string> values_dirs_;
   std::string snapshots_dir_;
   uint32_t key_size_;
   uint32_t value_size_;
+  ValueCodec codec_;
+  uint32_t stored_value_size_;
   uint64_t num_logical_blocks_per_chunk_;
   uint64_t num_values_per_chunk_;
   uint32_t num_values_per_block_;
   uint32_t physical_block_size_;
   uint32_t logical_block_size_;
 
+  // Each values directory has num_workers_per_dir_ consecutive workers.
   std::vector<std::unique_ptr<Worker<Engine>>> workers_;
+  uint32_t num_workers_per_dir_;
+  std::vector<uint64_t> row_ids_buffer_;
+  std::vector<std::vector<uint32_t>> dir_key_indices_;
 
   std::vector<uint32_t> offsets_buffer_;
   AlignedBuffer blocks_buffer_;
@@ -396,6 +551,22 @@ class PersistentTableImpl : public PersistentTable {
   uint64_t writable_key_file_chunk_id_;
   PosixFileLockGuard lock_;
   bool read_only_;
+
+  bool track_row_stats_;
+  uint64_t expiry_ttl_seconds_;
+  uint32_t eviction_min_count_;
+  std::function<uint32_t()> clock_;
+  uint32_t last_eviction_time_;
+  robin_hood::unordered_flat_map<Key, RowStats> row_stats_;
+
+  bool mmap_values_;
+  bool save_sorted_index_;
+  std::vector<PosixMappedFile> mapped_values_;
+  // While a sorted index is mapped, lookups binary search it and row_id_mapping_ is empty.
+  PosixMappedFile sorted_index_;
+  const Key* sorted_keys_;
+  const uint64_t* sorted_row_ids_;
+  size_t num_sorted_keys_;
 };
 
 template<typename Key, typename Engine>
@@ -403,14 +574,30 @@ PersistentTableImpl<Key, Engine>::PersistentTableImpl(const PersistentTableOptio
     : root_dir_(options.path),
       key_size_(options.key_size),
       value_size_(options.value_size),
+      codec_(options.storage_format, options.value_size, options.reduced_precision_dim),
+      stored_value_size_(codec_.StoredValueSize()),
       physical_block_size_(options.physical_block_size),
-      logical_block_size_(GetLogicalBlockSize(options.physical_block_size, value_size_)),
+      logical_block_size_(GetLogicalBlockSize(options.physical_block_size, stored_value_size_)),
       blocks_buffer_(options.physical_block_size),
       writable_key_file_chunk_id_(-1),
-      read_only_(options.read_only) {
+      read_only_(options.read_only),
+      track_row_stats_(options.expiry_ttl_seconds > 0 || options.eviction_min_count > 0),
+      expiry_ttl_seconds_(options.expiry_ttl_seconds),
+      eviction_min_count_(options.eviction_min_count),
+      clock_(options.clock ? options.clock : SystemNowSeconds),
+      last_eviction_time_(clock_()),
+      mmap_values_(options.mmap_values),
+      save_sorted_index_(options.save_sorted_index),
+      sorted_keys_(nullptr),
+      sorted_row_ids_(nullptr),
+      num_sorted_keys_(0) {
+  CHECK(!mmap_values_ || read_only_) << "Value chunks can only be mapped in read only mode";
   const uint64_t capacity_hint = ParseIntegerFromEnv(
       "ONEFLOW_ONE_EMBEDDING_PERSISTENT_TABLE_CAPACITY_HINT", options.capacity_hint);
-  if (capacity_hint > 0) { row_id_mapping_.reserve(capacity_hint); }
+  if (capacity_hint > 0) {
+    row_id_mapping_.reserve(capacity_hint);
+    if (track_row_stats_) { row_stats_.reserve(capacity_hint); }
+  }
   PosixFile::RecursiveCreateDirectory(options.path, 0755);
   const std::string lock_filename = PosixFile::JoinPath(options.path, kLockFileName);
   const bool init = !PosixFile::FileExists(lock_filename);
@@ -422,7 +609,7 @@ PersistentTableImpl<Key, Engine>::PersistentTableImpl(const PersistentTableOptio
   const uint64_t target_chunk_size = options.target_chunk_size_mb * 1024 * 1024;
   CHECK_GE(target_chunk_size, logical_block_size_);
   num_logical_blocks_per_chunk_ = target_chunk_size / logical_block_size_,
-  num_values_per_block_ = logical_block_size_ / value_size_;
+  num_values_per_block_ = logical_block_size_ / stored_value_size_;
   num_values_per_chunk_ = num_values_per_block_ * num_logical_blocks_per_chunk_;
   InitOrCheckMetaValue(PosixFile::JoinPath(options.path, kKeySizeFileName), key_size_, init);
   InitOrCheckMetaValue(PosixFile::JoinPath(options.path, kValueSizeFileName), value_size_, init);
@@ -430,27 +617,64 @@ PersistentTableImpl<Key, Engine>::PersistentTableImpl(const PersistentTableOptio
                        options.physical_block_size, init);
   InitOrCheckMetaValue(PosixFile::JoinPath(options.path, kNumLogicalBlocksPerChunkFileName),
                        num_logical_blocks_per_chunk_, init);
+  InitOrCheckOptionalMetaValue(PosixFile::JoinPath(options.path, kStorageFormatFileName),
+                               static_cast<int64_t>(options.storage_format),
+                               static_cast<int64_t>(PersistentTableOptions::StorageFormat::kRaw),
+                               init);
+  InitOrCheckOptionalMetaValue(PosixFile::JoinPath(options.path, kReducedPrecisionDimFileName),
+                               codec_.ReducedPrecisionDim(), 0, init);
   keys_dir_ = PosixFile::JoinPath(options.path, kKeysDirName);
-  values_dir_ = PosixFile::JoinPath(options.path, kValuesDirName);
+  if (options.value_paths.empty()) {
+    values_dirs_.push_back(PosixFile::JoinPath(options.path, kValuesDirName));
+  } else {
+    for (const auto& value_path : options.value_paths) {
+      values_dirs_.push_back(PosixFile::JoinPath(value_path, kValuesDirName));
+    }
+  }
+  InitOrCheckOptionalMetaValue(PosixFile::JoinPath(options.path, kNumValueDirsFileName),
+                               values_dirs_.size(), 1, init);
   snapshots_dir_ = PosixFile::JoinPath(options.path, kSnapshotsDirName);
   if (init) {
     PosixFile::RecursiveCreateDirectory(keys_dir_, 0755);
-    PosixFile::RecursiveCreateDirectory(values_dir_, 0755);
+    for (const auto& values_dir : values_dirs_) {
+      PosixFile::RecursiveCreateDirectory(values_dir, 0755);
+    }
   }
-  const uint32_t num_workers = ParseIntegerFromEnv(
-      "ONEFLOW_ONE_EMBEDDING_PERSISTENT_TABLE_NUM_WORKERS", kDefaultNumWorkerThreads);
-  workers_.resize(num_workers);
+  num_workers_per_dir_ = ParseIntegerFromEnv("ONEFLOW_ONE_EMBEDDING_PERSISTENT_TABLE_NUM_WORKERS",
+                                             kDefaultNumWorkerThreads);
+  CHECK_GT(num_workers_per_dir_, 0);
+  workers_.resize(num_workers_per_dir_ * values_dirs_.size());
   for (uint32_t tid = 0; tid < workers_.size(); ++tid) {
     workers_.at(tid).reset(new Worker<Engine>);
   }
-  std::unordered_map<uint64_t, std::string> chunks;
-  ListChunkFiles(values_dir_, kValueFileNamePrefix, &chunks);
-  for (auto& chunk : chunks) {
-    if (value_files_.size() <= chunk.first) { value_files_.resize(chunk.first + 1); }
-    CHECK_EQ(value_files_.at(chunk.first).fd(), -1);
-    const int flags = read_only_ ? (O_RDONLY | O_DIRECT) : (O_RDWR | O_DIRECT);
-    PosixFile value_file(chunk.second, flags, 0644);
-    value_files_.at(chunk.first) = std::move(value_file);
+  dir_key_indices_.resize(values_dirs_.size());
+  for (size_t dir = 0; dir < values_dirs_.size(); ++dir) {
+    std::unordered_map<uint64_t, std::string> chunks;
+    ListChunkFiles(values_dirs_.at(dir), kValueFileNamePrefix, &chunks);
+    for (auto& chunk : chunks) {
+      CHECK_EQ(ValueDirIndex(chunk.first), dir) << chunk.second;
+      if (value_files_.size() <= chunk.first) { value_files_.resize(chunk.first + 1); }
+      CHECK_EQ(value_files_.at(chunk.first).fd(), -1);
+      const int flags = read_only_ ? (O_RDONLY | O_DIRECT) : (O_RDWR | O_DIRECT);
+      PosixFile value_file(chunk.second, flags, 0644);
+      value_files_.at(chunk.first) = std::move(value_file);
+    }
+  }
+  if (mmap_values_) {
+    const int mmap_flags = MAP_SHARED | (options.mmap_populate ? MAP_POPULATE : 0);
+    mapped_values_.resize(value_files_.size());
+    for (uint64_t chunk_id = 0; chunk_id < value_files_.size(); ++chunk_id) {
+      if (!value_files_.at(chunk_id).IsOpen()) { continue; }
+      PosixFile value_file(ValueFilePath(chunk_id), O_RDONLY, 0644);
+      const size_t size = value_file.Size();
+      if (size == 0) { continue; }
+      mapped_values_.at(chunk_id) =
+          PosixMappedFile(std::move(value_file), size, PROT_READ, mmap_flags);
+      if (!options.mmap_populate) {
+        // Lookups are random, read ahead would only evict useful pages.
+        PCHECK(madvise(mapped_values_.at(chunk_id).ptr(), size, MADV_RANDOM) == 0);
+      }
+    }
   }
   if (!value_files_.empty()) {
     physical_table_size_ = ((value_files_.size() - 1) * num_logical_blocks_per_chunk_
@@ -475,36 +699,150 @@ template<typename Key, typename Engine>
 void PersistentTableImpl<Key, Engine>::GetBlocks(uint32_t num_keys, const void* keys, void* blocks,
                                                  uint32_t* offsets) {
   std::lock_guard<std::recursive_mutex> lock(mutex_);
-  ParallelFor(num_keys, [&](Engine* engine, size_t start, size_t end) {
+  if (values_dirs_.size() == 1) {
+    ParallelFor(num_keys, [&](Engine* engine, size_t start, size_t end) {
+      for (uint64_t i = start; i < end; ++i) {
+        uint64_t id = 0;
+        if (FindRowId(static_cast<const Key*>(keys)[i], &id)) {
+          ReadBlock(engine, id, BytesOffset(blocks, i * logical_block_size_), offsets + i);
+        } else {
+          offsets[i] = logical_block_size_;
+        }
+      }
+    });
+    return;
+  }
+  // Looks up all keys first, then every directory reads its blocks with its own workers so that
+  // the queue of each device is kept full independently of the others.
+  row_ids_buffer_.resize(num_keys);
+  ParallelFor(num_keys, [&](Engine*, size_t start, size_t end) {
     for (uint64_t i = start; i < end; ++i) {
-      const Key key = static_cast<const Key*>(keys)[i];
-      auto it = row_id_mapping_.find(key);
-      if (it == row_id_mapping_.end()) {
-        offsets[i] = logical_block_size_;
+      uint64_t id = 0;
+      row_ids_buffer_[i] = FindRowId(static_cast<const Key*>(keys)[i], &id) ? id : kInvalidRowId;
+    }
+  });
+  for (auto& indices : dir_key_indices_) { indices.clear(); }
+  for (uint32_t i = 0; i < num_keys; ++i) {
+    const uint64_t id = row_ids_buffer_[i];
+    if (id == kInvalidRowId) {
+      offsets[i] = logical_block_size_;
+    } else {
+      dir_key_indices_.at(ValueDirIndex(id / num_values_per_chunk_)).push_back(i);
+    }
+  }
+  BlockingCounter bc(workers_.size());
+  std::unique_ptr<std::atomic<size_t>[]> counters(new std::atomic<size_t>[values_dirs_.size()]);
+  for (size_t dir = 0; dir < values_dirs_.size(); ++dir) {
+    counters[dir].store(0, std::memory_order_relaxed);
+    const std::vector<uint32_t>* indices = &dir_key_indices_.at(dir);
+    std::atomic<size_t>* counter = &counters[dir];
+    for (uint32_t tid = 0; tid < num_workers_per_dir_; ++tid) {
+      Worker<Engine>* worker = workers_.at(dir * num_workers_per_dir_ + tid).get();
+      worker->Schedule([&, indices, counter](Engine* engine) {
+        while (true) {
+          const size_t start = counter->fetch_add(kParallelForStride, std::memory_order_relaxed);
+          if (start >= indices->size()) { break; }
+          const size_t end = std::min(start + kParallelForStride, indices->size());
+          for (size_t j = start; j < end; ++j) {
+            const uint32_t i = indices->at(j);
+            ReadBlock(engine, row_ids_buffer_[i], BytesOffset(blocks, i * logical_block_size_),
+                      offsets + i);
+          }
+        }
+        engine->WaitUntilDone();
+        bc.Decrease();
+      });
+    }
+  }
+  bc.WaitForeverUntilCntEqualZero();
+}
+
+template<typename Key, typename Engine>
+void PersistentTableImpl<Key, Engine>::ReadBlock(Engine* engine, uint64_t id, void* block,
+                                                 uint32_t* offset) {
+  const uint64_t block_id = id / num_values_per_block_;
+  const uint32_t id_in_block = id - block_id * num_values_per_block_;
+  const uint64_t chunk_id = block_id / num_logical_blocks_per_chunk_;
+  const uint64_t block_in_chunk = block_id - chunk_id * num_logical_blocks_per_chunk_;
+  *offset = id_in_block * stored_value_size_;
+  if (mmap_values_) {
+    MemcpyOffset(block, 0, mapped_values_.at(chunk_id).ptr(), block_in_chunk * logical_block_size_,
+                 logical_block_size_);
+  } else {
+    engine->AsyncPread(value_files_.at(chunk_id).fd(), block, logical_block_size_,
+                       block_in_chunk * logical_block_size_);
+  }
+}
+
+template<typename Key, typename Engine>
+bool PersistentTableImpl<Key, Engine>::FindRowId(Key key, uint64_t* id) const {
+  if (sorted_keys_ != nullptr) {
+    const Key* end = sorted_keys_ + num_sorted_keys_;
+    const Key* it = std::lower_bound(sorted_keys_, end, key);
+    if (it == end || *it != key) { return false; }
+    *id = sorted_row_ids_[it - sorted_keys_];
+    return true;
+  } else {
+    auto it = row_id_mapping_.find(key);
+    if (it == row_id_mapping_.end()) { return false; }
+    *id = it->second;
+    return true;
+  }
+}
+
+template<typename Key, typename Engine>
+void PersistentTableImpl<Key, Engine>::GetMapped(uint32_t num_keys, const void* keys, void* values,
+                                                 uint32_t* n_missing, uint32_t* missing_indices) {
+  row_ids_buffer_.resize(num_keys);
+  auto GetRange = [&](size_t start, size_t end) {
+    for (size_t i = start; i < end; ++i) {
+      uint64_t id = 0;
+      if (!FindRowId(static_cast<const Key*>(keys)[i], &id)) {
+        row_ids_buffer_[i] = kInvalidRowId;
+        continue;
+      }
+      row_ids_buffer_[i] = id;
+      const uint64_t block_id = id / num_values_per_block_;
+      const uint32_t id_in_block = id - block_id * num_values_per_block_;
+      const uint64_t chunk_id = block_id / num_logical_blocks_per_chunk_;
+      const uint64_t block_in_chunk = block_id - chunk_id * num_logical_blocks_per_chunk_;
+      const void* stored = BytesOffset(
+          mapped_values_.at(chunk_id).ptr(),
+          block_in_chunk * logical_block_size_ + id_in_block * stored_value_size_);
+      if (codec_.IsRaw()) {
+        MemcpyOffset(values, i * value_size_, stored, 0, value_size_);
       } else {
-        const uint64_t id = it->second;
-        const uint64_t block_id = id / num_values_per_block_;
-        const uint32_t id_in_block = id - block_id * num_values_per_block_;
-        const uint32_t offset_in_block = id_in_block * value_size_;
-        const uint64_t chunk_id = block_id / num_logical_blocks_per_chunk_;
-        const uint64_t block_in_chunk = block_id - chunk_id * num_logical_blocks_per_chunk_;
-        const uint64_t block_offset = block_in_chunk * logical_block_size_;
-        PosixFile& file = value_files_.at(chunk_id);
-        offsets[i] = offset_in_block;
-        engine->AsyncPread(file.fd(), BytesOffset(blocks, i * logical_block_size_),
-                           logical_block_size_, block_offset);
+        codec_.Decode(stored, BytesOffset(values, i * value_size_));
       }
     }
-  });
+  };
+  // Small batches are copied inline, handing them to the workers would cost more than the copy.
+  if (num_keys <= kParallelForStride) {
+    GetRange(0, num_keys);
+  } else {
+    ParallelFor(num_keys, [&](Engine*, size_t start, size_t end) { GetRange(start, end); });
+  }
+  uint32_t missing_count = 0;
+  for (uint32_t i = 0; i < num_keys; ++i) {
+    if (row_ids_buffer_[i] == kInvalidRowId) {
+      missing_indices[missing_count] = i;
+      missing_count += 1;
+    }
+  }
+  *n_missing = missing_count;
 }
 
 template<typename Key, typename Engine>
 void PersistentTableImpl<Key, Engine>::Get(uint32_t num_keys, const void* keys, void* values,
                                            uint32_t* n_missing, uint32_t* missing_indices) {
   std::lock_guard<std::recursive_mutex> lock(mutex_);
+  if (mmap_values_) {
+    GetMapped(num_keys, keys, values, n_missing, missing_indices);
+    return;
+  }
   offsets_buffer_.resize(num_keys);
   void* blocks_ptr = nullptr;
-  if (value_size_ == logical_block_size_
+  if (codec_.IsRaw() && value_size_ == logical_block_size_
       && reinterpret_cast<uintptr_t>(values) % physical_block_size_ == 0) {
     blocks_ptr = values;
   } else {
@@ -517,11 +855,12 @@ void PersistentTableImpl<Key, Engine>::Get(uint32_t num_keys, const void* keys,
     if (offsets_buffer_.at(i) == logical_block_size_) {
       missing_indices[missing_count] = i;
       missing_count += 1;
-    } else {
-      if (value_size_ != logical_block_size_) {
-        MemcpyOffset(values, i * value_size_, blocks_ptr,
-                     (i * logical_block_size_) + offsets_buffer_[i], value_size_);
-      }
+    } else if (!codec_.IsRaw()) {
+      codec_.Decode(BytesOffset(blocks_ptr, (i * logical_block_size_) + offsets_buffer_[i]),
+                    BytesOffset(values, i * value_size_));
+    } else if (value_size_ != logical_block_size_) {
+      MemcpyOffset(values, i * value_size_, blocks_ptr,
+                   (i * logical_block_size_) + offsets_buffer_[i], value_size_);
     }
   }
   *n_missing = missing_count;
@@ -538,60 +877,110 @@ void PersistentTableImpl<Key, Engine>::PutBlocks(uint32_t num_keys, const void*
   physical_table_size_ += num_padded_keys;
   CHECK_EQ(start_index % num_values_per_block_, 0);
   const uint64_t start_block_id = start_index / num_values_per_block_;
-  uint64_t written_blocks = 0;
   const uint64_t block_keys_size = num_values_per_block_ * sizeof(Key);
-  BlockingCounter bc(1);
-  workers_.at(0)->Schedule([&](Engine*) {
-    while (written_blocks < num_blocks) {
-      const uint64_t batch_start_block_id = start_block_id + written_blocks;
-      const uint64_t batch_chunk_id = batch_start_block_id / num_logical_blocks_per_chunk_;
-      if (batch_chunk_id == value_files_.size()) {
-        value_files_.emplace_back(ValueFilePath(batch_chunk_id), O_CREAT | O_RDWR | O_DIRECT, 0644);
-      } else {
-        CHECK_LE(batch_chunk_id, value_files_.size());
-      }
-      if ((!writable_key_file_.IsOpen()) || writable_key_file_chunk_id_ != batch_chunk_id) {
-        writable_key_file_ = PosixFile(KeyFilePath(batch_chunk_id), O_CREAT | O_RDWR, 0644);
-      }
-      PosixFile& value_file = value_files_.at(batch_chunk_id);
-      const uint64_t block_id_in_chunk =
-          batch_start_block_id - batch_chunk_id * num_logical_blocks_per_chunk_;
-      const uint64_t blocks_to_write =
-          std::min(num_blocks - written_blocks,
-                   (batch_chunk_id + 1) * num_logical_blocks_per_chunk_ - batch_start_block_id);
-      const uint64_t values_bytes = blocks_to_write * logical_block_size_;
-      const uint64_t values_offset_in_file = block_id_in_chunk * logical_block_size_;
-      CHECK_LE(value_file.Size(), values_offset_in_file);
-      value_file.Truncate(values_offset_in_file + values_bytes);
-      PCHECK(pwrite(value_file.fd(), BytesOffset(blocks, written_blocks * logical_block_size_),
-                    values_bytes, values_offset_in_file)
-             == values_bytes);
-      const uint64_t keys_offset_in_file = block_id_in_chunk * block_keys_size;
-      writable_key_file_.Truncate(keys_offset_in_file + blocks_to_write * block_keys_size);
-      const uint64_t keys_bytes = std::min(num_keys - written_blocks * num_values_per_block_,
-                                           blocks_to_write * num_values_per_block_)
-                                  * sizeof(Key);
-      PCHECK(pwrite(writable_key_file_.fd(), BytesOffset(keys, written_blocks * block_keys_size),
-                    keys_bytes, keys_offset_in_file)
-             == keys_bytes);
-      written_blocks += blocks_to_write;
-    }
-    bc.Decrease();
-  });
+  // The blocks of a chunk, written by a worker of the values directory of the chunk
+  struct ChunkBlocks {
+    uint64_t chunk_id;
+    uint64_t block_id_in_chunk;
+    // index of the first block in `blocks`
+    uint64_t first_block;
+    uint64_t num_blocks;
+  };
+  std::vector<ChunkBlocks> chunk_blocks;
+  for (uint64_t written_blocks = 0; written_blocks < num_blocks;) {
+    const uint64_t batch_start_block_id = start_block_id + written_blocks;
+    const uint64_t batch_chunk_id = batch_start_block_id / num_logical_blocks_per_chunk_;
+    if (batch_chunk_id == value_files_.size()) {
+      value_files_.emplace_back(ValueFilePath(batch_chunk_id), O_CREAT | O_RDWR | O_DIRECT, 0644);
+    } else {
+      CHECK_LE(batch_chunk_id, value_files_.size());
+    }
+    const uint64_t blocks_to_write =
+        std::min(num_blocks - written_blocks,
+                 (batch_chunk_id + 1) * num_logical_blocks_per_chunk_ - batch_start_block_id);
+    chunk_blocks.push_back(ChunkBlocks{
+        batch_chunk_id, batch_start_block_id - batch_chunk_id * num_logical_blocks_per_chunk_,
+        written_blocks, blocks_to_write});
+    written_blocks += blocks_to_write;
+  }
+  BlockingCounter bc(chunk_blocks.size());
+  for (size_t i = 0; i < chunk_blocks.size(); ++i) {
+    const ChunkBlocks& chunk = chunk_blocks.at(i);
+    // consecutive chunks are in different directories, spread them over the workers of each
+    const size_t tid = i / values_dirs_.size() % num_workers_per_dir_;
+    workers_.at(ValueDirIndex(chunk.chunk_id) * num_workers_per_dir_ + tid)
+        ->Schedule([&, chunk](Engine*) {
+          PosixFile& value_file = value_files_.at(chunk.chunk_id);
+          const uint64_t values_bytes = chunk.num_blocks * logical_block_size_;
+          const uint64_t values_offset_in_file = chunk.block_id_in_chunk * logical_block_size_;
+          CHECK_LE(value_file.Size(), values_offset_in_file);
+          value_file.Truncate(values_offset_in_file + values_bytes);
+          PCHECK(pwrite(value_file.fd(),
+                        BytesOffset(blocks, chunk.first_block * logical_block_size_),
+                        values_bytes, values_offset_in_file)
+                 == values_bytes);
+          bc.Decrease();
+        });
+  }
+  // The keys are written on this thread while the workers write the values
+  for (const ChunkBlocks& chunk : chunk_blocks) {
+    if ((!writable_key_file_.IsOpen()) || writable_key_file_chunk_id_ != chunk.chunk_id) {
+      writable_key_file_ = PosixFile(KeyFilePath(chunk.chunk_id), O_CREAT | O_RDWR, 0644);
+    }
+    const uint64_t keys_offset_in_file = chunk.block_id_in_chunk * block_keys_size;
+    writable_key_file_.Truncate(keys_offset_in_file + chunk.num_blocks * block_keys_size);
+    const uint64_t keys_bytes = std::min(num_keys - chunk.first_block * num_values_per_block_,
+                                         chunk.num_blocks * num_values_per_block_)
+                                * sizeof(Key);
+    PCHECK(pwrite(writable_key_file_.fd(), BytesOffset(keys, chunk.first_block * block_keys_size),
+                  keys_bytes, keys_offset_in_file)
+           == keys_bytes);
+  }
   for (uint64_t i = 0; i < num_keys; ++i) {
     row_id_mapping_[static_cast<const Key*>(keys)[i]] = start_index + i;
   }
+  if (track_row_stats_) {
+    const uint32_t now = clock_();
+    for (uint64_t i = 0; i < num_keys; ++i) {
+      RowStats& stats = row_stats_[static_cast<const Key*>(keys)[i]];
+      stats.update_time = now;
+      if (stats.update_count != std::numeric_limits<uint32_t>::max()) { stats.update_count += 1; }
+    }
+  }
   bc.WaitForeverUntilCntEqualZero();
 }
 
+template<typename Key, typename Engine>
+void PersistentTableImpl<Key, Engine>::Delete(uint32_t num_keys, const void* keys) {
+  CHECK(!read_only_);
+  std::lock_guard<std::recursive_mutex> lock(mutex_);
+  for (uint32_t i = 0; i < num_keys; ++i) {
+    const Key key = static_cast<const Key*>(keys)[i];
+    row_id_mapping_.erase(key);
+    if (track_row_stats_) { row_stats_.erase(key); }
+  }
+}
+
 template<typename Key, typename Engine>
 void PersistentTableImpl<Key, Engine>::Put(uint32_t num_keys, const void* keys,
                                            const void* values) {
   CHECK(!read_only_);
   std::lock_guard<std::recursive_mutex> lock(mutex_);
   const void* blocks_ptr = nullptr;
-  if (value_size_ == logical_block_size_
-      && reinterpret_cast<uintptr_t>(values) % physical_block_size_ == 0) {
+  if (!codec_.IsRaw()) {
+    const uint32_t num_blocks = RoundUp(num_keys, num_values_per_block_) / num_values_per_block_;
+    blocks_buffer_.Resize(num_blocks * logical_block_size_);
+    for (uint32_t i = 0; i < num_keys; ++i) {
+      const uint32_t block_id = i / num_values_per_block_;
+      const uint32_t id_in_block = i - block_id * num_values_per_block_;
+      const uint64_t stored_offset =
+          static_cast<uint64_t>(block_id) * logical_block_size_ + id_in_block * stored_value_size_;
+      codec_.Encode(BytesOffset(values, i * value_size_),
+                    BytesOffset(blocks_buffer_.ptr(), stored_offset));
+    }
+    blocks_ptr = blocks_buffer_.ptr();
+  } else if (value_size_ == logical_block_size_
+             && reinterpret_cast<uintptr_t>(values) % physical_block_size_ == 0) {
     blocks_ptr = values;
   } else {
     const uint32_t num_blocks = RoundUp(num_keys, num_values_per_block_);
@@ -616,7 +1005,8 @@ std::string PersistentTableImpl<Key, Engine>::KeyFilePath(uint64_t chunk_id) con
 
 template<typename Key, typename Engine>
 std::string PersistentTableImpl<Key, Engine>::ValueFilePath(uint64_t chunk_id) const {
-  return PosixFile::JoinPath(values_dir_, kValueFileNamePrefix + GetChunkName(chunk_id));
+  return PosixFile::JoinPath(values_dirs_.at(ValueDirIndex(chunk_id)),
+                             kValueFileNamePrefix + GetChunkName(chunk_id));
 }
 
 template<typename Key, typename Engine>
@@ -625,6 +1015,12 @@ std::string PersistentTableImpl<Key, Engine>::IndexFilePath(const std::string& n
   return PosixFile::JoinPath(SnapshotDirPath(name), kIndexFileNamePrefix + GetChunkName(chunk_id));
 }
 
+template<typename Key, typename Engine>
+std::string PersistentTableImpl<Key, Engine>::StatsFilePath(const std::string& name,
+                                                            uint64_t chunk_id) const {
+  return PosixFile::JoinPath(SnapshotDirPath(name), kStatsFileNamePrefix + GetChunkName(chunk_id));
+}
+
 template<typename Key, typename Engine>
 std::string PersistentTableImpl<Key, Engine>::SnapshotDirPath(const std::string& name) const {
   return PosixFile::JoinPath(snapshots_dir_, name);
@@ -641,6 +1037,8 @@ void PersistentTableImpl<Key, Engine>::LoadSnapshotImpl(const std::string& name)
   const std::string snapshot_base = SnapshotDirPath(name);
   const std::string snapshot_list = SnapshotListFilePath(name);
   row_id_mapping_.clear();
+  row_stats_.clear();
+  if (LoadSortedIndex(name)) { return; }
   std::ifstream list_if(snapshot_list);
   std::string index_filename;
   while (std::getline(list_if, index_filename)) {
@@ -660,6 +1058,7 @@ void PersistentTableImpl<Key, Engine>::LoadSnapshotImpl(const std::string& name)
     for (size_t i = 0; i < n_entries; ++i) {
       CHECK(row_id_mapping_.emplace(keys[indices[i] - chunk_start_index], indices[i]).second);
     }
+    if (track_row_stats_) { LoadRowStats(name, chunk_id, n_entries, keys, indices); }
   }
 }
 
@@ -671,8 +1070,10 @@ void PersistentTableImpl<Key, Engine>::SaveSnapshotImpl(const std::string& name)
   std::ofstream list_ofs(SnapshotListFilePath(name));
   if (row_id_mapping_.empty()) { return; }
   std::vector<PosixMappedFile> index_files(value_files_.size());
+  std::vector<PosixMappedFile> stats_files(track_row_stats_ ? value_files_.size() : 0);
   std::vector<uint64_t> counters(value_files_.size());
   const uint64_t max_index_file_size = num_values_per_chunk_ * sizeof(uint64_t);
+  const uint64_t max_stats_file_size = num_values_per_chunk_ * sizeof(RowStats);
   for (const auto& pair : row_id_mapping_) {
     const uint64_t chunk_id = pair.second / num_values_per_chunk_;
     CHECK(chunk_id < value_files_.size());
@@ -681,17 +1082,29 @@ void PersistentTableImpl<Key, Engine>::SaveSnapshotImpl(const std::string& name)
       snapshot_file.Truncate(max_index_file_size);
       index_files[chunk_id] =
           PosixMappedFile(std::move(snapshot_file), max_index_file_size, PROT_READ | PROT_WRITE);
+      if (track_row_stats_) {
+        PosixFile stats_file(StatsFilePath(name, chunk_id), O_CREAT | O_RDWR, 0644);
+        stats_file.Truncate(max_stats_file_size);
+        stats_files[chunk_id] =
+            PosixMappedFile(std::move(stats_file), max_stats_file_size, PROT_READ | PROT_WRITE);
+      }
     }
     uint64_t* indices = static_cast<uint64_t*>(index_files[chunk_id].ptr());
     uint64_t& count = counters[chunk_id];
     CHECK_LT(count, num_values_per_chunk_);
     indices[count] = pair.second;
+    if (track_row_stats_) {
+      RowStats* stats = static_cast<RowStats*>(stats_files[chunk_id].ptr());
+      auto it = row_stats_.find(pair.first);
+      stats[count] = it == row_stats_.end() ? RowStats{clock_(), 0} : it->second;
+    }
     count += 1;
   }
   for (size_t i = 0; i < value_files_.size(); ++i) {
     const uint64_t count = counters[i];
     if (count > 0) {
       index_files[i].file().Truncate(count * sizeof(uint64_t));
+      if (track_row_stats_) { stats_files[i].file().Truncate(count * sizeof(RowStats)); }
       list_ofs << kIndexFileNamePrefix + GetChunkName(i) << std::endl;
     } else {
       CHECK(index_files[i].ptr() == nullptr);
@@ -699,6 +1112,128 @@ void PersistentTableImpl<Key, Engine>::SaveSnapshotImpl(const std::string& name)
   }
 }
 
+template<typename Key, typename Engine>
+void PersistentTableImpl<Key, Engine>::LoadRowStats(const std::string& name, uint64_t chunk_id,
+                                                    size_t n_entries, const Key* keys,
+                                                    const uint64_t* indices) {
+  const uint64_t chunk_start_index = chunk_id * num_values_per_chunk_;
+  row_stats_.reserve(row_stats_.size() + n_entries);
+  const std::string stats_filename = StatsFilePath(name, chunk_id);
+  if (PosixFile::FileExists(stats_filename)) {
+    PosixFile stats_file(stats_filename, O_RDONLY, 0644);
+    CHECK_EQ(stats_file.Size(), n_entries * sizeof(RowStats));
+    PosixMappedFile mapped_stats(std::move(stats_file), n_entries * sizeof(RowStats), PROT_READ);
+    const RowStats* stats = static_cast<const RowStats*>(mapped_stats.ptr());
+    for (size_t i = 0; i < n_entries; ++i) {
+      row_stats_[keys[indices[i] - chunk_start_index]] = stats[i];
+    }
+  } else {
+    // Snapshots saved without eviction enabled start the clock at load time.
+    const RowStats stats{clock_(), 0};
+    for (size_t i = 0; i < n_entries; ++i) {
+      row_stats_[keys[indices[i] - chunk_start_index]] = stats;
+    }
+  }
+}
+
+template<typename Key, typename Engine>
+void PersistentTableImpl<Key, Engine>::EvictRows() {
+  const uint32_t now = clock_();
+  uint64_t num_expired = 0;
+  uint64_t num_infrequent = 0;
+  for (auto it = row_stats_.begin(); it != row_stats_.end();) {
+    RowStats& stats = it->second;
+    const bool expired = expiry_ttl_seconds_ > 0
+                         && static_cast<uint64_t>(stats.update_time) + expiry_ttl_seconds_ < now;
+    const bool infrequent = eviction_min_count_ > 0 && stats.update_time < last_eviction_time_
+                            && stats.update_count < eviction_min_count_;
+    if (expired || infrequent) {
+      num_expired += expired ? 1 : 0;
+      num_infrequent += expired ? 0 : 1;
+      row_id_mapping_.erase(it->first);
+      it = row_stats_.erase(it);
+    } else {
+      stats.update_count /= 2;
+      ++it;
+    }
+  }
+  last_eviction_time_ = now;
+  if (num_expired > 0 || num_infrequent > 0) {
+    LOG(INFO) << "Persistent table " << root_dir_ << " evicted " << num_expired
+              << " expired rows and " << num_infrequent << " infrequent rows, "
+              << row_id_mapping_.size() << " rows left";
+  }
+}
+
+template<typename Key, typename Engine>
+void PersistentTableImpl<Key, Engine>::ReleaseUnreferencedChunks() {
+  if (value_files_.empty()) { return; }
+  std::vector<bool> referenced(value_files_.size());
+  for (const auto& pair : row_id_mapping_) {
+    referenced.at(pair.second / num_values_per_chunk_) = true;
+  }
+  DIR* dir = opendir(snapshots_dir_.c_str());
+  PCHECK(dir != nullptr);
+  struct dirent* ent = nullptr;
+  while ((ent = readdir(dir)) != nullptr) {
+    if (strcmp(ent->d_name, ".") == 0 || strcmp(ent->d_name, "..") == 0) { continue; }
+    std::ifstream list_if(SnapshotListFilePath(ent->d_name));
+    std::string index_filename;
+    while (std::getline(list_if, index_filename)) {
+      const uint64_t chunk_id = GetChunkId(index_filename, kIndexFileNamePrefix);
+      if (chunk_id < referenced.size()) { referenced.at(chunk_id) = true; }
+    }
+  }
+  PCHECK(closedir(dir) == 0);
+  // The last chunk is still being appended to.
+  referenced.back() = true;
+  for (size_t i = 0; i < value_files_.size(); ++i) {
+    if (referenced.at(i) || !value_files_.at(i).IsOpen()) { continue; }
+    value_files_.at(i).Close();
+    PosixFile::RecursiveDelete(ValueFilePath(i));
+    PosixFile::RecursiveDelete(KeyFilePath(i));
+  }
+}
+
+template<typename Key, typename Engine>
+bool PersistentTableImpl<Key, Engine>::LoadSortedIndex(const std::string& name) {
+  sorted_index_ = PosixMappedFile();
+  sorted_keys_ = nullptr;
+  sorted_row_ids_ = nullptr;
+  num_sorted_keys_ = 0;
+  const std::string sorted_index_filename =
+      PosixFile::JoinPath(SnapshotDirPath(name), kSortedIndexFileName);
+  if (!mmap_values_ || !PosixFile::FileExists(sorted_index_filename)) { return false; }
+  PosixFile sorted_index_file(sorted_index_filename, O_RDONLY, 0644);
+  const size_t size = sorted_index_file.Size();
+  CHECK_EQ(size % (sizeof(Key) + sizeof(uint64_t)), 0);
+  if (size == 0) { return true; }
+  num_sorted_keys_ = size / (sizeof(Key) + sizeof(uint64_t));
+  sorted_index_ = PosixMappedFile(std::move(sorted_index_file), size, PROT_READ);
+  sorted_row_ids_ = static_cast<const uint64_t*>(sorted_index_.ptr());
+  sorted_keys_ = BytesOffset(static_cast<const Key*>(sorted_index_.ptr()),
+                             num_sorted_keys_ * sizeof(uint64_t));
+  return true;
+}
+
+template<typename Key, typename Engine>
+void PersistentTableImpl<Key, Engine>::SaveSortedIndex(const std::string& name) {
+  // [row ids][keys], sorted by key, the row ids go first to keep both arrays aligned.
+  std::vector<std::pair<Key, uint64_t>> pairs(row_id_mapping_.begin(), row_id_mapping_.end());
+  std::sort(pairs.begin(), pairs.end());
+  std::vector<uint64_t> row_ids(pairs.size());
+  std::vector<Key> keys(pairs.size());
+  for (size_t i = 0; i < pairs.size(); ++i) {
+    keys[i] = pairs[i].first;
+    row_ids[i] = pairs[i].second;
+  }
+  std::ofstream ofs(PosixFile::JoinPath(SnapshotDirPath(name), kSortedIndexFileName),
+                    std::ios::binary | std::ios::trunc);
+  ofs.write(reinterpret_cast<const char*>(row_ids.data()), row_ids.size() * sizeof(uint64_t));
+  ofs.write(reinterpret_cast<const char*>(keys.data()), keys.size() * sizeof(Key));
+  CHECK(ofs.good());
+}
+
 template<typename Key, typename Engine>
 bool PersistentTableImpl<Key, Engine>::SnapshotExists(const std::string& name) {
   std::lock_guard<std::recursive_mutex> lock(mutex_);
@@ -722,6 +1257,8 @@ void PersistentTableImpl<Key, Engine>::LoadSnapshot(
   const std::string snapshot_base = SnapshotDirPath(name);
   const std::string snapshot_list = SnapshotListFilePath(name);
   row_id_mapping_.clear();
+  row_stats_.clear();
+  const bool sorted_index_loaded = LoadSortedIndex(name);
   std::ifstream list_if(snapshot_list);
   std::string index_filename;
   while (std::getline(list_if, index_filename)) {
@@ -737,14 +1274,17 @@ void PersistentTableImpl<Key, Engine>::LoadSnapshot(
     const uint64_t* indices = static_cast<const uint64_t*>(mapped_index.ptr());
     const Key* keys = static_cast<const Key*>(mapped_key.ptr());
     const uint64_t chunk_start_index = chunk_id * num_values_per_chunk_;
-    row_id_mapping_.reserve(row_id_mapping_.size() + n_entries);
-    for (size_t i = 0; i < n_entries; ++i) {
-      CHECK(row_id_mapping_.emplace(keys[indices[i] - chunk_start_index], indices[i]).second);
+    if (!sorted_index_loaded) {
+      row_id_mapping_.reserve(row_id_mapping_.size() + n_entries);
+      for (size_t i = 0; i < n_entries; ++i) {
+        CHECK(row_id_mapping_.emplace(keys[indices[i] - chunk_start_index], indices[i]).second);
+      }
+      if (track_row_stats_) { LoadRowStats(name, chunk_id, n_entries, keys, indices); }
     }
     if (Hook) {
       PosixFile value_file(ValueFilePath(chunk_id), O_RDONLY, 0644);
       PosixMappedFile mapped_value(std::move(value_file), value_file.Size(), PROT_READ, mmap_flags);
-      ChunkIteratorImpl<Key> chunk_iterator(value_size_, logical_block_size_, num_values_per_block_,
+      ChunkIteratorImpl<Key> chunk_iterator(&codec_, logical_block_size_, num_values_per_block_,
                                             num_values_per_chunk_, chunk_id, n_entries, keys,
                                             indices, mapped_value.ptr());
       Hook(&chunk_iterator);
@@ -754,12 +1294,25 @@ void PersistentTableImpl<Key, Engine>::LoadSnapshot(
 
 template<typename Key, typename Engine>
 void PersistentTableImpl<Key, Engine>::SaveSnapshot(const std::string& name) {
+  std::lock_guard<std::recursive_mutex> lock(mutex_);
+  if (track_row_stats_) { EvictRows(); }
   SaveSnapshotImpl(name);
+  if (save_sorted_index_) {
+    SaveSortedIndex(name);
+  } else {
+    // Never leave a stale index of an overwritten snapshot behind.
+    const std::string sorted_index_filename =
+        PosixFile::JoinPath(SnapshotDirPath(name), kSortedIndexFileName);
+    if (PosixFile::FileExists(sorted_index_filename)) {
+      PosixFile::RecursiveDelete(sorted_index_filename);
+    }
+  }
+  ReleaseUnreferencedChunks();
 }
 
 template<typename Key, typename Engine>
 PersistentTable::Iterator* PersistentTableImpl<Key, Engine>::ReadSnapshot(const std::string& name) {
-  return new SnapshotIteratorImpl<Key, Engine>(this, name, value_size_, logical_block_size_,
+  return new SnapshotIteratorImpl<Key, Engine>(this, name, logical_block_size_,
                                                num_values_per_block_, num_values_per_chunk_);
 }
 
@@ -789,11 +1342,10 @@ class SnapshotIteratorImpl : public PersistentTable::Iterator {
  public:
   OF_DISALLOW_COPY_AND_MOVE(SnapshotIteratorImpl);
   SnapshotIteratorImpl(PersistentTableImpl<Key, Engine>* table, const std::string& snapshot_name,
-                       uint32_t value_size, uint32_t logical_block_size,
-                       uint32_t num_values_per_block, uint64_t num_values_per_chunk)
+                       uint32_t logical_block_size, uint32_t num_values_per_block,
+                       uint64_t num_values_per_chunk)
       : table_(table),
         snapshot_name_(snapshot_name),
-        value_size_(value_size),
         logical_block_size_(logical_block_size),
         num_values_per_block_(num_values_per_block),
         num_values_per_chunk_(num_values_per_chunk),
@@ -827,7 +1379,7 @@ class SnapshotIteratorImpl : public PersistentTable::Iterator {
         values_file_.reset(
             new PosixMappedFile(std::move(value_file), value_file.Size(), PROT_READ));
         chunk_iterator_.reset(new ChunkIteratorImpl<Key>(
-            value_size_, logical_block_size_, num_values_per_block_, num_values_per_chunk_,
+            &table_->codec_, logical_block_size_, num_values_per_block_, num_values_per_chunk_,
             chunk_id, n_entries, static_cast<const Key*>(keys_file_->ptr()),
             static_cast<const uint64_t*>(indices_file_->ptr()), values_file_->ptr()));
       }
@@ -850,7 +1402,6 @@ class SnapshotIteratorImpl : public PersistentTable::Iterator {
  private:
   PersistentTableImpl<Key, Engine>* table_;
   std::string snapshot_name_;
-  uint32_t value_size_;
   uint32_t logical_block_size_;
   uint32_t num_values_per_block_;
   uint64_t num_values_per_chunk_;
@@ -17,19 +17,50 @@ limitations under the License.
 #define ONEFLOW_CORE_EMBEDDING_PERSISTENT_TABLE_H_
 
 #include "oneflow/core/common/util.h"
+#include <functional>
 
 namespace oneflow {
 
 namespace embedding {
 
 struct PersistentTableOptions {
+  enum class StorageFormat {
+    kRaw,
+    kFloat16,
+    kBFloat16,
+    // int8 with a float scale per row.
+    kInt8,
+  };
   std::string path;
+  // Directories the value chunks are striped across round-robin by chunk id, each one should be on
+  // a different device. Empty means a single values directory under path.
+  std::vector<std::string> value_paths;
   uint32_t key_size = 0;
   uint32_t value_size = 0;
   uint64_t target_chunk_size_mb = 4 * 1024;
   uint16_t physical_block_size = 4096;
   uint64_t capacity_hint = 0;
   bool read_only = false;
+  // Serving mode, requires read_only. Value chunks are mapped to memory and read through the page
+  // cache, which is shared by all processes serving the same table, and LoadSnapshot maps the
+  // sorted index of the snapshot if there is one instead of building the key to row hash map.
+  bool mmap_values = false;
+  // Prefaults the value chunks when mapping them.
+  bool mmap_populate = false;
+  // SaveSnapshot additionally writes the snapshot keys sorted with their rows for serving mode.
+  bool save_sorted_index = false;
+  // Unless kRaw, values are rows of floats of which the leading reduced_precision_dim elements
+  // (the embedding) are stored in storage_format and the rest (the optimizer states) as is, 0 means
+  // the whole row.
+  StorageFormat storage_format = StorageFormat::kRaw;
+  uint32_t reduced_precision_dim = 0;
+  // When saving a snapshot, rows not put for expiry_ttl_seconds are deleted, and so are rows not
+  // put since the previous snapshot whose put count, halved at every snapshot, is below
+  // eviction_min_count. 0 disables the rule.
+  uint64_t expiry_ttl_seconds = 0;
+  uint32_t eviction_min_count = 0;
+  // Current time in seconds for the row stats, std::time when empty.
+  std::function<uint32_t()> clock;
 };
 
 class PersistentTable {
@@ -51,11 +82,13 @@ class PersistentTable {
   virtual uint32_t KeySize() const = 0;
   virtual uint32_t ValueSize() const = 0;
   virtual uint32_t LogicalBlockSize() const = 0;
+  // GetBlocks and PutBlocks operate on values in the storage format.
   virtual void GetBlocks(uint32_t num_keys, const void* keys, void* blocks, uint32_t* offsets) = 0;
   virtual void Get(uint32_t num_keys, const void* keys, void* values, uint32_t* n_missing,
                    uint32_t* missing_indices) = 0;
   virtual void PutBlocks(uint32_t num_keys, const void* keys, const void* blocks) = 0;
   virtual void Put(uint32_t num_keys, const void* keys, const void* values) = 0;
+  virtual void Delete(uint32_t num_keys, const void* keys) = 0;
   virtual bool SnapshotExists(const std::string& name) = 0;
   virtual void LoadSnapshot(const std::string& name) = 0;
   virtual void LoadSnapshot(const std::string& name,
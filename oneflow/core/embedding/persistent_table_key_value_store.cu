@@ -77,7 +77,10 @@ class KeyValueStoreImpl : public KeyValueStore {
  public:
   OF_DISALLOW_COPY_AND_MOVE(KeyValueStoreImpl);
   explicit KeyValueStoreImpl(const PersistentTableKeyValueStoreOptions& options)
-      : device_index_(-1), max_query_length_(0) {
+      : device_index_(-1),
+        max_query_length_(0),
+        read_only_(options.table_options.read_only),
+        serving_(options.table_options.mmap_values) {
     OF_CUDA_CHECK(cudaGetDevice(&device_index_));
     key_size_ = options.table_options.key_size;
     value_size_ = options.table_options.value_size;
@@ -131,6 +134,7 @@ class KeyValueStoreImpl : public KeyValueStore {
   void Get(ep::Stream* stream, uint32_t num_keys, const void* keys, void* values,
            uint32_t* n_missing, uint32_t* missing_indices) override;
   void Put(ep::Stream* stream, uint32_t num_keys, const void* keys, const void* values) override;
+  void Delete(ep::Stream* stream, uint32_t num_keys, const void* keys) override;
   bool SnapshotExists(const std::string& name) override;
   void LoadSnapshot(const std::string& name) override;
   void LoadSnapshot(const std::string& name,
@@ -142,6 +146,8 @@ class KeyValueStoreImpl : public KeyValueStore {
   uint32_t max_query_length_;
   uint32_t key_size_;
   uint32_t value_size_;
+  bool read_only_;
+  bool serving_;
   Key* host_query_keys_{};
   uint8_t* host_query_values_{};
   uint32_t* host_n_missing_{};
@@ -181,6 +187,10 @@ void KeyValueStoreImpl<Key>::Get(ep::Stream* stream, uint32_t num_keys, const vo
 template<typename Key>
 void KeyValueStoreImpl<Key>::Put(ep::Stream* stream, uint32_t num_keys, const void* keys,
                                  const void* values) {
+  // A table in serving mode is frozen and only serves lookups, the rows written back by the caches
+  // in front of it are the ones they read from it and are dropped.
+  if (serving_) { return; }
+  CHECK(!read_only_) << "Cannot put into a read only persistent table";
   std::lock_guard<std::mutex> lock(mutex_);
   auto cuda_stream = stream->As<ep::CudaStream>();
   CHECK_LE(num_keys, max_query_length_);
@@ -193,6 +203,18 @@ void KeyValueStoreImpl<Key>::Put(ep::Stream* stream, uint32_t num_keys, const vo
   table_->Put(num_keys, host_query_keys_, host_query_values_);
 }
 
+template<typename Key>
+void KeyValueStoreImpl<Key>::Delete(ep::Stream* stream, uint32_t num_keys, const void* keys) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto cuda_stream = stream->As<ep::CudaStream>();
+  CHECK_LE(num_keys, max_query_length_);
+  if (num_keys == 0) { return; }
+  OF_CUDA_CHECK(cudaMemcpyAsync(host_query_keys_, keys, key_size_ * num_keys, cudaMemcpyDefault,
+                                cuda_stream->cuda_stream()));
+  CHECK_JUST(cuda_stream->Sync());
+  table_->Delete(num_keys, host_query_keys_);
+}
+
 template<typename Key>
 bool KeyValueStoreImpl<Key>::SnapshotExists(const std::string& name) {
   return table_->SnapshotExists(name);
@@ -0,0 +1,231 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#ifndef ONEFLOW_CORE_EMBEDDING_SET_ASSOCIATIVE_CACHE_CUH_
+#define ONEFLOW_CORE_EMBEDDING_SET_ASSOCIATIVE_CACHE_CUH_
+
+// Warp cooperative building blocks shared by the set associative caches, every set has kWarpSize
+// ways and is processed by one warp holding the mutex of the set.
+
+#include "oneflow/core/embedding/cache.h"
+#include "oneflow/core/device/cuda_util.h"
+#include "oneflow/core/ep/cuda/cuda_stream.h"
+#include <new>
+#include <cuda.h>
+
+#if CUDA_VERSION >= 11000 && ((!defined(__CUDA_ARCH__)) || (__CUDA_ARCH__ >= 700)) \
+    && !(defined(__clang__) && defined(__CUDA__))
+#include <cuda/std/semaphore>
+#endif
+
+namespace oneflow {
+
+namespace embedding {
+
+namespace {
+
+constexpr int kWarpSize = 32;
+constexpr int kNumWarpPerBlock = 4;
+constexpr int kBlockSize = kNumWarpPerBlock * kWarpSize;
+constexpr uint32_t kFullMask = 0xFFFFFFFFU;
+
+// Indices of the CacheStats counters in the device stats buffer.
+constexpr int kStatQueries = 0;
+constexpr int kStatHits = 1;
+constexpr int kStatEvictions = 2;
+constexpr int kStatRejectedAdmissions = 3;
+constexpr int kNumStats = 4;
+
+ep::CudaLaunchConfig GetLaunchConfig(uint32_t n_keys) {
+  return ep::CudaLaunchConfig((n_keys + kNumWarpPerBlock - 1) / kNumWarpPerBlock,
+                              kWarpSize * kNumWarpPerBlock, 0);
+}
+
+struct ThreadContext {
+  __device__ ThreadContext() {
+    const uint32_t global_thread_id = blockIdx.x * blockDim.x + threadIdx.x;
+    global_warp_id = global_thread_id / kWarpSize;
+    warp_id_in_block = global_warp_id % kNumWarpPerBlock;  // NOLINT
+    num_warps = gridDim.x * kNumWarpPerBlock;              // NOLINT
+    lane_id = global_thread_id % kWarpSize;
+  }
+
+  uint32_t global_warp_id;
+  uint32_t warp_id_in_block;
+  uint32_t num_warps;
+  uint32_t lane_id;
+};
+
+class WarpMutexAtomicImpl {
+ public:
+  OF_DISALLOW_COPY_AND_MOVE(WarpMutexAtomicImpl);
+  __device__ WarpMutexAtomicImpl() : flag_(0) {}
+  __device__ ~WarpMutexAtomicImpl() = default;
+
+  __device__ void Lock(const ThreadContext& thread_ctx) {
+    if (thread_ctx.lane_id == 0) {
+      while (atomicCAS(&flag_, 0, 1) != 0)
+        ;
+    }
+    __threadfence();
+    __syncwarp();
+  }
+
+  __device__ void Unlock(const ThreadContext& thread_ctx) {
+    __syncwarp();
+    __threadfence();
+    if (thread_ctx.lane_id == 0) { atomicExch(&flag_, 0); }
+  }
+
+ private:
+  int32_t flag_;
+};
+
+#if CUDA_VERSION >= 11000 && ((!defined(__CUDA_ARCH__)) || (__CUDA_ARCH__ >= 700)) \
+    && !(defined(__clang__) && defined(__CUDA__))
+
+class WarpMutexSemaphoreImpl {
+ public:
+  OF_DISALLOW_COPY_AND_MOVE(WarpMutexSemaphoreImpl);
+  __device__ WarpMutexSemaphoreImpl() : semaphore_(1) {}
+  __device__ ~WarpMutexSemaphoreImpl() = default;
+
+  __device__ void Lock(const ThreadContext& thread_ctx) {
+    if (thread_ctx.lane_id == 0) { semaphore_.acquire(); }
+    __syncwarp();
+  }
+
+  __device__ void Unlock(const ThreadContext& thread_ctx) {
+    __syncwarp();
+    if (thread_ctx.lane_id == 0) { semaphore_.release(); }
+  }
+
+ private:
+  cuda::binary_semaphore<cuda::thread_scope_device> semaphore_;
+};
+
+#endif
+
+// The mutex type of the device pass, host code sizes the mutex buffer with GetWarpMutexSize.
+#if CUDA_VERSION >= 11000 && __CUDA_ARCH__ >= 700 && !(defined(__clang__) && defined(__CUDA__))
+using WarpMutex = WarpMutexSemaphoreImpl;
+#else
+using WarpMutex = WarpMutexAtomicImpl;
+#endif  // CUDA_VERSION >= 11000 && __CUDA_ARCH__ >= 700 && !(defined(__clang__) &&
+        // defined(__CUDA__))
+
+size_t GetWarpMutexSize(int device) {
+  int major = 0;
+  OF_CUDA_CHECK(cudaDeviceGetAttribute(&major, cudaDevAttrComputeCapabilityMajor, device));
+  size_t mutex_size = 0;
+#if CUDA_VERSION >= 11000 && !(defined(__clang__) && defined(__CUDA__))
+  if (major >= 7) {
+#if !defined(__CUDA_ARCH__)
+    mutex_size = sizeof(WarpMutexSemaphoreImpl);
+#else
+    UNIMPLEMENTED();
+#endif
+  } else {
+    mutex_size = sizeof(WarpMutexAtomicImpl);
+  }
+#else
+  mutex_size = sizeof(WarpMutexAtomicImpl);
+#endif  // CUDA_VERSION >= 11000 && !(defined(__clang__) && defined(__CUDA__))
+  return mutex_size;
+}
+
+__global__ void InitCacheSetMutex(uint32_t n_set, void* mutex) {
+  const uint32_t idx = blockIdx.x * blockDim.x + threadIdx.x;
+  if (idx < n_set) { new (reinterpret_cast<WarpMutex*>(mutex) + idx) WarpMutex; }
+}
+
+// Keys, lines and the mutex of one set, `CacheContext` provides keys, lines, mutex and line_size.
+// The per way replacement metadata is left to the derived set contexts.
+template<typename Key, typename Elem>
+struct SetContextBase {
+  template<typename CacheContext>
+  __device__ SetContextBase(const CacheContext& ctx, uint32_t set_id)
+      : keys(ctx.keys + set_id * kWarpSize),
+        lines(ctx.lines + static_cast<size_t>(set_id) * kWarpSize * ctx.line_size),
+        mutex(reinterpret_cast<WarpMutex*>(ctx.mutex) + set_id) {}
+
+  template<typename CacheContext>
+  __device__ void Read(const CacheContext& cache_ctx, const ThreadContext& thread_ctx, int way,
+                       Elem* line) {
+    const Elem* from_line = lines + way * cache_ctx.line_size;
+    for (int i = thread_ctx.lane_id; i < cache_ctx.line_size; i += kWarpSize) {
+      line[i] = from_line[i];
+    }
+  }
+
+  template<typename CacheContext>
+  __device__ void Write(const CacheContext& cache_ctx, const ThreadContext& thread_ctx, int way,
+                        const Elem* line) {
+    Elem* to_line = lines + way * cache_ctx.line_size;
+    for (int i = thread_ctx.lane_id; i < cache_ctx.line_size; i += kWarpSize) {
+      to_line[i] = line[i];
+    }
+  }
+
+  __device__ void Lock(const ThreadContext& thread_ctx) { mutex->Lock(thread_ctx); }
+
+  __device__ void Unlock(const ThreadContext& thread_ctx) { mutex->Unlock(thread_ctx); }
+
+  Key* keys;
+  Elem* lines;
+  WarpMutex* mutex;
+};
+
+// The stats buffer is only allocated when CacheOptions::enable_stats is set, kernels skip the
+// counting on a null buffer.
+unsigned long long int* NewCacheStats(const CacheOptions& options) {
+  if (!options.enable_stats) { return nullptr; }
+  unsigned long long int* stats = nullptr;
+  OF_CUDA_CHECK(cudaMalloc(&stats, kNumStats * sizeof(unsigned long long int)));
+  OF_CUDA_CHECK(cudaMemset(stats, 0, kNumStats * sizeof(unsigned long long int)));
+  return stats;
+}
+
+void DestroyCacheStats(unsigned long long int* stats) {
+  if (stats != nullptr) { OF_CUDA_CHECK(cudaFree(stats)); }
+}
+
+void GetCacheStats(ep::Stream* stream, const unsigned long long int* stats,
+                   CacheStats* cache_stats) {
+  *cache_stats = CacheStats();
+  if (stats == nullptr) { return; }
+  unsigned long long int host_stats[kNumStats];
+  OF_CUDA_CHECK(cudaMemcpyAsync(host_stats, stats, sizeof(host_stats), cudaMemcpyDefault,
+                                stream->As<ep::CudaStream>()->cuda_stream()));
+  CHECK_JUST(stream->Sync());
+  cache_stats->num_queries = host_stats[kStatQueries];
+  cache_stats->num_hits = host_stats[kStatHits];
+  cache_stats->num_evictions = host_stats[kStatEvictions];
+  cache_stats->num_rejected_admissions = host_stats[kStatRejectedAdmissions];
+}
+
+void ResetCacheStats(ep::Stream* stream, unsigned long long int* stats) {
+  if (stats == nullptr) { return; }
+  OF_CUDA_CHECK(cudaMemsetAsync(stats, 0, kNumStats * sizeof(unsigned long long int),
+                                stream->As<ep::CudaStream>()->cuda_stream()));
+}
+
+}  // namespace
+
+}  // namespace embedding
+
+}  // namespace oneflow
+
+#endif  // ONEFLOW_CORE_EMBEDDING_SET_ASSOCIATIVE_CACHE_CUH_
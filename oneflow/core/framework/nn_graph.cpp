@@ -14,6 +14,7 @@ See the License for the specific language governing permissions and
 limitations under the License.
 */
 #include "oneflow/core/framework/nn_graph.h"
+#include "oneflow/core/auto_parallel/cost_database.h"
 #include "oneflow/core/common/buffer_manager.h"
 #include "oneflow/core/common/hash_container.h"
 #include "oneflow/core/common/maybe.h"
@@ -44,6 +45,7 @@ limitations under the License.
 #include "oneflow/core/vm/virtual_machine.h"
 #include "oneflow/core/vm/vm_util.h"
 #include "oneflow/core/profiler/profiler.h"
+#include "oneflow/core/profiler/actor_tracer.h"
 #include "oneflow/core/framework/variable_tensor_mgr.h"
 
 namespace oneflow {
@@ -476,6 +478,32 @@ Maybe<void> NNGraph::InitRuntime() {
   return Maybe<void>::Ok();
 }
 
+Maybe<std::string> NNGraph::AnalyzeExecution() const {
+  CHECK_OR_RETURN(runtime_inited_) << "nn.Graph " << name_ << " has not been run";
+  HashMap<int64_t, std::vector<profiler::ActorActTime>> actor_id2acts;
+  profiler::CollectActorActTimes(&actor_id2acts);
+  return PlanUtil::AnalyzeExecution(plan_, GlobalProcessCtx::Rank(), actor_id2acts);
+}
+
+Maybe<std::string> NNGraph::AnalyzeRoofline() const {
+  CHECK_OR_RETURN(runtime_inited_) << "nn.Graph " << name_ << " has not been run";
+  HashMap<std::pair<int64_t, int64_t>, std::vector<int64_t>> actor_kernel2durations;
+  profiler::CollectActorKernelTimes(&actor_kernel2durations);
+  return PlanUtil::AnalyzeRoofline(plan_, GlobalProcessCtx::Rank(), actor_kernel2durations);
+}
+
+Maybe<void> NNGraph::RecordAutoParallelCost(const std::string& path) const {
+  CHECK_OR_RETURN(runtime_inited_) << "nn.Graph " << name_ << " has not been run";
+  HashMap<std::pair<int64_t, int64_t>, std::vector<int64_t>> actor_kernel2durations;
+  profiler::CollectActorKernelTimes(&actor_kernel2durations);
+  // Accumulate the times of several graphs, runs and ranks into the same database
+  return auto_parallel::CostDatabase::UpdateFile(
+      path, [&](auto_parallel::CostDatabase* cost_database) -> Maybe<void> {
+        return cost_database->AddKernelTimes(plan_, GlobalProcessCtx::Rank(),
+                                             actor_kernel2durations);
+      });
+}
+
 Maybe<void> NNGraph::CompileAndInitRuntime() {
   JUST(AlignStatesAfterLogicalGraphCompile());
   JUST(CompleteLogicalGraphForRuntime());
@@ -98,6 +98,14 @@ class NNGraph final : public NNGraphIf {
   // Initialize lazy runtime.
   Maybe<void> InitRuntime();
   Maybe<void> CompileAndInitRuntime();
+  // Analyzes the acts of this rank recorded by the actor trace, see PlanUtil::AnalyzeExecution.
+  Maybe<std::string> AnalyzeExecution() const;
+  // Reports the achieved GFLOP/s and GB/s of the kernels of this rank recorded by the actor trace,
+  // see PlanUtil::AnalyzeRoofline.
+  Maybe<std::string> AnalyzeRoofline() const;
+  // Adds the kernel times of this rank recorded by the actor trace to the auto parallel cost
+  // database at `path`, see auto_parallel::CostDatabase.
+  Maybe<void> RecordAutoParallelCost(const std::string& path) const;
   Maybe<void> Close();
   const auto variable_op_name2tensor() const { return variable_op_name2tensor_; }
   std::vector<std::shared_ptr<one::UserOpExpr>> cached_op_exprs;
@@ -16,6 +16,8 @@ limitations under the License.
 #ifndef ONEFLOW_CORE_FRAMEWORK_SAVED_TENSOR_HOOKS_H_
 #define ONEFLOW_CORE_FRAMEWORK_SAVED_TENSOR_HOOKS_H_
 
+#include "oneflow/core/common/small_vector.h"
+#include "oneflow/core/common/throw.h"
 #include "oneflow/core/framework/tensor.h"
 
 namespace oneflow {
@@ -33,6 +35,25 @@ class SavedTensorHookCreator {
   virtual std::unique_ptr<SavedTensorHook> new_saved_tensor_hook() const = 0;
 };
 
+// Keeps the creators of nested saved tensor hook scopes, only the innermost one creates hooks.
+class SavedTensorHookCreatorStack final : public SavedTensorHookCreator {
+ public:
+  std::unique_ptr<SavedTensorHook> new_saved_tensor_hook() const override {
+    if (creators_.empty()) { return nullptr; }
+    return creators_.back()->new_saved_tensor_hook();
+  }
+  void push(const std::shared_ptr<SavedTensorHookCreator>& creator) {
+    creators_.push_back(creator);
+  }
+  void pop() {
+    CHECK_OR_THROW(!creators_.empty()) << "pop_hooks should not be called when there are no hooks";
+    creators_.pop_back();
+  }
+
+ private:
+  small_vector<std::shared_ptr<SavedTensorHookCreator>, 1> creators_;
+};
+
 }  // namespace one
 }  // namespace oneflow
 
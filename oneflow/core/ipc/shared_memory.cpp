@@ -204,5 +204,82 @@ Maybe<void> SharedMemory::Unlink() {
 #endif
 }
 
+namespace {
+
+constexpr size_t kSlabPageSize = 4096;
+
+// The slot number and slot size, followed by the states of the slots
+struct SlabHeader {
+  uint64_t slot_num;
+  uint64_t slot_size;
+};
+
+static_assert(std::atomic<int32_t>::is_always_lock_free,
+              "the slot states are shared between processes");
+
+size_t SlabHeaderSize(size_t slot_num) {
+  return RoundUp(sizeof(SlabHeader) + slot_num * sizeof(std::atomic<int32_t>), kSlabPageSize);
+}
+
+}  // namespace
+
+SharedMemorySlab::SharedMemorySlab(const std::shared_ptr<SharedMemory>& shm)
+    : shm_(shm), next_slot_id_(0) {
+  const auto* header = reinterpret_cast<const SlabHeader*>(shm_->buf());
+  slot_num_ = header->slot_num;
+  slot_size_ = header->slot_size;
+  slot_states_ = reinterpret_cast<std::atomic<int32_t>*>(shm_->mut_buf() + sizeof(SlabHeader));
+  slots_ = shm_->mut_buf() + SlabHeaderSize(slot_num_);
+}
+
+Maybe<SharedMemorySlab> SharedMemorySlab::Create(size_t slot_num, size_t slot_size) {
+  CHECK_GT_OR_RETURN(slot_num, 0) << "the slot number of a shared memory slab should be positive";
+  slot_size = RoundUp(std::max<size_t>(slot_size, 1), kSlabPageSize);
+  const size_t size = SlabHeaderSize(slot_num) + slot_num * slot_size;
+  std::shared_ptr<SharedMemory> shm = JUST(SharedMemory::Open(size, /*create=*/true));
+  // The segment is zero-filled, all the slots are free
+  auto* header = reinterpret_cast<SlabHeader*>(shm->mut_buf());
+  header->slot_num = slot_num;
+  header->slot_size = slot_size;
+  return std::shared_ptr<SharedMemorySlab>(new SharedMemorySlab(shm));
+}
+
+Maybe<SharedMemorySlab> SharedMemorySlab::Open(const std::string& name) {
+  std::shared_ptr<SharedMemory> shm = JUST(SharedMemory::Open(name, /*create=*/false));
+  CHECK_GE_OR_RETURN(shm->size(), sizeof(SlabHeader))
+      << "shared memory " << name << " is not a shared memory slab";
+  const auto* header = reinterpret_cast<const SlabHeader*>(shm->buf());
+  CHECK_EQ_OR_RETURN(shm->size(),
+                     SlabHeaderSize(header->slot_num) + header->slot_num * header->slot_size)
+      << "shared memory " << name << " is not a shared memory slab";
+  return std::shared_ptr<SharedMemorySlab>(new SharedMemorySlab(shm));
+}
+
+int64_t SharedMemorySlab::AcquireSlot() {
+  for (size_t i = 0; i < slot_num_; ++i) {
+    const int64_t slot_id = next_slot_id_.fetch_add(1, std::memory_order_relaxed) % slot_num_;
+    int32_t expected = 0;
+    if (slot_states_[slot_id].compare_exchange_strong(expected, 1, std::memory_order_acquire)) {
+      return slot_id;
+    }
+  }
+  return -1;
+}
+
+Maybe<void> SharedMemorySlab::ReleaseSlot(int64_t slot_id) {
+  CHECK_OR_RETURN(slot_id >= 0 && slot_id < static_cast<int64_t>(slot_num_))
+      << "slot " << slot_id << " is out of the shared memory slab " << name();
+  // Publish the reads of the slot before the creator writes it again
+  CHECK_EQ_OR_RETURN(slot_states_[slot_id].exchange(0, std::memory_order_release), 1)
+      << "slot " << slot_id << " of the shared memory slab " << name() << " is not in use";
+  return Maybe<void>::Ok();
+}
+
+Maybe<char*> SharedMemorySlab::MutSlotBuf(int64_t slot_id) {
+  CHECK_OR_RETURN(slot_id >= 0 && slot_id < static_cast<int64_t>(slot_num_))
+      << "slot " << slot_id << " is out of the shared memory slab " << name();
+  return slots_ + slot_id * slot_size_;
+}
+
 }  // namespace ipc
 }  // namespace oneflow
@@ -16,6 +16,7 @@ limitations under the License.
 #ifndef ONEFLOW_CORE_IPC_SHARED_MEMORY_H_
 #define ONEFLOW_CORE_IPC_SHARED_MEMORY_H_
 
+#include <atomic>
 #include "oneflow/core/common/util.h"
 #include "oneflow/core/common/maybe.h"
 #include "oneflow/core/common/singleton.h"
@@ -68,6 +69,41 @@ class SharedMemory final {
   size_t size_;
 };
 
+// A shared memory segment divided into page-aligned slots of the same size. The creator acquires
+// the slots in a ring and any process which opens the slab releases them, so that the slots are
+// reused instead of creating, mapping and faulting in a new segment for every tensor.
+class SharedMemorySlab final {
+ public:
+  SharedMemorySlab(const SharedMemorySlab&) = delete;
+  SharedMemorySlab(SharedMemorySlab&&) = delete;
+  ~SharedMemorySlab() = default;
+
+  static Maybe<SharedMemorySlab> Create(size_t slot_num, size_t slot_size);
+  static Maybe<SharedMemorySlab> Open(const std::string& name);
+
+  // Returns -1 if all the slots are in use.
+  int64_t AcquireSlot();
+  Maybe<void> ReleaseSlot(int64_t slot_id);
+  Maybe<char*> MutSlotBuf(int64_t slot_id);
+
+  const std::string& name() const { return shm_->name(); }
+  size_t slot_num() const { return slot_num_; }
+  size_t slot_size() const { return slot_size_; }
+
+  Maybe<void> Unlink() { return shm_->Unlink(); }
+
+ private:
+  SharedMemorySlab(const std::shared_ptr<SharedMemory>& shm);
+
+  std::shared_ptr<SharedMemory> shm_;
+  size_t slot_num_;
+  size_t slot_size_;
+  std::atomic<int32_t>* slot_states_;
+  char* slots_;
+  // the slots of a slab may be acquired by several threads of the creator
+  std::atomic<uint64_t> next_slot_id_;
+};
+
 }  // namespace ipc
 }  // namespace oneflow
 
@@ -13,6 +13,8 @@ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
 See the License for the specific language governing permissions and
 limitations under the License.
 */
+#include <cmath>
+#include <map>
 #include "oneflow/core/common/constant.h"
 #include "oneflow/core/common/str_util.h"
 #include "oneflow/core/common/env_var/debug_mode.h"
@@ -28,6 +30,9 @@ limitations under the License.
 #include "oneflow/core/ep/include/device_manager_registry.h"
 #include "oneflow/core/operator/operator.h"
 #include "oneflow/core/graph/task_node.h"
+#include "oneflow/core/framework/to_string.h"
+#include "oneflow/core/profiler/op_cost.h"
+#include "nlohmann/json.hpp"
 
 namespace oneflow {
 
@@ -1385,4 +1390,409 @@ void PlanUtil::PopulateOpAttribute(
   return GetStreamId(task).device_id().device_index();
 }
 
+namespace {
+
+bool IsCommTaskType(TaskType task_type) {
+  return task_type == TaskType::kCopyCommNet || task_type == TaskType::kCollectiveBoxingGeneric
+         || task_type == TaskType::kNcclSendRecvBoxing || task_type == TaskType::kCopyHd;
+}
+
+std::string GetTaskName(const TaskProto& task) {
+  if (task.exec_sequence().exec_node_size() > 0) {
+    const KernelConf& kernel_conf = task.exec_sequence().exec_node(0).kernel_conf();
+    if (kernel_conf.has_op_attribute()) { return kernel_conf.op_attribute().op_conf().name(); }
+    if (kernel_conf.has_op_attribute_ref()) { return kernel_conf.op_attribute_ref(); }
+  }
+  return TaskType_Name(task.task_type()) + "_" + std::to_string(task.task_id());
+}
+
+double NsToUs(double ns) { return ns / 1000.0; }
+
+using ActTimes = std::vector<std::pair<int64_t, int64_t>>;
+
+}  // namespace
+
+/*static*/ Maybe<std::string> PlanUtil::AnalyzeExecution(
+    const Plan& plan, int64_t machine_id,
+    const HashMap<int64_t, std::vector<profiler::ActorActTime>>& actor_id2acts) {
+  using json = nlohmann::json;
+  HashMap<int64_t, const TaskProto*> task_id2task;
+  HashMap<int64_t, const RegstDescProto*> regst_desc_id2regst_desc;
+  for (const TaskProto& task : plan.task()) {
+    if (task.machine_id() != machine_id) { continue; }
+    task_id2task.emplace(task.task_id(), &task);
+    for (const auto& pair : task.produced_regst_desc()) {
+      regst_desc_id2regst_desc.emplace(pair.second.regst_desc_id(), &pair.second);
+    }
+  }
+
+  // Most actors act once per iteration and so have acted as many times as there were iterations,
+  // the other ones (e.g. acc and repeat) are left out of the analyses that pair the acts of
+  // producers and consumers.
+  HashMap<int64_t, int64_t> act_cnt2actor_cnt;
+  HashMap<int64_t, double> task_id2mean_act_ns;
+  for (const auto& pair : actor_id2acts) {
+    if (task_id2task.count(pair.first) == 0 || pair.second.empty()) { continue; }
+    act_cnt2actor_cnt[pair.second.back().act_id + 1] += 1;
+    double total_ns = 0;
+    for (const auto& act : pair.second) { total_ns += act.end_ns - act.begin_ns; }
+    task_id2mean_act_ns[pair.first] = total_ns / pair.second.size();
+  }
+  CHECK_OR_RETURN(!act_cnt2actor_cnt.empty())
+      << "No act of the plan is recorded, the actor trace should be enabled when running it";
+  int64_t total_iters = 0;
+  int64_t max_actor_cnt = 0;
+  for (const auto& pair : act_cnt2actor_cnt) {
+    if (pair.second > max_actor_cnt || (pair.second == max_actor_cnt && pair.first > total_iters)) {
+      total_iters = pair.first;
+      max_actor_cnt = pair.second;
+    }
+  }
+  // Act k of every actor acting once per iteration belongs to iteration k. The ring buffers of the
+  // threads keep different numbers of iterations, and the trace may have been stopped for a
+  // while, so only the last iterations recorded without a gap for all of these actors are used.
+  const auto& IsPerIterActor = [&](int64_t task_id) {
+    const auto it = actor_id2acts.find(task_id);
+    return task_id2task.count(task_id) > 0 && it != actor_id2acts.end() && !it->second.empty()
+           && it->second.back().act_id + 1 == total_iters;
+  };
+  int64_t first_iter = 0;
+  for (const auto& pair : actor_id2acts) {
+    if (!IsPerIterActor(pair.first)) { continue; }
+    const auto& acts = pair.second;
+    size_t first = acts.size() - 1;
+    while (first > 0 && acts.at(first - 1).act_id + 1 == acts.at(first).act_id) { first -= 1; }
+    first_iter = std::max(first_iter, acts.at(first).act_id);
+  }
+  const int64_t num_iters = total_iters - first_iter;
+  HashMap<int64_t, ActTimes> task_id2iter_acts;
+  int64_t begin_ns = std::numeric_limits<int64_t>::max();
+  int64_t end_ns = std::numeric_limits<int64_t>::min();
+  for (const auto& pair : actor_id2acts) {
+    if (!IsPerIterActor(pair.first)) { continue; }
+    ActTimes& iter_acts = task_id2iter_acts[pair.first];
+    for (size_t i = pair.second.size() - num_iters; i < pair.second.size(); ++i) {
+      iter_acts.emplace_back(pair.second.at(i).begin_ns, pair.second.at(i).end_ns);
+    }
+    begin_ns = std::min(begin_ns, iter_acts.front().first);
+    end_ns = std::max(end_ns, iter_acts.back().second);
+  }
+  const double iter_ns = static_cast<double>(end_ns - begin_ns) / num_iters;
+  // the acts per iteration of any actor, from the number of its acts since it was created
+  const auto& ActsPerIter = [&](int64_t task_id) {
+    return static_cast<double>(actor_id2acts.at(task_id).back().act_id + 1) / total_iters;
+  };
+  const auto& PerIterActs = [&](int64_t task_id) -> const ActTimes* {
+    const auto it = task_id2iter_acts.find(task_id);
+    return it == task_id2iter_acts.end() ? nullptr : &it->second;
+  };
+  const auto& ProducerTaskIds = [&](const TaskProto& task) {
+    std::vector<int64_t> producer_task_ids;
+    for (const auto& pair : task.consumed_regst_desc_id()) {
+      for (int64_t regst_desc_id : pair.second.regst_desc_id()) {
+        const auto it = regst_desc_id2regst_desc.find(regst_desc_id);
+        if (it != regst_desc_id2regst_desc.end()) {
+          producer_task_ids.emplace_back(it->second->producer_task_id());
+        }
+      }
+    }
+    return producer_task_ids;
+  };
+  const auto& TaskJson = [&](int64_t task_id) {
+    const TaskProto* task = task_id2task.at(task_id);
+    return json{{"actor_id", task_id},
+                {"name", GetTaskName(*task)},
+                {"task_type", TaskType_Name(task->task_type())},
+                {"thrd_id", task->thrd_id()},
+                {"order_in_graph", task->task_set_info().order_in_graph()}};
+  };
+
+  // The critical path is the longest path of mean act times through the dependencies of the
+  // actors acting once per iteration, visited in topological order.
+  HashMap<int64_t, std::vector<int64_t>> task_id2consumer_task_ids;
+  HashMap<int64_t, int64_t> task_id2in_degree;
+  for (const auto& pair : task_id2task) {
+    if (PerIterActs(pair.first) == nullptr) { continue; }
+    task_id2in_degree.emplace(pair.first, 0);
+    for (int64_t producer_task_id : ProducerTaskIds(*pair.second)) {
+      if (PerIterActs(producer_task_id) == nullptr || producer_task_id == pair.first) { continue; }
+      task_id2consumer_task_ids[producer_task_id].emplace_back(pair.first);
+      task_id2in_degree[pair.first] += 1;
+    }
+  }
+  std::vector<int64_t> ready_task_ids;
+  for (const auto& pair : task_id2in_degree) {
+    if (pair.second == 0) { ready_task_ids.emplace_back(pair.first); }
+  }
+  HashMap<int64_t, double> task_id2path_ns;
+  HashMap<int64_t, int64_t> task_id2path_prev;
+  while (!ready_task_ids.empty()) {
+    const int64_t task_id = ready_task_ids.back();
+    ready_task_ids.pop_back();
+    const double path_ns = task_id2path_ns[task_id] + task_id2mean_act_ns.at(task_id);
+    task_id2path_ns[task_id] = path_ns;
+    for (int64_t consumer_task_id : task_id2consumer_task_ids[task_id]) {
+      auto it = task_id2path_ns.find(consumer_task_id);
+      if (it == task_id2path_ns.end() || it->second < path_ns) {
+        task_id2path_ns[consumer_task_id] = path_ns;
+        task_id2path_prev[consumer_task_id] = task_id;
+      }
+      if (--task_id2in_degree[consumer_task_id] == 0) {
+        ready_task_ids.emplace_back(consumer_task_id);
+      }
+    }
+  }
+  int64_t path_end_task_id = -1;
+  double critical_path_ns = 0;
+  for (const auto& pair : task_id2in_degree) {
+    // the actors in cycles are never ready
+    if (pair.second != 0) { continue; }
+    if (task_id2path_ns.at(pair.first) > critical_path_ns) {
+      critical_path_ns = task_id2path_ns.at(pair.first);
+      path_end_task_id = pair.first;
+    }
+  }
+  json critical_path_actors = json::array();
+  for (int64_t task_id = path_end_task_id; task_id != -1;) {
+    json actor = TaskJson(task_id);
+    actor["mean_act_us"] = NsToUs(task_id2mean_act_ns.at(task_id));
+    critical_path_actors.insert(critical_path_actors.begin(), std::move(actor));
+    const auto it = task_id2path_prev.find(task_id);
+    task_id = it == task_id2path_prev.end() ? -1 : it->second;
+  }
+
+  // The input wait before an act is the time from the end of the previous act to the end of the
+  // act of the producer whose register came last.
+  std::map<std::pair<int64_t, int64_t>, double> consumer_producer2wait_ns;
+  for (const auto& pair : task_id2task) {
+    const auto* acts = PerIterActs(pair.first);
+    if (acts == nullptr) { continue; }
+    std::vector<std::pair<int64_t, const ActTimes*>> producers;
+    for (int64_t producer_task_id : ProducerTaskIds(*pair.second)) {
+      const auto* producer_acts = PerIterActs(producer_task_id);
+      if (producer_acts != nullptr && producer_task_id != pair.first) {
+        producers.emplace_back(producer_task_id, producer_acts);
+      }
+    }
+    if (producers.empty()) { continue; }
+    for (int64_t k = 1; k < num_iters; ++k) {
+      int64_t ready_ns = std::numeric_limits<int64_t>::min();
+      int64_t last_producer_task_id = -1;
+      for (const auto& producer : producers) {
+        if (producer.second->at(k).second > ready_ns) {
+          ready_ns = producer.second->at(k).second;
+          last_producer_task_id = producer.first;
+        }
+      }
+      const int64_t wait_ns = std::min(acts->at(k).first, ready_ns) - acts->at(k - 1).second;
+      if (wait_ns > 0) {
+        consumer_producer2wait_ns[std::make_pair(pair.first, last_producer_task_id)] += wait_ns;
+      }
+    }
+  }
+
+  // The load of a stream is the act time of its actors per iteration, the busiest stream bounds
+  // the iteration time of a pipeline.
+  std::map<int64_t, std::vector<int64_t>> thrd_id2task_ids;
+  for (const auto& pair : task_id2mean_act_ns) {
+    thrd_id2task_ids[task_id2task.at(pair.first)->thrd_id()].emplace_back(pair.first);
+  }
+  json suggestions = json::array();
+  json streams = json::array();
+  double max_load_ns = 0;
+  double total_load_ns = 0;
+  int64_t busiest_thrd_id = -1;
+  for (auto& pair : thrd_id2task_ids) {
+    double load_ns = 0;
+    for (int64_t task_id : pair.second) {
+      load_ns += task_id2mean_act_ns.at(task_id) * ActsPerIter(task_id);
+    }
+    std::sort(pair.second.begin(), pair.second.end(), [&](int64_t lhs, int64_t rhs) {
+      return task_id2mean_act_ns.at(lhs) * ActsPerIter(lhs)
+             > task_id2mean_act_ns.at(rhs) * ActsPerIter(rhs);
+    });
+    json top_actors = json::array();
+    for (size_t i = 0; i < std::min<size_t>(3, pair.second.size()); ++i) {
+      top_actors.push_back(GetTaskName(*task_id2task.at(pair.second.at(i))));
+    }
+    streams.push_back({{"thrd_id", pair.first},
+                       {"load_us_per_iter", NsToUs(load_ns)},
+                       {"utilization", load_ns / iter_ns},
+                       {"top_actors", std::move(top_actors)}});
+    total_load_ns += load_ns;
+    if (load_ns > max_load_ns) {
+      max_load_ns = load_ns;
+      busiest_thrd_id = pair.first;
+    }
+  }
+  const double mean_load_ns = total_load_ns / thrd_id2task_ids.size();
+  if (thrd_id2task_ids.size() > 1 && max_load_ns > 1.5 * mean_load_ns
+      && max_load_ns > 0.8 * iter_ns) {
+    suggestions.push_back("Stream " + std::to_string(busiest_thrd_id) + " is busy for "
+                          + std::to_string(NsToUs(max_load_ns)) + " us of the "
+                          + std::to_string(NsToUs(iter_ns))
+                          + " us iteration, move some of its ops to another pipeline stage");
+  }
+
+  // With register_num registers, the producer may only start the act of iteration k once the
+  // consumers of iteration k - register_num are done. Its stall is the time from the end of its
+  // previous act to that moment. Without stalls an iteration takes the load of the busiest
+  // stream, the suggested register_num covers the time a register is held in such iterations.
+  const double bottleneck_iter_ns = max_load_ns > 0 ? max_load_ns : iter_ns;
+  std::vector<json> regst_stalls;
+  for (const auto& pair : regst_desc_id2regst_desc) {
+    const RegstDescProto* regst_desc = pair.second;
+    if (!regst_desc->regst_desc_type().has_data_regst_desc()) { continue; }
+    const auto* producer_acts = PerIterActs(regst_desc->producer_task_id());
+    if (producer_acts == nullptr || regst_desc->consumer_task_id_size() == 0) { continue; }
+    std::vector<const ActTimes*> consumer_acts;
+    for (int64_t consumer_task_id : regst_desc->consumer_task_id()) {
+      consumer_acts.emplace_back(PerIterActs(consumer_task_id));
+    }
+    if (std::count(consumer_acts.begin(), consumer_acts.end(), nullptr) > 0) { continue; }
+    const auto& ReleaseNs = [&](int64_t k) {
+      int64_t release_ns = std::numeric_limits<int64_t>::min();
+      for (const auto* acts : consumer_acts) {
+        release_ns = std::max(release_ns, acts->at(k).second);
+      }
+      return release_ns;
+    };
+    const int64_t register_num = regst_desc->register_num();
+    double hold_ns = 0;
+    for (int64_t k = 0; k < num_iters; ++k) {
+      hold_ns += ReleaseNs(k) - producer_acts->at(k).first;
+    }
+    hold_ns /= num_iters;
+    double stall_ns = 0;
+    for (int64_t k = register_num; k < num_iters; ++k) {
+      const int64_t ready_ns = producer_acts->at(k - 1).second;
+      stall_ns += std::max<int64_t>(
+          0, std::min(producer_acts->at(k).first, ReleaseNs(k - register_num)) - ready_ns);
+    }
+    stall_ns /= num_iters;
+    if (stall_ns <= 0) { continue; }
+    const int64_t suggested_register_num = std::min<int64_t>(
+        std::max<int64_t>(register_num, std::ceil(hold_ns / bottleneck_iter_ns)),
+        regst_desc->max_register_num());
+    json stall = TaskJson(regst_desc->producer_task_id());
+    stall["regst_desc_id"] = regst_desc->regst_desc_id();
+    stall["register_num"] = register_num;
+    stall["stall_us_per_iter"] = NsToUs(stall_ns);
+    stall["mean_hold_us"] = NsToUs(hold_ns);
+    stall["suggested_register_num"] = suggested_register_num;
+    if (stall_ns > 0.01 * iter_ns && suggested_register_num > register_num) {
+      const std::string& producer_name =
+          GetTaskName(*task_id2task.at(regst_desc->producer_task_id()));
+      suggestions.push_back("Increase register_num of regst " + std::to_string(pair.first)
+                            + " produced by " + producer_name + " from "
+                            + std::to_string(register_num) + " to "
+                            + std::to_string(suggested_register_num) + ", the producer stalls "
+                            + std::to_string(NsToUs(stall_ns)) + " us per iteration on it");
+    }
+    regst_stalls.emplace_back(std::move(stall));
+  }
+  std::sort(regst_stalls.begin(), regst_stalls.end(), [](const json& lhs, const json& rhs) {
+    return lhs["stall_us_per_iter"].get<double>() > rhs["stall_us_per_iter"].get<double>();
+  });
+
+  std::vector<json> comm_waits;
+  double comm_wait_ns = 0;
+  for (const auto& pair : consumer_producer2wait_ns) {
+    const TaskProto* producer = task_id2task.at(pair.first.second);
+    if (!IsCommTaskType(producer->task_type())) { continue; }
+    json wait = TaskJson(pair.first.first);
+    wait["producer"] = TaskJson(pair.first.second);
+    wait["wait_us_per_iter"] = NsToUs(pair.second / num_iters);
+    comm_wait_ns += pair.second / num_iters;
+    comm_waits.emplace_back(std::move(wait));
+  }
+  std::sort(comm_waits.begin(), comm_waits.end(), [](const json& lhs, const json& rhs) {
+    return lhs["wait_us_per_iter"].get<double>() > rhs["wait_us_per_iter"].get<double>();
+  });
+  if (comm_wait_ns > 0.1 * iter_ns) {
+    suggestions.push_back("Actors wait " + std::to_string(NsToUs(comm_wait_ns))
+                          + " us per iteration for communication, first for "
+                          + comm_waits.front()["producer"]["name"].get<std::string>()
+                          + ", overlap it with more registers on its inputs or outputs");
+  }
+
+  if (critical_path_ns < 0.5 * iter_ns) {
+    suggestions.push_back(
+        "The critical path is less than half of the iteration time, the iteration is bound by "
+        "the throughput of the busiest stream or by stalls rather than by dependencies");
+  }
+
+  json report{{"machine_id", machine_id},
+              {"iterations", num_iters},
+              {"iteration_us", NsToUs(iter_ns)},
+              {"critical_path", {{"length_us", NsToUs(critical_path_ns)},
+                                 {"actors", std::move(critical_path_actors)}}},
+              {"streams", std::move(streams)},
+              {"regst_stalls", regst_stalls},
+              {"comm_waits", comm_waits},
+              {"suggestions", std::move(suggestions)}};
+  return report.dump();
+}
+
+/*static*/ Maybe<std::string> PlanUtil::AnalyzeRoofline(
+    const Plan& plan, int64_t machine_id,
+    const HashMap<std::pair<int64_t, int64_t>, std::vector<int64_t>>& actor_kernel2durations) {
+  using json = nlohmann::json;
+  HashMap<int64_t, const TaskProto*> task_id2task;
+  for (const TaskProto& task : plan.task()) {
+    if (task.machine_id() == machine_id) { task_id2task.emplace(task.task_id(), &task); }
+  }
+  // The kernels on cuda streams are timed by cuda events, the kernels on other devices are
+  // launched asynchronously and their recorded time is the launch time unless every kernel is
+  // synchronized after its launch.
+  const bool kernel_synced = ParseBooleanFromEnv("ONEFLOW_DEBUG_KERNEL_SYNC_CHECK", false);
+  std::vector<std::pair<double, json>> total_ns7kernels;
+  double total_ns = 0;
+  for (const auto& pair : actor_kernel2durations) {
+    const auto task_it = task_id2task.find(pair.first.first);
+    if (task_it == task_id2task.end() || pair.second.empty()) { continue; }
+    const auto& exec_nodes = task_it->second->exec_sequence().exec_node();
+    if (pair.first.second >= exec_nodes.size()) { continue; }
+    const KernelConf& kernel_conf = exec_nodes.Get(pair.first.second).kernel_conf();
+    if (!kernel_conf.has_op_attribute()) { continue; }
+    const OperatorConf& op_conf = kernel_conf.op_attribute().op_conf();
+    const DeviceType device_type = GetStreamId(*task_it->second).device_id().device_type();
+    const std::string device_tag = *JUST(DeviceTag4DeviceType(device_type));
+    const profiler::OpCost cost = profiler::InferOpCost(kernel_conf);
+    double kernel_total_ns = 0;
+    for (int64_t duration_ns : pair.second) { kernel_total_ns += duration_ns; }
+    const double mean_ns = kernel_total_ns / pair.second.size();
+    total_ns += kernel_total_ns;
+    json kernel{{"op_name", op_conf.name()},
+                {"actor_id", pair.first.first},
+                {"device", device_tag},
+                {"count", pair.second.size()},
+                {"mean_us", NsToUs(mean_ns)},
+                {"total_us", NsToUs(kernel_total_ns)},
+                {"flops", cost.flops},
+                {"bytes", cost.bytes},
+                // flops (bytes) per ns are GFLOP/s (GB/s)
+                {"gflops_per_s", mean_ns > 0 ? cost.flops / mean_ns : 0.0},
+                {"gbps", mean_ns > 0 ? cost.bytes / mean_ns : 0.0},
+                {"arithmetic_intensity", cost.bytes > 0 ? cost.flops / cost.bytes : 0.0},
+                {"launch_time_only", device_type != DeviceType::kCPU
+                                         && device_type != DeviceType::kCUDA && !kernel_synced}};
+    if (op_conf.has_user_conf()) { kernel["op_type"] = op_conf.user_conf().op_type_name(); }
+    total_ns7kernels.emplace_back(kernel_total_ns, std::move(kernel));
+  }
+  CHECK_OR_RETURN(!total_ns7kernels.empty())
+      << "No kernel launch of the plan is recorded, the actor trace should be enabled when "
+         "running it";
+  std::sort(total_ns7kernels.begin(), total_ns7kernels.end(),
+            [](const std::pair<double, json>& lhs, const std::pair<double, json>& rhs) {
+              return lhs.first > rhs.first;
+            });
+  json kernels = json::array();
+  for (auto& pair : total_ns7kernels) { kernels.emplace_back(std::move(pair.second)); }
+  json report{{"machine_id", machine_id},
+              {"total_us", NsToUs(total_ns)},
+              {"kernels", std::move(kernels)}};
+  return report.dump();
+}
+
 }  // namespace oneflow
@@ -17,11 +17,13 @@ limitations under the License.
 #define ONEFLOW_CORE_JOB_PLAN_UTIL_H_
 
 #include <functional>
+#include "oneflow/core/common/maybe.h"
 #include "oneflow/core/common/protobuf.h"
 #include "oneflow/core/common/util.h"
 #include "oneflow/core/job/plan.pb.h"
 #include "oneflow/core/job/job.pb.h"
 #include "oneflow/core/graph/stream_id.h"
+#include "oneflow/core/profiler/actor_tracer.h"
 
 namespace oneflow {
 
@@ -50,6 +52,18 @@ struct PlanUtil {
       const PbMap<int64_t, ::oneflow::OpAttributeRefTable>& job_id2op_attribute_ref_table);
   static StreamId GetStreamId(const TaskProto& task);
   static int64_t GetDeviceIndex(const TaskProto& task);
+  // Analyzes the acts recorded for the tasks of `machine_id`, in order, and returns a json report
+  // of the critical path of an iteration, the load of every stream, the stalls caused by too few
+  // registers and the waits for communication, together with suggested changes.
+  static Maybe<std::string> AnalyzeExecution(
+      const Plan& plan, int64_t machine_id,
+      const HashMap<int64_t, std::vector<profiler::ActorActTime>>& actor_id2acts);
+  // Joins the launch durations recorded for the kernels of `machine_id`, keyed by actor id and
+  // kernel index, with the FLOPs and bytes inferred for their ops, and returns a json report of
+  // the achieved GFLOP/s and GB/s of every kernel, sorted by total time.
+  static Maybe<std::string> AnalyzeRoofline(
+      const Plan& plan, int64_t machine_id,
+      const HashMap<std::pair<int64_t, int64_t>, std::vector<int64_t>>& actor_kernel2durations);
 };
 
 }  // namespace oneflow
@@ -0,0 +1,123 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "gtest/gtest.h"
+#include "nlohmann/json.hpp"
+#include "oneflow/core/common/util.h"
+#include "oneflow/core/job/plan_util.h"
+
+namespace oneflow {
+namespace test {
+
+namespace {
+
+TaskProto* AddTask(Plan* plan, int64_t task_id, int64_t thrd_id) {
+  TaskProto* task = plan->add_task();
+  task->set_task_type(TaskType::kNormalForward);
+  task->set_machine_id(0);
+  task->set_thrd_id(thrd_id);
+  task->set_task_id(task_id);
+  return task;
+}
+
+void AddRegst(TaskProto* producer, TaskProto* consumer, int64_t regst_desc_id,
+              int32_t register_num) {
+  RegstDescProto* regst_desc = &(*producer->mutable_produced_regst_desc())["out"];
+  regst_desc->set_regst_desc_id(regst_desc_id);
+  regst_desc->set_producer_task_id(producer->task_id());
+  regst_desc->add_consumer_task_id(consumer->task_id());
+  regst_desc->set_register_num(register_num);
+  regst_desc->set_min_register_num(1);
+  regst_desc->set_max_register_num(4);
+  regst_desc->mutable_regst_desc_type()->mutable_data_regst_desc();
+  (*consumer->mutable_consumed_regst_desc_id())["in"].add_regst_desc_id(regst_desc_id);
+}
+
+}  // namespace
+
+// A producer acting for 10us feeds a consumer acting for 30us on another stream through a
+// single register, so that the producer can only start once the consumer is done.
+TEST(PlanUtil, analyze_execution_of_register_bound_pipeline) {
+  Plan plan;
+  TaskProto* producer = AddTask(&plan, 1, 0);
+  TaskProto* consumer = AddTask(&plan, 2, 1);
+  AddRegst(producer, consumer, 10, 1);
+  HashMap<int64_t, std::vector<profiler::ActorActTime>> actor_id2acts;
+  for (int64_t k = 0; k < 4; ++k) {
+    actor_id2acts[1].emplace_back(profiler::ActorActTime{k, k * 40000, k * 40000 + 10000});
+    actor_id2acts[2].emplace_back(profiler::ActorActTime{k, k * 40000 + 10000, k * 40000 + 40000});
+  }
+  const auto report =
+      nlohmann::json::parse(CHECK_JUST(PlanUtil::AnalyzeExecution(plan, 0, actor_id2acts)));
+  ASSERT_EQ(report["iterations"].get<int64_t>(), 4);
+  ASSERT_DOUBLE_EQ(report["iteration_us"].get<double>(), 40);
+  ASSERT_DOUBLE_EQ(report["critical_path"]["length_us"].get<double>(), 40);
+  ASSERT_EQ(report["critical_path"]["actors"].size(), 2);
+  ASSERT_EQ(report["critical_path"]["actors"][0]["actor_id"].get<int64_t>(), 1);
+  ASSERT_EQ(report["critical_path"]["actors"][1]["actor_id"].get<int64_t>(), 2);
+  ASSERT_EQ(report["streams"].size(), 2);
+  ASSERT_EQ(report["regst_stalls"].size(), 1);
+  const auto& stall = report["regst_stalls"][0];
+  ASSERT_EQ(stall["regst_desc_id"].get<int64_t>(), 10);
+  // the producer waits 30us in 3 of the 4 iterations
+  ASSERT_DOUBLE_EQ(stall["stall_us_per_iter"].get<double>(), 22.5);
+  ASSERT_DOUBLE_EQ(stall["mean_hold_us"].get<double>(), 40);
+  ASSERT_EQ(stall["suggested_register_num"].get<int64_t>(), 2);
+  ASSERT_GE(report["suggestions"].size(), 1);
+}
+
+TEST(PlanUtil, analyze_execution_without_stalls) {
+  Plan plan;
+  TaskProto* producer = AddTask(&plan, 1, 0);
+  TaskProto* consumer = AddTask(&plan, 2, 1);
+  AddRegst(producer, consumer, 10, 2);
+  HashMap<int64_t, std::vector<profiler::ActorActTime>> actor_id2acts;
+  for (int64_t k = 0; k < 4; ++k) {
+    actor_id2acts[1].emplace_back(profiler::ActorActTime{k, k * 20000, k * 20000 + 10000});
+    actor_id2acts[2].emplace_back(profiler::ActorActTime{k, k * 20000 + 10000, k * 20000 + 20000});
+  }
+  const auto report =
+      nlohmann::json::parse(CHECK_JUST(PlanUtil::AnalyzeExecution(plan, 0, actor_id2acts)));
+  ASSERT_EQ(report["regst_stalls"].size(), 0);
+  ASSERT_EQ(report["comm_waits"].size(), 0);
+}
+
+// The ring buffer of the producer's thread has kept fewer acts than the one of the consumer's, and
+// the trace was stopped during iteration 6, so acts are paired by act id in iterations 7 to 9.
+TEST(PlanUtil, analyze_execution_aligns_acts_by_act_id) {
+  Plan plan;
+  TaskProto* producer = AddTask(&plan, 1, 0);
+  TaskProto* consumer = AddTask(&plan, 2, 1);
+  AddRegst(producer, consumer, 10, 1);
+  HashMap<int64_t, std::vector<profiler::ActorActTime>> actor_id2acts;
+  for (int64_t k = 0; k < 10; ++k) {
+    if (k >= 4 && k != 6) {
+      actor_id2acts[1].emplace_back(profiler::ActorActTime{k, k * 40000, k * 40000 + 10000});
+    }
+    actor_id2acts[2].emplace_back(profiler::ActorActTime{k, k * 40000 + 10000, k * 40000 + 40000});
+  }
+  const auto report =
+      nlohmann::json::parse(CHECK_JUST(PlanUtil::AnalyzeExecution(plan, 0, actor_id2acts)));
+  ASSERT_EQ(report["iterations"].get<int64_t>(), 3);
+  ASSERT_DOUBLE_EQ(report["iteration_us"].get<double>(), 40);
+  ASSERT_EQ(report["regst_stalls"].size(), 1);
+  const auto& stall = report["regst_stalls"][0];
+  // the producer waits 30us in 2 of the 3 iterations
+  ASSERT_DOUBLE_EQ(stall["stall_us_per_iter"].get<double>(), 20);
+  ASSERT_DOUBLE_EQ(stall["mean_hold_us"].get<double>(), 40);
+}
+
+}  // namespace test
+}  // namespace oneflow
@@ -17,6 +17,7 @@ limitations under the License.
 #include "oneflow/core/control/global_process_ctx.h"
 #include "oneflow/core/job/runtime_job_descs.h"
 #include "oneflow/core/lazy/stream_context/include/stream_context.h"
+#include "oneflow/core/profiler/actor_tracer.h"
 
 namespace oneflow {
 
@@ -176,6 +177,7 @@ void Actor::Init(const JobDesc* job_desc, ActorContext* actor_ctx) {
   }
 
   total_reading_cnt_ = 0;
+  act_cnt_ = 0;
   is_inplace_consumed_eord_ = false;
   CheckInplaceRegstDescId(task_proto);
   TakeOverInplaceConsumedAndProduced(task_proto.produced_regst_desc());
@@ -420,7 +422,11 @@ int Actor::HandlerZombie(const ActorMsg& msg) {
 void Actor::ActUntilFail() {
   while (IsReadReady() && IsWriteReady()) {
     PrepareProducedNaiveInplaceDataRegst();
-    Act();
+    {
+      profiler::ActorTraceGuard trace_guard(profiler::ActorTraceEventType::kAct, actor_id_,
+                                            act_cnt_++);
+      Act();
+    }
 
     AsyncSendCustomizedProducedRegstMsgToConsumer();
     AsyncSendNaiveProducedRegstMsgToConsumer();
@@ -540,7 +546,8 @@ bool Actor::IsWriteReady() const {
 }
 
 void Actor::AsyncLaunchKernel(std::function<Regst*(int64_t)> Regst4RegstDescId) {
-  for (const ExecKernel& ek : exec_kernel_vec_) {
+  for (int64_t i = 0; i < exec_kernel_vec_.size(); ++i) {
+    const ExecKernel& ek = exec_kernel_vec_.at(i);
     CHECK_NOTNULL(dynamic_cast<KernelContextImpl*>(ek.kernel_ctx.get()))
         ->UpdateBnInOp2BlobFn([&](const std::string& bn_in_op) -> Blob* {
           const auto blob_info_it = ek.bn_in_op2blob_info.find(bn_in_op);
@@ -560,6 +567,7 @@ void Actor::AsyncLaunchKernel(std::function<Regst*(int64_t)> Regst4RegstDescId)
             return regst->GetBlobByLbi(info.lbi);
           }
         });
+    profiler::ActorKernelTraceGuard trace_guard(actor_id_, i, actor_ctx_);
     ek.kernel->Launch(ek.kernel_ctx.get());
   }
 }
@@ -198,6 +198,7 @@ class Actor : public ActorBase {
   HashMap<int64_t, std::vector<std::unique_ptr<Regst>>> produced_regsts_;
   HashMap<Regst*, int64_t> produced_regst2reading_cnt_;
   int64_t total_reading_cnt_;
+  int64_t act_cnt_;
 
   RegstSlot naive_produced_rs_;
   RegstSlot naive_consumed_rs_;
@@ -18,6 +18,7 @@ limitations under the License.
 #include "oneflow/core/job/id_manager.h"
 #include "oneflow/core/thread/thread_manager.h"
 #include "oneflow/core/comm_network/comm_network.h"
+#include "oneflow/core/profiler/actor_tracer.h"
 
 namespace oneflow {
 
@@ -26,6 +27,8 @@ void ActorMsgBus::SendMsg(const ActorMsg& msg) {
   if (dst_machine_id == GlobalProcessCtx::Rank()) {
     SendMsgWithoutCommNet(msg);
   } else {
+    profiler::RecordActorTraceMsg(profiler::ActorTraceEventType::kSendMsg, msg.src_actor_id(),
+                                  msg.dst_actor_id());
     if (msg.IsDataRegstMsgToConsumer()) {
       int64_t comm_net_sequence;
       {
@@ -28,6 +28,7 @@ limitations under the License.
 #include "oneflow/core/common/util.h"
 #include "oneflow/core/kernel/user_kernel.h"
 #include "oneflow/core/lazy/stream_context/include/stream_context.h"
+#include "oneflow/core/profiler/actor_tracer.h"
 
 #ifdef WITH_CUDA
 
@@ -264,6 +265,7 @@ class LightActor : public ActorBase, public KernelContext, public ActorContextPr
     const int64_t thrd_id = ThrdId4ActorId(task_proto.task_id());
     thread_ = Singleton<ThreadMgr>::Get()->GetThrd(thrd_id);
     total_reading_cnt_ = 0;
+    act_cnt_ = 0;
     max_total_reading_cnt_ = 0;
     remaining_eord_cnt_ = 0;
     ready_consumed_ = 0;
@@ -522,6 +524,8 @@ class LightActor : public ActorBase, public KernelContext, public ActorContextPr
   }
 
   inline void ActOnce() {
+    profiler::ActorTraceGuard trace_guard(profiler::ActorTraceEventType::kAct,
+                                          actor_ctx_->task_proto().task_id(), act_cnt_++);
     if (OF_PREDICT_FALSE(sync_post_act_msgs_.empty() && async_post_act_msgs_.empty())) {
       InitBnInOp2Blob();
       InitActMsg();
@@ -562,6 +566,8 @@ class LightActor : public ActorBase, public KernelContext, public ActorContextPr
   }
 
   inline void LaunchKernel() {
+    profiler::ActorKernelTraceGuard trace_guard(actor_ctx_->task_proto().task_id(), 0,
+                                                actor_ctx_);
 #ifdef WITH_CUDA_GRAPHS
     bool is_capturing = false;
     if (cuda_graph_exec_[0]) {
@@ -696,6 +702,7 @@ class LightActor : public ActorBase, public KernelContext, public ActorContextPr
   std::vector<ActorMsg> sync_post_act_msgs_;
   std::vector<ActorMsg> async_post_act_msgs_;
   KernelObserver* stream_kernel_observer_;
+  int64_t act_cnt_;
 };
 
 template<int kernel_exec, int inplace, typename IndexType, typename RegstIndex,
@@ -17,26 +17,281 @@ limitations under the License.
 #include "oneflow/core/common/preprocessor.h"
 #include "oneflow/core/ndarray/ndarray_reduce_impl.h"
 #include "oneflow/core/ndarray/binary_func.h"
+#include "oneflow/core/ep/cpu/cpu_stream.h"
 
 namespace oneflow {
 
-#define SPECIALIZE_CPU_NDARRAY_REDUCE_IMPL(struct_name)                                        \
-  template<typename T, template<typename> class binary_func>                                   \
-  struct struct_name<DeviceType::kCPU, T, binary_func> final {                                 \
-    using RetT = typename BinaryFuncTrait<binary_func, T>::return_type;                        \
-    static bool Matched(const XpuVarNdarray<RetT>& y, const XpuVarNdarray<const T>& x) {       \
-      return false;                                                                            \
-    }                                                                                          \
-    static void Reduce(ep::Stream* stream, const XpuVarNdarray<RetT>& y,                       \
-                       const XpuVarNdarray<const T>& x, const XpuVarNdarray<T>& tmp_storage) { \
-      UNIMPLEMENTED();                                                                         \
-    }                                                                                          \
-  }
-SPECIALIZE_CPU_NDARRAY_REDUCE_IMPL(NdarrayScalarReduce);
-SPECIALIZE_CPU_NDARRAY_REDUCE_IMPL(NdarrayMatrixRowReduce);
-SPECIALIZE_CPU_NDARRAY_REDUCE_IMPL(NdarrayMatrixColReduce);
-SPECIALIZE_CPU_NDARRAY_REDUCE_IMPL(NdarrayXYZCubeXZReduce);
-#undef SPECIALIZE_CPU_NDARRAY_REDUCE_IMPL
+namespace {
+
+// Independent accumulators the inner loops are unrolled into, so that they can be vectorized
+// without reassociating a single dependency chain.
+constexpr int64_t kNumReduceLanes = 8;
+// Contiguous reductions are split in halves until at most this many elements are left, which
+// bounds the rounding error of summation by O(log(n)) instead of O(n).
+constexpr int64_t kPairwiseReduceBlockSize = 128;
+// Number of elements reduced by one parallel task. It only depends on the shape, so the partial
+// results and the order they are combined in are independent of the number of threads.
+constexpr int64_t kParallelReduceBlockSize = 32768;
+// Rows of a column reduction accumulated by one parallel task before the pairwise combination of
+// the per-task partial results.
+constexpr int64_t kColReduceRowBlockSize = 128;
+// Columns of a column reduction processed by one parallel task.
+constexpr int64_t kColReduceColBlockSize = 1024;
+
+int64_t DivUp(int64_t n, int64_t d) { return (n + d - 1) / d; }
+
+template<typename T, template<typename> class binary_func>
+T PairwiseReduce(const T* x, int64_t n) {
+  if (n <= kPairwiseReduceBlockSize) {
+    T lanes[kNumReduceLanes];
+    std::fill(lanes, lanes + kNumReduceLanes, UnitOfBinaryFunc<T, binary_func>::Val());
+    int64_t i = 0;
+    for (; i + kNumReduceLanes <= n; i += kNumReduceLanes) {
+      for (int64_t lane = 0; lane < kNumReduceLanes; ++lane) {
+        lanes[lane] = binary_func<T>::Invoke(lanes[lane], x[i + lane]);
+      }
+    }
+    for (; i < n; ++i) { lanes[0] = binary_func<T>::Invoke(lanes[0], x[i]); }
+    for (int64_t width = kNumReduceLanes / 2; width > 0; width /= 2) {
+      for (int64_t lane = 0; lane < width; ++lane) {
+        lanes[lane] = binary_func<T>::Invoke(lanes[lane], lanes[lane + width]);
+      }
+    }
+    return lanes[0];
+  }
+  const int64_t half = DivUp(n / 2, kNumReduceLanes) * kNumReduceLanes;
+  return binary_func<T>::Invoke(PairwiseReduce<T, binary_func>(x, half),
+                                PairwiseReduce<T, binary_func>(x + half, n - half));
+}
+
+// Reduces `num_partials` vectors of `size` elements stored `stride` apart into the first one,
+// combining neighbours pairwise.
+template<typename T, template<typename> class binary_func>
+void PairwiseReducePartials(T* partials, int64_t num_partials, int64_t stride, int64_t size) {
+  for (int64_t step = 1; step < num_partials; step *= 2) {
+    for (int64_t i = 0; i + step < num_partials; i += 2 * step) {
+      T* dst = partials + i * stride;
+      const T* src = partials + (i + step) * stride;
+      for (int64_t j = 0; j < size; ++j) { dst[j] = binary_func<T>::Invoke(dst[j], src[j]); }
+    }
+  }
+}
+
+// Reduces each row of the `num_rows` x `num_cols` matrix `x` into `y`. Partial results of long
+// rows are kept in `tmp`, which holds at least as many elements as `x`.
+template<typename T, template<typename> class binary_func>
+void ParallelRowReduce(ep::Stream* stream, int64_t num_rows, int64_t num_cols, const T* x, T* y,
+                       T* tmp) {
+  auto* cpu_stream = stream->As<ep::CpuStream>();
+  if (num_cols <= kParallelReduceBlockSize) {
+    const int64_t num_rows_per_block = std::max<int64_t>(kParallelReduceBlockSize / num_cols, 1);
+    const int64_t num_blocks = DivUp(num_rows, num_rows_per_block);
+    cpu_stream->ParallelFor(
+        0, num_blocks,
+        [&](int64_t begin, int64_t end) {
+          for (int64_t i = begin * num_rows_per_block;
+               i < std::min(end * num_rows_per_block, num_rows); ++i) {
+            y[i] = PairwiseReduce<T, binary_func>(x + i * num_cols, num_cols);
+          }
+        },
+        1);
+    return;
+  }
+  // Long rows are split into blocks reduced in parallel, then each row combines its blocks.
+  const int64_t num_blocks_per_row = DivUp(num_cols, kParallelReduceBlockSize);
+  T* partials = tmp;
+  cpu_stream->ParallelFor(
+      0, num_rows * num_blocks_per_row,
+      [&](int64_t begin, int64_t end) {
+        for (int64_t i = begin; i < end; ++i) {
+          const int64_t row = i / num_blocks_per_row;
+          const int64_t col = (i % num_blocks_per_row) * kParallelReduceBlockSize;
+          partials[i] = PairwiseReduce<T, binary_func>(
+              x + row * num_cols + col, std::min(kParallelReduceBlockSize, num_cols - col));
+        }
+      },
+      1);
+  for (int64_t row = 0; row < num_rows; ++row) {
+    y[row] =
+        PairwiseReduce<T, binary_func>(partials + row * num_blocks_per_row, num_blocks_per_row);
+  }
+}
+
+// Reduces each column of the `num_rows` x `num_cols` matrix `x` into `y`. Tasks accumulate a
+// block of rows for a block of columns, which keeps the inner loop contiguous over columns, and
+// the per row block partial results, kept in `tmp` which holds at least as many elements as `x`,
+// are combined pairwise.
+template<typename T, template<typename> class binary_func>
+void ParallelColReduce(ep::Stream* stream, int64_t num_rows, int64_t num_cols, const T* x, T* y,
+                       T* tmp) {
+  auto* cpu_stream = stream->As<ep::CpuStream>();
+  const int64_t num_row_blocks = DivUp(num_rows, kColReduceRowBlockSize);
+  const int64_t num_col_blocks = DivUp(num_cols, kColReduceColBlockSize);
+  T* partials = num_row_blocks > 1 ? tmp : y;
+  cpu_stream->ParallelFor(
+      0, num_row_blocks * num_col_blocks,
+      [&](int64_t begin, int64_t end) {
+        for (int64_t i = begin; i < end; ++i) {
+          const int64_t row_block = i / num_col_blocks;
+          const int64_t col_begin = (i % num_col_blocks) * kColReduceColBlockSize;
+          const int64_t col_end = std::min(col_begin + kColReduceColBlockSize, num_cols);
+          const int64_t row_begin = row_block * kColReduceRowBlockSize;
+          const int64_t row_end = std::min(row_begin + kColReduceRowBlockSize, num_rows);
+          T* dst = partials + row_block * num_cols;
+          std::fill(dst + col_begin, dst + col_end, UnitOfBinaryFunc<T, binary_func>::Val());
+          for (int64_t row = row_begin; row < row_end; ++row) {
+            const T* src = x + row * num_cols;
+            for (int64_t col = col_begin; col < col_end; ++col) {
+              dst[col] = binary_func<T>::Invoke(dst[col], src[col]);
+            }
+          }
+        }
+      },
+      1);
+  if (num_row_blocks == 1) { return; }
+  cpu_stream->ParallelFor(
+      0, num_col_blocks,
+      [&](int64_t begin, int64_t end) {
+        const int64_t col_begin = begin * kColReduceColBlockSize;
+        const int64_t col_end = std::min(end * kColReduceColBlockSize, num_cols);
+        PairwiseReducePartials<T, binary_func>(partials + col_begin, num_row_blocks, num_cols,
+                                               col_end - col_begin);
+        std::copy(partials + col_begin, partials + col_end, y + col_begin);
+      },
+      1);
+}
+
+// Reduces the x and z axes of the (x, y, z) cube `x` into `y`: the x axis as a column reduction
+// of the (x, y * z) matrix, then the z axis as a row reduction of the (y, z) matrix. The (y, z)
+// matrix is kept at the beginning of `tmp` and the partial results of both reductions after it.
+template<typename T, template<typename> class binary_func>
+void ParallelXYZCubeXZReduce(ep::Stream* stream, int64_t dim_x, int64_t dim_y, int64_t dim_z,
+                             const T* x, T* y, T* tmp) {
+  if (dim_x == 1) {
+    ParallelRowReduce<T, binary_func>(stream, dim_y, dim_z, x, y, tmp);
+    return;
+  }
+  T* yz = tmp;
+  T* partials = tmp + dim_y * dim_z;
+  ParallelColReduce<T, binary_func>(stream, dim_x, dim_y * dim_z, x, yz, partials);
+  ParallelRowReduce<T, binary_func>(stream, dim_y, dim_z, yz, y, partials);
+}
+
+// Logical reductions (any, all) return bool rather than T, they are never matched and always
+// take the NdarrayDefaultReduce path.
+template<typename T, template<typename> class binary_func>
+struct CpuReduceUtil final {
+  using RetT = typename BinaryFuncTrait<binary_func, T>::return_type;
+  static constexpr bool kSupported = std::is_same<T, RetT>::value;
+
+  template<typename U = RetT>
+  static typename std::enable_if<std::is_same<T, U>::value>::type RowReduce(
+      ep::Stream* stream, int64_t num_rows, int64_t num_cols, const T* x, U* y, T* tmp) {
+    ParallelRowReduce<T, binary_func>(stream, num_rows, num_cols, x, y, tmp);
+  }
+  template<typename U = RetT>
+  static typename std::enable_if<std::is_same<T, U>::value>::type ColReduce(
+      ep::Stream* stream, int64_t num_rows, int64_t num_cols, const T* x, U* y, T* tmp) {
+    ParallelColReduce<T, binary_func>(stream, num_rows, num_cols, x, y, tmp);
+  }
+  template<typename U = RetT>
+  static typename std::enable_if<std::is_same<T, U>::value>::type XYZCubeXZReduce(
+      ep::Stream* stream, int64_t dim_x, int64_t dim_y, int64_t dim_z, const T* x, U* y, T* tmp) {
+    ParallelXYZCubeXZReduce<T, binary_func>(stream, dim_x, dim_y, dim_z, x, y, tmp);
+  }
+
+  template<typename U = RetT>
+  static typename std::enable_if<!std::is_same<T, U>::value>::type RowReduce(
+      ep::Stream* stream, int64_t num_rows, int64_t num_cols, const T* x, U* y, T* tmp) {
+    UNIMPLEMENTED();
+  }
+  template<typename U = RetT>
+  static typename std::enable_if<!std::is_same<T, U>::value>::type ColReduce(
+      ep::Stream* stream, int64_t num_rows, int64_t num_cols, const T* x, U* y, T* tmp) {
+    UNIMPLEMENTED();
+  }
+  template<typename U = RetT>
+  static typename std::enable_if<!std::is_same<T, U>::value>::type XYZCubeXZReduce(
+      ep::Stream* stream, int64_t dim_x, int64_t dim_y, int64_t dim_z, const T* x, U* y, T* tmp) {
+    UNIMPLEMENTED();
+  }
+};
+
+}  // namespace
+
+template<typename T, template<typename> class binary_func>
+struct NdarrayScalarReduce<DeviceType::kCPU, T, binary_func> final {
+  using RetT = typename BinaryFuncTrait<binary_func, T>::return_type;
+  static bool Matched(const XpuVarNdarray<RetT>& y, const XpuVarNdarray<const T>& x) {
+    return CpuReduceUtil<T, binary_func>::kSupported && y.shape().ElemNum() == 1;
+  }
+
+  static void Reduce(ep::Stream* stream, const XpuVarNdarray<RetT>& y,
+                     const XpuVarNdarray<const T>& x, const XpuVarNdarray<T>& tmp_storage) {
+    CHECK(Matched(y, x));
+    CHECK_GE(tmp_storage.shape().ElemNum(), x.shape().ElemNum());
+    CpuReduceUtil<T, binary_func>::RowReduce(stream, 1, x.shape().ElemNum(), x.ptr(), y.ptr(),
+                                             tmp_storage.ptr());
+  }
+};
+
+template<typename T, template<typename> class binary_func>
+struct NdarrayMatrixRowReduce<DeviceType::kCPU, T, binary_func> final {
+  using RetT = typename BinaryFuncTrait<binary_func, T>::return_type;
+  static bool Matched(const XpuVarNdarray<RetT>& y, const XpuVarNdarray<const T>& x) {
+    if (!CpuReduceUtil<T, binary_func>::kSupported) { return false; }
+    if (x.shape().NumAxes() != 2) { return false; }
+    if (y.shape().NumAxes() != 2) { return false; }
+    return x.shape().At(0) == y.shape().At(0) && y.shape().At(1) == 1;
+  }
+
+  static void Reduce(ep::Stream* stream, const XpuVarNdarray<RetT>& y,
+                     const XpuVarNdarray<const T>& x, const XpuVarNdarray<T>& tmp_storage) {
+    CHECK(Matched(y, x));
+    CHECK_GE(tmp_storage.shape().ElemNum(), x.shape().ElemNum());
+    CpuReduceUtil<T, binary_func>::RowReduce(stream, x.shape().At(0), x.shape().At(1), x.ptr(),
+                                             y.ptr(), tmp_storage.ptr());
+  }
+};
+
+template<typename T, template<typename> class binary_func>
+struct NdarrayMatrixColReduce<DeviceType::kCPU, T, binary_func> final {
+  using RetT = typename BinaryFuncTrait<binary_func, T>::return_type;
+  static bool Matched(const XpuVarNdarray<RetT>& y, const XpuVarNdarray<const T>& x) {
+    if (!CpuReduceUtil<T, binary_func>::kSupported) { return false; }
+    if (x.shape().NumAxes() != 2) { return false; }
+    if (y.shape().NumAxes() != 2) { return false; }
+    return y.shape().At(0) == 1 && x.shape().At(1) == y.shape().At(1);
+  }
+
+  static void Reduce(ep::Stream* stream, const XpuVarNdarray<RetT>& y,
+                     const XpuVarNdarray<const T>& x, const XpuVarNdarray<T>& tmp_storage) {
+    CHECK(Matched(y, x));
+    CHECK_GE(tmp_storage.shape().ElemNum(), x.shape().ElemNum());
+    CpuReduceUtil<T, binary_func>::ColReduce(stream, x.shape().At(0), x.shape().At(1), x.ptr(),
+                                             y.ptr(), tmp_storage.ptr());
+  }
+};
+
+template<typename T, template<typename> class binary_func>
+struct NdarrayXYZCubeXZReduce<DeviceType::kCPU, T, binary_func> final {
+  using RetT = typename BinaryFuncTrait<binary_func, T>::return_type;
+  static bool Matched(const XpuVarNdarray<RetT>& y, const XpuVarNdarray<const T>& x) {
+    if (!CpuReduceUtil<T, binary_func>::kSupported) { return false; }
+    if (x.shape().NumAxes() != 3) { return false; }
+    if (y.shape().NumAxes() != 3) { return false; }
+    return y.shape().At(0) == 1 && x.shape().At(1) == y.shape().At(1) && y.shape().At(2) == 1;
+  }
+
+  static void Reduce(ep::Stream* stream, const XpuVarNdarray<RetT>& y,
+                     const XpuVarNdarray<const T>& x, const XpuVarNdarray<T>& tmp_storage) {
+    CHECK(Matched(y, x));
+    CHECK_GE(tmp_storage.shape().ElemNum(), x.shape().ElemNum());
+    CpuReduceUtil<T, binary_func>::XYZCubeXZReduce(stream, x.shape().At(0), x.shape().At(1),
+                                                   x.shape().At(2), x.ptr(), y.ptr(),
+                                                   tmp_storage.ptr());
+  }
+};
 
 #define INSTANTIATE_NDARRAY_REDUCE_IMPL(dtype, binary_func)                                       \
   template struct NdarrayScalarReduce<DeviceType::kCPU, OF_PP_PAIR_FIRST(dtype), binary_func>;    \
@@ -0,0 +1,384 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "oneflow/core/profiler/actor_tracer.h"
+#include <algorithm>
+#include <mutex>
+#include "nlohmann/json.hpp"
+#include "oneflow/core/rpc/include/global_process_ctx.h"
+#include "oneflow/core/lazy/actor/actor_context.h"
+#include "oneflow/core/lazy/stream_context/include/stream_context.h"
+#include "oneflow/core/ep/cuda/cuda_stream.h"
+#include "oneflow/core/ep/cuda/cuda_device.h"
+
+namespace oneflow {
+
+namespace profiler {
+
+std::atomic<bool> actor_trace_enabled(false);
+
+namespace {
+
+// Single writer ring buffer, the writer never waits for readers. A reader drops the records
+// which may have been overwritten while it copied them.
+class ActorTraceBuffer final {
+ public:
+  OF_DISALLOW_COPY_AND_MOVE(ActorTraceBuffer);
+  ActorTraceBuffer(size_t capacity, int32_t tid, const std::string& name)
+      : records_(capacity),
+        mask_(capacity - 1),
+        head_(0),
+        cleared_head_(0),
+        tid_(tid),
+        name_(name) {}
+  ~ActorTraceBuffer() = default;
+
+  void Push(const ActorTraceRecord& record) {
+    const uint64_t head = head_.load(std::memory_order_relaxed);
+    records_[head & mask_] = record;
+    head_.store(head + 1, std::memory_order_release);
+  }
+
+  void Snapshot(std::vector<ActorTraceRecord>* records) const {
+    const uint64_t capacity = records_.size();
+    const uint64_t head = head_.load(std::memory_order_acquire);
+    // a concurrent Clear may have seen a newer head
+    const uint64_t cleared_head = std::min(cleared_head_.load(std::memory_order_relaxed), head);
+    const uint64_t begin = std::max<uint64_t>(head > capacity ? head - capacity : 0, cleared_head);
+    records->clear();
+    records->reserve(head - begin);
+    for (uint64_t i = begin; i < head; ++i) { records->push_back(records_[i & mask_]); }
+    std::atomic_thread_fence(std::memory_order_acquire);
+    // the writer may be writing the slot of the record `new_head - capacity`
+    const uint64_t new_head = head_.load(std::memory_order_relaxed);
+    if (new_head + 1 > begin + capacity) {
+      const uint64_t num_dropped =
+          std::min<uint64_t>(new_head + 1 - capacity - begin, head - begin);
+      records->erase(records->begin(), records->begin() + num_dropped);
+    }
+  }
+
+  // the records pushed so far are skipped by later snapshots, the writer is not involved
+  void Clear() {
+    cleared_head_.store(head_.load(std::memory_order_acquire), std::memory_order_relaxed);
+  }
+
+  int32_t tid() const { return tid_; }
+  const std::string& name() const { return name_; }
+  void set_name(const std::string& name) { name_ = name; }
+
+ private:
+  std::vector<ActorTraceRecord> records_;
+  uint64_t mask_;
+  std::atomic<uint64_t> head_;
+  std::atomic<uint64_t> cleared_head_;
+  int32_t tid_;
+  std::string name_;
+};
+
+struct ActorTraceRegistry {
+  std::mutex mutex;
+  std::vector<std::unique_ptr<ActorTraceBuffer>> buffers;
+  HashMap<int64_t, std::string> actor_id2name;
+};
+
+// Never destroyed, threads may still record when static objects are destroyed.
+ActorTraceRegistry* GetActorTraceRegistry() {
+  static ActorTraceRegistry* registry = new ActorTraceRegistry();
+  return registry;
+}
+
+size_t GetActorTraceBufferSize() {
+  static const size_t buffer_size = []() {
+    const int64_t size = ParseIntegerFromEnv("ONEFLOW_ACTOR_TRACE_BUFFER_SIZE", 1 << 16);
+    CHECK_GT(size, 0) << "ONEFLOW_ACTOR_TRACE_BUFFER_SIZE should be positive";
+    size_t capacity = 1;
+    while (capacity < static_cast<size_t>(size)) { capacity <<= 1; }
+    return capacity;
+  }();
+  return buffer_size;
+}
+
+thread_local ActorTraceBuffer* thread_buffer = nullptr;
+thread_local std::string thread_name;
+
+ActorTraceBuffer* GetThreadActorTraceBuffer() {
+  if (OF_PREDICT_FALSE(thread_buffer == nullptr)) {
+    auto* registry = GetActorTraceRegistry();
+    std::unique_lock<std::mutex> lock(registry->mutex);
+    const int32_t tid = registry->buffers.size();
+    const std::string name = thread_name.empty() ? "thread " + std::to_string(tid) : thread_name;
+    registry->buffers.emplace_back(new ActorTraceBuffer(GetActorTraceBufferSize(), tid, name));
+    thread_buffer = registry->buffers.back().get();
+  }
+  return thread_buffer;
+}
+
+void InitActorTrace() {
+  if (ParseBooleanFromEnv("ONEFLOW_ACTOR_TRACE", false)) { EnableActorTrace(); }
+}
+
+COMMAND(InitActorTrace());
+
+double ToMicroseconds(time_t ns) { return static_cast<double>(ns) / 1000.0; }
+
+void RecordActorTraceOfThread(int32_t tid, ActorTraceEventType type, int64_t actor_id,
+                              int64_t arg, time_t begin_ns, time_t end_ns) {
+  GetThreadActorTraceBuffer()->Push(
+      ActorTraceRecord{begin_ns, end_ns, actor_id, arg, type, tid});
+}
+
+#if defined(WITH_CUDA)
+
+// The timing events of the traced kernels of every device. Creating and destroying events may
+// synchronize, so they are reused: an actor thread takes two events for a kernel and the callback
+// gives them back when the stream has run the kernel.
+class CudaTimingEventPool final {
+ public:
+  OF_DISALLOW_COPY_AND_MOVE(CudaTimingEventPool);
+  CudaTimingEventPool() = default;
+  ~CudaTimingEventPool() = default;
+
+  cudaEvent_t Get(int device_index) {
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      std::vector<cudaEvent_t>* events = &device_index2events_[device_index];
+      if (!events->empty()) {
+        cudaEvent_t event = events->back();
+        events->pop_back();
+        return event;
+      }
+    }
+    CudaCurrentDeviceGuard guard(device_index);
+    cudaEvent_t event = nullptr;
+    OF_CUDA_CHECK(cudaEventCreate(&event));
+    return event;
+  }
+
+  void Put(int device_index, cudaEvent_t event) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    device_index2events_[device_index].push_back(event);
+  }
+
+ private:
+  std::mutex mutex_;
+  HashMap<int, std::vector<cudaEvent_t>> device_index2events_;
+};
+
+// Never destroyed, the callbacks may give events back when static objects are destroyed.
+CudaTimingEventPool* GetCudaTimingEventPool() {
+  static CudaTimingEventPool* pool = new CudaTimingEventPool();
+  return pool;
+}
+
+#endif  // WITH_CUDA
+
+}  // namespace
+
+void EnableActorTrace() { actor_trace_enabled.store(true, std::memory_order_relaxed); }
+
+void DisableActorTrace() { actor_trace_enabled.store(false, std::memory_order_relaxed); }
+
+void ClearActorTrace() {
+  auto* registry = GetActorTraceRegistry();
+  std::unique_lock<std::mutex> lock(registry->mutex);
+  for (const auto& buffer : registry->buffers) { buffer->Clear(); }
+}
+
+void RecordActorTrace(ActorTraceEventType type, int64_t actor_id, int64_t arg, time_t begin_ns,
+                      time_t end_ns) {
+  RecordActorTraceOfThread(GetThreadActorTraceBuffer()->tid(), type, actor_id, arg, begin_ns,
+                           end_ns);
+}
+
+void ActorKernelTraceGuard::BeginKernel() {
+#if defined(WITH_CUDA)
+  auto* cuda_stream = dynamic_cast<ep::CudaStream*>(actor_ctx_->stream_ctx()->stream());
+  if (cuda_stream == nullptr) { return; }
+#if defined(WITH_CUDA_GRAPHS)
+  // the kernels captured into a cuda graph don't run on the stream
+  if (cuda_stream->IsGraphCapturing()) { return; }
+#endif  // WITH_CUDA_GRAPHS
+  start_event_ = GetCudaTimingEventPool()->Get(cuda_stream->device()->device_index());
+  OF_CUDA_CHECK(cudaEventRecord(start_event_, cuda_stream->cuda_stream()));
+#endif  // WITH_CUDA
+}
+
+void ActorKernelTraceGuard::EndKernel() {
+#if defined(WITH_CUDA)
+  if (start_event_ != nullptr) {
+    auto* cuda_stream = static_cast<ep::CudaStream*>(actor_ctx_->stream_ctx()->stream());
+    const int device_index = cuda_stream->device()->device_index();
+    cudaEvent_t start_event = start_event_;
+    cudaEvent_t end_event = GetCudaTimingEventPool()->Get(device_index);
+    OF_CUDA_CHECK(cudaEventRecord(end_event, cuda_stream->cuda_stream()));
+    // the record is pushed by the callback thread into the row of the actor thread
+    const int32_t tid = GetThreadActorTraceBuffer()->tid();
+    const int64_t actor_id = actor_id_;
+    const int64_t kernel_index = kernel_index_;
+    const time_t begin_ns = begin_ns_;
+    actor_ctx_->AddCallback([=]() {
+      float elapsed_ms = 0;
+      OF_CUDA_CHECK(cudaEventElapsedTime(&elapsed_ms, start_event, end_event));
+      GetCudaTimingEventPool()->Put(device_index, start_event);
+      GetCudaTimingEventPool()->Put(device_index, end_event);
+      RecordActorTraceOfThread(tid, ActorTraceEventType::kKernel, actor_id, kernel_index,
+                               begin_ns, begin_ns + static_cast<time_t>(elapsed_ms * 1e6));
+    });
+    return;
+  }
+#endif  // WITH_CUDA
+  RecordActorTrace(ActorTraceEventType::kKernel, actor_id_, kernel_index_, begin_ns_,
+                   GetTimeNow(true));
+}
+
+void SetActorTraceThreadName(const std::string& name) {
+  thread_name = name;
+  if (thread_buffer != nullptr) {
+    auto* registry = GetActorTraceRegistry();
+    std::unique_lock<std::mutex> lock(registry->mutex);
+    thread_buffer->set_name(name);
+  }
+}
+
+void SetActorTraceActorName(int64_t actor_id, const std::string& name) {
+  auto* registry = GetActorTraceRegistry();
+  std::unique_lock<std::mutex> lock(registry->mutex);
+  registry->actor_id2name[actor_id] = name;
+}
+
+namespace {
+
+void ForEachActorTraceRecord(const std::function<void(const ActorTraceRecord&)>& Handler) {
+  auto* registry = GetActorTraceRegistry();
+  std::vector<const ActorTraceBuffer*> buffers;
+  {
+    std::unique_lock<std::mutex> lock(registry->mutex);
+    for (const auto& buffer : registry->buffers) { buffers.emplace_back(buffer.get()); }
+  }
+  std::vector<ActorTraceRecord> records;
+  for (const ActorTraceBuffer* buffer : buffers) {
+    buffer->Snapshot(&records);
+    for (const ActorTraceRecord& record : records) { Handler(record); }
+  }
+}
+
+}  // namespace
+
+void CollectActorActTimes(HashMap<int64_t, std::vector<ActorActTime>>* actor_id2acts) {
+  actor_id2acts->clear();
+  ForEachActorTraceRecord([&](const ActorTraceRecord& record) {
+    if (record.type != ActorTraceEventType::kAct) { return; }
+    (*actor_id2acts)[record.actor_id].emplace_back(
+        ActorActTime{record.arg, record.begin_ns, record.end_ns});
+  });
+}
+
+void CollectActorKernelTimes(
+    HashMap<std::pair<int64_t, int64_t>, std::vector<time_t>>* actor_kernel2durations) {
+  actor_kernel2durations->clear();
+  ForEachActorTraceRecord([&](const ActorTraceRecord& record) {
+    if (record.type != ActorTraceEventType::kKernel) { return; }
+    (*actor_kernel2durations)[std::make_pair(record.actor_id, record.arg)].emplace_back(
+        record.end_ns - record.begin_ns);
+  });
+}
+
+Maybe<std::string> ExportActorTrace() {
+  using json = nlohmann::json;
+  auto* registry = GetActorTraceRegistry();
+  std::vector<std::pair<const ActorTraceBuffer*, std::string>> buffers;
+  HashMap<int64_t, std::string> actor_id2name;
+  {
+    std::unique_lock<std::mutex> lock(registry->mutex);
+    for (const auto& buffer : registry->buffers) {
+      buffers.emplace_back(buffer.get(), buffer->name());
+    }
+    actor_id2name = registry->actor_id2name;
+  }
+  const auto& ActorName = [&](int64_t actor_id) -> std::string {
+    const auto it = actor_id2name.find(actor_id);
+    if (it == actor_id2name.end()) { return "actor " + std::to_string(actor_id); }
+    return it->second;
+  };
+  const int64_t pid = GlobalProcessCtx::Rank();
+  json events = json::array();
+  events.push_back({{"name", "process_name"},
+                    {"ph", "M"},
+                    {"pid", pid},
+                    {"args", {{"name", "rank " + std::to_string(pid)}}}});
+  // An actor is bound to one thread, so that all its acts are in the same buffer and in order.
+  HashMap<int64_t, time_t> actor_id2last_act_end_ns;
+  // The kernels on cuda streams are recorded by the callback threads into the rows of the actor
+  // threads, out of order
+  std::vector<std::pair<time_t, json>> timed_events;
+  std::vector<ActorTraceRecord> records;
+  for (const auto& pair : buffers) {
+    pair.first->Snapshot(&records);
+    events.push_back({{"name", "thread_name"},
+                      {"ph", "M"},
+                      {"pid", pid},
+                      {"tid", pair.first->tid()},
+                      {"args", {{"name", pair.second}}}});
+    for (const ActorTraceRecord& record : records) {
+      json event{{"ts", ToMicroseconds(record.begin_ns)}, {"pid", pid}, {"tid", record.tid}};
+      if (record.type == ActorTraceEventType::kAct || record.type == ActorTraceEventType::kKernel) {
+        event["name"] = ActorName(record.actor_id);
+        event["ph"] = "X";
+        event["dur"] = ToMicroseconds(record.end_ns - record.begin_ns);
+        event["args"] = {{"actor_id", record.actor_id}};
+        if (record.type == ActorTraceEventType::kAct) {
+          event["cat"] = "act";
+          // the time since the previous act, in which the actor waited for its registers or for
+          // the other actors of its thread
+          const auto it = actor_id2last_act_end_ns.find(record.actor_id);
+          if (it != actor_id2last_act_end_ns.end()) {
+            event["args"]["wait_us"] = ToMicroseconds(record.begin_ns - it->second);
+          }
+          actor_id2last_act_end_ns[record.actor_id] = record.end_ns;
+        } else {
+          event["cat"] = "kernel";
+          event["args"]["kernel"] = record.arg;
+        }
+      } else if (record.type == ActorTraceEventType::kSendMsg) {
+        event["name"] = "send";
+        event["cat"] = "msg";
+        event["ph"] = "i";
+        event["s"] = "t";
+        event["args"] = {{"src_actor_id", record.actor_id}, {"dst_actor_id", record.arg}};
+      } else if (record.type == ActorTraceEventType::kRecvMsg) {
+        event["name"] = "recv";
+        event["cat"] = "msg";
+        event["ph"] = "i";
+        event["s"] = "t";
+        event["args"] = {{"src_actor_id", record.arg}, {"dst_actor_id", record.actor_id}};
+      } else {
+        UNIMPLEMENTED_THEN_RETURN();
+      }
+      timed_events.emplace_back(record.begin_ns, std::move(event));
+    }
+  }
+  std::stable_sort(timed_events.begin(), timed_events.end(),
+                   [](const std::pair<time_t, json>& lhs, const std::pair<time_t, json>& rhs) {
+                     return lhs.first < rhs.first;
+                   });
+  for (auto& pair : timed_events) { events.push_back(std::move(pair.second)); }
+  json trace{{"traceEvents", std::move(events)}, {"displayTimeUnit", "ns"}};
+  return trace.dump();
+}
+
+}  // namespace profiler
+
+}  // namespace oneflow
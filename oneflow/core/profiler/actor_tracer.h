@@ -0,0 +1,161 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#ifndef ONEFLOW_CORE_PROFILER_ACTOR_TRACER_H_
+#define ONEFLOW_CORE_PROFILER_ACTOR_TRACER_H_
+
+#include <atomic>
+#include "oneflow/core/common/util.h"
+#include "oneflow/core/common/maybe.h"
+#include "oneflow/core/profiler/util.h"
+
+#if defined(WITH_CUDA)
+struct CUevent_st;
+#endif  // WITH_CUDA
+
+namespace oneflow {
+
+class ActorContext;
+
+namespace profiler {
+
+// The actor tracer records the timeline of lazy graph actors into fixed size records kept in a
+// ring buffer per thread, so that it is cheap enough to be left on in live jobs. Only the newest
+// records of every thread are kept, see ONEFLOW_ACTOR_TRACE_BUFFER_SIZE. A record costs two clock
+// reads and a store into the ring buffer, under 1% of acts longer than about 40 us, see the
+// ActorTracer.RecordOverhead benchmark. A kernel on a cuda stream costs more, two cuda event
+// records taken from a locked pool and a stream callback, see the
+// ActorTracer.CudaKernelRecordOverhead benchmark.
+
+enum class ActorTraceEventType : int32_t {
+  kAct = 0,      // arg: act id, the number of acts of the actor before this one
+  kKernel = 1,   // arg: index of the kernel in the actor, see ActorKernelTraceGuard
+  kSendMsg = 2,  // arg: dst actor id
+  kRecvMsg = 3,  // arg: src actor id
+};
+
+struct ActorTraceRecord {
+  time_t begin_ns;
+  time_t end_ns;
+  int64_t actor_id;
+  int64_t arg;
+  ActorTraceEventType type;
+  // the thread of the actor, which is not the recording thread for the kernels on cuda streams
+  int32_t tid;
+};
+
+// An act recorded for an actor, its act id counts the acts of the actor since it was created.
+struct ActorActTime {
+  int64_t act_id;
+  time_t begin_ns;
+  time_t end_ns;
+};
+
+extern std::atomic<bool> actor_trace_enabled;
+
+inline bool IsActorTraceEnabled() { return actor_trace_enabled.load(std::memory_order_relaxed); }
+
+void EnableActorTrace();
+
+void DisableActorTrace();
+
+// Drops the records of all threads recorded so far, e.g. between two runs to analyze.
+void ClearActorTrace();
+
+// Appends a record to the ring buffer of the calling thread.
+void RecordActorTrace(ActorTraceEventType type, int64_t actor_id, int64_t arg, time_t begin_ns,
+                      time_t end_ns);
+
+inline void RecordActorTraceMsg(ActorTraceEventType type, int64_t actor_id, int64_t arg) {
+  if (OF_PREDICT_FALSE(IsActorTraceEnabled())) {
+    const time_t now = GetTimeNow(true);
+    RecordActorTrace(type, actor_id, arg, now, now);
+  }
+}
+
+// Names the rows of the calling thread and of the actor in the exported trace.
+void SetActorTraceThreadName(const std::string& name);
+void SetActorTraceActorName(int64_t actor_id, const std::string& name);
+
+// Returns the records of all threads in the Chrome trace event format, which Perfetto and
+// chrome://tracing open. The records are read without stopping the threads that write them.
+Maybe<std::string> ExportActorTrace();
+
+// Collects the recorded acts of every actor, in order.
+void CollectActorActTimes(HashMap<int64_t, std::vector<ActorActTime>>* actor_id2acts);
+
+// Collects the durations of the recorded kernels, keyed by the actor id and the index of the
+// kernel in the actor.
+void CollectActorKernelTimes(
+    HashMap<std::pair<int64_t, int64_t>, std::vector<time_t>>* actor_kernel2durations);
+
+class ActorTraceGuard final {
+ public:
+  OF_DISALLOW_COPY_AND_MOVE(ActorTraceGuard);
+  ActorTraceGuard(ActorTraceEventType type, int64_t actor_id, int64_t arg)
+      : type_(type),
+        actor_id_(actor_id),
+        arg_(arg),
+        begin_ns_(OF_PREDICT_FALSE(IsActorTraceEnabled()) ? GetTimeNow(true) : -1) {}
+  ~ActorTraceGuard() {
+    if (OF_PREDICT_FALSE(begin_ns_ >= 0)) {
+      RecordActorTrace(type_, actor_id_, arg_, begin_ns_, GetTimeNow(true));
+    }
+  }
+
+ private:
+  ActorTraceEventType type_;
+  int64_t actor_id_;
+  int64_t arg_;
+  time_t begin_ns_;
+};
+
+// Records a kernel of an actor. The kernels on cuda streams are launched asynchronously, so their
+// time is measured by cuda events recorded around the launch, and the record is appended by the
+// callback of the actor context when the stream has run the kernel. The record begins at the
+// launch and lasts the device time of the kernel. The kernels on other streams are recorded with
+// the host time of the launch.
+class ActorKernelTraceGuard final {
+ public:
+  OF_DISALLOW_COPY_AND_MOVE(ActorKernelTraceGuard);
+  ActorKernelTraceGuard(int64_t actor_id, int64_t kernel_index, ActorContext* actor_ctx)
+      : actor_id_(actor_id),
+        kernel_index_(kernel_index),
+        actor_ctx_(actor_ctx),
+        begin_ns_(OF_PREDICT_FALSE(IsActorTraceEnabled()) ? GetTimeNow(true) : -1) {
+    if (OF_PREDICT_FALSE(begin_ns_ >= 0)) { BeginKernel(); }
+  }
+  ~ActorKernelTraceGuard() {
+    if (OF_PREDICT_FALSE(begin_ns_ >= 0)) { EndKernel(); }
+  }
+
+ private:
+  void BeginKernel();
+  void EndKernel();
+
+  int64_t actor_id_;
+  int64_t kernel_index_;
+  ActorContext* actor_ctx_;
+  time_t begin_ns_;
+#if defined(WITH_CUDA)
+  CUevent_st* start_event_ = nullptr;
+#endif  // WITH_CUDA
+};
+
+}  // namespace profiler
+
+}  // namespace oneflow
+
+#endif  // ONEFLOW_CORE_PROFILER_ACTOR_TRACER_H_
@@ -0,0 +1,190 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include <gtest/gtest.h>
+#include <chrono>
+#include <thread>
+#include "nlohmann/json.hpp"
+#include "oneflow/core/profiler/actor_tracer.h"
+#include "oneflow/core/lazy/actor/actor_context.h"
+#include "oneflow/core/ep/include/device_manager_registry.h"
+
+namespace oneflow {
+namespace profiler {
+
+namespace {
+
+// Runs `num_records` kernel trace guards on a fresh thread and returns the time per guard in ns.
+double MeasureTraceGuardNs(bool enabled, int64_t num_records) {
+  const bool was_enabled = IsActorTraceEnabled();
+  if (enabled) {
+    EnableActorTrace();
+  } else {
+    DisableActorTrace();
+  }
+  double ns_per_record = 0;
+  std::thread thread([&]() {
+    // the first record of a thread allocates its ring buffer
+    { ActorTraceGuard guard(ActorTraceEventType::kKernel, -1, 0); }
+    const auto start = std::chrono::steady_clock::now();
+    for (int64_t i = 0; i < num_records; ++i) {
+      ActorTraceGuard guard(ActorTraceEventType::kKernel, -1, i);
+    }
+    const auto end = std::chrono::steady_clock::now();
+    ns_per_record = std::chrono::duration<double, std::nano>(end - start).count() / num_records;
+  });
+  thread.join();
+  if (was_enabled) {
+    EnableActorTrace();
+  } else {
+    DisableActorTrace();
+  }
+  return ns_per_record;
+}
+
+#if defined(WITH_CUDA)
+
+class TestStreamContext final : public StreamContext {
+ public:
+  OF_DISALLOW_COPY_AND_MOVE(TestStreamContext);
+  explicit TestStreamContext(ep::Stream* stream) : stream_(stream) {}
+  ~TestStreamContext() override = default;
+
+  ep::Stream* stream() override { return stream_; }
+  Maybe<void> AddCallback(std::function<void()> callback) override { UNIMPLEMENTED_THEN_RETURN(); }
+  DeviceType device_type() const override { return stream_->device_type(); }
+
+ private:
+  ep::Stream* stream_;
+};
+
+// Keeps the callbacks, which are run by the test when the stream is synchronized.
+class TestActorContext final : public ActorContext {
+ public:
+  OF_DISALLOW_COPY_AND_MOVE(TestActorContext);
+  explicit TestActorContext(StreamContext* stream_ctx) : stream_ctx_(stream_ctx) {}
+  ~TestActorContext() override = default;
+
+  void Init(const TaskProto& task_proto, StreamContext* stream_ctx) override { UNIMPLEMENTED(); }
+  void AddCallback(std::function<void()> callback) override {
+    callbacks_.emplace_back(std::move(callback));
+  }
+  StreamContext* stream_ctx() const override { return stream_ctx_; }
+  const TaskProto& task_proto() const override { return task_proto_; }
+
+  void RunCallbacks() {
+    CHECK_JUST(stream_ctx_->stream()->Sync());
+    for (const auto& callback : callbacks_) { callback(); }
+    callbacks_.clear();
+  }
+
+ private:
+  StreamContext* stream_ctx_;
+  TaskProto task_proto_;
+  std::vector<std::function<void()>> callbacks_;
+};
+
+#endif  // WITH_CUDA
+
+}  // namespace
+
+// Benchmarks the cost the tracer adds to every act, kernel launch and message. An act records
+// about five events: itself, one or two kernels and its messages. On a Xeon VM this measured
+// 0.7 ns per event when off and 64-80 ns per event when on, which is under 1% of acts longer than
+// about 40 us.
+TEST(ActorTracer, RecordOverhead) {
+  const int64_t num_records = 1 << 20;
+  const double disabled_ns = MeasureTraceGuardNs(false, num_records);
+  const double enabled_ns = MeasureTraceGuardNs(true, num_records);
+  LOG(INFO) << "actor trace overhead per record: " << disabled_ns << " ns when off, "
+            << enabled_ns << " ns when on";
+  // loose bounds that hold in debug and sanitizer builds, the numbers above are the benchmark
+  ASSERT_LT(disabled_ns, 50.0);
+  ASSERT_LT(enabled_ns, 2000.0);
+}
+
+#if defined(WITH_CUDA)
+
+// Benchmarks the cost the tracer adds to the launch of a kernel on a cuda stream, which records
+// two pooled cuda events and adds a callback, and checks that the records land in the row of the
+// actor thread although the callbacks are run by another thread.
+TEST(ActorTracer, CudaKernelRecordOverhead) {
+  Singleton<ep::DeviceManagerRegistry>::New();
+  if (Singleton<ep::DeviceManagerRegistry>::Get()->GetDeviceCount(DeviceType::kCUDA) == 0) {
+    Singleton<ep::DeviceManagerRegistry>::Delete();
+    GTEST_SKIP() << "no cuda device";
+  }
+  auto device = Singleton<ep::DeviceManagerRegistry>::Get()->GetDevice(DeviceType::kCUDA, 0);
+  ep::Stream* stream = device->CreateStream();
+  TestStreamContext stream_ctx(stream);
+  TestActorContext actor_ctx(&stream_ctx);
+  const bool was_enabled = IsActorTraceEnabled();
+  EnableActorTrace();
+  ClearActorTrace();
+  const int64_t num_rounds = 16;
+  const int64_t num_records = 1024;
+  const int64_t actor_id = -2;
+  double ns_per_record = 0;
+  std::thread thread([&]() {
+    SetActorTraceThreadName("cuda actor");
+    // the first round creates the events of the pool
+    for (int64_t round = 0; round < num_rounds; ++round) {
+      const auto start = std::chrono::steady_clock::now();
+      for (int64_t i = 0; i < num_records; ++i) {
+        ActorKernelTraceGuard guard(actor_id, i, &actor_ctx);
+      }
+      const auto end = std::chrono::steady_clock::now();
+      ns_per_record = std::chrono::duration<double, std::nano>(end - start).count() / num_records;
+      std::thread callback_thread([&]() { actor_ctx.RunCallbacks(); });
+      callback_thread.join();
+    }
+  });
+  thread.join();
+  if (!was_enabled) { DisableActorTrace(); }
+  LOG(INFO) << "actor trace overhead per cuda kernel: " << ns_per_record << " ns";
+  HashMap<std::pair<int64_t, int64_t>, std::vector<time_t>> actor_kernel2durations;
+  CollectActorKernelTimes(&actor_kernel2durations);
+  ASSERT_EQ(actor_kernel2durations.size(), num_records);
+  for (const auto& pair : actor_kernel2durations) {
+    ASSERT_EQ(pair.second.size(), num_rounds);
+  }
+  // the kernels are in the row of the actor thread, whose name is the only one given
+  const auto trace = nlohmann::json::parse(CHECK_JUST(ExportActorTrace()));
+  int64_t actor_tid = -1;
+  for (const auto& event : trace["traceEvents"]) {
+    if (event["name"] == "thread_name" && event["args"]["name"] == "cuda actor") {
+      actor_tid = event["tid"];
+    }
+  }
+  ASSERT_GE(actor_tid, 0);
+  int64_t num_kernel_events = 0;
+  for (const auto& event : trace["traceEvents"]) {
+    if (event.contains("cat") && event["cat"] == "kernel") {
+      ASSERT_EQ(event["tid"], actor_tid);
+      num_kernel_events += 1;
+    }
+  }
+  ASSERT_EQ(num_kernel_events, num_rounds * num_records);
+  ClearActorTrace();
+  device->DestroyStream(stream);
+  Singleton<ep::DeviceManagerRegistry>::Delete();
+  // loose bound that holds in debug and sanitizer builds, the number above is the benchmark
+  ASSERT_LT(ns_per_record, 100000.0);
+}
+
+#endif  // WITH_CUDA
+
+}  // namespace profiler
+}  // namespace oneflow
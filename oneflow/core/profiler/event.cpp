@@ -17,6 +17,7 @@ limitations under the License.
 #include "fmt/core.h"
 #include "fmt/format.h"
 #include "oneflow/core/profiler/event.h"
+#include "oneflow/core/profiler/op_cost.h"
 #include "oneflow/core/profiler/util.h"
 
 using json = nlohmann::json;
@@ -60,6 +61,10 @@ nlohmann::json KernelEvent::ToJson() {
   for (const auto& desc : description_) {
     j["description"][desc.first] = {desc.second.first, desc.second.second};
   }
+  if (flops_ >= 0) {
+    j["flops"] = flops_;
+    j["bytes"] = bytes_;
+  }
 #if defined(WITH_CUDA)
   j["memory_size"] = memory_size_;
   if (!children_.empty()) { j["children"] = children_; }
@@ -67,6 +72,11 @@ nlohmann::json KernelEvent::ToJson() {
   return j;
 }
 
+void KernelEvent::SetOpCost(const OpCost& op_cost) {
+  flops_ = op_cost.flops;
+  bytes_ = op_cost.bytes;
+}
+
 std::shared_ptr<KernelEvent> KernelEvent::Create(const std::string& name,
                                                  const Description& description) {
   return std::shared_ptr<KernelEvent>(new KernelEvent(name, description));
@@ -28,6 +28,7 @@ namespace oneflow {
 namespace profiler {
 
 class ProfileManager;
+struct OpCost;
 
 enum class EventType {
   kCustom,        // has three kinds
@@ -138,6 +139,8 @@ class KernelEvent final : public IEvent {
   static std::shared_ptr<KernelEvent> Create(const std::string& name,
                                              const Description& description);
 
+  void SetOpCost(const OpCost& op_cost);
+
 #if defined(WITH_CUDA)
   void SetMemorySize(int64_t memory_size) { memory_size_ = memory_size; }
   void AddChildEvent(const std::shared_ptr<IEvent>& e) { children_.emplace(e); }
@@ -164,6 +167,8 @@ class KernelEvent final : public IEvent {
 #endif  // WITH_CUDA
 
   const Description description_;
+  double flops_ = -1;
+  double bytes_ = -1;
 };
 
 }  // namespace profiler
@@ -35,7 +35,8 @@ Maybe<EventRecorder> EventRecorder::CreateKernelEventRecorder(
 #if defined(WITH_CUDA)
     const std::function<int64_t()>& memory_size_getter,
 #endif
-    const DescriptionGetter& input_shapes_getter, const DescriptionGetter& attrs_getter) {
+    const DescriptionGetter& input_shapes_getter, const DescriptionGetter& attrs_getter,
+    const std::function<OpCost()>& op_cost_getter) {
   auto pmgr = Singleton<ProfileManager>::Get();
   if (pmgr) {
     const auto description_getter = [pmgr, input_shapes_getter, attrs_getter]() {
@@ -50,11 +51,14 @@ Maybe<EventRecorder> EventRecorder::CreateKernelEventRecorder(
       if (pmgr->use_cuda_) {
         if (pmgr->record_bandwidth_) { event->SetMemorySize(memory_size_getter()); }
       }
+      if (pmgr->record_flops_) { event->SetOpCost(op_cost_getter()); }
       return std::make_shared<EventRecorder>(event);
     }
 #else
     if (pmgr->use_cpu_) {
-      return std::make_shared<EventRecorder>(KernelEvent::Create(name, description_getter()));
+      auto event = KernelEvent::Create(name, description_getter());
+      if (pmgr->record_flops_) { event->SetOpCost(op_cost_getter()); }
+      return std::make_shared<EventRecorder>(event);
     }
 #endif  // WITH_CUDA
   }
@@ -18,6 +18,7 @@ limitations under the License.
 
 #include "oneflow/core/common/util.h"
 #include "oneflow/core/profiler/event.h"
+#include "oneflow/core/profiler/op_cost.h"
 
 namespace oneflow {
 namespace profiler {
@@ -49,7 +50,8 @@ class EventRecorder {
 #if defined(WITH_CUDA)
       const std::function<int64_t()>& memory_size_getter,
 #endif
-      const DescriptionGetter& input_shapes_getter, const DescriptionGetter& attrs_getter);
+      const DescriptionGetter& input_shapes_getter, const DescriptionGetter& attrs_getter,
+      const std::function<OpCost()>& op_cost_getter);
 
  private:
   std::shared_ptr<IEvent> event_;
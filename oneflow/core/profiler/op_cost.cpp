@@ -0,0 +1,220 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "oneflow/core/profiler/op_cost.h"
+#include "oneflow/core/framework/user_op_conf.h"
+#include "oneflow/core/kernel/kernel.pb.h"
+#include "oneflow/core/operator/operator.h"
+
+namespace oneflow {
+
+namespace profiler {
+
+namespace {
+
+using ArgVec = std::vector<std::pair<std::string, int32_t>>;
+using OpFlopsFn = std::function<double(const OpCostContext&)>;
+
+double ElemCnt(const OpCostContext& ctx, const std::string& arg_name, int32_t index) {
+  const user_op::TensorDesc* desc = ctx.TensorDesc4ArgNameAndIndex(arg_name, index);
+  return desc == nullptr ? 0 : static_cast<double>(desc->shape().elem_cnt());
+}
+
+double Bytes(const OpCostContext& ctx, const std::string& arg_name, int32_t index) {
+  const user_op::TensorDesc* desc = ctx.TensorDesc4ArgNameAndIndex(arg_name, index);
+  if (desc == nullptr) { return 0; }
+  return static_cast<double>(desc->shape().elem_cnt()) * GetSizeOfDataType(desc->data_type());
+}
+
+double MaxElemCnt(const OpCostContext& ctx, const ArgVec& args) {
+  double elem_cnt = 0;
+  for (const auto& arg : args) {
+    elem_cnt = std::max(elem_cnt, ElemCnt(ctx, arg.first, arg.second));
+  }
+  return elem_cnt;
+}
+
+int64_t Dim(const OpCostContext& ctx, const std::string& arg_name, int64_t axis_from_end) {
+  const Shape& shape = CHECK_NOTNULL(ctx.TensorDesc4ArgNameAndIndex(arg_name, 0))->shape();
+  return shape.At(shape.NumAxes() - axis_from_end);
+}
+
+// Every output element is a dot product of length k, which takes k multiplies and k adds.
+double MatmulFlops(const OpCostContext& ctx) {
+  const int64_t k = ctx.Attr<bool>("transpose_a") ? Dim(ctx, "a", 2) : Dim(ctx, "a", 1);
+  return 2.0 * ElemCnt(ctx, "out", 0) * k;
+}
+
+// Every output element of a convolution is a dot product over in_channels / groups times the
+// kernel size, which is the element count of the weight divided by the number of filters.
+double ConvFlops(const OpCostContext& ctx, const std::string& out_arg, const std::string& weight) {
+  const user_op::TensorDesc* weight_desc = CHECK_NOTNULL(ctx.TensorDesc4ArgNameAndIndex(weight, 0));
+  const double filter_elem_cnt =
+      static_cast<double>(weight_desc->shape().elem_cnt()) / weight_desc->shape().At(0);
+  return 2.0 * ElemCnt(ctx, out_arg, 0) * filter_elem_cnt;
+}
+
+double PoolFlops(const OpCostContext& ctx, const std::string& out_arg) {
+  double kernel_elem_cnt = 1;
+  for (int32_t size : ctx.Attr<std::vector<int32_t>>("kernel_size")) { kernel_elem_cnt *= size; }
+  return ElemCnt(ctx, out_arg, 0) * kernel_elem_cnt;
+}
+
+OpFlopsFn FlopsPerOutputElem(double flops) {
+  return [flops](const OpCostContext& ctx) { return flops * MaxElemCnt(ctx, ctx.outputs()); };
+}
+
+OpFlopsFn FlopsPerInputElem(double flops) {
+  return [flops](const OpCostContext& ctx) { return flops * MaxElemCnt(ctx, ctx.inputs()); };
+}
+
+const HashMap<std::string, OpFlopsFn>& OpType2FlopsFn() {
+  static const HashMap<std::string, OpFlopsFn> op_type2flops_fn = [] {
+    HashMap<std::string, OpFlopsFn> fns;
+    // matmul
+    fns["matmul"] = &MatmulFlops;
+    fns["batch_matmul"] = &MatmulFlops;
+    fns["broadcast_matmul"] = &MatmulFlops;
+    fns["broadcast_matmul_grad_b"] = [](const OpCostContext& ctx) {
+      return 2.0 * ElemCnt(ctx, "a", 0) * Dim(ctx, "b", 1);
+    };
+    fns["fused_matmul_bias"] = [](const OpCostContext& ctx) {
+      return (2.0 * Dim(ctx, "x", 1) + 1) * ElemCnt(ctx, "out", 0);
+    };
+    // convolution
+    for (const char* op_type : {"conv1d", "conv2d", "conv3d"}) {
+      fns[op_type] = [](const OpCostContext& ctx) { return ConvFlops(ctx, "out", "weight"); };
+    }
+    for (const char* op_type : {"deconv1d", "deconv2d", "deconv3d"}) {
+      fns[op_type] = [](const OpCostContext& ctx) { return ConvFlops(ctx, "in", "weight"); };
+    }
+    fns["conv_data_grad"] = [](const OpCostContext& ctx) { return ConvFlops(ctx, "dy", "filter"); };
+    fns["conv_filter_grad"] = [](const OpCostContext& ctx) {
+      return ConvFlops(ctx, "dy", "filter_diff");
+    };
+    fns["conv_bias_grad"] = FlopsPerInputElem(1);
+    // pooling
+    for (const char* op_type : {"max_pool_1d", "max_pool_2d", "max_pool_3d", "avg_pool_1d",
+                                "avg_pool_2d", "avg_pool_3d"}) {
+      fns[op_type] = [](const OpCostContext& ctx) { return PoolFlops(ctx, "y"); };
+      fns[std::string(op_type) + "_grad"] = [](const OpCostContext& ctx) {
+        return PoolFlops(ctx, "dy");
+      };
+    }
+    // softmax and normalization, by the operations of their reference formulas per element
+    fns["softmax"] = FlopsPerInputElem(5);
+    fns["log_softmax"] = FlopsPerInputElem(5);
+    fns["softmax_grad"] = FlopsPerInputElem(4);
+    fns["log_softmax_grad"] = FlopsPerInputElem(4);
+    fns["layer_norm"] = FlopsPerInputElem(8);
+    fns["layer_norm_grad"] = FlopsPerInputElem(10);
+    fns["layer_norm_param_grad"] = FlopsPerInputElem(4);
+    fns["rms_norm"] = FlopsPerInputElem(4);
+    fns["rms_norm_grad"] = FlopsPerInputElem(6);
+    fns["normalization"] = FlopsPerInputElem(8);
+    fns["normalization_add_relu"] = FlopsPerInputElem(9);
+    fns["normalization_grad"] = FlopsPerInputElem(10);
+    // reductions
+    for (const char* op_type :
+         {"reduce_sum", "reduce_max", "reduce_min", "reduce_prod", "reduce_sum_like"}) {
+      fns[op_type] = FlopsPerInputElem(1);
+    }
+    // elementwise, one operation per output element
+    fns["add_n"] = [](const OpCostContext& ctx) {
+      return (ctx.inputs().size() - 1.0) * ElemCnt(ctx, "out", 0);
+    };
+    for (const char* op_type :
+         {"broadcast_add", "broadcast_sub", "broadcast_mul", "broadcast_div", "broadcast_pow",
+          "broadcast_maximum", "broadcast_minimum", "scalar_add", "scalar_mul", "scalar_div",
+          "scalar_pow", "bias_add", "fused_bias_add_gelu", "fused_bias_add_mask_scale", "dropout",
+          "relu", "relu_grad", "gelu", "gelu_grad", "sigmoid", "sigmoid_grad", "tanh", "tanh_grad",
+          "silu", "silu_grad", "mish", "elu", "leaky_relu", "hardswish", "hardsigmoid", "softplus",
+          "exp", "log", "sqrt", "rsqrt", "square", "abs", "negative", "reciprocal", "erf", "sin",
+          "cos"}) {
+      fns[op_type] = FlopsPerOutputElem(1);
+    }
+    return fns;
+  }();
+  return op_type2flops_fn;
+}
+
+class KernelConfOpCostContext final : public OpCostContext {
+ public:
+  explicit KernelConfOpCostContext(const KernelConf& kernel_conf)
+      : user_op_conf_(kernel_conf.op_attribute().op_conf()) {
+    const auto& user_conf = kernel_conf.op_attribute().op_conf().user_conf();
+    const auto InitInOrOut = [](const PbMap<std::string, UserOpConf::ListString>& arg_map,
+                                ArgVec* arg_vec) {
+      for (const auto& pair : arg_map) {
+        for (int32_t i = 0; i < pair.second.s_size(); ++i) { arg_vec->emplace_back(pair.first, i); }
+      }
+    };
+    InitInOrOut(user_conf.input(), &inputs_);
+    InitInOrOut(user_conf.output(), &outputs_);
+    for (const auto& pair : kernel_conf.user_conf().bn_in_op2blob_desc()) {
+      arg2tensor_desc_.emplace(GenUnRepeatedBn(pair.first), user_op::NaiveTensorDesc(pair.second));
+    }
+  }
+  ~KernelConfOpCostContext() override = default;
+
+  const std::string& op_type_name() const override { return user_op_conf_.op_type_name(); }
+  const ArgVec& inputs() const override { return inputs_; }
+  const ArgVec& outputs() const override { return outputs_; }
+  const user_op::TensorDesc* TensorDesc4ArgNameAndIndex(const std::string& arg_name,
+                                                        int32_t index) const override {
+    const auto it = arg2tensor_desc_.find(std::make_pair(arg_name, index));
+    if (it == arg2tensor_desc_.end()) { return nullptr; }
+    return &it->second;
+  }
+  const std::shared_ptr<const user_op::AttrVal>& Attr4Name(
+      const std::string& attr_name) const override {
+    return user_op_conf_.Attr4Name(attr_name);
+  }
+
+ private:
+  user_op::UserOpConfWrapper user_op_conf_;
+  ArgVec inputs_;
+  ArgVec outputs_;
+  HashMap<std::pair<std::string, int32_t>, user_op::NaiveTensorDesc> arg2tensor_desc_;
+};
+
+}  // namespace
+
+OpCost InferOpCost(const OpCostContext& ctx) {
+  OpCost cost;
+  const auto& op_type_name = ctx.op_type_name();
+  if (op_type_name == "gather" || op_type_name == "embedding") {
+    // the gathered rows are read once and written once
+    cost.bytes = Bytes(ctx, "indices", 0) + 2 * Bytes(ctx, "out", 0);
+  } else {
+    for (const auto& arg : ctx.inputs()) { cost.bytes += Bytes(ctx, arg.first, arg.second); }
+    for (const auto& arg : ctx.outputs()) { cost.bytes += Bytes(ctx, arg.first, arg.second); }
+  }
+  const auto& op_type2flops_fn = OpType2FlopsFn();
+  const auto it = op_type2flops_fn.find(op_type_name);
+  if (it != op_type2flops_fn.end()) { cost.flops = it->second(ctx); }
+  return cost;
+}
+
+OpCost InferOpCost(const KernelConf& kernel_conf) {
+  if (!kernel_conf.op_attribute().op_conf().has_user_conf() || !kernel_conf.has_user_conf()) {
+    return OpCost();
+  }
+  return InferOpCost(KernelConfOpCostContext(kernel_conf));
+}
+
+}  // namespace profiler
+
+}  // namespace oneflow
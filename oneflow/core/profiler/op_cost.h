@@ -0,0 +1,74 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#ifndef ONEFLOW_CORE_PROFILER_OP_COST_H_
+#define ONEFLOW_CORE_PROFILER_OP_COST_H_
+
+#include "oneflow/core/common/util.h"
+#include "oneflow/core/common/tensor_desc.h"
+#include "oneflow/core/framework/attr_value.h"
+
+namespace oneflow {
+
+class KernelConf;
+
+namespace profiler {
+
+// The arithmetic operations and the bytes of memory traffic of one run of an op. Divided by the
+// measured time of the kernel they give its achieved GFLOP/s and GB/s, which place the kernel on
+// the roofline of the device.
+struct OpCost {
+  double flops = 0;
+  double bytes = 0;
+};
+
+// The shapes, data types and attributes which the cost of an op is inferred from.
+class OpCostContext {
+ public:
+  OF_DISALLOW_COPY_AND_MOVE(OpCostContext);
+  virtual ~OpCostContext() = default;
+
+  virtual const std::string& op_type_name() const = 0;
+  virtual const std::vector<std::pair<std::string, int32_t>>& inputs() const = 0;
+  virtual const std::vector<std::pair<std::string, int32_t>>& outputs() const = 0;
+  virtual const user_op::TensorDesc* TensorDesc4ArgNameAndIndex(const std::string& arg_name,
+                                                                int32_t index) const = 0;
+  virtual const std::shared_ptr<const user_op::AttrVal>& Attr4Name(
+      const std::string& attr_name) const = 0;
+
+  template<typename T>
+  const T& Attr(const std::string& attr_name) const {
+    return AttrValueCast<T>(*Attr4Name(attr_name));
+  }
+
+ protected:
+  OpCostContext() = default;
+};
+
+// FLOPs are counted for the matmul, convolution, elementwise, reduction, normalization, softmax
+// and pooling families, and are 0 for the ops which only move data, such as copy, cast and
+// transpose. Bytes count every input and output once, except that gather and embedding read only
+// the gathered rows of their table.
+OpCost InferOpCost(const OpCostContext& ctx);
+
+// Infers the cost of the user op of a lazy kernel from the static shapes in its kernel conf.
+// Returns an empty cost for the kernels of system ops.
+OpCost InferOpCost(const KernelConf& kernel_conf);
+
+}  // namespace profiler
+
+}  // namespace oneflow
+
+#endif  // ONEFLOW_CORE_PROFILER_OP_COST_H_
@@ -33,12 +33,13 @@ class ProfileManager {
   friend class EventRecorder;
 
   ProfileManager(bool use_cpu, bool use_cuda, bool record_shapes, bool record_attrs,
-                 bool record_bandwidth)
+                 bool record_bandwidth, bool record_flops)
       : use_cpu_(use_cpu),
         use_cuda_(use_cuda),
         record_shapes_(record_shapes),
         record_attrs_(record_attrs),
-        record_bandwidth_(record_bandwidth) {
+        record_bandwidth_(record_bandwidth),
+        record_flops_(record_flops) {
 #if defined(WITH_CUDA)
     std::set<ActivityType> activities{};
     if (use_cpu) { activities.insert(ActivityType::CPU); }
@@ -59,6 +60,7 @@ class ProfileManager {
   bool record_shapes_;
   bool record_attrs_;
   bool record_bandwidth_;
+  bool record_flops_;
 
   std::queue<std::shared_ptr<IEvent>> events_;
   std::unordered_map<std::string, std::shared_ptr<EventRecorder>> event_recorders_;
@@ -93,11 +93,11 @@ void ProfilerStop() {
 }
 
 void EnableProfiler(bool use_cpu, bool use_cuda, bool record_shapes, bool record_attrs,
-                    bool record_bandwidth) {
+                    bool record_bandwidth, bool record_flops) {
   CHECK_JUST(vm::ClusterSync());
   if (Singleton<ProfileManager>::Get() == nullptr) {
     Singleton<ProfileManager>::New(use_cpu, use_cuda, record_shapes, record_attrs,
-                                   record_bandwidth);
+                                   record_bandwidth, record_flops);
   }
 }
 
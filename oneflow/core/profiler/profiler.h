@@ -64,7 +64,7 @@ class RangeGuard final {
 #endif
 
 void EnableProfiler(bool use_cpu, bool use_cuda, bool record_shapes, bool record_attrs,
-                    bool record_bandwidth);
+                    bool record_bandwidth, bool record_flops);
 
 // DisableProfilerAndReturnResult will return a json of profile results.
 Maybe<std::string> DisableProfilerAndReturnResult();
@@ -19,6 +19,7 @@ limitations under the License.
 #include "oneflow/core/lazy/actor/actor.h"
 #include "oneflow/core/lazy/actor/light_actor.h"
 #include "oneflow/core/profiler/profiler.h"
+#include "oneflow/core/profiler/actor_tracer.h"
 #include "oneflow/core/lazy/stream_context/include/stream_context.h"
 #include "oneflow/core/framework/to_string.h"
 #include "oneflow/core/lazy/stream_context/include/generic_stream_context.h"
@@ -39,9 +40,11 @@ Thread::Thread(const StreamId& stream_id) : thrd_id_(EncodeStreamIdToInt64(strea
 
   actor_thread_ = std::thread([this, stream_id]() {
     LazyMode::Guard guard(true);
-    OF_PROFILER_NAME_THIS_HOST_THREAD("_" + ToString(stream_id.device_id().device_type())
-                                      + std::to_string(stream_id.device_id().device_index())
-                                      + "_actor");
+    const std::string thread_name = "_" + ToString(stream_id.device_id().device_type())
+                                    + std::to_string(stream_id.device_id().device_index())
+                                    + "_actor";
+    OF_PROFILER_NAME_THIS_HOST_THREAD(thread_name);
+    profiler::SetActorTraceThreadName(thread_name + " " + std::to_string(thrd_id_));
     CHECK_JUST(stream_ctx_->stream()->OnExecutionContextSetup());
     PollMsgChannel();
     CHECK_JUST(stream_ctx_->stream()->OnExecutionContextTeardown());
@@ -80,6 +83,8 @@ void Thread::PollMsgChannel() {
       }
     }
     int64_t actor_id = msg.dst_actor_id();
+    profiler::RecordActorTraceMsg(profiler::ActorTraceEventType::kRecvMsg, actor_id,
+                                  msg.src_actor_id());
     auto actor_it = id2actor_ptr_.find(actor_id);
     CHECK(actor_it != id2actor_ptr_.end());
     int process_msg_ret = actor_it->second.second->ProcessMsg(msg);
@@ -112,6 +117,13 @@ void Thread::ConstructActor(int64_t actor_id) {
     VLOG(3) << "Thread " << thrd_id_ << " construct LightActor " << TaskType_Name(task.task_type())
             << " " << actor_id;
   }
+  if (task.exec_sequence().exec_node_size() > 0
+      && task.exec_sequence().exec_node(0).kernel_conf().has_op_attribute()) {
+    profiler::SetActorTraceActorName(
+        actor_id, task.exec_sequence().exec_node(0).kernel_conf().op_attribute().op_conf().name());
+  } else {
+    profiler::SetActorTraceActorName(actor_id, TaskType_Name(task.task_type()));
+  }
   CHECK(id2actor_ptr_.emplace(actor_id, std::make_pair(std::move(actor_ctx), std::move(actor_ptr)))
             .second);
   CHECK(id2job_id_.emplace(actor_id, task.job_id()).second);
@@ -22,6 +22,7 @@ limitations under the License.
 #include "oneflow/core/job/task.pb.h"
 #include "oneflow/core/lazy/actor/actor.h"
 #include "oneflow/core/lazy/actor/actor_context.h"
+#include "oneflow/core/profiler/actor_tracer.h"
 
 namespace oneflow {
 
@@ -38,6 +39,8 @@ class Thread {
   Channel<ActorMsg>* GetMsgChannelPtr() { return &msg_channel_; }
 
   inline void EnqueueActorMsg(const ActorMsg& msg) {
+    profiler::RecordActorTraceMsg(profiler::ActorTraceEventType::kSendMsg, msg.src_actor_id(),
+                                  msg.dst_actor_id());
     if (UseLocalMsgQueue()) {
       local_msg_queue_.push(msg);
     } else {
@@ -47,6 +50,12 @@ class Thread {
 
   template<typename InputIt>
   inline void EnqueueActorMsg(InputIt first, InputIt last) {
+    if (OF_PREDICT_FALSE(profiler::IsActorTraceEnabled())) {
+      for (auto it = first; it != last; ++it) {
+        profiler::RecordActorTraceMsg(profiler::ActorTraceEventType::kSendMsg, it->src_actor_id(),
+                                      it->dst_actor_id());
+      }
+    }
     if (UseLocalMsgQueue()) {
       for (auto it = first; it != last; ++it) { local_msg_queue_.push(*it); }
     } else {
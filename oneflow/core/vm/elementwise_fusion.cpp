@@ -0,0 +1,506 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "oneflow/core/vm/elementwise_fusion.h"
+#include <atomic>
+#include "oneflow/core/vm/instruction.h"
+#include "oneflow/core/vm/op_call_instruction_policy.h"
+#include "oneflow/core/vm/stream_policy.h"
+#include "oneflow/core/eager/eager_blob_object.h"
+#include "oneflow/core/common/singleton.h"
+#include "oneflow/core/common/tensor_meta.h"
+#include "oneflow/core/framework/device.h"
+#include "oneflow/core/ep/cpu/cpu_stream.h"
+#include "oneflow/core/ep/cpu/primitive/unary_functor.h"
+#include "oneflow/core/ep/cpu/primitive/binary_functor.h"
+#include "oneflow/core/profiler/profile_manager.h"
+
+namespace oneflow {
+namespace vm {
+
+namespace {
+
+using ep::primitive::BinaryOp;
+using ep::primitive::UnaryOp;
+
+// Number of elements every op of the expression computes before moving on to the next chunk,
+// small enough for all operands of a chunk to stay in L2.
+constexpr int64_t kChunkSize = 4096;
+// Broadcast operands are expanded once per thread into chunk sized buffers, which requires chunk
+// boundaries to be aligned with the broadcast period.
+constexpr int64_t kMaxBroadcastPeriod = kChunkSize;
+
+using UnaryStepFn = void (*)(int64_t n, const void* src, void* dst);
+using BinaryStepFn = void (*)(int64_t n, const void* src0, const void* src1, void* dst);
+
+template<UnaryOp op, typename Src, typename Dst>
+void UnaryStep(int64_t n, const void* src, void* dst) {
+  const auto functor =
+      ep::primitive::UnaryFunctor<DeviceType::kCPU, op, Dst, Src>(Scalar(), Scalar());
+  const Src* x = reinterpret_cast<const Src*>(src);
+  Dst* y = reinterpret_cast<Dst*>(dst);
+  for (int64_t i = 0; i < n; ++i) { y[i] = functor(x[i]); }
+}
+
+template<BinaryOp op, typename T>
+void BinaryStep(int64_t n, const void* src0, const void* src1, void* dst) {
+  const auto functor =
+      ep::primitive::broadcast_elementwise_binary::BinaryFunctor<DeviceType::kCPU, op, T, T>(
+          Scalar(), Scalar());
+  const T* x0 = reinterpret_cast<const T*>(src0);
+  const T* x1 = reinterpret_cast<const T*>(src1);
+  T* y = reinterpret_cast<T*>(dst);
+  for (int64_t i = 0; i < n; ++i) { y[i] = functor(x0[i], x1[i]); }
+}
+
+int64_t StepKey(int32_t op, DataType src_data_type, DataType dst_data_type) {
+  return (static_cast<int64_t>(op) << 16) | (static_cast<int64_t>(src_data_type) << 8)
+         | static_cast<int64_t>(dst_data_type);
+}
+
+struct StepFnRegistry {
+  HashMap<int64_t, UnaryStepFn> unary_fns;
+  HashMap<int64_t, BinaryStepFn> binary_fns;
+};
+
+template<typename T>
+void AddFloatingStepFns(StepFnRegistry* registry) {
+  const DataType data_type = GetDataType<T>::value;
+#define ADD_UNARY_STEP_FN(op)                                                    \
+  registry->unary_fns[StepKey(static_cast<int32_t>(op), data_type, data_type)] = \
+      &UnaryStep<op, T, T>;
+  ADD_UNARY_STEP_FN(UnaryOp::kRelu)
+  ADD_UNARY_STEP_FN(UnaryOp::kGelu)
+  ADD_UNARY_STEP_FN(UnaryOp::kFastGelu)
+  ADD_UNARY_STEP_FN(UnaryOp::kSilu)
+  ADD_UNARY_STEP_FN(UnaryOp::kTanh)
+  ADD_UNARY_STEP_FN(UnaryOp::kSigmoid)
+  ADD_UNARY_STEP_FN(UnaryOp::kExp)
+  ADD_UNARY_STEP_FN(UnaryOp::kLog)
+  ADD_UNARY_STEP_FN(UnaryOp::kAbs)
+  ADD_UNARY_STEP_FN(UnaryOp::kNegative)
+  ADD_UNARY_STEP_FN(UnaryOp::kSquare)
+  ADD_UNARY_STEP_FN(UnaryOp::kSqrt)
+  ADD_UNARY_STEP_FN(UnaryOp::kRsqrt)
+#undef ADD_UNARY_STEP_FN
+#define ADD_BINARY_STEP_FN(op)                                                    \
+  registry->binary_fns[StepKey(static_cast<int32_t>(op), data_type, data_type)] = \
+      &BinaryStep<op, T>;
+  ADD_BINARY_STEP_FN(BinaryOp::kAdd)
+  ADD_BINARY_STEP_FN(BinaryOp::kSub)
+  ADD_BINARY_STEP_FN(BinaryOp::kMul)
+  ADD_BINARY_STEP_FN(BinaryOp::kDiv)
+  ADD_BINARY_STEP_FN(BinaryOp::kMax)
+  ADD_BINARY_STEP_FN(BinaryOp::kMin)
+  ADD_BINARY_STEP_FN(BinaryOp::kPow)
+#undef ADD_BINARY_STEP_FN
+}
+
+template<typename Src, typename Dst>
+void AddCastStepFn(StepFnRegistry* registry) {
+  registry->unary_fns[StepKey(static_cast<int32_t>(UnaryOp::kCast), GetDataType<Src>::value,
+                              GetDataType<Dst>::value)] = &UnaryStep<UnaryOp::kCast, Src, Dst>;
+}
+
+const StepFnRegistry& GetStepFnRegistry() {
+  static const StepFnRegistry registry = []() {
+    StepFnRegistry registry;
+    AddFloatingStepFns<float>(&registry);
+    AddFloatingStepFns<double>(&registry);
+    AddCastStepFn<float, float>(&registry);
+    AddCastStepFn<float, double>(&registry);
+    AddCastStepFn<double, float>(&registry);
+    AddCastStepFn<double, double>(&registry);
+    return registry;
+  }();
+  return registry;
+}
+
+enum class FusedOpKind { kUnary, kBinary, kScalar, kCast };
+
+struct FusedOpDesc {
+  FusedOpKind kind;
+  int32_t op;
+  int32_t num_inputs;
+};
+
+FusedOpDesc UnaryDesc(UnaryOp op) {
+  return FusedOpDesc{FusedOpKind::kUnary, static_cast<int32_t>(op), 1};
+}
+FusedOpDesc BinaryDesc(BinaryOp op) {
+  return FusedOpDesc{FusedOpKind::kBinary, static_cast<int32_t>(op), 2};
+}
+FusedOpDesc ScalarDesc(BinaryOp op) {
+  return FusedOpDesc{FusedOpKind::kScalar, static_cast<int32_t>(op), 1};
+}
+
+const HashMap<std::string, FusedOpDesc>& GetFusedOpDescs() {
+  static const HashMap<std::string, FusedOpDesc> descs = {
+      {"relu", UnaryDesc(UnaryOp::kRelu)},
+      {"gelu", UnaryDesc(UnaryOp::kGelu)},
+      {"fast_gelu", UnaryDesc(UnaryOp::kFastGelu)},
+      {"silu", UnaryDesc(UnaryOp::kSilu)},
+      {"tanh", UnaryDesc(UnaryOp::kTanh)},
+      {"sigmoid", UnaryDesc(UnaryOp::kSigmoid)},
+      {"exp", UnaryDesc(UnaryOp::kExp)},
+      {"log", UnaryDesc(UnaryOp::kLog)},
+      {"abs", UnaryDesc(UnaryOp::kAbs)},
+      {"negative", UnaryDesc(UnaryOp::kNegative)},
+      {"square", UnaryDesc(UnaryOp::kSquare)},
+      {"sqrt", UnaryDesc(UnaryOp::kSqrt)},
+      {"rsqrt", UnaryDesc(UnaryOp::kRsqrt)},
+      {"add_n", BinaryDesc(BinaryOp::kAdd)},
+      {"broadcast_add", BinaryDesc(BinaryOp::kAdd)},
+      {"broadcast_sub", BinaryDesc(BinaryOp::kSub)},
+      {"broadcast_mul", BinaryDesc(BinaryOp::kMul)},
+      {"broadcast_div", BinaryDesc(BinaryOp::kDiv)},
+      {"broadcast_maximum", BinaryDesc(BinaryOp::kMax)},
+      {"broadcast_minimum", BinaryDesc(BinaryOp::kMin)},
+      {"scalar_add", ScalarDesc(BinaryOp::kAdd)},
+      {"scalar_mul", ScalarDesc(BinaryOp::kMul)},
+      {"scalar_div", ScalarDesc(BinaryOp::kDiv)},
+      {"scalar_pow", ScalarDesc(BinaryOp::kPow)},
+      {"cast", FusedOpDesc{FusedOpKind::kCast, static_cast<int32_t>(UnaryOp::kCast), 1}},
+  };
+  return descs;
+}
+
+// How an operand is addressed when computing the chunk [offset, offset + n) of the expression.
+enum class FusedOperandKind {
+  // Same element count and order as the outputs, read in place at `offset`.
+  kTensor,
+  // A single element broadcast to every position.
+  kScalarTensor,
+  // Broadcast along the leading axes of the outputs, element i reads element i % period.
+  kPeriodicTensor,
+  // Scalar attribute of a scalar_* op.
+  kConstant,
+};
+
+struct FusedOperand {
+  FusedOperandKind kind;
+  EagerBlobObject* blob_object;
+  Scalar value;
+};
+
+struct FusedOpCall {
+  FusedOpDesc desc;
+  UnaryStepFn unary_fn;
+  BinaryStepFn binary_fn;
+  DataType src_data_type;
+  std::vector<FusedOperand> operands;
+  EagerBlobObject* out;
+};
+
+Shape StripOnes(const Shape& shape) {
+  DimVector dims;
+  for (int64_t dim : shape.dim_vec()) {
+    if (dim != 1) { dims.emplace_back(dim); }
+  }
+  return Shape(dims);
+}
+
+bool InitTensorOperand(EagerBlobObject* in, const Shape& out_shape, int64_t elem_cnt,
+                       FusedOperand* operand) {
+  if (!IsContiguous(in->shape(), in->stride())) { return false; }
+  operand->blob_object = in;
+  const int64_t in_elem_cnt = in->shape().elem_cnt();
+  if (in_elem_cnt == elem_cnt && StripOnes(in->shape()) == StripOnes(out_shape)) {
+    operand->kind = FusedOperandKind::kTensor;
+    return true;
+  }
+  if (in_elem_cnt == 1) {
+    operand->kind = FusedOperandKind::kScalarTensor;
+    return true;
+  }
+  if (in_elem_cnt > kMaxBroadcastPeriod) { return false; }
+  // Only broadcasting along leading axes keeps a fixed period, e.g. a bias of shape (c,) added
+  // to an (n, c) activation.
+  int64_t leading_ones = 0;
+  while (leading_ones < in->shape().NumAxes() && in->shape().At(leading_ones) == 1) {
+    ++leading_ones;
+  }
+  const int64_t num_trailing_axes = in->shape().NumAxes() - leading_ones;
+  if (num_trailing_axes > out_shape.NumAxes()) { return false; }
+  for (int64_t i = 0; i < num_trailing_axes; ++i) {
+    if (in->shape().At(leading_ones + i)
+        != out_shape.At(out_shape.NumAxes() - num_trailing_axes + i)) {
+      return false;
+    }
+  }
+  operand->kind = FusedOperandKind::kPeriodicTensor;
+  return true;
+}
+
+Maybe<Scalar> GetScalarOperand(const OpCallInstructionPolicy& op_call) {
+  const auto& attrs = op_call.composed_attrs();
+  if (JUST(attrs.GetAttr<bool>("has_int_operand"))) {
+    return Scalar(JUST(attrs.GetAttr<int64_t>("int_operand")));
+  } else if (JUST(attrs.GetAttr<bool>("has_float_operand"))) {
+    return Scalar(JUST(attrs.GetAttr<double>("float_operand")));
+  } else {
+    UNIMPLEMENTED_THEN_RETURN();
+  }
+}
+
+// Fills `op_calls` with the operands of every op, returns false if the ops do not form a
+// fusable expression.
+Maybe<bool> InitFusedOpCalls(const std::vector<OpCallInstructionPolicy*>& op_call_policies,
+                             std::vector<FusedOpCall>* op_calls, int64_t* elem_cnt,
+                             int64_t* period) {
+  const Shape& out_shape = op_call_policies.front()->outputs().front()->shape();
+  *elem_cnt = out_shape.elem_cnt();
+  *period = 0;
+  if (*elem_cnt == 0) { return false; }
+  for (auto* op_call_policy : op_call_policies) {
+    FusedOpCall op_call;
+    op_call.desc = GetFusedOpDescs().at(op_call_policy->opkernel().op_type_name());
+    op_call.out = op_call_policy->outputs().front().get();
+    if (op_call.out->shape().elem_cnt() != *elem_cnt
+        || !IsContiguous(op_call.out->shape(), op_call.out->stride())) {
+      return false;
+    }
+    const auto& inputs = op_call_policy->inputs();
+    if (inputs.size() != static_cast<size_t>(op_call.desc.num_inputs)) { return false; }
+    op_call.src_data_type = inputs.front()->data_type();
+    for (const auto& input : inputs) {
+      if (input->data_type() != op_call.src_data_type) { return false; }
+      FusedOperand operand;
+      if (!InitTensorOperand(input.get(), op_call.out->shape(), *elem_cnt, &operand)) {
+        return false;
+      }
+      if (operand.kind == FusedOperandKind::kPeriodicTensor) {
+        const int64_t operand_period = input->shape().elem_cnt();
+        if (*period != 0 && *period != operand_period) { return false; }
+        *period = operand_period;
+      }
+      op_call.operands.emplace_back(operand);
+    }
+    if (op_call.desc.kind == FusedOpKind::kScalar) {
+      FusedOperand operand;
+      operand.kind = FusedOperandKind::kConstant;
+      operand.blob_object = nullptr;
+      operand.value = JUST(GetScalarOperand(*op_call_policy));
+      op_call.operands.emplace_back(operand);
+    }
+    if (op_call.desc.kind != FusedOpKind::kCast
+        && op_call.out->data_type() != op_call.src_data_type) {
+      return false;
+    }
+    op_calls->emplace_back(std::move(op_call));
+  }
+  // Broadcast operands are expanded before the first chunk is computed, so they must not be
+  // produced or modified by any op of the expression.
+  for (const auto& op_call : *op_calls) {
+    for (const auto& operand : op_call.operands) {
+      if (operand.kind != FusedOperandKind::kScalarTensor
+          && operand.kind != FusedOperandKind::kPeriodicTensor) {
+        continue;
+      }
+      for (const auto& other : *op_calls) {
+        if (other.out == operand.blob_object) { return false; }
+      }
+    }
+  }
+  return true;
+}
+
+// Resolves the step function of every op from the registry, one hash lookup per op.
+bool InitStepFns(std::vector<FusedOpCall>* op_calls) {
+  const auto& registry = GetStepFnRegistry();
+  for (auto& op_call : *op_calls) {
+    const int64_t key = StepKey(op_call.desc.op, op_call.src_data_type, op_call.out->data_type());
+    op_call.unary_fn = nullptr;
+    op_call.binary_fn = nullptr;
+    if (op_call.desc.kind == FusedOpKind::kUnary || op_call.desc.kind == FusedOpKind::kCast) {
+      const auto fn_it = registry.unary_fns.find(key);
+      if (fn_it == registry.unary_fns.end()) { return false; }
+      op_call.unary_fn = fn_it->second;
+    } else {
+      const auto fn_it = registry.binary_fns.find(key);
+      if (fn_it == registry.binary_fns.end()) { return false; }
+      op_call.binary_fn = fn_it->second;
+    }
+  }
+  return true;
+}
+
+bool IsOverlapped(const EagerBlobObject* a, const EagerBlobObject* b) {
+  const char* a_begin = static_cast<const char*>(a->raw_dptr());
+  const char* b_begin = static_cast<const char*>(b->raw_dptr());
+  const size_t a_size = a->shape().elem_cnt() * GetSizeOfDataType(a->data_type());
+  const size_t b_size = b->shape().elem_cnt() * GetSizeOfDataType(b->data_type());
+  return a_begin < b_begin + b_size && b_begin < a_begin + a_size;
+}
+
+// Elementwise ops computed chunk by chunk in program order see the same values as unfused ones
+// as long as no operand or output partially overlaps an output: only identical tensors may alias.
+bool HasPartialAlias(const std::vector<FusedOpCall>& op_calls) {
+  for (const auto& op_call : op_calls) {
+    for (const auto& other : op_calls) {
+      if (IsOverlapped(op_call.out, other.out)
+          && (op_call.out->raw_dptr() != other.out->raw_dptr()
+              || op_call.out->data_type() != other.out->data_type())) {
+        return true;
+      }
+    }
+    for (const auto& operand : op_call.operands) {
+      if (operand.blob_object == nullptr) { continue; }
+      for (const auto& other : op_calls) {
+        if (!IsOverlapped(operand.blob_object, other.out)) { continue; }
+        if (operand.kind != FusedOperandKind::kTensor
+            || operand.blob_object->raw_dptr() != other.out->raw_dptr()) {
+          return true;
+        }
+      }
+    }
+  }
+  return false;
+}
+
+template<typename T>
+void ExpandOperand(const FusedOperand& operand, int64_t n, void* dst) {
+  T* out = reinterpret_cast<T*>(dst);
+  if (operand.kind == FusedOperandKind::kConstant) {
+    std::fill(out, out + n, operand.value.Value<T>());
+  } else if (operand.kind == FusedOperandKind::kScalarTensor) {
+    std::fill(out, out + n, *reinterpret_cast<const T*>(operand.blob_object->raw_dptr()));
+  } else if (operand.kind == FusedOperandKind::kPeriodicTensor) {
+    const T* src = reinterpret_cast<const T*>(operand.blob_object->raw_dptr());
+    const int64_t period = operand.blob_object->shape().elem_cnt();
+    for (int64_t i = 0; i < n; i += period) { std::copy(src, src + period, out + i); }
+  } else {
+    UNIMPLEMENTED();
+  }
+}
+
+void ExpandOperand(const FusedOperand& operand, DataType data_type, int64_t n, void* dst) {
+  if (data_type == DataType::kFloat) {
+    ExpandOperand<float>(operand, n, dst);
+  } else if (data_type == DataType::kDouble) {
+    ExpandOperand<double>(operand, n, dst);
+  } else {
+    UNIMPLEMENTED();
+  }
+}
+
+void ComputeFusedOpCalls(ep::CpuStream* stream, const std::vector<FusedOpCall>& op_calls,
+                         int64_t elem_cnt, int64_t period) {
+  const int64_t chunk_size = period == 0 ? kChunkSize : (kChunkSize / period) * period;
+  const int64_t num_chunks = (elem_cnt + chunk_size - 1) / chunk_size;
+  stream->ParallelFor(
+      0, num_chunks,
+      [&](int64_t begin, int64_t end) {
+        // Broadcast operands are expanded to a full chunk once per task, the chunk size is a
+        // multiple of the period so the same expansion is valid for every chunk.
+        std::vector<std::vector<char>> expanded_buffers;
+        std::vector<std::vector<const char*>> expanded(op_calls.size());
+        for (size_t i = 0; i < op_calls.size(); ++i) {
+          const auto& op_call = op_calls.at(i);
+          for (const auto& operand : op_call.operands) {
+            if (operand.kind == FusedOperandKind::kTensor) {
+              expanded.at(i).emplace_back(nullptr);
+              continue;
+            }
+            expanded_buffers.emplace_back(chunk_size * GetSizeOfDataType(op_call.src_data_type));
+            ExpandOperand(operand, op_call.src_data_type, chunk_size,
+                          expanded_buffers.back().data());
+            expanded.at(i).emplace_back(expanded_buffers.back().data());
+          }
+        }
+        for (int64_t chunk = begin; chunk < end; ++chunk) {
+          const int64_t offset = chunk * chunk_size;
+          const int64_t n = std::min(chunk_size, elem_cnt - offset);
+          for (size_t i = 0; i < op_calls.size(); ++i) {
+            const auto& op_call = op_calls.at(i);
+            const size_t src_size = GetSizeOfDataType(op_call.src_data_type);
+            const void* srcs[2] = {nullptr, nullptr};
+            for (size_t j = 0; j < op_call.operands.size(); ++j) {
+              if (expanded.at(i).at(j) == nullptr) {
+                srcs[j] = static_cast<const char*>(op_call.operands.at(j).blob_object->raw_dptr())
+                          + offset * src_size;
+              } else {
+                srcs[j] = expanded.at(i).at(j);
+              }
+            }
+            void* dst = static_cast<char*>(op_call.out->mut_raw_dptr())
+                        + offset * GetSizeOfDataType(op_call.out->data_type());
+            if (op_call.unary_fn != nullptr) {
+              op_call.unary_fn(n, srcs[0], dst);
+            } else {
+              op_call.binary_fn(n, srcs[0], srcs[1], dst);
+            }
+          }
+        }
+      },
+      1);
+}
+
+std::atomic<int64_t> fused_elementwise_instruction_count(0);
+
+}  // namespace
+
+bool IsFusableElementwiseOpCall(const OpCallInstructionPolicy& op_call) {
+  const Stream* vm_stream = op_call.vm_stream();
+  if (vm_stream->stream_type() != StreamType::kCompute
+      || vm_stream->device()->enum_type() != DeviceType::kCPU) {
+    return false;
+  }
+  if (op_call.need_temp_storage() || op_call.user_opkernel()->has_state_or_cache()
+      || op_call.op_interp_ctx().state) {
+    return false;
+  }
+  if (op_call.outputs().size() != 1) { return false; }
+  return GetFusedOpDescs().count(op_call.opkernel().op_type_name()) > 0;
+}
+
+bool IsFusableElementwiseInstruction(Instruction* instruction) {
+  const auto* op_call =
+      dynamic_cast<const OpCallInstructionPolicy*>(&instruction->instruction_policy());
+  return op_call != nullptr && IsFusableElementwiseOpCall(*op_call);
+}
+
+Maybe<bool> TryComputeFusedElementwise(const std::vector<Instruction*>& instructions) {
+  CHECK_OR_RETURN(!instructions.empty());
+  // Profiled instructions are computed one by one so that every kernel event is recorded
+  if (Singleton<profiler::ProfileManager>::Get() != nullptr) { return false; }
+  std::vector<OpCallInstructionPolicy*> op_call_policies;
+  op_call_policies.reserve(instructions.size());
+  for (auto* instruction : instructions) {
+    auto* op_call = dynamic_cast<OpCallInstructionPolicy*>(instruction->mut_instruction_policy());
+    CHECK_NOTNULL_OR_RETURN(op_call);
+    op_call_policies.emplace_back(op_call);
+  }
+  std::vector<FusedOpCall> op_calls;
+  int64_t elem_cnt = 0;
+  int64_t period = 0;
+  if (!JUST(InitFusedOpCalls(op_call_policies, &op_calls, &elem_cnt, &period))) { return false; }
+  if (!InitStepFns(&op_calls)) { return false; }
+  Instruction* front = instructions.front();
+  Allocator* allocator = front->mut_stream()->mut_stream_policy()->mut_allocator();
+  for (auto* op_call : op_call_policies) {
+    JUST(op_call->outputs().front()->TryAllocateBlobBodyMemory(allocator));
+  }
+  if (HasPartialAlias(op_calls)) { return false; }
+  auto* stream = front->mut_stream()->mut_stream_policy()->stream()->As<ep::CpuStream>();
+  ComputeFusedOpCalls(stream, op_calls, elem_cnt, period);
+  fused_elementwise_instruction_count += instructions.size();
+  return true;
+}
+
+int64_t FusedElementwiseInstructionCount() { return fused_elementwise_instruction_count; }
+
+}  // namespace vm
+}  // namespace oneflow
@@ -0,0 +1,48 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#ifndef ONEFLOW_CORE_VM_ELEMENTWISE_FUSION_H_
+#define ONEFLOW_CORE_VM_ELEMENTWISE_FUSION_H_
+
+#include <vector>
+#include "oneflow/core/common/maybe.h"
+
+namespace oneflow {
+namespace vm {
+
+class Instruction;
+class OpCallInstructionPolicy;
+
+// Returns true if `op_call` is a call of a CPU elementwise unary, binary, scalar or cast op which
+// TryComputeFusedElementwise is able to compute together with its neighbours.
+bool IsFusableElementwiseOpCall(const OpCallInstructionPolicy& op_call);
+
+// Returns true if `instruction` is an op call accepted by IsFusableElementwiseOpCall.
+bool IsFusableElementwiseInstruction(Instruction* instruction);
+
+// Computes the op calls of `instructions` (all accepted by IsFusableElementwiseInstruction, in
+// program order) in a single chunked pass, so that every intermediate result is consumed by the
+// following ops while it is still in cache instead of being re-read from memory by a separate
+// full-tensor pass. Returns false if the ops do not form a fusable expression, e.g. because of
+// mismatched element counts or unsupported broadcasting, the caller then computes them one by one.
+Maybe<bool> TryComputeFusedElementwise(const std::vector<Instruction*>& instructions);
+
+// Number of instructions computed by TryComputeFusedElementwise in this process.
+int64_t FusedElementwiseInstructionCount();
+
+}  // namespace vm
+}  // namespace oneflow
+
+#endif  // ONEFLOW_CORE_VM_ELEMENTWISE_FUSION_H_
@@ -19,6 +19,8 @@ limitations under the License.
 #include <functional>
 #include "oneflow/core/vm/instruction.h"
 #include "oneflow/core/vm/instruction_policy_util.h"
+#include "oneflow/core/vm/elementwise_fusion.h"
+#include "oneflow/core/common/env_var/eager.h"
 #include "oneflow/core/vm/vm_object.h"
 
 namespace oneflow {
@@ -72,8 +74,32 @@ class FuseInstructionPolicy final : public InstructionPolicy {
   }
   void Compute(Instruction* instruction) override {
     OF_PROFILER_RANGE_GUARD("F:" + instruction->DebugName());
+    if (ThreadLocalEnvBool<ONEFLOW_EAGER_ENABLE_ELEMENTWISE_FUSION>()) {
+      return ComputeWithElementwiseFusion();
+    }
     INTRUSIVE_UNSAFE_FOR_EACH_PTR(instruction, mut_instruction_list()) { instruction->Compute(); }
   }
+  void ComputeWithElementwiseFusion() {
+    std::vector<Instruction*> elementwise_instructions;
+    const auto& ComputeElementwiseInstructions = [&]() {
+      if (elementwise_instructions.size() > 1
+          && CHECK_JUST(TryComputeFusedElementwise(elementwise_instructions))) {
+        elementwise_instructions.clear();
+        return;
+      }
+      for (auto* instruction : elementwise_instructions) { instruction->Compute(); }
+      elementwise_instructions.clear();
+    };
+    INTRUSIVE_UNSAFE_FOR_EACH_PTR(instruction, mut_instruction_list()) {
+      if (IsFusableElementwiseInstruction(instruction)) {
+        elementwise_instructions.emplace_back(instruction);
+      } else {
+        ComputeElementwiseInstructions();
+        instruction->Compute();
+      }
+    }
+    ComputeElementwiseInstructions();
+  }
   void InitInstructionStatus(Instruction* instruction) override {
     auto* last_instruction = CHECK_NOTNULL(mut_instruction_list()->Last());
     last_instruction->mut_instruction_policy()->InitInstructionStatusIf(instruction);
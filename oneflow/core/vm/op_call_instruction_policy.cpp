@@ -16,6 +16,8 @@ limitations under the License.
 
 #include "oneflow/core/vm/op_call_instruction_policy.h"
 #include "oneflow/core/vm/allocator.h"
+#include "oneflow/core/vm/elementwise_fusion.h"
+#include "oneflow/core/common/env_var/eager.h"
 #include "oneflow/user/kernels/stateful_opkernel.h"
 #include "oneflow/core/eager/dev_vm_dep_object_consume_mode.h"
 #include "oneflow/core/framework/stream_is_comm_net_stream.h"
@@ -146,7 +148,15 @@ OpCallInstructionPolicy::OpCallInstructionPolicy(
 }
 
 Maybe<void> OpCallInstructionPolicy::Init() {
-  return mut_opkernel()->ChooseOpKernel(&call_ctx_, &user_opkernel_, &need_temp_storage_);
+  JUST(mut_opkernel()->ChooseOpKernel(&call_ctx_, &user_opkernel_, &need_temp_storage_));
+  // Vm only fuses instructions sharing the same stream sequential dependence, sequentialize
+  // elementwise instructions so that consecutive ones can be computed in a single pass.
+  if (stream_sequential_dependence_ == nullptr
+      && ThreadLocalEnvBool<ONEFLOW_EAGER_ENABLE_ELEMENTWISE_FUSION>()
+      && IsFusableElementwiseOpCall(*this)) {
+    stream_sequential_dependence_ = vm_stream_->schedule_local_dep_object().get();
+  }
+  return Maybe<void>::Ok();
 }
 
 template<typename DoEachT>
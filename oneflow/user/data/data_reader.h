@@ -25,23 +25,34 @@ namespace oneflow {
 namespace data {
 
 static const int32_t kDataReaderBatchBufferSize = 4;
+static const int32_t kDataReaderMaxBatchBufferSize = 32;
+// The prefetch depth is halved again once this many fetches in a row found a batch ready.
+static const int32_t kDataReaderPrefetchShrinkInterval = 256;
 
 template<typename LoadTarget>
 class DataReader {
  public:
   using SampleType = LoadTarget;
   using BatchType = std::vector<SampleType>;
+  using LoaderCreator =
+      std::function<std::unique_ptr<Dataset<LoadTarget>>(int32_t worker_id, int32_t num_workers)>;
 
   DataReader(user_op::KernelInitContext* ctx)
-      : is_closed_(false), batch_buffer_(kDataReaderBatchBufferSize) {}
+      : is_closed_(false),
+        ordered_(ParseBooleanFromEnv("ONEFLOW_DATA_READER_ORDERED", true)),
+        prefetch_depth_(kDataReaderBatchBufferSize),
+        num_ready_fetches_(0),
+        num_fetches_(0) {}
 
   virtual ~DataReader() {
     Close();
-    if (load_thrd_.joinable()) { load_thrd_.join(); }
+    for (auto& load_thrd : load_thrds_) {
+      if (load_thrd.joinable()) { load_thrd.join(); }
+    }
   }
 
   void Read(user_op::KernelComputeContext* ctx) {
-    CHECK(load_thrd_.joinable()) << "You should call StartLoadThread before read data";
+    CHECK(!load_thrds_.empty()) << "You should call StartLoadThread before read data";
     auto batch = FetchBatchData();
     parser_->Parse(batch, ctx);
   }
@@ -49,36 +60,111 @@ class DataReader {
   void Close() {
     if (!is_closed_.load()) {
       is_closed_.store(true);
-      batch_buffer_.Close();
+      for (auto& batch_buffer : batch_buffers_) { batch_buffer->Close(); }
     }
   }
 
  protected:
   void StartLoadThread() {
-    if (load_thrd_.joinable()) { return; }
-    load_thrd_ = std::thread([this] {
-      while (!is_closed_.load() && LoadBatch()) {}
-    });
+    if (!load_thrds_.empty()) { return; }
+    batch_buffers_.emplace_back(new Buffer<BatchType>(prefetch_depth_));
+    StartWorker(loader_.get(), batch_buffers_.front().get());
   }
 
-  std::unique_ptr<Dataset<LoadTarget>> loader_;
-  std::unique_ptr<Parser<LoadTarget>> parser_;
+  // Loads batches with up to `max_num_workers` threads (ONEFLOW_DATA_READER_NUM_WORKERS, 1 by
+  // default), each one reading the batches of its own loader created by NewLoader. In ordered mode
+  // (ONEFLOW_DATA_READER_ORDERED, the default) every worker has its own buffer and the batches are
+  // taken from the workers in turn, so the batch order only depends on the number of workers.
+  // Otherwise all workers share one buffer and a slow worker does not hold back the others.
+  void StartLoadThreads(int32_t max_num_workers, const LoaderCreator& NewLoader) {
+    if (!load_thrds_.empty()) { return; }
+    const int32_t num_workers = static_cast<int32_t>(std::max<int64_t>(
+        std::min<int64_t>(ParseIntegerFromEnv("ONEFLOW_DATA_READER_NUM_WORKERS", 1),
+                          max_num_workers),
+        1));
+    if (num_workers == 1) {
+      loader_ = NewLoader(0, 1);
+      StartLoadThread();
+      return;
+    }
+    for (int32_t i = 0; i < num_workers; ++i) {
+      worker_loaders_.emplace_back(NewLoader(i, num_workers));
+    }
+    const int32_t num_buffers = ordered_ ? num_workers : 1;
+    for (int32_t i = 0; i < num_buffers; ++i) {
+      batch_buffers_.emplace_back(new Buffer<BatchType>(BufferDepth()));
+    }
+    for (int32_t i = 0; i < num_workers; ++i) {
+      StartWorker(worker_loaders_.at(i).get(), batch_buffers_.at(i % num_buffers).get());
+    }
+  }
 
- private:
   BatchType FetchBatchData() {
+    Buffer<BatchType>* batch_buffer =
+        batch_buffers_.at(num_fetches_ % batch_buffers_.size()).get();
     BatchType batch;
-    CHECK_EQ(batch_buffer_.Pull(&batch), BufferStatus::kBufferStatusSuccess);
+    BufferStatus status = batch_buffer->TryReceive(&batch);
+    // the first round of fetches waits for the workers to start up and says nothing about
+    // whether the prefetch depth is enough
+    if (num_fetches_ >= batch_buffers_.size()) {
+      AdaptPrefetchDepth(status == BufferStatus::kBufferStatusEmpty);
+    }
+    if (status == BufferStatus::kBufferStatusEmpty) { status = batch_buffer->Pull(&batch); }
+    CHECK_EQ(status, BufferStatus::kBufferStatusSuccess);
+    num_fetches_ += 1;
     return batch;
   }
 
-  bool LoadBatch() {
-    BatchType batch = loader_->Next();
-    return batch_buffer_.Push(std::move(batch)) == BufferStatus::kBufferStatusSuccess;
+  int32_t prefetch_depth() const { return prefetch_depth_; }
+
+  std::unique_ptr<Dataset<LoadTarget>> loader_;
+  std::unique_ptr<Parser<LoadTarget>> parser_;
+
+ private:
+  void StartWorker(Dataset<LoadTarget>* loader, Buffer<BatchType>* batch_buffer) {
+    load_thrds_.emplace_back([this, loader, batch_buffer] {
+      while (!is_closed_.load() && LoadBatch(loader, batch_buffer)) {}
+    });
+  }
+
+  // Doubles the prefetch depth each time the consumer has to wait for a batch, up to
+  // kDataReaderMaxBatchBufferSize, and gives the memory back step by step once the loaders keep
+  // up again.
+  void AdaptPrefetchDepth(bool stalled) {
+    if (stalled) {
+      num_ready_fetches_ = 0;
+      if (prefetch_depth_ >= kDataReaderMaxBatchBufferSize) { return; }
+      prefetch_depth_ = std::min(prefetch_depth_ * 2, kDataReaderMaxBatchBufferSize);
+    } else {
+      num_ready_fetches_ += 1;
+      if (num_ready_fetches_ < kDataReaderPrefetchShrinkInterval) { return; }
+      num_ready_fetches_ = 0;
+      if (prefetch_depth_ <= kDataReaderBatchBufferSize) { return; }
+      prefetch_depth_ = std::max(prefetch_depth_ / 2, kDataReaderBatchBufferSize);
+    }
+    for (auto& batch_buffer : batch_buffers_) { batch_buffer->SetMaxLen(BufferDepth()); }
+  }
+
+  // a buffer shared by all workers of the unordered mode is as deep as all the per worker buffers
+  // of the ordered mode together
+  size_t BufferDepth() const {
+    const size_t num_workers = std::max<size_t>(worker_loaders_.size(), 1);
+    return prefetch_depth_ * (ordered_ ? 1 : num_workers);
+  }
+
+  bool LoadBatch(Dataset<LoadTarget>* loader, Buffer<BatchType>* batch_buffer) {
+    BatchType batch = loader->Next();
+    return batch_buffer->Push(std::move(batch)) == BufferStatus::kBufferStatusSuccess;
   }
 
   std::atomic<bool> is_closed_;
-  Buffer<BatchType> batch_buffer_;
-  std::thread load_thrd_;
+  bool ordered_;
+  int32_t prefetch_depth_;
+  int32_t num_ready_fetches_;
+  size_t num_fetches_;
+  std::vector<std::unique_ptr<Dataset<LoadTarget>>> worker_loaders_;
+  std::vector<std::unique_ptr<Buffer<BatchType>>> batch_buffers_;
+  std::vector<std::thread> load_thrds_;
 };
 
 }  // namespace data
@@ -0,0 +1,174 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include <gtest/gtest.h>
+#include <chrono>
+#include <cstdlib>
+#include <thread>
+#include "oneflow/user/data/data_reader.h"
+#include "oneflow/user/data/distributed_util.h"
+
+namespace oneflow {
+namespace data {
+
+namespace {
+
+constexpr int64_t kSamplesPerWorker = 1000;
+
+// Batches of one sample counting up from worker_id * kSamplesPerWorker, optionally slowed down.
+class CountingDataset final : public Dataset<int64_t> {
+ public:
+  CountingDataset(int32_t worker_id, const std::atomic<bool>* slow)
+      : next_(worker_id * kSamplesPerWorker), slow_(slow) {}
+  ~CountingDataset() override = default;
+
+  BatchType Next() override {
+    if (slow_ != nullptr && slow_->load()) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    BatchType batch;
+    batch.push_back(next_);
+    next_ += 1;
+    return batch;
+  }
+
+ private:
+  int64_t next_;
+  const std::atomic<bool>* slow_;
+};
+
+class TestDataReader final : public DataReader<int64_t> {
+ public:
+  explicit TestDataReader(const std::atomic<bool>* slow = nullptr)
+      : DataReader<int64_t>(nullptr), slow_(slow) {}
+  ~TestDataReader() override = default;
+
+  void Start(int32_t max_num_workers) {
+    const std::atomic<bool>* slow = slow_;
+    StartLoadThreads(max_num_workers, [slow](int32_t worker_id, int32_t num_workers) {
+      return std::unique_ptr<Dataset<int64_t>>(new CountingDataset(worker_id, slow));
+    });
+  }
+
+  int64_t Fetch() {
+    BatchType batch = FetchBatchData();
+    CHECK_EQ(batch.size(), 1);
+    return batch.front();
+  }
+
+  using DataReader<int64_t>::prefetch_depth;
+
+ private:
+  const std::atomic<bool>* slow_;
+};
+
+class ScopedEnv final {
+ public:
+  ScopedEnv(const std::string& name, const std::string& value) : name_(name) {
+    setenv(name_.c_str(), value.c_str(), 1);
+  }
+  ~ScopedEnv() { unsetenv(name_.c_str()); }
+
+ private:
+  std::string name_;
+};
+
+}  // namespace
+
+TEST(DataReader, OrderedWorkers) {
+  ScopedEnv num_workers("ONEFLOW_DATA_READER_NUM_WORKERS", "3");
+  ScopedEnv ordered("ONEFLOW_DATA_READER_ORDERED", "1");
+  TestDataReader reader;
+  reader.Start(8);
+  // the batches are taken from the workers in turn
+  for (int64_t i = 0; i < 300; ++i) {
+    ASSERT_EQ(reader.Fetch(), (i % 3) * kSamplesPerWorker + i / 3);
+  }
+}
+
+TEST(DataReader, UnorderedWorkers) {
+  ScopedEnv num_workers("ONEFLOW_DATA_READER_NUM_WORKERS", "3");
+  ScopedEnv ordered("ONEFLOW_DATA_READER_ORDERED", "0");
+  TestDataReader reader;
+  reader.Start(8);
+  // the workers race for one buffer, but each one still delivers its own samples in order
+  std::vector<int64_t> next_sample(3, 0);
+  for (int64_t i = 0; i < 300; ++i) {
+    const int64_t sample = reader.Fetch();
+    const int64_t worker_id = sample / kSamplesPerWorker;
+    ASSERT_GE(worker_id, 0);
+    ASSERT_LT(worker_id, 3);
+    ASSERT_EQ(sample % kSamplesPerWorker, next_sample.at(worker_id));
+    next_sample.at(worker_id) += 1;
+  }
+}
+
+TEST(DataReader, NumWorkersIsClamped) {
+  ScopedEnv num_workers("ONEFLOW_DATA_READER_NUM_WORKERS", "4");
+  ScopedEnv ordered("ONEFLOW_DATA_READER_ORDERED", "1");
+  TestDataReader reader;
+  reader.Start(2);
+  for (int64_t i = 0; i < 100; ++i) {
+    ASSERT_EQ(reader.Fetch(), (i % 2) * kSamplesPerWorker + i / 2);
+  }
+}
+
+TEST(DataReader, AdaptPrefetchDepth) {
+  ScopedEnv num_workers("ONEFLOW_DATA_READER_NUM_WORKERS", "1");
+  std::atomic<bool> slow(true);
+  TestDataReader reader(&slow);
+  reader.Start(1);
+  ASSERT_EQ(reader.prefetch_depth(), kDataReaderBatchBufferSize);
+  // every fetch from a slow loader waits and doubles the depth
+  for (int i = 0; i < 8; ++i) { reader.Fetch(); }
+  ASSERT_EQ(reader.prefetch_depth(), kDataReaderMaxBatchBufferSize);
+  // once the loader keeps up the depth shrinks back step by step
+  slow.store(false);
+  int32_t min_depth = reader.prefetch_depth();
+  for (int i = 0; i < 16 * kDataReaderPrefetchShrinkInterval; ++i) {
+    reader.Fetch();
+    min_depth = std::min(min_depth, reader.prefetch_depth());
+    if (min_depth == kDataReaderBatchBufferSize) { break; }
+    std::this_thread::sleep_for(std::chrono::microseconds(200));
+  }
+  ASSERT_EQ(min_depth, kDataReaderBatchBufferSize);
+}
+
+TEST(DataReader, WorkerRange) {
+  const Range range(10, 27);
+  ASSERT_EQ(WorkerRange(range, 0, 1), range);
+  int64_t begin = range.begin();
+  for (int32_t worker_id = 0; worker_id < 4; ++worker_id) {
+    const Range worker_range = WorkerRange(range, worker_id, 4);
+    // the workers read consecutive balanced parts of the range
+    ASSERT_EQ(worker_range.begin(), begin);
+    ASSERT_GE(worker_range.size(), range.size() / 4);
+    ASSERT_LE(worker_range.size(), range.size() / 4 + 1);
+    begin = worker_range.end();
+  }
+  ASSERT_EQ(begin, range.end());
+}
+
+TEST(DataReader, WorkerSeed) {
+  ASSERT_EQ(WorkerSeed(7, 0), 7);
+  ASSERT_NE(WorkerSeed(7, 1), WorkerSeed(7, 0));
+  ASSERT_NE(WorkerSeed(7, 1), WorkerSeed(7, 2));
+  ASSERT_EQ(WorkerShuffleBufferSize(1024, 1), 1024);
+  ASSERT_EQ(WorkerShuffleBufferSize(1024, 4), 256);
+  ASSERT_EQ(WorkerShuffleBufferSize(1025, 4), 257);
+}
+
+}  // namespace data
+}  // namespace oneflow
@@ -18,6 +18,7 @@ limitations under the License.
 
 #include "oneflow/core/framework/framework.h"
 #include "oneflow/core/common/nd_index_offset_helper.h"
+#include "oneflow/core/common/balanced_splitter.h"
 #include "oneflow/core/job/sbp_parallel.h"
 #include "oneflow/core/rpc/include/global_process_ctx.h"
 
@@ -54,6 +55,24 @@ inline Maybe<void> InitDataSourceDistributedInfo(user_op::KernelInitContext* ctx
   return Maybe<void>::Ok();
 }
 
+// The part of the files `range` of a rank read by load worker `worker_id` of its data reader.
+inline Range WorkerRange(const Range& range, int32_t worker_id, int32_t num_workers) {
+  if (num_workers <= 1) { return range; }
+  CHECK_GE(range.size(), num_workers);
+  const Range worker_range = BalancedSplitter(range.size(), num_workers).At(worker_id);
+  return Range(range.begin() + worker_range.begin(), range.begin() + worker_range.end());
+}
+
+// The seed of load worker `worker_id` of a data reader seeded with `seed`, -1 for a random seed.
+inline int64_t WorkerSeed(int64_t seed, int32_t worker_id) {
+  return seed == -1 ? NewRandomSeed() : seed + worker_id;
+}
+
+// The share of a shuffle buffer of `buffer_size` samples held by each of `num_workers` workers.
+inline int32_t WorkerShuffleBufferSize(int32_t buffer_size, int32_t num_workers) {
+  return RoundUp(buffer_size, num_workers) / num_workers;
+}
+
 }  // namespace data
 
 }  // namespace oneflow
@@ -14,11 +14,15 @@ See the License for the specific language governing permissions and
 limitations under the License.
 */
 #include "oneflow/user/data/gpt_dataset.h"
+#include "oneflow/core/common/str_util.h"
+#include <sstream>
 
 #ifdef __linux__
 #include <fcntl.h>
 #include <stdio.h>
 #include <errno.h>
+#include <unistd.h>
+#include <sys/file.h>
 #include <sys/stat.h>
 #include <sys/mman.h>
 #endif
@@ -74,6 +78,114 @@ size_t GetNumCompleteEpochs(size_t num_samples, size_t seq_length, size_t tokens
   return separate_last_epoch ? (num_epochs - 1) : num_epochs;
 }
 
+constexpr char kIndexCacheMagicCode[] = "GPTIDXC";
+
+struct IndexCacheHeader {
+  char magic_code[sizeof(kIndexCacheMagicCode)];
+  uint64_t num_docs;
+  uint64_t tokens_per_epoch;
+  uint64_t elem_size;
+};
+
+static_assert(sizeof(IndexCacheHeader) == 32, "");
+static_assert(sizeof(std::pair<size_t, size_t>) == 2 * sizeof(size_t), "");
+
+// Returns the common prefix of the index cache files of a dataset, the key covers everything the
+// doc, sample and shuffle indices depend on. Returns an empty string if the cache is disabled.
+std::string GetIndexCachePrefix(const std::string& data_file_prefix,
+                                const std::vector<int64_t>& split_sizes, size_t split_index,
+                                size_t num_samples, size_t seq_len, bool shuffle, uint32_t seed) {
+#ifdef __linux__
+  if (!ParseBooleanFromEnv("ONEFLOW_GPT_DATASET_INDEX_CACHE", true)) { return ""; }
+  const std::string cache_dir =
+      GetStringFromEnv("ONEFLOW_GPT_DATASET_INDEX_CACHE_DIR", Dirname(data_file_prefix));
+  std::ostringstream ss;
+  ss << Basename(data_file_prefix) << "_split" << split_index;
+  for (int64_t split_size : split_sizes) { ss << "-" << split_size; }
+  ss << "_" << num_samples << "ns_" << seq_len << "sl";
+  if (shuffle) { ss << "_" << seed << "s"; }
+  return JoinPath(cache_dir, ss.str());
+#else
+  return "";
+#endif
+}
+
+// Takes an exclusive lock on `lock_path` which serializes the local ranks building the same index
+// cache, returns -1 if the lock file can't be created, e.g. in a read-only directory.
+int LockIndexCache(const std::string& lock_path) {
+#ifdef __linux__
+  int fd = open(lock_path.c_str(), O_RDWR | O_CREAT, 0644);
+  if (fd == -1) { return -1; }
+  CHECK(flock(fd, LOCK_EX) == 0) << "flock " << lock_path << " failed: " << strerror(errno);
+  return fd;
+#else
+  return -1;
+#endif
+}
+
+void UnlockIndexCache(int fd) {
+#ifdef __linux__
+  CHECK(flock(fd, LOCK_UN) == 0) << "unlock index cache failed: " << strerror(errno);
+  close(fd);
+#endif
+}
+
+template<typename T>
+bool LoadIndexCacheFile(const std::string& path, size_t num_docs, size_t tokens_per_epoch,
+                        IndexArray<T>* array) {
+#ifdef __linux__
+  struct stat s;
+  if (stat(path.c_str(), &s) != 0 || static_cast<size_t>(s.st_size) < sizeof(IndexCacheHeader)) {
+    return false;
+  }
+  auto mapped = std::make_unique<const MappedBuffer>(path);
+  const auto* header = static_cast<const IndexCacheHeader*>(mapped->ptr());
+  if (std::memcmp(header->magic_code, kIndexCacheMagicCode, sizeof(kIndexCacheMagicCode)) != 0
+      || header->num_docs != num_docs || header->tokens_per_epoch != tokens_per_epoch
+      || header->elem_size != sizeof(T)
+      || (mapped->size() - sizeof(IndexCacheHeader)) % sizeof(T) != 0) {
+    LOG(WARNING) << "Ignore mismatched GPT Dataset index cache file " << path;
+    return false;
+  }
+  array->Reset(std::move(mapped), sizeof(IndexCacheHeader));
+  return true;
+#else
+  return false;
+#endif
+}
+
+template<typename T>
+bool SaveIndexCacheFile(const std::string& path, size_t num_docs, size_t tokens_per_epoch,
+                        const IndexArray<T>& array) {
+#ifdef __linux__
+  IndexCacheHeader header{};
+  std::memcpy(header.magic_code, kIndexCacheMagicCode, sizeof(kIndexCacheMagicCode));
+  header.num_docs = num_docs;
+  header.tokens_per_epoch = tokens_per_epoch;
+  header.elem_size = sizeof(T);
+  // written aside and renamed, so a crashed writer never leaves a truncated cache file behind
+  const std::string tmp_path = path + ".tmp-" + std::to_string(getpid());
+  {
+    std::ofstream stream(tmp_path, std::ios::binary | std::ios::trunc);
+    if (!stream.is_open()) { return false; }
+    stream.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    stream.write(reinterpret_cast<const char*>(array.data()), sizeof(T) * array.size());
+    if (!stream.good()) {
+      stream.close();
+      std::remove(tmp_path.c_str());
+      return false;
+    }
+  }
+  if (std::rename(tmp_path.c_str(), path.c_str()) != 0) {
+    std::remove(tmp_path.c_str());
+    return false;
+  }
+  return true;
+#else
+  return false;
+#endif
+}
+
 }  // namespace
 
 constexpr char MegatronGPTIndex::kMagicCode[];
@@ -161,11 +273,28 @@ MegatronGPTMMapDataset::MegatronGPTMMapDataset(const std::string& data_file_pref
   tokens_per_epoch_ = GetEpochNumTokens(epoch_doc_indices);
   num_epochs_ = GetNumEpochs(num_samples_, seq_len_, tokens_per_epoch_);
   num_complete_epochs_ = GetNumCompleteEpochs(num_samples_, seq_len_, tokens_per_epoch_);
-  InitDocIndices(epoch_doc_indices, num_epochs_, num_complete_epochs_);
   size_t total_num_samples = static_cast<size_t>(
       std::floor(static_cast<double>(num_epochs_ * tokens_per_epoch_ - 1) / seq_len_));
-  InitSampleIndices(total_num_samples);
-  InitShuffleIndices(sample_indices_.size());
+  const std::string cache_prefix = GetIndexCachePrefix(
+      data_file_prefix, split_sizes, split_index, num_samples_, seq_len_, shuffle_, seed_);
+  const int lock_fd = cache_prefix.empty() ? -1 : LockIndexCache(cache_prefix + ".lock");
+  if (lock_fd != -1) {
+    // the first local rank taking the lock builds and saves the indices, the others find them
+    // saved once they get the lock and all ranks share the same read-only mapped pages
+    bool cached = LoadCachedIndices(cache_prefix);
+    if (!cached) {
+      InitIndices(epoch_doc_indices, total_num_samples);
+      // remap the saved files to drop the private copies of the indices
+      if (SaveCachedIndices(cache_prefix)) { CHECK(LoadCachedIndices(cache_prefix)); }
+    }
+    UnlockIndexCache(lock_fd);
+    VLOG(2) << "GPT Dataset indices " << (cached ? "loaded from " : "cached in ") << cache_prefix;
+  } else {
+    InitIndices(epoch_doc_indices, total_num_samples);
+  }
+  CHECK_EQ(sample_indices_.size(), total_num_samples);
+  CHECK_GE(sample_indices_.size(), num_samples_);
+  CHECK_EQ(shuffle_indices_.size(), sample_indices_.size());
   std::chrono::duration<double, std::milli> elapse = std::chrono::system_clock::now() - start;
   VLOG(2) << "Create GPT Dataset successed, sequence length: " << seq_len_
           << ", number of samples: " << num_samples_
@@ -183,36 +312,60 @@ size_t MegatronGPTMMapDataset::GetEpochNumTokens(const std::vector<size_t>& doc_
   return num_tokens;
 }
 
+void MegatronGPTMMapDataset::InitIndices(const std::vector<size_t>& epoch_doc_indices,
+                                         size_t total_num_samples) {
+  std::vector<size_t> doc_indices;
+  InitDocIndices(epoch_doc_indices, num_epochs_, num_complete_epochs_, &doc_indices);
+  // the sample indices only depend on the doc indices and the shuffle indices only on the number
+  // of samples, so both are built at the same time with the generator state left by the doc
+  // shuffle, which keeps the result identical to building them one after another
+  std::vector<size_t> shuffle_indices;
+  std::mt19937 shuffle_gen = gen_;
+  std::thread shuffle_thread([&]() {
+    InitShuffleIndices(total_num_samples, &shuffle_gen, &shuffle_indices);
+  });
+  std::vector<std::pair<size_t, size_t>> sample_indices;
+  InitSampleIndices(doc_indices, total_num_samples, &sample_indices);
+  shuffle_thread.join();
+  gen_ = shuffle_gen;
+  doc_indices_.Reset(std::move(doc_indices));
+  sample_indices_.Reset(std::move(sample_indices));
+  shuffle_indices_.Reset(std::move(shuffle_indices));
+}
+
 void MegatronGPTMMapDataset::InitDocIndices(const std::vector<size_t>& epoch_doc_indices,
-                                            size_t num_epochs, size_t num_complete_epochs) {
-  doc_indices_.reserve(epoch_doc_indices.size() * num_epochs);
-  InitDocIndices(epoch_doc_indices, num_complete_epochs);
+                                            size_t num_epochs, size_t num_complete_epochs,
+                                            std::vector<size_t>* doc_indices) {
+  doc_indices->reserve(epoch_doc_indices.size() * num_epochs);
+  InitDocIndices(epoch_doc_indices, num_complete_epochs, doc_indices);
   if (num_epochs != num_complete_epochs) {
     CHECK_EQ(num_complete_epochs + 1, num_epochs);
-    InitDocIndices(epoch_doc_indices, 1);
+    InitDocIndices(epoch_doc_indices, 1, doc_indices);
   }
 }
 
 void MegatronGPTMMapDataset::InitDocIndices(const std::vector<size_t>& epoch_doc_indices,
-                                            size_t num_epochs) {
-  auto start = std::distance(doc_indices_.cbegin(), doc_indices_.cend());
+                                            size_t num_epochs, std::vector<size_t>* doc_indices) {
+  auto start = std::distance(doc_indices->cbegin(), doc_indices->cend());
   FOR_RANGE(size_t, i, 0, num_epochs) {
-    doc_indices_.insert(doc_indices_.end(), epoch_doc_indices.cbegin(), epoch_doc_indices.cend());
+    doc_indices->insert(doc_indices->end(), epoch_doc_indices.cbegin(), epoch_doc_indices.cend());
   }
-  if (shuffle_) { std::shuffle(doc_indices_.begin() + start, doc_indices_.end(), gen_); }
+  if (shuffle_) { std::shuffle(doc_indices->begin() + start, doc_indices->end(), gen_); }
 }
 
-void MegatronGPTMMapDataset::InitSampleIndices(size_t total_num_samples) {
-  sample_indices_.reserve(total_num_samples);
+void MegatronGPTMMapDataset::InitSampleIndices(
+    const std::vector<size_t>& doc_indices, size_t total_num_samples,
+    std::vector<std::pair<size_t, size_t>>* sample_indices) const {
+  sample_indices->reserve(total_num_samples);
   size_t doc_indices_idx = 0;
   size_t doc_offset = 0;
   FOR_RANGE(size_t, i, 0, total_num_samples) {
-    if (doc_indices_idx >= doc_indices_.size()) { break; }
-    sample_indices_.emplace_back(doc_indices_idx, doc_offset);
+    if (doc_indices_idx >= doc_indices.size()) { break; }
+    sample_indices->emplace_back(doc_indices_idx, doc_offset);
     int remaining_tokens = seq_len_;
     while (remaining_tokens > 0) {
-      CHECK_LT(doc_indices_idx, doc_indices_.size());
-      size_t doc_len = index_->doc_length(doc_indices_[doc_indices_idx]);
+      CHECK_LT(doc_indices_idx, doc_indices.size());
+      size_t doc_len = index_->doc_length(doc_indices[doc_indices_idx]);
       CHECK_LT(doc_offset, doc_len);
       doc_len -= doc_offset;
       if (remaining_tokens < doc_len) {
@@ -226,24 +379,49 @@ void MegatronGPTMMapDataset::InitSampleIndices(size_t total_num_samples) {
       remaining_tokens -= doc_len;
     }
   }
-  CHECK_EQ(sample_indices_.size(), total_num_samples);
-  CHECK_GE(sample_indices_.size(), num_samples_);
 }
 
-void MegatronGPTMMapDataset::InitShuffleIndices(size_t total_num_samples) {
-  shuffle_indices_.resize(total_num_samples);
-  std::iota(shuffle_indices_.begin(), shuffle_indices_.end(), 0);
+void MegatronGPTMMapDataset::InitShuffleIndices(size_t total_num_samples, std::mt19937* gen,
+                                                std::vector<size_t>* shuffle_indices) const {
+  shuffle_indices->resize(total_num_samples);
+  std::iota(shuffle_indices->begin(), shuffle_indices->end(), 0);
   if (shuffle_) {
     size_t num_samples = static_cast<size_t>(
         std::floor(static_cast<double>(num_complete_epochs_ * tokens_per_epoch_ - 1) / seq_len_));
-    CHECK_LE(num_samples, shuffle_indices_.size());
-    std::shuffle(shuffle_indices_.begin(), shuffle_indices_.begin() + num_samples, gen_);
+    CHECK_LE(num_samples, shuffle_indices->size());
+    std::shuffle(shuffle_indices->begin(), shuffle_indices->begin() + num_samples, *gen);
     if (num_complete_epochs_ != num_epochs_) {
-      std::shuffle(shuffle_indices_.begin() + num_samples, shuffle_indices_.end(), gen_);
+      std::shuffle(shuffle_indices->begin() + num_samples, shuffle_indices->end(), *gen);
     }
   }
 }
 
+bool MegatronGPTMMapDataset::LoadCachedIndices(const std::string& cache_prefix) {
+  const size_t num_docs = index_->num_docs();
+  return LoadIndexCacheFile(cache_prefix + "_doc_idx.bin", num_docs, tokens_per_epoch_,
+                            &doc_indices_)
+         && LoadIndexCacheFile(cache_prefix + "_sample_idx.bin", num_docs, tokens_per_epoch_,
+                               &sample_indices_)
+         && LoadIndexCacheFile(cache_prefix + "_shuffle_idx.bin", num_docs, tokens_per_epoch_,
+                               &shuffle_indices_);
+}
+
+bool MegatronGPTMMapDataset::SaveCachedIndices(const std::string& cache_prefix) const {
+  const size_t num_docs = index_->num_docs();
+  // the shuffle indices are saved last, their presence marks a complete cache
+  bool saved = SaveIndexCacheFile(cache_prefix + "_doc_idx.bin", num_docs, tokens_per_epoch_,
+                                  doc_indices_)
+               && SaveIndexCacheFile(cache_prefix + "_sample_idx.bin", num_docs,
+                                     tokens_per_epoch_, sample_indices_)
+               && SaveIndexCacheFile(cache_prefix + "_shuffle_idx.bin", num_docs,
+                                     tokens_per_epoch_, shuffle_indices_);
+  if (!saved) {
+    LOG(WARNING) << "Failed to save GPT Dataset index cache " << cache_prefix
+                 << ", the indices will be rebuilt next time";
+  }
+  return saved;
+}
+
 const HashMap<char, size_t> MegatronGPTMMapDataset::kDTypeCode2Size = {
     {1, 1},  // DataType::kUInt8
     {2, 1},  // DataType::kInt8
@@ -58,6 +58,41 @@ class MappedBuffer final {
   size_t size_;
 };
 
+// A read-only index array which is either built in memory or memory-mapped from an index cache
+// file, in which case the elements start `offset` bytes into the mapped file.
+template<typename T>
+class IndexArray final {
+ public:
+  IndexArray() : data_(nullptr), size_(0) {}
+  OF_DISALLOW_COPY_AND_MOVE(IndexArray);
+  ~IndexArray() = default;
+
+  void Reset(std::vector<T>&& vec) {
+    mapped_.reset();
+    vec_ = std::move(vec);
+    data_ = vec_.data();
+    size_ = vec_.size();
+  }
+  void Reset(std::unique_ptr<const MappedBuffer>&& mapped, size_t offset) {
+    CHECK_GE(mapped->size(), offset);
+    CHECK_EQ((mapped->size() - offset) % sizeof(T), 0);
+    vec_.clear();
+    mapped_ = std::move(mapped);
+    data_ = reinterpret_cast<const T*>(static_cast<const char*>(mapped_->ptr()) + offset);
+    size_ = (mapped_->size() - offset) / sizeof(T);
+  }
+
+  const T* data() const { return data_; }
+  size_t size() const { return size_; }
+  const T& operator[](size_t i) const { return data_[i]; }
+
+ private:
+  std::vector<T> vec_;
+  std::unique_ptr<const MappedBuffer> mapped_;
+  const T* data_;
+  size_t size_;
+};
+
 class MegatronGPTMMapDataset final {
  public:
   MegatronGPTMMapDataset(const std::string& data_file_prefix, size_t seq_len, size_t label_len,
@@ -73,11 +108,17 @@ class MegatronGPTMMapDataset final {
   static const HashMap<char, size_t> kDTypeCode2Size;
 
   size_t GetEpochNumTokens(const std::vector<size_t>& doc_indices) const;
+  void InitIndices(const std::vector<size_t>& epoch_doc_indices, size_t total_num_samples);
+  void InitDocIndices(const std::vector<size_t>& epoch_doc_indices, size_t num_epochs,
+                      size_t num_complete_epochs, std::vector<size_t>* doc_indices);
   void InitDocIndices(const std::vector<size_t>& epoch_doc_indices, size_t num_epochs,
-                      size_t num_complete_epochs);
-  void InitDocIndices(const std::vector<size_t>& doc_indices, size_t num_epochs);
-  void InitSampleIndices(size_t total_num_samples);
-  void InitShuffleIndices(size_t total_num_samples);
+                      std::vector<size_t>* doc_indices);
+  void InitSampleIndices(const std::vector<size_t>& doc_indices, size_t total_num_samples,
+                         std::vector<std::pair<size_t, size_t>>* sample_indices) const;
+  void InitShuffleIndices(size_t total_num_samples, std::mt19937* gen,
+                          std::vector<size_t>* shuffle_indices) const;
+  bool LoadCachedIndices(const std::string& cache_prefix);
+  bool SaveCachedIndices(const std::string& cache_prefix) const;
   template<typename T>
   void ReadTokens(const void* src, size_t offset, T* dst, size_t size) const;
 
@@ -96,9 +137,9 @@ class MegatronGPTMMapDataset final {
   size_t tokens_per_epoch_;
   size_t num_epochs_;
   size_t num_complete_epochs_;
-  std::vector<size_t> doc_indices_;
-  std::vector<std::pair<size_t, size_t>> sample_indices_;
-  std::vector<size_t> shuffle_indices_;
+  IndexArray<size_t> doc_indices_;
+  IndexArray<std::pair<size_t, size_t>> sample_indices_;
+  IndexArray<size_t> shuffle_indices_;
 };
 
 template<typename T>
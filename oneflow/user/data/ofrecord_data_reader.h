@@ -18,6 +18,7 @@ limitations under the License.
 
 #include "oneflow/user/data/data_reader.h"
 #include "oneflow/user/data/ofrecord_dataset.h"
+#include "oneflow/user/data/ofrecord_indexed_dataset.h"
 #include "oneflow/user/data/ofrecord_parser.h"
 #include "oneflow/user/data/random_shuffle_dataset.h"
 #include "oneflow/user/data/batch_dataset.h"
@@ -30,13 +31,31 @@ class OFRecordDataReader final : public DataReader<TensorBuffer> {
   OFRecordDataReader(user_op::KernelInitContext* ctx) : DataReader<TensorBuffer>(ctx) {
     batch_size_ = ctx->TensorDesc4ArgNameAndIndex("out", 0)->shape().elem_cnt();
     if (auto* pool = TensorBufferPool::TryGet()) { pool->IncreasePoolSizeByBase(batch_size_); }
-    loader_.reset(new OFRecordDataset(ctx));
-    if (ctx->Attr<bool>("random_shuffle")) {
-      loader_.reset(new RandomShuffleDataset<TensorBuffer>(ctx, std::move(loader_)));
-    }
-    loader_.reset(new BatchDataset<TensorBuffer>(batch_size_, std::move(loader_)));
     parser_.reset(new OFRecordParser());
-    StartLoadThread();
+    const size_t batch_size = batch_size_;
+    std::shared_ptr<const OFRecordPartIndexes> part_indexes;
+    // with the record indexes, the load workers split the records instead of the part files
+    int32_t max_num_workers = std::numeric_limits<int32_t>::max();
+    if (ctx->Attr<bool>("use_index")) {
+      part_indexes.reset(new OFRecordPartIndexes(ctx));
+    } else {
+      max_num_workers = OFRecordDataset::NumLocalParts(ctx);
+    }
+    StartLoadThreads(max_num_workers, [ctx, batch_size, part_indexes](int32_t worker_id,
+                                                                      int32_t num_workers) {
+      std::unique_ptr<Dataset<TensorBuffer>> loader;
+      if (part_indexes) {
+        loader.reset(new OFRecordIndexedDataset(ctx, part_indexes, worker_id, num_workers));
+      } else {
+        loader.reset(new OFRecordDataset(ctx, worker_id, num_workers));
+      }
+      if (ctx->Attr<bool>("random_shuffle")) {
+        loader.reset(
+            new RandomShuffleDataset<TensorBuffer>(ctx, std::move(loader), worker_id, num_workers));
+      }
+      loader.reset(new BatchDataset<TensorBuffer>(batch_size, std::move(loader)));
+      return loader;
+    });
   }
 
   ~OFRecordDataReader() override {
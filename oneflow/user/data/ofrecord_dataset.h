@@ -24,6 +24,7 @@ limitations under the License.
 #include "oneflow/core/rpc/include/global_process_ctx.h"
 #include "oneflow/core/job/env_desc.h"
 #include "oneflow/user/data/dataset.h"
+#include "oneflow/user/data/distributed_util.h"
 
 namespace oneflow {
 namespace data {
@@ -36,24 +37,42 @@ class OFRecordDataset final : public Dataset<TensorBuffer> {
 
   OF_DISALLOW_COPY_AND_MOVE(OFRecordDataset);
 
-  OFRecordDataset(user_op::KernelInitContext* ctx) {
+  OFRecordDataset(user_op::KernelInitContext* ctx) : OFRecordDataset(ctx, 0, 1) {}
+  // Reads the part `worker_id` out of `num_workers` of the data part files of this rank.
+  OFRecordDataset(user_op::KernelInitContext* ctx, int32_t worker_id, int32_t num_workers) {
     current_epoch_ = 0;
     shuffle_after_epoch_ = ctx->Attr<bool>("shuffle_after_epoch");
 
     // in stream
     data_part_num_ = ctx->Attr<int32_t>("data_part_num");
-    std::string data_dir = ctx->Attr<std::string>("data_dir");
-    std::string part_name_prefix = ctx->Attr<std::string>("part_name_prefix");
-    int32_t part_name_suffix_length = ctx->Attr<int32_t>("part_name_suffix_length");
+    data_file_paths_ = PartFilePaths(ctx);
+    range_ = WorkerRange(RankRange(ctx), worker_id, num_workers);
+    std::vector<std::string> local_file_paths = GetLocalFilePaths();
+    in_stream_.reset(
+        new PersistentInStream(DataFS(), local_file_paths, !shuffle_after_epoch_, false));
+  }
+  ~OFRecordDataset() = default;
+
+  // The number of data part files read by this rank, which bounds the number of load workers.
+  static int32_t NumLocalParts(user_op::KernelInitContext* ctx) { return RankRange(ctx).size(); }
 
-    for (int i = 0; i < data_part_num_; ++i) {
+  static std::vector<std::string> PartFilePaths(user_op::KernelInitContext* ctx) {
+    const int32_t data_part_num = ctx->Attr<int32_t>("data_part_num");
+    const std::string& data_dir = ctx->Attr<std::string>("data_dir");
+    const std::string& part_name_prefix = ctx->Attr<std::string>("part_name_prefix");
+    const int32_t part_name_suffix_length = ctx->Attr<int32_t>("part_name_suffix_length");
+    std::vector<std::string> paths;
+    for (int i = 0; i < data_part_num; ++i) {
       std::string num = std::to_string(i);
       int32_t zero_count =
           std::max(part_name_suffix_length - static_cast<int32_t>(num.length()), 0);
-      data_file_paths_.emplace_back(
-          JoinPath(data_dir, part_name_prefix + std::string(zero_count, '0') + num));
+      paths.emplace_back(JoinPath(data_dir, part_name_prefix + std::string(zero_count, '0') + num));
     }
+    return paths;
+  }
 
+  // The rank of this reader among the ranks sharing the dataset and their number.
+  static std::pair<int32_t, int32_t> ParallelIdAndNum(user_op::KernelInitContext* ctx) {
     bool is_local = false;
     // NOTE(zwx): OFRecordDataset is used by OFRecordDataReader and
     // OFRecordImageClassificationDataReader both, the latter has no attr nd_sbp,
@@ -67,20 +86,11 @@ class OFRecordDataset final : public Dataset<TensorBuffer> {
       if (nd_sbp_str_vec.empty()) { is_local = true; }
     }
     if (is_local) {
-      parallel_id_ = GlobalProcessCtx::Rank();
-      parallel_num_ = GlobalProcessCtx::WorldSize();
+      return std::make_pair(GlobalProcessCtx::Rank(), GlobalProcessCtx::WorldSize());
     } else {
-      parallel_id_ = ctx->parallel_ctx().parallel_id();
-      parallel_num_ = ctx->parallel_ctx().parallel_num();
+      return std::make_pair(ctx->parallel_ctx().parallel_id(), ctx->parallel_ctx().parallel_num());
     }
-    CHECK_LE(parallel_num_, data_part_num_);
-    BalancedSplitter bs(data_part_num_, parallel_num_);
-    range_ = bs.At(parallel_id_);
-    std::vector<std::string> local_file_paths = GetLocalFilePaths();
-    in_stream_.reset(
-        new PersistentInStream(DataFS(), local_file_paths, !shuffle_after_epoch_, false));
   }
-  ~OFRecordDataset() = default;
 
   BatchType Next() override {
     BatchType batch;
@@ -90,6 +100,14 @@ class OFRecordDataset final : public Dataset<TensorBuffer> {
   }
 
  private:
+  static Range RankRange(user_op::KernelInitContext* ctx) {
+    const int32_t data_part_num = ctx->Attr<int32_t>("data_part_num");
+    const auto parallel_id_and_num = ParallelIdAndNum(ctx);
+    CHECK_LE(parallel_id_and_num.second, data_part_num);
+    BalancedSplitter bs(data_part_num, parallel_id_and_num.second);
+    return bs.At(parallel_id_and_num.first);
+  }
+
   void ReadSample(TensorBuffer& tensor) {
     int64_t OFRecord_size = -1;
     char* size_ptr = reinterpret_cast<char*>(&OFRecord_size);
@@ -123,8 +141,6 @@ class OFRecordDataset final : public Dataset<TensorBuffer> {
   bool shuffle_after_epoch_;
 
   int32_t data_part_num_;
-  int32_t parallel_id_;
-  int32_t parallel_num_;
   Range range_;
   std::vector<std::string> data_file_paths_;
   std::unique_ptr<PersistentInStream> in_stream_;
@@ -0,0 +1,273 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "oneflow/user/data/ofrecord_feature_view.h"
+
+namespace oneflow {
+namespace data {
+
+namespace {
+
+enum WireType {
+  kWireTypeVarint = 0,
+  kWireTypeFixed64 = 1,
+  kWireTypeLengthDelimited = 2,
+  kWireTypeFixed32 = 5,
+};
+
+bool ReadVarint(const uint8_t** ptr, const uint8_t* end, uint64_t* value) {
+  uint64_t result = 0;
+  for (int shift = 0; shift < 64; shift += 7) {
+    if (*ptr >= end) { return false; }
+    const uint8_t byte = *(*ptr)++;
+    result |= static_cast<uint64_t>(byte & 0x7F) << shift;
+    if ((byte & 0x80) == 0) {
+      *value = result;
+      return true;
+    }
+  }
+  return false;
+}
+
+// Reads the field at `*ptr` and moves past it, the payload of a length-delimited field excludes
+// its length. Returns false on malformed input or on (deprecated) groups.
+bool ReadField(const uint8_t** ptr, const uint8_t* end, uint64_t* field_number, int* wire_type,
+               const uint8_t** payload, size_t* payload_size) {
+  uint64_t tag = 0;
+  if (!ReadVarint(ptr, end, &tag)) { return false; }
+  *field_number = tag >> 3;
+  *wire_type = static_cast<int>(tag & 0x7);
+  size_t size = 0;
+  switch (*wire_type) {
+    case kWireTypeVarint: {
+      const uint8_t* begin = *ptr;
+      uint64_t value = 0;
+      if (!ReadVarint(ptr, end, &value)) { return false; }
+      *payload = begin;
+      *payload_size = *ptr - begin;
+      return true;
+    }
+    case kWireTypeFixed64: size = 8; break;
+    case kWireTypeFixed32: size = 4; break;
+    case kWireTypeLengthDelimited: {
+      uint64_t length = 0;
+      if (!ReadVarint(ptr, end, &length)) { return false; }
+      size = length;
+      break;
+    }
+    default: return false;
+  }
+  if (size > static_cast<size_t>(end - *ptr)) { return false; }
+  *payload = *ptr;
+  *payload_size = size;
+  *ptr += size;
+  return true;
+}
+
+}  // namespace
+
+void SetSerializedOFRecord(const char* data, size_t size, OFRecord* record) {
+  auto* feature_map = record->mutable_feature();
+  if (feature_map->size() != 1 || feature_map->count(kSerializedOFRecordFeatureName) == 0) {
+    feature_map->clear();
+  }
+  auto* bytes_list = (*feature_map)[kSerializedOFRecordFeatureName].mutable_bytes_list();
+  if (bytes_list->value_size() != 1) {
+    bytes_list->clear_value();
+    bytes_list->add_value();
+  }
+  bytes_list->mutable_value(0)->assign(data, size);
+}
+
+OFRecordFeatureView::OFRecordFeatureView(const OFRecord& record, const std::string& name) {
+  auto serialized_it = record.feature().find(kSerializedOFRecordFeatureName);
+  if (serialized_it != record.feature().end()) {
+    const BytesList& bytes_list = serialized_it->second.bytes_list();
+    CHECK_EQ(bytes_list.value_size(), 1);
+    Init(bytes_list.value(0).data(), bytes_list.value(0).size(), name);
+  } else {
+    auto it = record.feature().find(name);
+    if (it != record.feature().end()) {
+      Reset(it->second);
+    } else {
+      found_ = false;
+      kind_ = Feature::KIND_NOT_SET;
+      value_size_ = 0;
+      data_ = nullptr;
+      size_ = 0;
+      varint_ = false;
+    }
+  }
+}
+
+OFRecordFeatureView::OFRecordFeatureView(const char* data, size_t size, const std::string& name) {
+  Init(data, size, name);
+}
+
+void OFRecordFeatureView::Init(const char* data, size_t size, const std::string& name) {
+  if (Scan(data, size, name)) { return; }
+  parsed_record_.reset(new OFRecord());
+  CHECK(parsed_record_->ParseFromArray(data, size));
+  auto it = parsed_record_->feature().find(name);
+  if (it != parsed_record_->feature().end()) {
+    Reset(it->second);
+  } else {
+    found_ = false;
+    kind_ = Feature::KIND_NOT_SET;
+  }
+}
+
+void OFRecordFeatureView::Reset(const Feature& feature) {
+  found_ = true;
+  kind_ = feature.kind_case();
+  value_size_ = 0;
+  data_ = nullptr;
+  size_ = 0;
+  varint_ = false;
+  switch (kind_) {
+    case Feature::kBytesList: {
+      value_size_ = feature.bytes_list().value_size();
+      if (value_size_ > 0) {
+        data_ = feature.bytes_list().value(0).data();
+        size_ = feature.bytes_list().value(0).size();
+      }
+      break;
+    }
+#define SWITCH_CASE_ENTRY(kind_case, list_name)                                  \
+  case Feature::kind_case: {                                                     \
+    value_size_ = feature.list_name().value_size();                              \
+    data_ = reinterpret_cast<const char*>(feature.list_name().value().data());   \
+    size_ = value_size_ * sizeof(*feature.list_name().value().data());           \
+    break;                                                                       \
+  }
+      SWITCH_CASE_ENTRY(kFloatList, float_list)
+      SWITCH_CASE_ENTRY(kDoubleList, double_list)
+      SWITCH_CASE_ENTRY(kInt32List, int32_list)
+      SWITCH_CASE_ENTRY(kInt64List, int64_list)
+#undef SWITCH_CASE_ENTRY
+    default: break;
+  }
+}
+
+bool OFRecordFeatureView::Scan(const char* data, size_t size, const std::string& name) {
+  found_ = false;
+  kind_ = Feature::KIND_NOT_SET;
+  value_size_ = 0;
+  data_ = nullptr;
+  size_ = 0;
+  varint_ = false;
+  uint64_t field_number = 0;
+  int wire_type = 0;
+  const uint8_t* payload = nullptr;
+  size_t payload_size = 0;
+  // OFRecord: every entry of the feature map is a message with the key as field 1 and the Feature
+  // as field 2, a later entry of the same key replaces the former one
+  const uint8_t* feature = nullptr;
+  size_t feature_size = 0;
+  const auto* ptr = reinterpret_cast<const uint8_t*>(data);
+  const uint8_t* end = ptr + size;
+  while (ptr < end) {
+    if (!ReadField(&ptr, end, &field_number, &wire_type, &payload, &payload_size)) {
+      return false;
+    }
+    if (field_number != 1 || wire_type != kWireTypeLengthDelimited) { continue; }
+    const uint8_t* entry_ptr = payload;
+    const uint8_t* entry_end = payload + payload_size;
+    const uint8_t* key = nullptr;
+    size_t key_size = 0;
+    const uint8_t* value = nullptr;
+    size_t value_size = 0;
+    while (entry_ptr < entry_end) {
+      if (!ReadField(&entry_ptr, entry_end, &field_number, &wire_type, &payload, &payload_size)) {
+        return false;
+      }
+      if (wire_type != kWireTypeLengthDelimited) { continue; }
+      if (field_number == 1) {
+        key = payload;
+        key_size = payload_size;
+      } else if (field_number == 2) {
+        // repeated messages of one field are merged by protobuf
+        if (value != nullptr) { return false; }
+        value = payload;
+        value_size = payload_size;
+      }
+    }
+    if (key_size == name.size()
+        && (key_size == 0 || std::memcmp(key, name.data(), key_size) == 0)) {
+      found_ = true;
+      feature = value;
+      feature_size = value_size;
+    }
+  }
+  if (!found_ || feature == nullptr) { return true; }
+  // Feature: the list messages are the fields of a oneof
+  const uint8_t* list = nullptr;
+  size_t list_size = 0;
+  ptr = feature;
+  end = feature + feature_size;
+  while (ptr < end) {
+    if (!ReadField(&ptr, end, &field_number, &wire_type, &payload, &payload_size)) {
+      return false;
+    }
+    if (field_number < Feature::kBytesList || field_number > Feature::kInt64List
+        || wire_type != kWireTypeLengthDelimited) {
+      continue;
+    }
+    if (list != nullptr) { return false; }
+    kind_ = static_cast<Feature::KindCase>(field_number);
+    list = payload;
+    list_size = payload_size;
+  }
+  if (list == nullptr) { return true; }
+  // the list: values are field 1, numeric values are expected to be packed in a single field
+  ptr = list;
+  end = list + list_size;
+  while (ptr < end) {
+    if (!ReadField(&ptr, end, &field_number, &wire_type, &payload, &payload_size)) {
+      return false;
+    }
+    if (field_number != 1) { continue; }
+    if (wire_type != kWireTypeLengthDelimited) { return false; }
+    if (has_bytes_list()) {
+      if (value_size_ == 0) {
+        data_ = reinterpret_cast<const char*>(payload);
+        size_ = payload_size;
+      }
+      value_size_ += 1;
+    } else {
+      if (data_ != nullptr) { return false; }
+      data_ = reinterpret_cast<const char*>(payload);
+      size_ = payload_size;
+    }
+  }
+  if (has_float_list() || has_double_list()) {
+    const size_t elem_size = has_float_list() ? sizeof(float) : sizeof(double);
+    if (size_ % elem_size != 0) { return false; }
+    value_size_ = size_ / elem_size;
+  } else if (has_int32_list() || has_int64_list()) {
+    varint_ = true;
+    ptr = reinterpret_cast<const uint8_t*>(data_);
+    end = ptr + size_;
+    uint64_t value = 0;
+    while (ptr < end) {
+      if (!ReadVarint(&ptr, end, &value)) { return false; }
+      value_size_ += 1;
+    }
+  }
+  return true;
+}
+
+}  // namespace data
+}  // namespace oneflow
@@ -0,0 +1,145 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#ifndef ONEFLOW_USER_DATA_OFRECORD_FEATURE_VIEW_H_
+#define ONEFLOW_USER_DATA_OFRECORD_FEATURE_VIEW_H_
+
+#include "oneflow/core/common/util.h"
+#include "oneflow/core/record/record.pb.h"
+
+namespace oneflow {
+namespace data {
+
+// The feature under which an OFRecord keeps its own serialized bytes when the parsing is left to
+// OFRecordFeatureView, see SetSerializedOFRecord.
+constexpr char kSerializedOFRecordFeatureName[] = "__oneflow_serialized_ofrecord__";
+
+// Makes `record` hold the serialized OFRecord `data` as is instead of parsing it, the capacity of
+// a previously held record is reused.
+void SetSerializedOFRecord(const char* data, size_t size, OFRecord* record);
+
+// A read-only view of the feature `name` of an OFRecord. For a serialized record the wire format
+// is scanned for that feature only and the view points into the serialized bytes, so none of the
+// other features is parsed or copied. Records the scanner doesn't handle, e.g. numeric lists that
+// are not packed, are fully parsed as a fallback.
+class OFRecordFeatureView final {
+ public:
+  OFRecordFeatureView(const OFRecord& record, const std::string& name);
+  OFRecordFeatureView(const char* data, size_t size, const std::string& name);
+  OF_DISALLOW_COPY_AND_MOVE(OFRecordFeatureView);
+  ~OFRecordFeatureView() = default;
+
+  bool found() const { return found_; }
+  bool has_bytes_list() const { return kind_ == Feature::kBytesList; }
+  bool has_float_list() const { return kind_ == Feature::kFloatList; }
+  bool has_double_list() const { return kind_ == Feature::kDoubleList; }
+  bool has_int32_list() const { return kind_ == Feature::kInt32List; }
+  bool has_int64_list() const { return kind_ == Feature::kInt64List; }
+  bool has_numeric_list() const {
+    return has_float_list() || has_double_list() || has_int32_list() || has_int64_list();
+  }
+  int64_t value_size() const { return value_size_; }
+
+  // the first value of a bytes list
+  const char* bytes_data() const {
+    CHECK(has_bytes_list() && value_size_ > 0);
+    return data_;
+  }
+  size_t bytes_size() const {
+    CHECK(has_bytes_list() && value_size_ > 0);
+    return size_;
+  }
+
+  // converts the first `cnt` values of a float, double, int32 or int64 list to T
+  template<typename T>
+  void CopyValues(T* dst, int64_t cnt) const;
+
+ private:
+  void Init(const char* data, size_t size, const std::string& name);
+  void Reset(const Feature& feature);
+  bool Scan(const char* data, size_t size, const std::string& name);
+
+  template<typename CppT, typename T>
+  void CopyFixedValues(T* dst, int64_t cnt) const;
+  template<typename CppT, typename T>
+  void CopyVarintValues(T* dst, int64_t cnt) const;
+
+  bool found_;
+  Feature::KindCase kind_;
+  int64_t value_size_;
+  // first value of a bytes list, or all the values of a numeric list
+  const char* data_;
+  size_t size_;
+  bool varint_;
+  std::unique_ptr<OFRecord> parsed_record_;
+};
+
+template<typename T>
+void OFRecordFeatureView::CopyValues(T* dst, int64_t cnt) const {
+  CHECK_LE(cnt, value_size_);
+  switch (kind_) {
+    case Feature::kFloatList: CopyFixedValues<float>(dst, cnt); break;
+    case Feature::kDoubleList: CopyFixedValues<double>(dst, cnt); break;
+    case Feature::kInt32List: {
+      if (varint_) {
+        CopyVarintValues<int32_t>(dst, cnt);
+      } else {
+        CopyFixedValues<int32_t>(dst, cnt);
+      }
+      break;
+    }
+    case Feature::kInt64List: {
+      if (varint_) {
+        CopyVarintValues<int64_t>(dst, cnt);
+      } else {
+        CopyFixedValues<int64_t>(dst, cnt);
+      }
+      break;
+    }
+    default: UNIMPLEMENTED();
+  }
+}
+
+template<typename CppT, typename T>
+void OFRecordFeatureView::CopyFixedValues(T* dst, int64_t cnt) const {
+  // values inside a serialized record are not aligned
+  FOR_RANGE(int64_t, i, 0, cnt) {
+    CppT value;
+    std::memcpy(&value, data_ + i * sizeof(CppT), sizeof(CppT));
+    dst[i] = static_cast<T>(value);
+  }
+}
+
+template<typename CppT, typename T>
+void OFRecordFeatureView::CopyVarintValues(T* dst, int64_t cnt) const {
+  // the varints were validated by Scan
+  const auto* ptr = reinterpret_cast<const uint8_t*>(data_);
+  FOR_RANGE(int64_t, i, 0, cnt) {
+    uint64_t value = 0;
+    int shift = 0;
+    uint8_t byte = 0;
+    do {
+      byte = *ptr++;
+      value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+      shift += 7;
+    } while (byte & 0x80);
+    dst[i] = static_cast<T>(static_cast<CppT>(value));
+  }
+}
+
+}  // namespace data
+}  // namespace oneflow
+
+#endif  // ONEFLOW_USER_DATA_OFRECORD_FEATURE_VIEW_H_
@@ -0,0 +1,121 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include <gtest/gtest.h>
+#include "oneflow/user/data/ofrecord_feature_view.h"
+
+namespace oneflow {
+namespace data {
+
+namespace {
+
+OFRecord GenRandomRecord(std::mt19937* gen, int num_features) {
+  OFRecord record;
+  for (int i = 0; i < num_features; ++i) {
+    Feature& feature = (*record.mutable_feature())["feature_" + std::to_string(i)];
+    const int num_values = (*gen)() % 5;
+    switch (i % 6) {
+      case 0: {
+        feature.mutable_bytes_list()->add_value(std::string((*gen)() % 300, 'a' + i % 26));
+        break;
+      }
+      case 1: {
+        for (int j = 0; j < num_values; ++j) { feature.mutable_float_list()->add_value((*gen)()); }
+        break;
+      }
+      case 2: {
+        for (int j = 0; j < num_values; ++j) { feature.mutable_double_list()->add_value((*gen)()); }
+        break;
+      }
+      case 3: {
+        for (int j = 0; j < num_values; ++j) {
+          feature.mutable_int32_list()->add_value(static_cast<int32_t>((*gen)()));
+        }
+        break;
+      }
+      case 4: {
+        for (int j = 0; j < num_values; ++j) {
+          feature.mutable_int64_list()->add_value(-static_cast<int64_t>((*gen)()) * 12345);
+        }
+        break;
+      }
+      default: break;
+    }
+  }
+  return record;
+}
+
+void CheckSameFeature(const OFRecordFeatureView& view, const OFRecordFeatureView& expected) {
+  ASSERT_EQ(view.found(), expected.found());
+  ASSERT_EQ(view.has_bytes_list(), expected.has_bytes_list());
+  ASSERT_EQ(view.has_numeric_list(), expected.has_numeric_list());
+  ASSERT_EQ(view.value_size(), expected.value_size());
+  if (view.has_bytes_list()) {
+    ASSERT_EQ(std::string(view.bytes_data(), view.bytes_size()),
+              std::string(expected.bytes_data(), expected.bytes_size()));
+  } else if (view.has_numeric_list()) {
+    std::vector<double> values(view.value_size());
+    std::vector<double> expected_values(expected.value_size());
+    view.CopyValues(values.data(), values.size());
+    expected.CopyValues(expected_values.data(), expected_values.size());
+    ASSERT_EQ(values, expected_values);
+  }
+}
+
+}  // namespace
+
+TEST(OFRecordFeatureView, scan) {
+  std::mt19937 gen(0);
+  OFRecord serialized_record;
+  for (int i = 0; i < 100; ++i) {
+    const int num_features = i % 25;
+    OFRecord record = GenRandomRecord(&gen, num_features);
+    std::string serialized;
+    ASSERT_TRUE(record.SerializeToString(&serialized));
+    // records are set over and over like in OFRecordParser
+    SetSerializedOFRecord(serialized.data(), serialized.size(), &serialized_record);
+    for (int j = 0; j <= num_features; ++j) {
+      const std::string name = "feature_" + std::to_string(j);
+      OFRecordFeatureView expected(record, name);
+      CheckSameFeature(OFRecordFeatureView(serialized_record, name), expected);
+      CheckSameFeature(OFRecordFeatureView(serialized.data(), serialized.size(), name), expected);
+    }
+  }
+}
+
+TEST(OFRecordFeatureView, unpacked_fallback) {
+  // the record {"label": int32_list [7, 9]} serialized by hand with the values not packed, which
+  // the scanner leaves to protobuf
+  const std::string list = {1 << 3, 7, 1 << 3, 9};
+  std::string feature = {(Feature::kInt32List << 3) | 2, static_cast<char>(list.size())};
+  feature += list;
+  std::string entry = {(1 << 3) | 2, 5};
+  entry += "label";
+  entry += {(2 << 3) | 2, static_cast<char>(feature.size())};
+  entry += feature;
+  std::string serialized = {(1 << 3) | 2, static_cast<char>(entry.size())};
+  serialized += entry;
+  OFRecordFeatureView view(serialized.data(), serialized.size(), "label");
+  ASSERT_TRUE(view.found());
+  ASSERT_TRUE(view.has_int32_list());
+  ASSERT_EQ(view.value_size(), 2);
+  int32_t values[2];
+  view.CopyValues(values, 2);
+  ASSERT_EQ(values[0], 7);
+  ASSERT_EQ(values[1], 9);
+}
+
+}  // namespace data
+}  // namespace oneflow
@@ -14,6 +14,7 @@ See the License for the specific language governing permissions and
 limitations under the License.
 */
 #include "oneflow/user/data/ofrecord_image_classification_dataset.h"
+#include "oneflow/user/data/ofrecord_feature_view.h"
 #include "oneflow/core/common/tensor_buffer.h"
 #include "oneflow/user/image/image_util.h"
 #include "oneflow/core/job/resource_desc.h"
@@ -29,16 +30,17 @@ namespace {
 
 using DS = OFRecordImageClassificationDataset;
 
-void DecodeImageFromOFRecord(const OFRecord& record, const std::string& feature_name,
-                             const std::string& color_space, TensorBuffer* out) {
-  auto image_feature_it = record.feature().find(feature_name);
-  CHECK(image_feature_it != record.feature().end());
-  const Feature& image_feature = image_feature_it->second;
+void DecodeImageFromOFRecord(const TensorBuffer& serialized_record,
+                             const std::string& feature_name, const std::string& color_space,
+                             TensorBuffer* out) {
+  OFRecordFeatureView image_feature(serialized_record.data<char>(), serialized_record.nbytes(),
+                                    feature_name);
+  CHECK(image_feature.found());
   CHECK(image_feature.has_bytes_list());
-  CHECK(image_feature.bytes_list().value_size() == 1);
-  const std::string& src_data = image_feature.bytes_list().value(0);
-  cv::Mat image = cv::imdecode(cv::Mat(1, src_data.size(), CV_8UC1, (void*)(src_data.data())),
-                               cv::IMREAD_COLOR);
+  CHECK(image_feature.value_size() == 1);
+  cv::Mat image = cv::imdecode(
+      cv::Mat(1, image_feature.bytes_size(), CV_8UC1, (void*)(image_feature.bytes_data())),
+      cv::IMREAD_COLOR);
   int W = image.cols;
   int H = image.rows;
 
@@ -57,18 +59,15 @@ void DecodeImageFromOFRecord(const OFRecord& record, const std::string& feature_
   memcpy(out->mut_data<uint8_t>(), image.ptr(), image_shape.elem_cnt());
 }
 
-void DecodeLabelFromFromOFRecord(const OFRecord& record, const std::string& feature_name,
-                                 TensorBuffer* out) {
-  auto label_feature_it = record.feature().find(feature_name);
-  CHECK(label_feature_it != record.feature().end());
-  const Feature& label_feature = label_feature_it->second;
+void DecodeLabelFromFromOFRecord(const TensorBuffer& serialized_record,
+                                 const std::string& feature_name, TensorBuffer* out) {
+  OFRecordFeatureView label_feature(serialized_record.data<char>(), serialized_record.nbytes(),
+                                    feature_name);
+  CHECK(label_feature.found());
   out->Resize(Shape({1}), DataType::kInt32);
-  if (label_feature.has_int32_list()) {
-    CHECK_EQ(label_feature.int32_list().value_size(), 1);
-    *out->mut_data<int32_t>() = label_feature.int32_list().value(0);
-  } else if (label_feature.has_int64_list()) {
-    CHECK_EQ(label_feature.int64_list().value_size(), 1);
-    *out->mut_data<int32_t>() = label_feature.int64_list().value(0);
+  if (label_feature.has_int32_list() || label_feature.has_int64_list()) {
+    CHECK_EQ(label_feature.value_size(), 1);
+    label_feature.CopyValues(out->mut_data<int32_t>(), 1);
   } else {
     UNIMPLEMENTED();
   }
@@ -101,12 +100,10 @@ void DecodeWorker(const std::string& image_feature_name, const std::string& labe
     auto receive_status = in_buffer->Pull(&serialized_record);
     if (receive_status == kBufferStatusErrorClosed) { break; }
     CHECK(receive_status == kBufferStatusSuccess);
-    OFRecord record;
-    CHECK(record.ParseFromArray(serialized_record.data<char>(),
-                                serialized_record.shape_view().elem_cnt()));
+    // the features are read from the serialized record without parsing the others
     ImageClassificationDataInstance instance;
-    DecodeImageFromOFRecord(record, image_feature_name, color_space, &instance.image);
-    DecodeLabelFromFromOFRecord(record, label_feature_name, &instance.label);
+    DecodeImageFromOFRecord(serialized_record, image_feature_name, color_space, &instance.image);
+    DecodeLabelFromFromOFRecord(serialized_record, label_feature_name, &instance.label);
     auto send_status = out_buffer->Push(std::move(instance));
     if (send_status == kBufferStatusErrorClosed) { break; }
     CHECK(send_status == kBufferStatusSuccess);
@@ -0,0 +1,98 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "oneflow/user/data/ofrecord_index.h"
+
+namespace oneflow {
+namespace data {
+
+namespace {
+
+// the record headers are scanned in windows of this size when building an index
+constexpr size_t kScanWindowSize = 1 << 20;
+
+}  // namespace
+
+std::unique_ptr<OFRecordIndex> OFRecordIndex::LoadOrBuild(fs::FileSystem* fs,
+                                                          const std::string& path, bool save) {
+  const uint64_t file_size = fs->GetFileSize(path);
+  std::vector<uint64_t> offsets;
+  if (!TryLoad(fs, path, file_size, &offsets)) {
+    Build(fs, path, file_size, &offsets);
+    if (save) { Save(fs, path, offsets); }
+  }
+  return std::unique_ptr<OFRecordIndex>(new OFRecordIndex(std::move(offsets)));
+}
+
+bool OFRecordIndex::TryLoad(fs::FileSystem* fs, const std::string& path, uint64_t file_size,
+                            std::vector<uint64_t>* offsets) {
+  const std::string index_path = IndexFilePath(path);
+  if (!fs->FileExists(index_path)) { return false; }
+  const uint64_t index_size = fs->GetFileSize(index_path);
+  if (index_size == 0 || index_size % sizeof(uint64_t) != 0) { return false; }
+  offsets->resize(index_size / sizeof(uint64_t));
+  std::unique_ptr<fs::RandomAccessFile> index_file;
+  fs->NewRandomAccessFile(index_path, &index_file);
+  index_file->Read(0, index_size, reinterpret_cast<char*>(offsets->data()));
+  // a part file rewritten after its index was saved is indexed again
+  if (offsets->front() != 0 || offsets->back() != file_size) {
+    LOG(WARNING) << index_path << " does not match " << path << ", rebuilding it";
+    offsets->clear();
+    return false;
+  }
+  return true;
+}
+
+void OFRecordIndex::Build(fs::FileSystem* fs, const std::string& path, uint64_t file_size,
+                          std::vector<uint64_t>* offsets) {
+  std::unique_ptr<fs::RandomAccessFile> file;
+  fs->NewRandomAccessFile(path, &file);
+  std::vector<char> window(kScanWindowSize);
+  uint64_t window_begin = 0;
+  uint64_t window_end = 0;
+  uint64_t offset = 0;
+  offsets->clear();
+  while (offset < file_size) {
+    CHECK_LE(offset + sizeof(int64_t), file_size) << "truncated record header in " << path;
+    if (offset + sizeof(int64_t) > window_end) {
+      window_begin = offset;
+      window_end = std::min<uint64_t>(offset + kScanWindowSize, file_size);
+      file->Read(window_begin, window_end - window_begin, window.data());
+    }
+    int64_t record_size = -1;
+    std::memcpy(&record_size, window.data() + (offset - window_begin), sizeof(int64_t));
+    CHECK_GT(record_size, 0) << "invalid record at offset " << offset << " of " << path;
+    offsets->push_back(offset);
+    offset += sizeof(int64_t) + record_size;
+  }
+  CHECK_EQ(offset, file_size) << "truncated record in " << path;
+  offsets->push_back(file_size);
+}
+
+void OFRecordIndex::Save(fs::FileSystem* fs, const std::string& path,
+                         const std::vector<uint64_t>& offsets) {
+  // every rank may build the same index, each one writes its own file and renames it into place
+  const std::string index_path = IndexFilePath(path);
+  const std::string tmp_path = index_path + ".tmp-" + std::to_string(NewRandomSeed());
+  std::unique_ptr<fs::WritableFile> index_file;
+  fs->NewWritableFile(tmp_path, &index_file);
+  index_file->Append(reinterpret_cast<const char*>(offsets.data()),
+                     offsets.size() * sizeof(uint64_t));
+  index_file->Close();
+  fs->RenameFile(tmp_path, index_path);
+}
+
+}  // namespace data
+}  // namespace oneflow
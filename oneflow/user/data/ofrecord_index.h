@@ -0,0 +1,64 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#ifndef ONEFLOW_USER_DATA_OFRECORD_INDEX_H_
+#define ONEFLOW_USER_DATA_OFRECORD_INDEX_H_
+
+#include "oneflow/core/common/util.h"
+#include "oneflow/core/persistence/file_system.h"
+
+namespace oneflow {
+namespace data {
+
+// The offsets of the length prefixed records of an OFRecord part file. The index of a part file
+// is kept in the sidecar file "<part file>.index", an array of little endian uint64 holding the
+// offset of every record followed by the size of the part file.
+class OFRecordIndex final {
+ public:
+  OF_DISALLOW_COPY_AND_MOVE(OFRecordIndex);
+  ~OFRecordIndex() = default;
+
+  // Loads the sidecar index of the part file `path`. If there is none, or it does not match the
+  // part file any more, the index is built by scanning the record headers of the part file and
+  // saved to the sidecar file if `save`.
+  static std::unique_ptr<OFRecordIndex> LoadOrBuild(fs::FileSystem* fs, const std::string& path,
+                                                    bool save);
+  static std::string IndexFilePath(const std::string& path) { return path + ".index"; }
+
+  size_t num_records() const { return offsets_.size() - 1; }
+  // offset of the length prefix of record `i`
+  uint64_t record_offset(size_t i) const { return offsets_.at(i); }
+  // size of record `i` without its length prefix
+  uint64_t record_size(size_t i) const {
+    return offsets_.at(i + 1) - offsets_.at(i) - sizeof(int64_t);
+  }
+
+ private:
+  explicit OFRecordIndex(std::vector<uint64_t>&& offsets) : offsets_(std::move(offsets)) {}
+
+  static bool TryLoad(fs::FileSystem* fs, const std::string& path, uint64_t file_size,
+                      std::vector<uint64_t>* offsets);
+  static void Build(fs::FileSystem* fs, const std::string& path, uint64_t file_size,
+                    std::vector<uint64_t>* offsets);
+  static void Save(fs::FileSystem* fs, const std::string& path,
+                   const std::vector<uint64_t>& offsets);
+
+  std::vector<uint64_t> offsets_;
+};
+
+}  // namespace data
+}  // namespace oneflow
+
+#endif  // ONEFLOW_USER_DATA_OFRECORD_INDEX_H_
@@ -0,0 +1,113 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include <gtest/gtest.h>
+#include "oneflow/core/common/process_state.h"
+#include "oneflow/core/common/str_util.h"
+#include "oneflow/user/data/ofrecord_index.h"
+#include "oneflow/user/data/ofrecord_indexed_dataset.h"
+
+namespace oneflow {
+namespace data {
+
+namespace {
+
+void WriteRecords(fs::FileSystem* file_system, const std::string& path,
+                  const std::vector<int64_t>& record_sizes) {
+  std::unique_ptr<fs::WritableFile> file;
+  file_system->NewWritableFile(path, &file);
+  for (int64_t record_size : record_sizes) {
+    file->Append(reinterpret_cast<const char*>(&record_size), sizeof(int64_t));
+    std::string record(record_size, static_cast<char>(record_size));
+    file->Append(record.data(), record.size());
+  }
+  file->Close();
+}
+
+void CheckIndex(const OFRecordIndex& index, const std::vector<int64_t>& record_sizes) {
+  ASSERT_EQ(index.num_records(), record_sizes.size());
+  uint64_t offset = 0;
+  for (size_t i = 0; i < record_sizes.size(); ++i) {
+    ASSERT_EQ(index.record_offset(i), offset);
+    ASSERT_EQ(index.record_size(i), record_sizes.at(i));
+    offset += sizeof(int64_t) + record_sizes.at(i);
+  }
+}
+
+}  // namespace
+
+TEST(OFRecordIndex, LoadOrBuild) {
+  fs::FileSystem* file_system = LocalFS();
+  std::string current_dir = GetCwd();
+  StringReplace(&current_dir, '\\', '/');
+  const std::string path = JoinPath(current_dir, "tmp_ofrecord_index_test_part");
+  const std::string index_path = OFRecordIndex::IndexFilePath(path);
+  std::vector<int64_t> record_sizes;
+  std::mt19937 gen(0);
+  // some records are larger than the window in which the record headers are scanned
+  std::uniform_int_distribution<int64_t> dis(1, 3 << 20);
+  for (int i = 0; i < 64; ++i) { record_sizes.push_back(i % 8 == 0 ? dis(gen) : 1 + i); }
+  WriteRecords(file_system, path, record_sizes);
+  if (file_system->FileExists(index_path)) { file_system->DelFile(index_path); }
+
+  // built without saving
+  CheckIndex(*OFRecordIndex::LoadOrBuild(file_system, path, false), record_sizes);
+  ASSERT_FALSE(file_system->FileExists(index_path));
+  // built and saved
+  CheckIndex(*OFRecordIndex::LoadOrBuild(file_system, path, true), record_sizes);
+  ASSERT_TRUE(file_system->FileExists(index_path));
+  ASSERT_EQ(file_system->GetFileSize(index_path), (record_sizes.size() + 1) * sizeof(uint64_t));
+  // loaded
+  CheckIndex(*OFRecordIndex::LoadOrBuild(file_system, path, false), record_sizes);
+  // rebuilt after the part file changed
+  record_sizes.push_back(7);
+  WriteRecords(file_system, path, record_sizes);
+  CheckIndex(*OFRecordIndex::LoadOrBuild(file_system, path, true), record_sizes);
+  CheckIndex(*OFRecordIndex::LoadOrBuild(file_system, path, false), record_sizes);
+
+  file_system->DelFile(index_path);
+  file_system->DelFile(path);
+}
+
+TEST(OFRecordIndexedDataset, FeistelPermutation) {
+  for (int64_t size : {1, 2, 3, 5, 64, 1000, 4097}) {
+    const FeistelPermutation permutation(size, 524287);
+    std::vector<bool> seen(size, false);
+    int64_t num_fixed_points = 0;
+    for (int64_t i = 0; i < size; ++i) {
+      const int64_t j = permutation(i);
+      ASSERT_GE(j, 0);
+      ASSERT_LT(j, size);
+      ASSERT_FALSE(seen.at(j));
+      seen.at(j) = true;
+      if (j == i) { num_fixed_points += 1; }
+    }
+    // a shuffle rather than the identity
+    if (size >= 64) { ASSERT_LT(num_fixed_points, size / 8); }
+  }
+  // the permutation only depends on the seed, so every rank computes the same one
+  const FeistelPermutation lhs(1000, 1);
+  const FeistelPermutation rhs(1000, 1);
+  const FeistelPermutation other(1000, 2);
+  int64_t num_different = 0;
+  for (int64_t i = 0; i < 1000; ++i) {
+    ASSERT_EQ(lhs(i), rhs(i));
+    if (lhs(i) != other(i)) { num_different += 1; }
+  }
+  ASSERT_GT(num_different, 900);
+}
+
+}  // namespace data
+}  // namespace oneflow
@@ -0,0 +1,186 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "oneflow/user/data/ofrecord_indexed_dataset.h"
+#include "oneflow/user/data/ofrecord_dataset.h"
+#include "oneflow/core/common/balanced_splitter.h"
+#include "oneflow/core/thread/thread_manager.h"
+
+namespace oneflow {
+namespace data {
+
+namespace {
+
+// samples read ahead at a time, their reads are sorted by offset and coalesced
+constexpr int64_t kReadAheadNumSamples = 64;
+// records adjacent in a part file are read together up to this size
+constexpr uint64_t kMaxCoalescedReadSize = 16 << 20;
+
+uint64_t SplitMix64(uint64_t x) {
+  x += 0x9E3779B97F4A7C15ULL;
+  x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+  return x ^ (x >> 31);
+}
+
+}  // namespace
+
+FeistelPermutation::FeistelPermutation(int64_t size, uint64_t seed)
+    : size_(size), half_bits_(1) {
+  CHECK_GT(size, 0);
+  while ((int64_t{1} << (2 * half_bits_)) < size) { half_bits_ += 1; }
+  half_mask_ = (uint64_t{1} << half_bits_) - 1;
+  uint64_t key = seed;
+  for (auto& round_key : round_keys_) {
+    key = SplitMix64(key);
+    round_key = key;
+  }
+}
+
+int64_t FeistelPermutation::operator()(int64_t x) const {
+  CHECK_GE(x, 0);
+  CHECK_LT(x, size_);
+  // the network permutes [0, 4^half_bits) which holds less than 4 * size_ elements, so the walk
+  // takes less than 4 steps on average
+  uint64_t value = x;
+  do {
+    uint64_t left = value >> half_bits_;
+    uint64_t right = value & half_mask_;
+    for (const uint64_t round_key : round_keys_) {
+      const uint64_t next = left ^ (SplitMix64(right ^ round_key) & half_mask_);
+      left = right;
+      right = next;
+    }
+    value = (left << half_bits_) | right;
+  } while (value >= static_cast<uint64_t>(size_));
+  return static_cast<int64_t>(value);
+}
+
+OFRecordPartIndexes::OFRecordPartIndexes(user_op::KernelInitContext* ctx)
+    : paths_(OFRecordDataset::PartFilePaths(ctx)) {
+  // the indexes are saved next to the part files by default so that only the first run scans
+  // them, set ONEFLOW_OFRECORD_SAVE_INDEX=0 for datasets in read only directories
+  const bool save = ParseBooleanFromEnv("ONEFLOW_OFRECORD_SAVE_INDEX", true);
+  indexes_.resize(paths_.size());
+  MultiThreadLoop(paths_.size(), [&](size_t i) {
+    indexes_.at(i) = OFRecordIndex::LoadOrBuild(DataFS(), paths_.at(i), save);
+  });
+  part_record_offsets_.push_back(0);
+  for (const auto& index : indexes_) {
+    part_record_offsets_.push_back(part_record_offsets_.back() + index->num_records());
+  }
+}
+
+std::pair<size_t, size_t> OFRecordPartIndexes::Locate(int64_t record_id) const {
+  CHECK_GE(record_id, 0);
+  CHECK_LT(record_id, num_records());
+  const auto it =
+      std::upper_bound(part_record_offsets_.cbegin(), part_record_offsets_.cend(), record_id);
+  const size_t part = std::distance(part_record_offsets_.cbegin(), it) - 1;
+  return std::make_pair(part, record_id - part_record_offsets_.at(part));
+}
+
+OFRecordIndexedDataset::OFRecordIndexedDataset(
+    user_op::KernelInitContext* ctx, std::shared_ptr<const OFRecordPartIndexes> part_indexes,
+    int32_t worker_id, int32_t num_workers)
+    : part_indexes_(std::move(part_indexes)),
+      files_(part_indexes_->num_parts()),
+      shuffle_after_epoch_(ctx->Attr<bool>("shuffle_after_epoch")),
+      num_workers_(num_workers),
+      permutation_epoch_(-1),
+      permutation_(part_indexes_->num_records(), kOneflowDatasetSeed) {
+  const auto parallel_id_and_num = OFRecordDataset::ParallelIdAndNum(ctx);
+  CHECK_LE(static_cast<int64_t>(parallel_id_and_num.second), part_indexes_->num_records());
+  range_ = BalancedSplitter(part_indexes_->num_records(), parallel_id_and_num.second)
+               .At(parallel_id_and_num.first);
+  // the samples read so far by all ranks were read evenly by them
+  const int64_t start_sample_id = ctx->Attr<int64_t>("start_sample") / parallel_id_and_num.second;
+  next_sample_id_ =
+      start_sample_id + (worker_id - start_sample_id % num_workers + num_workers) % num_workers;
+}
+
+OFRecordIndexedDataset::BatchType OFRecordIndexedDataset::Next() {
+  if (samples_.empty()) { ReadAhead(); }
+  BatchType batch;
+  batch.push_back(std::move(samples_.front()));
+  samples_.pop_front();
+  return batch;
+}
+
+int64_t OFRecordIndexedDataset::RecordId(int64_t sample_id) {
+  const int64_t epoch = sample_id / range_.size();
+  const int64_t position = range_.begin() + sample_id % range_.size();
+  if (!shuffle_after_epoch_) { return position; }
+  if (epoch != permutation_epoch_) {
+    permutation_ = FeistelPermutation(part_indexes_->num_records(), kOneflowDatasetSeed + epoch);
+    permutation_epoch_ = epoch;
+  }
+  return permutation_(position);
+}
+
+void OFRecordIndexedDataset::ReadAhead() {
+  struct Slot {
+    size_t part;
+    size_t record;
+    size_t order;
+  };
+  std::vector<Slot> slots(kReadAheadNumSamples);
+  for (size_t i = 0; i < slots.size(); ++i) {
+    const auto part_and_record = part_indexes_->Locate(RecordId(next_sample_id_));
+    slots.at(i) = Slot{part_and_record.first, part_and_record.second, i};
+    next_sample_id_ += num_workers_;
+  }
+  std::sort(slots.begin(), slots.end(), [](const Slot& lhs, const Slot& rhs) {
+    return lhs.part != rhs.part ? lhs.part < rhs.part : lhs.record < rhs.record;
+  });
+  std::vector<TensorBuffer> samples(slots.size());
+  size_t begin = 0;
+  while (begin < slots.size()) {
+    const Slot& first = slots.at(begin);
+    const OFRecordIndex& index = part_indexes_->index(first.part);
+    const uint64_t read_begin = index.record_offset(first.record);
+    size_t end = begin + 1;
+    while (end < slots.size() && slots.at(end).part == first.part
+           && slots.at(end).record == slots.at(end - 1).record + 1
+           && index.record_offset(slots.at(end).record + 1) - read_begin
+                  <= kMaxCoalescedReadSize) {
+      end += 1;
+    }
+    const uint64_t read_end = index.record_offset(slots.at(end - 1).record + 1);
+    auto& file = files_.at(first.part);
+    if (!file) { DataFS()->NewRandomAccessFile(part_indexes_->path(first.part), &file); }
+    read_buffer_.resize(read_end - read_begin);
+    file->Read(read_begin, read_buffer_.size(), read_buffer_.data());
+    for (size_t i = begin; i < end; ++i) {
+      const Slot& slot = slots.at(i);
+      const uint64_t record_offset = index.record_offset(slot.record) - read_begin;
+      const char* record_ptr = read_buffer_.data() + record_offset;
+      const int64_t record_size = index.record_size(slot.record);
+      int64_t header_size = -1;
+      std::memcpy(&header_size, record_ptr, sizeof(int64_t));
+      const std::string& path = part_indexes_->path(slot.part);
+      CHECK_EQ(header_size, record_size)
+          << path << " does not match " << OFRecordIndex::IndexFilePath(path);
+      TensorBuffer& sample = samples.at(slot.order);
+      sample.Resize(Shape({record_size}), DataType::kChar);
+      std::memcpy(sample.mut_data<char>(), record_ptr + sizeof(int64_t), record_size);
+    }
+    begin = end;
+  }
+  for (auto& sample : samples) { samples_.push_back(std::move(sample)); }
+}
+
+}  // namespace data
+}  // namespace oneflow
@@ -0,0 +1,108 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#ifndef ONEFLOW_USER_DATA_OFRECORD_INDEXED_DATASET_H_
+#define ONEFLOW_USER_DATA_OFRECORD_INDEXED_DATASET_H_
+
+#include <array>
+#include "oneflow/core/common/range.h"
+#include "oneflow/core/common/tensor_buffer.h"
+#include "oneflow/core/framework/op_kernel.h"
+#include "oneflow/user/data/dataset.h"
+#include "oneflow/user/data/ofrecord_index.h"
+
+namespace oneflow {
+namespace data {
+
+// The record indexes of all the part files of an OFRecord dataset, shared by the load workers of a
+// data reader.
+class OFRecordPartIndexes final {
+ public:
+  OF_DISALLOW_COPY_AND_MOVE(OFRecordPartIndexes);
+  explicit OFRecordPartIndexes(user_op::KernelInitContext* ctx);
+  ~OFRecordPartIndexes() = default;
+
+  int64_t num_records() const { return part_record_offsets_.back(); }
+  size_t num_parts() const { return paths_.size(); }
+  const std::string& path(size_t part) const { return paths_.at(part); }
+  const OFRecordIndex& index(size_t part) const { return *indexes_.at(part); }
+  // the part file of the record `record_id` of the whole dataset and its position in that file
+  std::pair<size_t, size_t> Locate(int64_t record_id) const;
+
+ private:
+  std::vector<std::string> paths_;
+  std::vector<std::unique_ptr<OFRecordIndex>> indexes_;
+  std::vector<int64_t> part_record_offsets_;
+};
+
+// A pseudo random permutation of [0, size) computed per element rather than stored: a balanced
+// Feistel network over the smallest power of four not below `size`, walking the cycle of an
+// element until it is back in [0, size).
+class FeistelPermutation final {
+ public:
+  FeistelPermutation(int64_t size, uint64_t seed);
+  ~FeistelPermutation() = default;
+
+  int64_t operator()(int64_t x) const;
+
+ private:
+  static constexpr size_t kNumRounds = 6;
+
+  int64_t size_;
+  int32_t half_bits_;
+  uint64_t half_mask_;
+  std::array<uint64_t, kNumRounds> round_keys_;
+};
+
+// Reads the records of an OFRecord dataset at random through the indexes of its part files. The
+// ranks split the records of the dataset evenly by count. With shuffle_after_epoch, the records are
+// read in a new permutation of the whole dataset every epoch, which is the same on all ranks. A
+// reader restarted with start_sample set to the number of samples read by all ranks so far
+// continues with the very next sample.
+class OFRecordIndexedDataset final : public Dataset<TensorBuffer> {
+ public:
+  using Base = Dataset<TensorBuffer>;
+  using SampleType = typename Base::SampleType;
+  using BatchType = typename Base::BatchType;
+
+  OF_DISALLOW_COPY_AND_MOVE(OFRecordIndexedDataset);
+  // Load worker `worker_id` out of `num_workers` reads every num_workers-th sample of this rank.
+  OFRecordIndexedDataset(user_op::KernelInitContext* ctx,
+                         std::shared_ptr<const OFRecordPartIndexes> part_indexes, int32_t worker_id,
+                         int32_t num_workers);
+  ~OFRecordIndexedDataset() override = default;
+
+  BatchType Next() override;
+
+ private:
+  int64_t RecordId(int64_t sample_id);
+  void ReadAhead();
+
+  std::shared_ptr<const OFRecordPartIndexes> part_indexes_;
+  std::vector<std::unique_ptr<fs::RandomAccessFile>> files_;
+  bool shuffle_after_epoch_;
+  Range range_;
+  int32_t num_workers_;
+  int64_t next_sample_id_;
+  int64_t permutation_epoch_;
+  FeistelPermutation permutation_;
+  std::deque<TensorBuffer> samples_;
+  std::vector<char> read_buffer_;
+};
+
+}  // namespace data
+}  // namespace oneflow
+
+#endif  // ONEFLOW_USER_DATA_OFRECORD_INDEXED_DATASET_H_
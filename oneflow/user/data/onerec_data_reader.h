@@ -33,22 +33,29 @@ class OneRecDataReader final : public DataReader<TensorBuffer> {
     if (auto* pool = TensorBufferPool::TryGet()) { pool->IncreasePoolSizeByBase(batch_size_); }
     const auto random_shuffle = ctx->Attr<bool>("random_shuffle");
     parser_.reset(new OneRecParser());
-    if (random_shuffle) {
-      const auto mode = ctx->Attr<std::string>("shuffle_mode");
-      if (mode == "batch") {
-        loader_.reset(new OneRecDataset(ctx, batch_size_));
-        loader_.reset(new BatchRandomShuffleDataset<TensorBuffer>(ctx, std::move(loader_)));
-      } else if (mode == "instance") {
-        loader_.reset(new OneRecDataset(ctx, 1));
-        loader_.reset(new RandomShuffleDataset<TensorBuffer>(ctx, std::move(loader_)));
-        loader_.reset(new BatchDataset<TensorBuffer>(batch_size_, std::move(loader_)));
-      } else {
-        UNIMPLEMENTED();
-      }
-    } else {
-      loader_.reset(new OneRecDataset(ctx, batch_size_));
-    }
-    StartLoadThread();
+    const size_t batch_size = batch_size_;
+    StartLoadThreads(
+        OneRecDataset::NumLocalParts(ctx),
+        [ctx, batch_size, random_shuffle](int32_t worker_id, int32_t num_workers) {
+          std::unique_ptr<Dataset<TensorBuffer>> loader;
+          if (random_shuffle) {
+            const auto mode = ctx->Attr<std::string>("shuffle_mode");
+            if (mode == "batch") {
+              loader.reset(new OneRecDataset(ctx, batch_size, worker_id, num_workers));
+              loader.reset(new BatchRandomShuffleDataset<TensorBuffer>(ctx, std::move(loader)));
+            } else if (mode == "instance") {
+              loader.reset(new OneRecDataset(ctx, 1, worker_id, num_workers));
+              loader.reset(new RandomShuffleDataset<TensorBuffer>(ctx, std::move(loader),
+                                                                  worker_id, num_workers));
+              loader.reset(new BatchDataset<TensorBuffer>(batch_size, std::move(loader)));
+            } else {
+              UNIMPLEMENTED();
+            }
+          } else {
+            loader.reset(new OneRecDataset(ctx, batch_size, worker_id, num_workers));
+          }
+          return loader;
+        });
   }
 
   ~OneRecDataReader() override {
@@ -80,23 +80,25 @@ class OneRecDataset final : public Dataset<TensorBuffer> {
 
   OF_DISALLOW_COPY_AND_MOVE(OneRecDataset);
 
-  OneRecDataset(user_op::KernelInitContext* ctx, int32_t batch_size) : batch_size_(batch_size) {
+  OneRecDataset(user_op::KernelInitContext* ctx, int32_t batch_size)
+      : OneRecDataset(ctx, batch_size, 0, 1) {}
+  // Reads the part `worker_id` out of `num_workers` of the files of this rank.
+  OneRecDataset(user_op::KernelInitContext* ctx, int32_t batch_size, int32_t worker_id,
+                int32_t num_workers)
+      : batch_size_(batch_size) {
     current_epoch_ = 0;
     shuffle_after_epoch_ = ctx->Attr<bool>("shuffle_after_epoch");
     data_file_paths_ = ctx->Attr<std::vector<std::string>>("files");
-    size_t world_size = 1;
-    int64_t rank = 0;
-    CHECK_JUST(InitDataSourceDistributedInfo(ctx, world_size, rank));
-    parallel_id_ = rank;
-    parallel_num_ = world_size;
-    BalancedSplitter bs(data_file_paths_.size(), parallel_num_);
-    range_ = bs.At(parallel_id_);
+    range_ = WorkerRange(RankRange(ctx), worker_id, num_workers);
     ResetInstream();
     hash_state_ = LZ4_XXH64_createState();
   }
 
   ~OneRecDataset() { CHECK_NE(LZ4_XXH64_freeState(hash_state_), XXH_ERROR); }
 
+  // The number of files read by this rank, which bounds the number of load workers.
+  static int32_t NumLocalParts(user_op::KernelInitContext* ctx) { return RankRange(ctx).size(); }
+
   BatchType Next() override {
     BatchType batch;
     batch.reserve(batch_size_);
@@ -108,6 +110,15 @@ class OneRecDataset final : public Dataset<TensorBuffer> {
   }
 
  private:
+  static Range RankRange(user_op::KernelInitContext* ctx) {
+    const size_t num_files = ctx->Attr<std::vector<std::string>>("files").size();
+    size_t world_size = 1;
+    int64_t rank = 0;
+    CHECK_JUST(InitDataSourceDistributedInfo(ctx, world_size, rank));
+    BalancedSplitter bs(num_files, world_size);
+    return bs.At(rank);
+  }
+
   void ReadSample(TensorBuffer& tensor) {
     static_assert(sizeof(OneRecFrameHeader) == kHeaderSize, "");
     OneRecFrameHeaderView header_view{};
@@ -163,8 +174,6 @@ class OneRecDataset final : public Dataset<TensorBuffer> {
   int32_t current_epoch_;
   bool shuffle_after_epoch_;
 
-  int32_t parallel_id_;
-  int32_t parallel_num_;
   Range range_;
   std::vector<std::string> data_file_paths_;
   std::unique_ptr<PersistentInStream> in_stream_;
@@ -17,6 +17,7 @@ limitations under the License.
 #define ONEFLOW_USER_DATA_RANDOM_SHUFFLE_DATASET_H_
 
 #include "oneflow/user/data/dataset.h"
+#include "oneflow/user/data/distributed_util.h"
 #include "oneflow/core/common/tensor_buffer.h"
 #include "oneflow/core/framework/op_kernel.h"
 
@@ -32,15 +33,21 @@ class RandomShuffleDataset final : public Dataset<LoadTarget> {
 
   RandomShuffleDataset(user_op::KernelInitContext* ctx,
                        std::unique_ptr<Dataset<LoadTarget>>&& dataset)
+      : RandomShuffleDataset(ctx, std::move(dataset), 0, 1) {}
+  // The shuffle buffer of each of the `num_workers` load workers holds its share of
+  // shuffle_buffer_size samples, and each worker draws from its own seed.
+  RandomShuffleDataset(user_op::KernelInitContext* ctx,
+                       std::unique_ptr<Dataset<LoadTarget>>&& dataset, int32_t worker_id,
+                       int32_t num_workers)
       : nested_ds_(std::move(dataset)) {
     // random
-    seed_ = ctx->Attr<int64_t>("seed");
-    if (seed_ == -1) { seed_ = NewRandomSeed(); }
+    seed_ = WorkerSeed(ctx->Attr<int64_t>("seed"), worker_id);
     std::seed_seq seq({seed_});
     rand_engine_ = std::default_random_engine(seq);
 
     // fill buffer
-    initial_buffer_fill_ = ctx->Attr<int32_t>("shuffle_buffer_size");
+    initial_buffer_fill_ =
+        WorkerShuffleBufferSize(ctx->Attr<int32_t>("shuffle_buffer_size"), num_workers);
     int32_t remain_cnt = initial_buffer_fill_;
     while (remain_cnt > 0) {
       BatchType batch = nested_ds_->Next();
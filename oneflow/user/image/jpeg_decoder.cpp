@@ -101,6 +101,88 @@ bool JpegPartialDecodeRandomCropImage(const unsigned char* data, size_t length,
   return true;
 }
 
+bool JpegPartialDecodeRandomCropScaledImage(const unsigned char* data, size_t length,
+                                            RandomCropGenerator* random_crop_gen, bool color,
+                                            int min_width, int min_height, cv::Mat* out_mat) {
+  // libjpeg scales by scale_num / 8 in the DCT domain
+  constexpr unsigned int kScaleDenom = 8;
+  struct jpeg_decompress_struct compress_info {};
+  struct jpeg_error_mgr jpeg_err {};
+  compress_info.err = jpeg_std_error(&jpeg_err);
+  jpeg_create_decompress(&compress_info);
+  if (compress_info.err->msg_code != 0) { return false; }
+
+  LibjpegCtx ctx_guard(&compress_info);
+
+  jpeg_mem_src(ctx_guard.compress_info(), data, length);
+  if (ctx_guard.compress_info()->err->msg_code != 0) { return false; }
+
+  int rc = jpeg_read_header(ctx_guard.compress_info(), TRUE);
+  if (rc != JPEG_HEADER_OK) { return false; }
+  const J_COLOR_SPACE jpeg_color_space = ctx_guard.compress_info()->jpeg_color_space;
+  if (jpeg_color_space == JCS_CMYK || jpeg_color_space == JCS_YCCK) { return false; }
+
+  const unsigned int width = ctx_guard.compress_info()->image_width;
+  const unsigned int height = ctx_guard.compress_info()->image_height;
+  unsigned int crop_x = 0, crop_y = 0, crop_w = width, crop_h = height;
+  if (random_crop_gen) {
+    CropWindow crop;
+    random_crop_gen->GenerateCropWindow({static_cast<int64_t>(height), static_cast<int64_t>(width)},
+                                        &crop);
+    crop_y = crop.anchor.At(0);
+    crop_x = crop.anchor.At(1);
+    crop_h = crop.shape.At(0);
+    crop_w = crop.shape.At(1);
+  }
+
+  const unsigned int min_w = std::max(min_width, 1);
+  const unsigned int min_h = std::max(min_height, 1);
+  unsigned int scale_num = kScaleDenom;
+  while (scale_num > 1 && crop_w * (scale_num - 1) >= min_w * kScaleDenom
+         && crop_h * (scale_num - 1) >= min_h * kScaleDenom) {
+    scale_num -= 1;
+  }
+  ctx_guard.compress_info()->scale_num = scale_num;
+  ctx_guard.compress_info()->scale_denom = kScaleDenom;
+  ctx_guard.compress_info()->out_color_space = color ? JCS_RGB : JCS_GRAYSCALE;
+
+  jpeg_start_decompress(ctx_guard.compress_info());
+  const unsigned int out_width = ctx_guard.compress_info()->output_width;
+  const unsigned int out_height = ctx_guard.compress_info()->output_height;
+  const int pixel_size = ctx_guard.compress_info()->output_components;
+
+  // map the crop window to the scaled image
+  unsigned int u_crop_x = std::min(crop_x * out_width / width, out_width - 1);
+  const unsigned int u_crop_y = std::min(crop_y * out_height / height, out_height - 1);
+  const unsigned int u_crop_w =
+      std::max(std::min(crop_w * out_width / width, out_width - u_crop_x), 1U);
+  const unsigned int u_crop_h =
+      std::max(std::min(crop_h * out_height / height, out_height - u_crop_y), 1U);
+
+  unsigned int tmp_w = u_crop_w;
+  jpeg_crop_scanline(ctx_guard.compress_info(), &u_crop_x, &tmp_w);
+  if (jpeg_skip_scanlines(ctx_guard.compress_info(), u_crop_y) != u_crop_y) { return false; }
+
+  const int row_offset = (tmp_w - u_crop_w) * pixel_size;
+  const int out_row_stride = u_crop_w * pixel_size;
+  std::vector<unsigned char> decode_output_buf(out_width * pixel_size);
+  out_mat->create(u_crop_h, u_crop_w, color ? CV_8UC3 : CV_8UC1);
+
+  while (ctx_guard.compress_info()->output_scanline < u_crop_y + u_crop_h) {
+    unsigned char* buffer_array[1];
+    buffer_array[0] = decode_output_buf.data();
+    unsigned int read_line_index = ctx_guard.compress_info()->output_scanline;
+    jpeg_read_scanlines(ctx_guard.compress_info(), buffer_array, 1);
+    memcpy(out_mat->data + (read_line_index - u_crop_y) * out_row_stride,
+           decode_output_buf.data() + row_offset, out_row_stride);
+  }
+
+  jpeg_skip_scanlines(ctx_guard.compress_info(), out_height - u_crop_y - u_crop_h);
+  jpeg_finish_decompress(ctx_guard.compress_info());
+
+  return true;
+}
+
 void OpenCvPartialDecodeRandomCropImage(const unsigned char* data, size_t length,
                                         RandomCropGenerator* random_crop_gen,
                                         const std::string& color_space, cv::Mat& out_mat) {
@@ -27,6 +27,14 @@ bool JpegPartialDecodeRandomCropImage(const unsigned char* data, size_t length,
                                       unsigned char* workspace, size_t workspace_size,
                                       cv::Mat* out_mat);
 
+// Decodes the random crop window (generated on the full resolution image) with the smallest
+// libjpeg DCT scaling factor that keeps it at least `min_width` x `min_height`, so that an image
+// to be downscaled afterwards is never decoded at full resolution. out_mat is RGB, or GRAY if not
+// `color`.
+bool JpegPartialDecodeRandomCropScaledImage(const unsigned char* data, size_t length,
+                                            RandomCropGenerator* random_crop_gen, bool color,
+                                            int min_width, int min_height, cv::Mat* out_mat);
+
 void OpenCvPartialDecodeRandomCropImage(const unsigned char* data, size_t length,
                                         RandomCropGenerator* random_crop_gen,
                                         const std::string& color_space, cv::Mat& out_mat);
@@ -93,4 +93,46 @@ TEST(JPEG, decoder) {
   }
 }
 
+TEST(JPEG, scaled_decoder) {
+  constexpr int image_size = 768;
+  constexpr int target_size = 192;
+  std::vector<unsigned char> jpg;
+  GenerateImage(jpg, image_size, image_size);
+
+  // the whole image is decoded at a quarter of its size
+  cv::Mat scaled_image_mat;
+  auto status = JpegPartialDecodeRandomCropScaledImage(jpg.data(), jpg.size(), nullptr, true,
+                                                       target_size, target_size, &scaled_image_mat);
+  ASSERT_EQ(status, true);
+  ASSERT_EQ(scaled_image_mat.cols, target_size);
+  ASSERT_EQ(scaled_image_mat.rows, target_size);
+  cv::Mat opencv_image_mat =
+      cv::imdecode(cv::Mat(1, jpg.size(), CV_8UC1, jpg.data()), cv::IMREAD_COLOR);
+  ImageUtil::ConvertColor("BGR", opencv_image_mat, "RGB", opencv_image_mat);
+  cv::resize(opencv_image_mat, opencv_image_mat, cv::Size(target_size, target_size), 0, 0,
+             cv::INTER_AREA);
+  cv::Mat diff;
+  cv::absdiff(scaled_image_mat, opencv_image_mat, diff);
+  auto mean_diff = cv::mean(diff);
+  for (int c = 0; c < 3; ++c) { ASSERT_LT(mean_diff[c], 4.0); }
+
+  // crop windows are never decoded smaller than the target size
+  constexpr size_t test_num = 8;
+  std::seed_seq seq{4, 5, 6};
+  std::vector<int64_t> seeds(test_num);
+  seq.generate(seeds.begin(), seeds.end());
+  for (int i = 0; i < test_num; i++) {
+    RandomCropGenerator random_crop_gen({0.75, 1.333333}, {0.3, 1.0}, seeds[i], 10);
+    cv::Mat crop_image_mat;
+    status = JpegPartialDecodeRandomCropScaledImage(jpg.data(), jpg.size(), &random_crop_gen, true,
+                                                    target_size, target_size, &crop_image_mat);
+    ASSERT_EQ(status, true);
+    ASSERT_EQ(crop_image_mat.channels(), 3);
+    ASSERT_GE(crop_image_mat.cols, target_size);
+    ASSERT_GE(crop_image_mat.rows, target_size);
+    ASSERT_LT(crop_image_mat.cols, image_size);
+    ASSERT_LT(crop_image_mat.rows, image_size);
+  }
+}
+
 }  // namespace oneflow
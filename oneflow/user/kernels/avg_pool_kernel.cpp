@@ -14,6 +14,7 @@ See the License for the specific language governing permissions and
 limitations under the License.
 */
 #include "oneflow/user/kernels/avg_pool_kernel_util.h"
+#include "oneflow/core/ep/cpu/cpu_stream.h"
 
 namespace oneflow {
 
@@ -41,70 +42,120 @@ std::shared_ptr<AvgPoolOpKernelCache> CreateAvgOpKernelCache(user_op::KernelCach
   return cache;
 }
 
+namespace {
+
+// Number of output elements computed by one parallel task.
+constexpr int64_t kPoolParallelGrain = 32768;
+
+// Pooling only reads and writes within a single (n, c) plane, so planes are split among threads.
+// In the backward this also makes every thread the only writer of its dx planes.
+template<typename F>
+void ParallelForPlanes(ep::Stream* stream, int64_t elem_num, int64_t plane_size, const F& f) {
+  if (elem_num == 0 || plane_size == 0) { return; }
+  const int64_t grain = std::max<int64_t>(kPoolParallelGrain / plane_size, 1);
+  stream->As<ep::CpuStream>()->ParallelFor(0, elem_num / plane_size, f, grain);
+}
+
+}  // namespace
+
 template<typename T, typename IDX>
 struct AvgPoolKernelUtil<DeviceType::kCPU, T, IDX> {
   static void Avgpool1dForward(ep::Stream* stream, const NdIndexOffsetHelper<IDX, 2>& index_helper,
                                const IDX elem_num, const T* src, T* dest,
                                const AvgPoolParams3D& params_3d) {
-    Avgpool1dForwardCompute<T, IDX>(
-        index_helper, elem_num, src, dest, params_3d.padding()[2], params_3d.num_batch(),
-        params_3d.num_channel(), params_3d.GetXShape5D().At(4), params_3d.pool_size_3d()[2],
-        params_3d.stride_3d()[2], params_3d.count_include_pad(), params_3d.divisor_override());
+    const int64_t x_plane_size = params_3d.GetXShape5D().Count(2);
+    const int64_t y_plane_size = params_3d.GetYShape5D().Count(2);
+    ParallelForPlanes(stream, elem_num, y_plane_size, [&](int64_t begin, int64_t end) {
+      Avgpool1dForwardCompute<T, IDX>(
+          index_helper, (end - begin) * y_plane_size, src + begin * x_plane_size,
+          dest + begin * y_plane_size, params_3d.padding()[2], params_3d.num_batch(),
+          params_3d.num_channel(), params_3d.GetXShape5D().At(4), params_3d.pool_size_3d()[2],
+          params_3d.stride_3d()[2], params_3d.count_include_pad(),
+          params_3d.divisor_override());
+    });
   }
 
   static void Avgpool1dBackward(ep::Stream* stream, const NdIndexOffsetHelper<IDX, 2>& index_helper,
                                 const IDX elem_num, const T* src, T* dest,
                                 const AvgPoolParams3D& params_3d) {
-    Avgpool1dBackwardCompute<T, IDX>(
-        index_helper, elem_num, src, dest, params_3d.padding()[2], params_3d.num_batch(),
-        params_3d.num_channel(), params_3d.GetXShape5D().At(4), params_3d.pool_size_3d()[2],
-        params_3d.stride_3d()[2], params_3d.count_include_pad(), params_3d.divisor_override());
+    const int64_t x_plane_size = params_3d.GetXShape5D().Count(2);
+    const int64_t y_plane_size = params_3d.GetYShape5D().Count(2);
+    ParallelForPlanes(stream, elem_num, y_plane_size, [&](int64_t begin, int64_t end) {
+      Avgpool1dBackwardCompute<T, IDX>(
+          index_helper, (end - begin) * y_plane_size, src + begin * y_plane_size,
+          dest + begin * x_plane_size, params_3d.padding()[2], params_3d.num_batch(),
+          params_3d.num_channel(), params_3d.GetXShape5D().At(4), params_3d.pool_size_3d()[2],
+          params_3d.stride_3d()[2], params_3d.count_include_pad(),
+          params_3d.divisor_override());
+    });
   }
 
   static void Avgpool2dForward(ep::Stream* stream, const NdIndexOffsetHelper<IDX, 3>& index_helper,
                                const IDX elem_num, const T* src, T* dest,
                                const AvgPoolParams3D& params_3d) {
-    Avgpool2dForwardCompute<T, IDX>(
-        index_helper, elem_num, src, dest, params_3d.padding()[1], params_3d.padding()[2],
-        params_3d.num_batch(), params_3d.num_channel(), params_3d.GetXShape5D().At(3),
-        params_3d.GetXShape5D().At(4), params_3d.pool_size_3d()[1], params_3d.pool_size_3d()[2],
-        params_3d.stride_3d()[1], params_3d.stride_3d()[2], params_3d.count_include_pad(),
-        params_3d.divisor_override());
+    const int64_t x_plane_size = params_3d.GetXShape5D().Count(2);
+    const int64_t y_plane_size = params_3d.GetYShape5D().Count(2);
+    ParallelForPlanes(stream, elem_num, y_plane_size, [&](int64_t begin, int64_t end) {
+      Avgpool2dForwardCompute<T, IDX>(
+          index_helper, (end - begin) * y_plane_size, src + begin * x_plane_size,
+          dest + begin * y_plane_size, params_3d.padding()[1], params_3d.padding()[2],
+          params_3d.num_batch(), params_3d.num_channel(), params_3d.GetXShape5D().At(3),
+          params_3d.GetXShape5D().At(4), params_3d.pool_size_3d()[1],
+          params_3d.pool_size_3d()[2], params_3d.stride_3d()[1], params_3d.stride_3d()[2],
+          params_3d.count_include_pad(), params_3d.divisor_override());
+    });
   }
 
   static void Avgpool2dBackward(ep::Stream* stream, const NdIndexOffsetHelper<IDX, 3>& index_helper,
                                 const IDX elem_num, const T* src, T* dest,
                                 const AvgPoolParams3D& params_3d) {
-    Avgpool2dBackwardCompute<T, IDX>(
-        index_helper, elem_num, src, dest, params_3d.padding()[1], params_3d.padding()[2],
-        params_3d.num_batch(), params_3d.num_channel(), params_3d.GetXShape5D().At(3),
-        params_3d.GetXShape5D().At(4), params_3d.pool_size_3d()[1], params_3d.pool_size_3d()[2],
-        params_3d.stride_3d()[1], params_3d.stride_3d()[2], params_3d.count_include_pad(),
-        params_3d.divisor_override());
+    const int64_t x_plane_size = params_3d.GetXShape5D().Count(2);
+    const int64_t y_plane_size = params_3d.GetYShape5D().Count(2);
+    ParallelForPlanes(stream, elem_num, y_plane_size, [&](int64_t begin, int64_t end) {
+      Avgpool2dBackwardCompute<T, IDX>(
+          index_helper, (end - begin) * y_plane_size, src + begin * y_plane_size,
+          dest + begin * x_plane_size, params_3d.padding()[1], params_3d.padding()[2],
+          params_3d.num_batch(), params_3d.num_channel(), params_3d.GetXShape5D().At(3),
+          params_3d.GetXShape5D().At(4), params_3d.pool_size_3d()[1],
+          params_3d.pool_size_3d()[2], params_3d.stride_3d()[1], params_3d.stride_3d()[2],
+          params_3d.count_include_pad(), params_3d.divisor_override());
+    });
   }
 
   static void Avgpool3dForward(ep::Stream* stream, const NdIndexOffsetHelper<IDX, 4>& index_helper,
                                const IDX elem_num, const T* src, T* dest,
                                const AvgPoolParams3D& params_3d) {
-    Avgpool3dForwardCompute<T, IDX>(
-        index_helper, elem_num, src, dest, params_3d.padding()[0], params_3d.padding()[1],
-        params_3d.padding()[2], params_3d.num_batch(), params_3d.num_channel(),
-        params_3d.GetXShape5D().At(2), params_3d.GetXShape5D().At(3), params_3d.GetXShape5D().At(4),
-        params_3d.pool_size_3d()[0], params_3d.pool_size_3d()[1], params_3d.pool_size_3d()[2],
-        params_3d.stride_3d()[0], params_3d.stride_3d()[1], params_3d.stride_3d()[2],
-        params_3d.count_include_pad(), params_3d.divisor_override());
+    const int64_t x_plane_size = params_3d.GetXShape5D().Count(2);
+    const int64_t y_plane_size = params_3d.GetYShape5D().Count(2);
+    ParallelForPlanes(stream, elem_num, y_plane_size, [&](int64_t begin, int64_t end) {
+      Avgpool3dForwardCompute<T, IDX>(
+          index_helper, (end - begin) * y_plane_size, src + begin * x_plane_size,
+          dest + begin * y_plane_size, params_3d.padding()[0], params_3d.padding()[1],
+          params_3d.padding()[2], params_3d.num_batch(), params_3d.num_channel(),
+          params_3d.GetXShape5D().At(2), params_3d.GetXShape5D().At(3),
+          params_3d.GetXShape5D().At(4), params_3d.pool_size_3d()[0],
+          params_3d.pool_size_3d()[1], params_3d.pool_size_3d()[2], params_3d.stride_3d()[0],
+          params_3d.stride_3d()[1], params_3d.stride_3d()[2], params_3d.count_include_pad(),
+          params_3d.divisor_override());
+    });
   }
 
   static void Avgpool3dBackward(ep::Stream* stream, const NdIndexOffsetHelper<IDX, 4>& index_helper,
                                 const int64_t elem_num, const T* src, T* dest,
                                 const AvgPoolParams3D& params_3d) {
-    Avgpool3dBackwardCompute<T, IDX>(
-        index_helper, elem_num, src, dest, params_3d.padding()[0], params_3d.padding()[1],
-        params_3d.padding()[2], params_3d.num_batch(), params_3d.num_channel(),
-        params_3d.GetXShape5D().At(2), params_3d.GetXShape5D().At(3), params_3d.GetXShape5D().At(4),
-        params_3d.pool_size_3d()[0], params_3d.pool_size_3d()[1], params_3d.pool_size_3d()[2],
-        params_3d.stride_3d()[0], params_3d.stride_3d()[1], params_3d.stride_3d()[2],
-        params_3d.count_include_pad(), params_3d.divisor_override());
+    const int64_t x_plane_size = params_3d.GetXShape5D().Count(2);
+    const int64_t y_plane_size = params_3d.GetYShape5D().Count(2);
+    ParallelForPlanes(stream, elem_num, y_plane_size, [&](int64_t begin, int64_t end) {
+      Avgpool3dBackwardCompute<T, IDX>(
+          index_helper, (end - begin) * y_plane_size, src + begin * y_plane_size,
+          dest + begin * x_plane_size, params_3d.padding()[0], params_3d.padding()[1],
+          params_3d.padding()[2], params_3d.num_batch(), params_3d.num_channel(),
+          params_3d.GetXShape5D().At(2), params_3d.GetXShape5D().At(3),
+          params_3d.GetXShape5D().At(4), params_3d.pool_size_3d()[0],
+          params_3d.pool_size_3d()[1], params_3d.pool_size_3d()[2], params_3d.stride_3d()[0],
+          params_3d.stride_3d()[1], params_3d.stride_3d()[2], params_3d.count_include_pad(),
+          params_3d.divisor_override());
+    });
   }
 };
 
@@ -18,9 +18,20 @@ limitations under the License.
 #include "oneflow/core/kernel/kernel_util.h"
 #include "oneflow/core/ep/include/primitive/add.h"
 #include "oneflow/core/ep/include/primitive/matmul.h"
+#include "oneflow/core/ep/include/device_manager_registry.h"
+#include "oneflow/core/ep/cpu/cpu_stream.h"
+#include "oneflow/core/ep/cpu/cpu_device.h"
+#ifdef WITH_ONEDNN
+#include "oneflow/core/ep/common/onednn.h"
+#endif
 
 namespace oneflow {
 
+#ifdef WITH_ONEDNN
+// Computes 2d float convolutions with oneDNN instead of im2col and cblas.
+DEFINE_ENV_BOOL(ONEFLOW_ENABLE_ONEDNN_CONV, false);
+#endif  // WITH_ONEDNN
+
 namespace {
 
 ep::primitive::BlasTransposeType GetBlasTransposeType(bool transpose) {
@@ -64,6 +75,20 @@ auto ChannelsLastMatmulPrimitiveExists() {
                           });
 }
 
+template<typename Context>
+std::unique_ptr<ep::primitive::Matmul> NewChannelsLastPointwiseMatmulPrimitive(Context* ctx) {
+  const DataType data_type = ctx->TensorDesc4ArgNameAndIndex("in", 0)->data_type();
+  return NewMatmulPrimitive(ctx->device_type(), data_type, /*transpose_a=*/false,
+                            /*transpose_b=*/true);
+}
+
+auto ChannelsLastPointwiseMatmulPrimitiveExists() {
+  return hob::make_custom("ChannelsLastPointwiseMatmulPrimitiveExists",
+                          [](const user_op::KernelRegContext& ctx) {
+                            return NewChannelsLastPointwiseMatmulPrimitive(&ctx).operator bool();
+                          });
+}
+
 template<typename Context>
 std::unique_ptr<ep::primitive::Matmul> NewConvDataGradTransATransBMatmulPrimitive(Context* ctx) {
   const DataType data_type = ctx->TensorDesc4ArgNameAndIndex("dy", 0)->data_type();
@@ -418,6 +443,12 @@ struct ConvOpKernelCache final : public user_op::OpKernelCache {
 
   int32_t idx_offset_{};
   bool is_dynamic_{};
+
+#ifdef WITH_ONEDNN
+  // The oneDNN primitive of the last input shape, built on the first launch
+  mutable std::shared_ptr<dnnl::convolution_forward> onednn_conv_;
+  mutable std::vector<int64_t> onednn_conv_key_;
+#endif  // WITH_ONEDNN
 };
 
 template<typename T>
@@ -480,6 +511,161 @@ void InitBiasMulBuf(T* dptr, int64_t num) {
   for (int64_t i = 0; i < num; ++i) { dptr[i] = 1; }
 }
 
+// Upper bound of the memory used by the col buffers of the samples computed in parallel.
+constexpr int64_t kMaxParallelColBufBytes = 256 * 1024 * 1024;
+
+// A 1x1 convolution without stride or padding is a plain matmul of the input and the weight, its
+// col buffer would be an exact copy of the input.
+template<typename Context>
+bool IsPointwiseConv(const Context* ctx) {
+  const auto& kernel_size = ctx->template Attr<std::vector<int32_t>>("kernel_size");
+  const auto& strides = ctx->template Attr<std::vector<int32_t>>("strides");
+  const auto& padding_before = ctx->template Attr<std::vector<int32_t>>("padding_before");
+  for (int32_t k : kernel_size) {
+    if (k != 1) { return false; }
+  }
+  for (int32_t stride : strides) {
+    if (stride != 1) { return false; }
+  }
+  for (int32_t padding : padding_before) {
+    if (padding != 0) { return false; }
+  }
+  return true;
+}
+
+size_t GetCpuDeviceNumThreads() {
+  auto device = std::dynamic_pointer_cast<ep::CpuDevice>(
+      Singleton<ep::DeviceManagerRegistry>::Get()->GetDevice(DeviceType::kCPU, 0));
+  return device ? device->GetNumThreads() : 1;
+}
+
+// The samples of a batch are distributed among threads, every thread im2cols into its own col
+// buffer of the tmp buffer.
+int64_t CalcNumOfParallelColBuf(int64_t batch_size, int64_t col_buf_size) {
+  if (batch_size <= 1 || col_buf_size == 0) { return 1; }
+  int64_t num = std::min<int64_t>(batch_size, GetCpuDeviceNumThreads());
+  num = std::min<int64_t>(num, kMaxParallelColBufBytes / col_buf_size);
+  return std::max<int64_t>(num, 1);
+}
+
+template<typename T>
+size_t InferConvCpuTmpSize(user_op::InferContext* ctx, int32_t ndims) {
+  size_t tmp_buffer_size = 0;
+  const auto& out_shape = ctx->OutputTensorDesc("out", 0).shape();
+  const auto& weight_shape = ctx->InputTensorDesc("weight", 0).shape();
+
+  int64_t idx_offset = IdxOffset(ctx->Attr<std::string>("data_format"));
+  if (!IsPointwiseConv(ctx)) {
+    const size_t col_buf_size =
+        CalcElemNumOfColBuf(out_shape, weight_shape, idx_offset) * sizeof(T);
+    tmp_buffer_size += col_buf_size * CalcNumOfParallelColBuf(out_shape.At(0), col_buf_size);
+  }
+  bool has_bias = ctx->has_input("bias", 0);
+  if (has_bias) {
+    int64_t bias_mul_cnt = 1;
+    for (int i = 0; i < ndims; ++i) { bias_mul_cnt *= out_shape.At(idx_offset + i); }
+    tmp_buffer_size += bias_mul_cnt * sizeof(T);
+  }
+  return tmp_buffer_size;
+}
+
+#ifdef WITH_ONEDNN
+
+// Computes a 2d float convolution with a oneDNN primitive on the plain NCHW or NHWC tensors. The
+// primitive is cached in `conv_cache` and rebuilt only when the input shape changes.
+void LaunchOneDnnConv2d(ep::Stream* stream, const ConvOpKernelCache<float>& conv_cache,
+                        const ShapeView& in_shape, const ShapeView& weight_shape,
+                        const ShapeView& out_shape, const float* in, const float* weight,
+                        const float* bias, float* out) {
+  const bool channels_first = conv_cache.idx_offset_ == 2;
+  auto ToDims = [](const ShapeView& shape) {
+    dnnl::memory::dims dims(shape.NumAxes());
+    for (int i = 0; i < shape.NumAxes(); ++i) { dims[i] = shape.At(i); }
+    return dims;
+  };
+  // oneDNN describes the logical dims in NCHW/OIHW order whatever the memory format is
+  dnnl::memory::dims src_dims = ToDims(in_shape);
+  dnnl::memory::dims weight_dims = ToDims(weight_shape);
+  dnnl::memory::dims dst_dims = ToDims(out_shape);
+  if (!channels_first) {
+    src_dims = {src_dims[0], src_dims[3], src_dims[1], src_dims[2]};
+    weight_dims = {weight_dims[0], weight_dims[3], weight_dims[1], weight_dims[2]};
+    dst_dims = {dst_dims[0], dst_dims[3], dst_dims[1], dst_dims[2]};
+  }
+  const auto act_tag =
+      channels_first ? dnnl::memory::format_tag::nchw : dnnl::memory::format_tag::nhwc;
+  const auto weight_tag =
+      channels_first ? dnnl::memory::format_tag::oihw : dnnl::memory::format_tag::ohwi;
+  const auto data_type = dnnl::memory::data_type::f32;
+  const auto src_md = dnnl::memory::desc(src_dims, data_type, act_tag);
+  const auto weight_md = dnnl::memory::desc(weight_dims, data_type, weight_tag);
+  const auto dst_md = dnnl::memory::desc(dst_dims, data_type, act_tag);
+  const auto bias_md = bias == nullptr ? dnnl::memory::desc()
+                                       : dnnl::memory::desc({dst_dims[1]}, data_type,
+                                                            dnnl::memory::format_tag::x);
+
+  stream->As<ep::CpuStream>()->onednn_executor()->Launch([&](dnnl::engine* onednn_engine,
+                                                             dnnl::stream* onednn_stream) {
+    std::vector<int64_t> key(src_dims.begin(), src_dims.end());
+    key.emplace_back(bias != nullptr);
+    key.emplace_back(reinterpret_cast<int64_t>(onednn_engine));
+    if (!conv_cache.onednn_conv_ || conv_cache.onednn_conv_key_ != key) {
+      dnnl::memory::dims strides(conv_cache.strides_3d_.begin() + 1,
+                                 conv_cache.strides_3d_.end());
+      dnnl::memory::dims dilates;
+      dnnl::memory::dims padding_l;
+      dnnl::memory::dims padding_r;
+      for (int i = 0; i < 2; ++i) {
+        const int64_t dilation = conv_cache.dilation_rate_3d_.at(i + 1);
+        const int64_t padding = conv_cache.padding_before_3d_.at(i + 1);
+        const int64_t kernel = weight_dims[i + 2];
+        // oneDNN counts the holes between two kernel elements as dilation
+        dilates.emplace_back(dilation - 1);
+        padding_l.emplace_back(padding);
+        padding_r.emplace_back((dst_dims[i + 2] - 1) * strides[i] + (kernel - 1) * dilation + 1
+                               - src_dims[i + 2] - padding);
+      }
+      auto conv_d = dnnl::convolution_forward::desc(
+          dnnl::prop_kind::forward_inference, dnnl::algorithm::convolution_direct, src_md,
+          weight_md, bias_md, dst_md, strides, dilates, padding_l, padding_r);
+      auto conv_pd = dnnl::convolution_forward::primitive_desc(conv_d, *onednn_engine);
+      conv_cache.onednn_conv_ = std::make_shared<dnnl::convolution_forward>(conv_pd);
+      conv_cache.onednn_conv_key_ = std::move(key);
+    }
+    std::unordered_map<int, dnnl::memory> args{
+        {DNNL_ARG_SRC, dnnl::memory(src_md, *onednn_engine, const_cast<float*>(in))},
+        {DNNL_ARG_WEIGHTS, dnnl::memory(weight_md, *onednn_engine, const_cast<float*>(weight))},
+        {DNNL_ARG_DST, dnnl::memory(dst_md, *onednn_engine, out)}};
+    if (bias != nullptr) {
+      args.emplace(DNNL_ARG_BIAS,
+                   dnnl::memory(bias_md, *onednn_engine, const_cast<float*>(bias)));
+    }
+    conv_cache.onednn_conv_->execute(*onednn_stream, args);
+  });
+}
+
+template<typename T, size_t NDims>
+bool TryLaunchOneDnnConv(ep::Stream* stream, const ConvOpKernelCache<T>& conv_cache,
+                         const user_op::Tensor* in, const user_op::Tensor* weight,
+                         const user_op::Tensor* bias, user_op::Tensor* out) {
+  return false;
+}
+
+template<>
+bool TryLaunchOneDnnConv<float, 2>(ep::Stream* stream, const ConvOpKernelCache<float>& conv_cache,
+                                   const user_op::Tensor* in, const user_op::Tensor* weight,
+                                   const user_op::Tensor* bias, user_op::Tensor* out) {
+  if (!ep::primitive::OneDnnIsEnabled() || !EnvBool<ONEFLOW_ENABLE_ONEDNN_CONV>()) {
+    return false;
+  }
+  LaunchOneDnnConv2d(stream, conv_cache, in->shape_view(), weight->shape_view(), out->shape_view(),
+                     in->dptr<float>(), weight->dptr<float>(),
+                     bias == nullptr ? nullptr : bias->dptr<float>(), out->mut_dptr<float>());
+  return true;
+}
+
+#endif  // WITH_ONEDNN
+
 template<typename T, size_t NDims>
 class ConvCpuKernel final : public user_op::OpKernel {
  public:
@@ -501,12 +687,16 @@ class ConvCpuKernel final : public user_op::OpKernel {
 
     const user_op::Tensor* in = ctx->Tensor4ArgNameAndIndex("in", 0);
     const user_op::Tensor* weight = ctx->Tensor4ArgNameAndIndex("weight", 0);
+    const user_op::Tensor* bias = ctx->Tensor4ArgNameAndIndex("bias", 0);
     user_op::Tensor* tmp_buffer = ctx->Tensor4ArgNameAndIndex("tmp_buffer", 0);
     user_op::Tensor* out = ctx->Tensor4ArgNameAndIndex("out", 0);
 
-    T* col_buf_dptr = tmp_buffer->mut_dptr<T>();
-
-    bool is_bias_mul_inited = false;
+#ifdef WITH_ONEDNN
+    if (!ctx->has_input("_add_to_output", 0)
+        && TryLaunchOneDnnConv<T, NDims>(ctx->stream(), *conv_cache, in, weight, bias, out)) {
+      return;
+    }
+#endif  // WITH_ONEDNN
 
     const auto& data_format = ctx->Attr<std::string>("data_format");
     std::unique_ptr<ep::primitive::Matmul> matmul;
@@ -528,47 +718,105 @@ class ConvCpuKernel final : public user_op::OpKernel {
       beta = 1;
     }
 
-    for (int64_t i = 0; i < in->shape_view().At(0); ++i) {
-      conv_cache->im2col_func_(GetImgDptr<T>(in, i), ShapeView(conv_cache->in_5d_shape_),
-                               ShapeView(conv_cache->weight_5d_shape_),
-                               ShapeView(conv_cache->out_5d_shape_), conv_cache->strides_3d_.data(),
-                               conv_cache->dilation_rate_3d_.data(),
-                               conv_cache->padding_before_3d_.data(), col_buf_dptr);
+    const int32_t idx_offset = conv_cache->idx_offset_;
+    const int64_t batch_size = in->shape_view().At(0);
+    const int64_t col_buf_elem_cnt =
+        CalcElemNumOfColBuf(out->shape_view(), weight->shape_view(), idx_offset);
+    const bool is_pointwise = IsPointwiseConv(ctx);
+    const int64_t num_of_bias_mul = conv_cache->out_5d_shape_.Count(idx_offset, idx_offset + 3);
+    // the tmp buffer holds the col buffers, followed by the bias multiplier
+    int64_t num_col_bufs = 0;
+    if (!is_pointwise) {
+      const int64_t bias_mul_size = bias == nullptr ? 0 : num_of_bias_mul * sizeof(T);
+      num_col_bufs = (tmp_buffer->shape_view().elem_cnt() - bias_mul_size)
+                     / (col_buf_elem_cnt * sizeof(T));
+      CHECK_GT(num_col_bufs, 0);
+      num_col_bufs = std::min(num_col_bufs, batch_size);
+    }
+    T* col_buf_dptr = tmp_buffer->mut_dptr<T>();
+    T* bias_mul_dptr = col_buf_dptr + num_col_bufs * col_buf_elem_cnt;
+    if (bias != nullptr) { InitBiasMulBuf(bias_mul_dptr, num_of_bias_mul); }
+
+    if (is_pointwise && data_format == "channels_last") {
+      // out(n * h * w, co) = in(n * h * w, ci) * weight(co, ci)(T), one matmul for the whole batch
+      auto pointwise_matmul = NewChannelsLastPointwiseMatmulPrimitive(ctx);
+      CHECK(pointwise_matmul);
+      pointwise_matmul->Launch(ctx->stream(), batch_size * num_of_bias_mul,
+                               conv_cache->weight_5d_shape_.At(0),  // filter
+                               conv_cache->weight_5d_shape_.Count(1),  // ci
+                               static_cast<T>(1), in->dptr<T>(), weight->dptr<T>(), beta,
+                               out->mut_dptr<T>());
+      if (bias != nullptr) {
+        FOR_RANGE(int64_t, i, 0, batch_size) {
+          AddBias(ctx->stream(), matmul.get(), *conv_cache, bias->dptr<T>(), bias_mul_dptr,
+                  GetImgMutDptr<T>(out, i));
+        }
+      }
+      return;
+    }
 
+    auto Im2Col = [&](int64_t i, T* col_buf) {
+      conv_cache->im2col_func_(
+          GetImgDptr<T>(in, i), ShapeView(conv_cache->in_5d_shape_),
+          ShapeView(conv_cache->weight_5d_shape_), ShapeView(conv_cache->out_5d_shape_),
+          conv_cache->strides_3d_.data(), conv_cache->dilation_rate_3d_.data(),
+          conv_cache->padding_before_3d_.data(), col_buf);
+    };
+
+    auto MatmulImg = [&](int64_t i, const T* col_buf_or_img) {
       // channels first: out = weight * col_buf
       // channels last:  out = (weight * col_buf)(T)
-      int32_t idx_offset = conv_cache->idx_offset_;
       matmul->Launch(ctx->stream(),
                      conv_cache->weight_5d_shape_.At(0),                           // filter
                      conv_cache->out_5d_shape_.Count(idx_offset, idx_offset + 3),  // od * oh * ow
                      conv_cache->weight_5d_shape_.Count(1),  // ci * kd * kh * kw
-                     static_cast<T>(1), weight->dptr<T>(), col_buf_dptr, beta,
+                     static_cast<T>(1), weight->dptr<T>(), col_buf_or_img, beta,
                      GetImgMutDptr<T>(out, i));
 
-      const user_op::Tensor* bias = ctx->Tensor4ArgNameAndIndex("bias", 0);
       if (bias != nullptr) {
-        int64_t num_of_col_buf =
-            CalcElemNumOfColBuf(out->shape_view(), weight->shape_view(), idx_offset);
-        int64_t num_of_bias_mul =
-            (tmp_buffer->shape_view().elem_cnt() - num_of_col_buf * sizeof(T)) / sizeof(T);
-        CHECK_GT(num_of_bias_mul, 0);
-        T* bias_mul_dptr = col_buf_dptr + num_of_col_buf;
-        if (!is_bias_mul_inited) {
-          InitBiasMulBuf(bias_mul_dptr, num_of_bias_mul);
-          is_bias_mul_inited = true;
-        }
+        AddBias(ctx->stream(), matmul.get(), *conv_cache, bias->dptr<T>(), bias_mul_dptr,
+                GetImgMutDptr<T>(out, i));
+      }
+    };
 
-        // channels first:  out += bias * bias_mul
-        // channels last:   out += (bias * bias_mul)(T)
-        matmul->Launch(ctx->stream(),
-                       conv_cache->weight_5d_shape_.At(0),                           // filter
-                       conv_cache->out_5d_shape_.Count(idx_offset, idx_offset + 3),  // od * oh * ow
-                       1,                                                            // 1
-                       static_cast<T>(1), bias->dptr<T>(), bias_mul_dptr, static_cast<T>(1),
-                       GetImgMutDptr<T>(out, i));
+    if (is_pointwise) {
+      FOR_RANGE(int64_t, i, 0, batch_size) { MatmulImg(i, GetImgDptr<T>(in, i)); }
+      return;
+    }
+    // The samples are processed num_col_bufs at a time: their im2col runs in parallel on the
+    // CpuStream, then the matmuls run one by one since cblas is multi-threaded by itself.
+    for (int64_t batch_begin = 0; batch_begin < batch_size; batch_begin += num_col_bufs) {
+      const int64_t num_imgs = std::min(num_col_bufs, batch_size - batch_begin);
+      if (num_imgs > 1) {
+        ctx->stream()->As<ep::CpuStream>()->ParallelFor(
+            0, num_imgs,
+            [&](int64_t begin, int64_t end) {
+              for (int64_t j = begin; j < end; ++j) {
+                Im2Col(batch_begin + j, col_buf_dptr + j * col_buf_elem_cnt);
+              }
+            },
+            1);
+      } else {
+        Im2Col(batch_begin, col_buf_dptr);
+      }
+      FOR_RANGE(int64_t, j, 0, num_imgs) {
+        MatmulImg(batch_begin + j, col_buf_dptr + j * col_buf_elem_cnt);
       }
     }
   }
+
+  static void AddBias(ep::Stream* stream, ep::primitive::Matmul* matmul,
+                      const ConvOpKernelCache<T>& conv_cache, const T* bias,
+                      const T* bias_mul_dptr, T* out) {
+    const int32_t idx_offset = conv_cache.idx_offset_;
+    // channels first:  out += bias * bias_mul
+    // channels last:   out += (bias * bias_mul)(T)
+    matmul->Launch(stream,
+                   conv_cache.weight_5d_shape_.At(0),                           // filter
+                   conv_cache.out_5d_shape_.Count(idx_offset, idx_offset + 3),  // od * oh * ow
+                   1,                                                           // 1
+                   static_cast<T>(1), bias, bias_mul_dptr, static_cast<T>(1), out);
+  }
 };
 
 #define REGISTER_CONV_KERNEL(op_name, dtype, ndims)                                         \
@@ -578,22 +826,10 @@ class ConvCpuKernel final : public user_op::OpKernel {
                        && (user_op::HobAttr<int32_t>("groups") == 1)                        \
                        && (user_op::HobDataType("in", 0) == GetDataType<dtype>::value)      \
                        && ChannelsFirstMatmulPrimitiveExists()                              \
-                       && ChannelsLastMatmulPrimitiveExists())                              \
+                       && ChannelsLastMatmulPrimitiveExists()                               \
+                       && ChannelsLastPointwiseMatmulPrimitiveExists())                     \
       .SetInferTmpSizeFn([](user_op::InferContext* ctx) -> size_t {                         \
-        size_t tmp_buffer_size = 0;                                                         \
-        const auto& out_shape = ctx->OutputTensorDesc("out", 0).shape();                    \
-        const auto& weight_shape = ctx->InputTensorDesc("weight", 0).shape();               \
-                                                                                            \
-        int64_t idx_offset = IdxOffset(ctx->Attr<std::string>("data_format"));              \
-        tmp_buffer_size +=                                                                  \
-            CalcElemNumOfColBuf(out_shape, weight_shape, idx_offset) * sizeof(dtype);       \
-        bool has_bias = ctx->has_input("bias", 0);                                          \
-        if (has_bias) {                                                                     \
-          int64_t bias_mul_cnt = 1;                                                         \
-          for (int i = 0; i < ndims; ++i) { bias_mul_cnt *= out_shape.At(idx_offset + i); } \
-          tmp_buffer_size += bias_mul_cnt * sizeof(dtype);                                  \
-        }                                                                                   \
-        return tmp_buffer_size;                                                             \
+        return InferConvCpuTmpSize<dtype>(ctx, ndims);                                      \
       })                                                                                    \
       .SetInplaceProposalFn(                                                                \
           [](const user_op::InferContext& ctx,                                              \
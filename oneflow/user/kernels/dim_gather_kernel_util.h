@@ -47,25 +47,34 @@ struct DimGatherFunctor final {
                   IN_T* output);
 };
 
+template<typename IN_T, typename IDX_T>
+OF_DEVICE_FUNC void DimGatherElement(const DimOpIndexNdHelper<IDX_T>& input_nd_helper,
+                                     const DimOpIndexNdHelper<IDX_T>& index_nd_helper, int ndim,
+                                     int64_t index_offset, int32_t dim_length, int32_t dim,
+                                     const IDX_T* index, const IN_T* input, IN_T* output) {
+  IDX_T coordinate[kDimGatherMaxDimCount] = {0};
+  const IDX_T x = index[index_offset];
+#ifdef __CUDA_ARCH__
+  assert(x < dim_length && "gather index is out of bounds");
+#else
+  CHECK_LE(x, dim_length) << "RuntimeError: index " << x << " is out of bounds for dimension "
+                          << dim << " with size " << dim_length;
+#endif
+  index_nd_helper.OffsetToNdIndex(index_offset, coordinate, ndim);
+  coordinate[dim] = x;
+
+  IDX_T input_offset = input_nd_helper.NdIndexToOffset(coordinate, ndim);
+  output[index_offset] = input[input_offset];
+}
+
 template<typename IN_T, typename IDX_T>
 OF_DEVICE_FUNC void DoDimGather(const DimOpIndexNdHelper<IDX_T>& input_nd_helper,
                                 const DimOpIndexNdHelper<IDX_T>& index_nd_helper, int ndim,
                                 int64_t elem_cnt, int32_t dim_length, int32_t dim,
                                 const IDX_T* index, const IN_T* input, IN_T* output) {
   XPU_1D_KERNEL_LOOP(index_offset, elem_cnt) {
-    IDX_T coordinate[kDimGatherMaxDimCount] = {0};
-    const IDX_T x = index[index_offset];
-#ifdef __CUDA_ARCH__
-    assert(x < dim_length && "gather index is out of bounds");
-#else
-    CHECK_LE(x, dim_length) << "RuntimeError: index " << x << " is out of bounds for dimension "
-                            << dim << " with size " << dim_length;
-#endif
-    index_nd_helper.OffsetToNdIndex(index_offset, coordinate, ndim);
-    coordinate[dim] = x;
-
-    IDX_T input_offset = input_nd_helper.NdIndexToOffset(coordinate, ndim);
-    output[index_offset] = input[input_offset];
+    DimGatherElement<IN_T, IDX_T>(input_nd_helper, index_nd_helper, ndim, index_offset,
+                                  dim_length, dim, index, input, output);
   }
 }
 
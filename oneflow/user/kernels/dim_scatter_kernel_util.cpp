@@ -16,6 +16,7 @@ limitations under the License.
 
 #include "oneflow/core/framework/framework.h"
 #include "oneflow/user/kernels/dim_scatter_kernel_util.h"
+#include "oneflow/core/ep/cpu/cpu_stream.h"
 
 namespace oneflow {
 namespace user_op {
@@ -27,9 +28,44 @@ struct DimScatterFunctor<DeviceType::kCPU, IN_T, IDX_T, Opt> final {
                   const DimOpIndexNdHelper<IDX_T>& output_nd_helper, const int ndim,
                   const int64_t elem_cnt, const int32_t dim, const int64_t upper_bound,
                   const IDX_T* index, const IN_T* src, IN_T* output) {
-    DoDimScatter<IN_T, IDX_T, Opt>(src_nd_helper, idx_nd_helper, output_nd_helper, ndim, elem_cnt,
-                                   dim, upper_bound, index, src, output);
+    if (elem_cnt == 0) { return; }
+    // Elements of index only differing in the scattered dim are the only ones that may write the
+    // same output element. Viewing index as (outer, dim_size, inner), every task owns a block of
+    // (outer, inner) columns and applies them in the same order as a serial loop.
+    IDX_T dim_unit[kDimGatherMaxDimCount] = {0};
+    dim_unit[dim] = 1;
+    const int64_t inner_size = idx_nd_helper.NdIndexToOffset(dim_unit, ndim);
+    int64_t outer_stride = elem_cnt;
+    if (dim > 0) {
+      IDX_T outer_unit[kDimGatherMaxDimCount] = {0};
+      outer_unit[dim - 1] = 1;
+      outer_stride = idx_nd_helper.NdIndexToOffset(outer_unit, ndim);
+    }
+    const int64_t outer_size = elem_cnt / outer_stride;
+    const int64_t dim_size = outer_stride / inner_size;
+    const int64_t num_inner_blocks = (inner_size + kInnerBlockSize - 1) / kInnerBlockSize;
+    stream->As<ep::CpuStream>()->ParallelFor(
+        0, outer_size * num_inner_blocks,
+        [&](int64_t begin, int64_t end) {
+          for (int64_t task = begin; task < end; ++task) {
+            const int64_t outer = task / num_inner_blocks;
+            const int64_t inner_begin = (task % num_inner_blocks) * kInnerBlockSize;
+            const int64_t inner_end = std::min(inner_begin + kInnerBlockSize, inner_size);
+            for (int64_t d = 0; d < dim_size; ++d) {
+              const int64_t row_offset = outer * outer_stride + d * inner_size;
+              for (int64_t inner = inner_begin; inner < inner_end; ++inner) {
+                DimScatterElement<IN_T, IDX_T, Opt>(src_nd_helper, idx_nd_helper, output_nd_helper,
+                                                    ndim, row_offset + inner, dim, upper_bound,
+                                                    index, src, output);
+              }
+            }
+          }
+        },
+        1);
   }
+
+ private:
+  static constexpr int64_t kInnerBlockSize = 1024;
 };
 
 INSTANTIATE_DIM_SCATTER_CPU_FUNCTORS(DeviceType::kCPU, BinOpAddFunctor);
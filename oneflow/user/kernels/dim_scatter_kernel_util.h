@@ -164,6 +164,30 @@ struct DimScatterFunctor final {
                   const IDX_T* index, const IN_T* src, IN_T* output);
 };
 
+template<typename IN_T, typename IDX_T, template<typename T> class Opt>
+OF_DEVICE_FUNC void DimScatterElement(const DimOpIndexNdHelper<IDX_T>& src_nd_helper,
+                                      const DimOpIndexNdHelper<IDX_T>& idx_nd_helper,
+                                      const DimOpIndexNdHelper<IDX_T>& output_nd_helper,
+                                      const int ndim, const int64_t idx_offset, const int32_t dim,
+                                      int64_t upper_bound, const IDX_T* index, const IN_T* src,
+                                      IN_T* output) {
+  IDX_T coordinate[kDimGatherMaxDimCount] = {0};
+  idx_nd_helper.OffsetToNdIndex(idx_offset, coordinate, ndim);  // idx_offset -> ijk
+  IDX_T idx_elem = index[idx_offset];
+  if (upper_bound != 0 && idx_elem >= upper_bound) {
+#if __CUDA_ARCH__
+    __trap();
+#else
+    UNIMPLEMENTED() << "The index element " << idx_elem << " is out of bounds for dimension "
+                    << dim << " with size " << upper_bound << ".";
+#endif
+  }
+  IDX_T src_offset = src_nd_helper.NdIndexToOffset(coordinate, ndim);
+  coordinate[dim] = idx_elem;
+  IDX_T output_offset = output_nd_helper.NdIndexToOffset(coordinate, ndim);
+  Opt<IN_T>::apply(src + src_offset, output + output_offset);
+}
+
 template<typename IN_T, typename IDX_T, template<typename T> class Opt>
 OF_DEVICE_FUNC void DoDimScatter(const DimOpIndexNdHelper<IDX_T>& src_nd_helper,
                                  const DimOpIndexNdHelper<IDX_T>& idx_nd_helper,
@@ -171,21 +195,8 @@ OF_DEVICE_FUNC void DoDimScatter(const DimOpIndexNdHelper<IDX_T>& src_nd_helper,
                                  const int64_t elem_cnt, const int32_t dim, int64_t upper_bound,
                                  const IDX_T* index, const IN_T* src, IN_T* output) {
   XPU_1D_KERNEL_LOOP(idx_offset, elem_cnt) {
-    IDX_T coordinate[kDimGatherMaxDimCount] = {0};
-    idx_nd_helper.OffsetToNdIndex(idx_offset, coordinate, ndim);  // idx_offset -> ijk
-    IDX_T idx_elem = index[idx_offset];
-    if (upper_bound != 0 && idx_elem >= upper_bound) {
-#if __CUDA_ARCH__
-      __trap();
-#else
-      UNIMPLEMENTED() << "The index element " << idx_elem << " is out of bounds for dimension "
-                      << dim << " with size " << upper_bound << ".";
-#endif
-    }
-    IDX_T src_offset = src_nd_helper.NdIndexToOffset(coordinate, ndim);
-    coordinate[dim] = idx_elem;
-    IDX_T output_offset = output_nd_helper.NdIndexToOffset(coordinate, ndim);
-    Opt<IN_T>::apply(src + src_offset, output + output_offset);
+    DimScatterElement<IN_T, IDX_T, Opt>(src_nd_helper, idx_nd_helper, output_nd_helper, ndim,
+                                        idx_offset, dim, upper_bound, index, src, output);
   }
 }
 
@@ -14,11 +14,15 @@ See the License for the specific language governing permissions and
 limitations under the License.
 */
 #include "oneflow/user/kernels/gather_kernel_util.h"
+#include "oneflow/core/ep/cpu/cpu_stream.h"
 
 namespace oneflow {
 
 namespace {
 
+// Number of output elements copied by one parallel task.
+constexpr int64_t kGatherParallelGrain = 32768;
+
 Shape GetFlatShape(const ShapeView& shape, int64_t axis) {
   CHECK_GT(shape.NumAxes(), 0);
   CHECK_GE(axis, 0);
@@ -76,19 +80,32 @@ void GatherKernelUtilImpl<DeviceType::kCPU, T, K>::Forward(ep::Stream* stream, c
   const int64_t outer_dim_size = flat_in_shape.At(0);
   const int64_t gather_dim_size = flat_in_shape.At(1);
   const int64_t inner_dim_size = flat_in_shape.At(2);
-  FOR_RANGE(int64_t, outer_idx, 0, outer_dim_size) {
-    FOR_RANGE(int64_t, i, 0, num_indices) {
-      CHECK_GE(indices[i], 0);
-      const int64_t idx = indices[i] - offset;
-      T* to = out + outer_idx * num_indices * inner_dim_size + i * inner_dim_size;
-      if (idx >= 0 && idx < gather_dim_size) {
-        const T* from = in + outer_idx * gather_dim_size * inner_dim_size + idx * inner_dim_size;
-        std::copy(from, from + inner_dim_size, to);
-      } else {
-        std::memset(reinterpret_cast<void*>(to), 0, inner_dim_size * sizeof(T));
-      }
-    }
-  }
+  const int64_t num_rows = outer_dim_size * num_indices;
+  if (num_rows == 0 || inner_dim_size == 0) { return; }
+  const int64_t grain = std::max<int64_t>(kGatherParallelGrain / inner_dim_size, 1);
+  stream->As<ep::CpuStream>()->ParallelFor(
+      0, num_rows,
+      [&](int64_t begin, int64_t end) {
+        for (int64_t row = begin; row < end; ++row) {
+          const int64_t outer_idx = row / num_indices;
+          const int64_t i = row % num_indices;
+          CHECK_GE(indices[i], 0);
+          const int64_t idx = indices[i] - offset;
+          T* to = out + row * inner_dim_size;
+          if (idx < 0 || idx >= gather_dim_size) {
+            std::memset(reinterpret_cast<void*>(to), 0, inner_dim_size * sizeof(T));
+            continue;
+          }
+          const T* from = in + (outer_idx * gather_dim_size + idx) * inner_dim_size;
+          if (inner_dim_size == 1) {
+            *to = *from;
+          } else {
+            std::memcpy(reinterpret_cast<void*>(to), reinterpret_cast<const void*>(from),
+                        inner_dim_size * sizeof(T));
+          }
+        }
+      },
+      grain);
 }
 
 #define INITIATE_GATHER_KERNEL_UTIL_CPU_IMPL(in_type_pair, index_type_pair)              \
@@ -18,6 +18,7 @@ limitations under the License.
 #include "oneflow/core/kernel/kernel_util.h"
 #include "oneflow/core/ep/include/primitive/add.h"
 #include "oneflow/core/ep/include/primitive/matmul.h"
+#include "oneflow/core/ep/cpu/cpu_stream.h"
 
 namespace oneflow {
 
@@ -588,6 +589,130 @@ REGISTER_CONV_KERNEL(conv1d, double, 1);
 REGISTER_CONV_KERNEL(conv2d, double, 2);
 REGISTER_CONV_KERNEL(conv3d, double, 3);
 
+auto IsDepthwiseConv() {
+  return hob::make_custom("IsDepthwiseConv", [](const user_op::KernelRegContext& ctx) {
+    const int32_t groups = ctx.Attr<int32_t>("groups");
+    const Shape& in_shape = ctx.TensorDesc4ArgNameAndIndex("in", 0)->shape();
+    const Shape& weight_shape = ctx.TensorDesc4ArgNameAndIndex("weight", 0)->shape();
+    const int32_t channel_axis =
+        ctx.Attr<std::string>("data_format") == "channels_first" ? 1 : in_shape.NumAxes() - 1;
+    return in_shape.At(channel_axis) == groups && weight_shape.At(0) == groups;
+  });
+}
+
+// Depthwise convolution of NHWC tensors. Every output channel only reads the same input channel,
+// so the window of an output pixel is scanned once for all the contiguous channels instead of
+// running an im2col and a matmul with a single row for every group.
+template<typename T>
+class DepthwiseConv2dChannelsLastCpuKernel final : public user_op::OpKernel {
+ public:
+  DepthwiseConv2dChannelsLastCpuKernel() = default;
+  ~DepthwiseConv2dChannelsLastCpuKernel() = default;
+
+  bool AlwaysComputeWhenAllOutputsEmpty() const override { return false; }
+
+  std::shared_ptr<user_op::OpKernelCache> InitOpKernelCache(
+      user_op::KernelCacheContext* ctx) const override {
+    return CreateConvOpKernelCache<T>(ctx, "in", "out", "weight");
+  }
+
+ private:
+  void Compute(user_op::KernelComputeContext* ctx, user_op::OpKernelState*,
+               const user_op::OpKernelCache* cache) const override {
+    const auto* conv_cache = dynamic_cast<const ConvOpKernelCache<T>*>(cache);
+    CHECK_NOTNULL(conv_cache);
+
+    const user_op::Tensor* in = ctx->Tensor4ArgNameAndIndex("in", 0);
+    const user_op::Tensor* weight = ctx->Tensor4ArgNameAndIndex("weight", 0);
+    const user_op::Tensor* bias = ctx->Tensor4ArgNameAndIndex("bias", 0);
+    user_op::Tensor* tmp_buffer = ctx->Tensor4ArgNameAndIndex("tmp_buffer", 0);
+    user_op::Tensor* out = ctx->Tensor4ArgNameAndIndex("out", 0);
+    const T* add_to_output = nullptr;
+    if (ctx->has_input("_add_to_output", 0)) {
+      const user_op::Tensor* add_to_output_tensor =
+          ctx->Tensor4ArgNameAndIndex("_add_to_output", 0);
+      CHECK_EQ(add_to_output_tensor->shape_view(), out->shape_view());
+      add_to_output = add_to_output_tensor->dptr<T>();
+    }
+
+    const int64_t batch_size = in->shape_view().At(0);
+    const int64_t in_height = in->shape_view().At(1);
+    const int64_t in_width = in->shape_view().At(2);
+    const int64_t channels = in->shape_view().At(3);
+    const int64_t out_height = out->shape_view().At(1);
+    const int64_t out_width = out->shape_view().At(2);
+    const int64_t kernel_height = weight->shape_view().At(1);
+    const int64_t kernel_width = weight->shape_view().At(2);
+    const int32_t stride_h = conv_cache->strides_3d_.at(1);
+    const int32_t stride_w = conv_cache->strides_3d_.at(2);
+    const int32_t dilation_h = conv_cache->dilation_rate_3d_.at(1);
+    const int32_t dilation_w = conv_cache->dilation_rate_3d_.at(2);
+    const int32_t padding_h = conv_cache->padding_before_3d_.at(1);
+    const int32_t padding_w = conv_cache->padding_before_3d_.at(2);
+
+    // weight (c, kh, kw, 1) -> (kh, kw, c), so that the channels of a kernel element are contiguous
+    T* weight_t = tmp_buffer->mut_dptr<T>();
+    const int64_t kernel_size = kernel_height * kernel_width;
+    const T* weight_ptr = weight->dptr<T>();
+    FOR_RANGE(int64_t, c, 0, channels) {
+      FOR_RANGE(int64_t, k, 0, kernel_size) {
+        weight_t[k * channels + c] = weight_ptr[c * kernel_size + k];
+      }
+    }
+
+    const T* in_ptr = in->dptr<T>();
+    const T* bias_ptr = bias == nullptr ? nullptr : bias->dptr<T>();
+    T* out_ptr = out->mut_dptr<T>();
+    const int64_t row_size = out_width * channels;
+    ctx->stream()->As<ep::CpuStream>()->ParallelFor(
+        0, batch_size * out_height,
+        [&](int64_t begin, int64_t end) {
+          for (int64_t row = begin; row < end; ++row) {
+            const int64_t n = row / out_height;
+            const int64_t oh = row % out_height;
+            for (int64_t ow = 0; ow < out_width; ++ow) {
+              const int64_t out_offset = row * row_size + ow * channels;
+              T* y = out_ptr + out_offset;
+              for (int64_t c = 0; c < channels; ++c) {
+                y[c] = bias_ptr == nullptr ? static_cast<T>(0) : bias_ptr[c];
+              }
+              if (add_to_output != nullptr) {
+                for (int64_t c = 0; c < channels; ++c) { y[c] += add_to_output[out_offset + c]; }
+              }
+              for (int64_t kh = 0; kh < kernel_height; ++kh) {
+                const int64_t ih = oh * stride_h - padding_h + kh * dilation_h;
+                if (ih < 0 || ih >= in_height) { continue; }
+                for (int64_t kw = 0; kw < kernel_width; ++kw) {
+                  const int64_t iw = ow * stride_w - padding_w + kw * dilation_w;
+                  if (iw < 0 || iw >= in_width) { continue; }
+                  const T* x = in_ptr + ((n * in_height + ih) * in_width + iw) * channels;
+                  const T* w = weight_t + (kh * kernel_width + kw) * channels;
+                  for (int64_t c = 0; c < channels; ++c) { y[c] += x[c] * w[c]; }
+                }
+              }
+            }
+          }
+        },
+        std::max<int64_t>(32768 / std::max<int64_t>(row_size * kernel_size, 1), 1));
+  }
+};
+
+#define REGISTER_DEPTHWISE_CONV2D_CHANNELS_LAST_KERNEL(dtype)                                 \
+  REGISTER_USER_KERNEL("conv2d")                                                              \
+      .SetCreateFn<DepthwiseConv2dChannelsLastCpuKernel<dtype>>()                             \
+      .SetIsMatchedHob((user_op::HobDeviceType() == DeviceType::kCPU)                         \
+                       && (user_op::HobAttr<int32_t>("groups") > 1)                           \
+                       && (user_op::HobAttr<std::string>("data_format") == "channels_last")   \
+                       && (user_op::HobDataType("in", 0) == GetDataType<dtype>::value)        \
+                       && IsDepthwiseConv())                                                  \
+      .SetInferTmpSizeFn([](user_op::InferContext* ctx) -> size_t {                           \
+        return ctx->InputTensorDesc("weight", 0).shape().elem_cnt() * sizeof(dtype);          \
+      })                                                                                      \
+      .SetPriority(user_op::kKernelPriorityOptimized)
+
+REGISTER_DEPTHWISE_CONV2D_CHANNELS_LAST_KERNEL(float);
+REGISTER_DEPTHWISE_CONV2D_CHANNELS_LAST_KERNEL(double);
+
 template<typename T>
 class ConvDataGradCpuKernel final : public user_op::OpKernel {
  public:
@@ -0,0 +1,467 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "oneflow/core/framework/framework.h"
+#include "oneflow/core/ep/cpu/cpu_stream.h"
+#include "oneflow/core/ep/include/primitive/matmul.h"
+
+namespace oneflow {
+
+namespace {
+
+// Batches up to kGemvMaxRows rows (the decode phase of LLM inference) are computed by the fused
+// dequantize-GEMV micro-kernel, larger batches dequantize the weight once and call cblas.
+constexpr int64_t kGemvMaxRows = 8;
+constexpr int64_t kRowBlock = 4;
+constexpr int64_t kColBlock = 4;
+// Number of independent partial sums kept per dot product, lets the compiler vectorize the
+// reduction along k without relying on floating point reassociation.
+constexpr int64_t kNumLanes = 8;
+// Number of output elements a ParallelFor task of the dequantize kernel should at least write.
+constexpr int64_t kDequantizeParallelGrain = 32768;
+
+// Unpacks `n` quantized values into float, the first value is the `offset`-th value of `q`. For
+// 4 bits the high nibble holds the first value of a pair, `offset` and `n` must be even.
+template<typename U, int num_bits>
+void UnpackQuantized(const U* q, int64_t offset, int64_t n, float* out) {
+  if constexpr (num_bits == 8) {
+    const U* src = q + offset;
+    for (int64_t i = 0; i < n; ++i) { out[i] = static_cast<float>(src[i]); }
+  } else if constexpr (num_bits == 4) {
+    const U* src = q + offset / 2;
+    for (int64_t i = 0; i < n / 2; ++i) {
+      const U packed = src[i];
+      if constexpr (std::is_same<U, uint8_t>::value) {
+        out[i * 2 + 0] = static_cast<float>(packed >> 4);
+        out[i * 2 + 1] = static_cast<float>(packed & 0xF);
+      } else {
+        out[i * 2 + 0] = static_cast<float>(packed >> 4);
+        out[i * 2 + 1] = static_cast<float>(static_cast<int8_t>(packed << 4) >> 4);
+      }
+    }
+  } else {
+    UNIMPLEMENTED();
+  }
+}
+
+// Symmetric uint8 storage keeps the values shifted by 2^(bits - 1) - 1.
+template<typename U, int num_bits>
+float SymmetricZero(float scale) {
+  if (std::is_same<U, uint8_t>::value) {
+    return -static_cast<float>((1 << (num_bits - 1)) - 1) * scale;
+  } else {
+    return 0;
+  }
+}
+
+template<typename T, typename U, int num_bits, bool symmetric>
+void Dequantize(ep::CpuStream* stream, int64_t outer_size, int64_t group_size, int64_t inner_size,
+                const U* in, const T* scale, const T* zero, T* out) {
+  if (inner_size == 1) {
+    CHECK_EQ(group_size % (8 / num_bits), 0);
+    const int64_t grain = std::max<int64_t>(kDequantizeParallelGrain / group_size, 1);
+    stream->ParallelFor(
+        0, outer_size,
+        [&](int64_t begin, int64_t end) {
+          std::vector<float> values(group_size);
+          for (int64_t outer_id = begin; outer_id < end; ++outer_id) {
+            const float group_scale = static_cast<float>(scale[outer_id]);
+            const float group_zero = symmetric
+                                         ? SymmetricZero<U, num_bits>(group_scale)
+                                         : static_cast<float>(zero[outer_id]);
+            UnpackQuantized<U, num_bits>(in, outer_id * group_size, group_size, values.data());
+            T* out_group = out + outer_id * group_size;
+            for (int64_t i = 0; i < group_size; ++i) {
+              out_group[i] = static_cast<T>(values[i] * group_scale + group_zero);
+            }
+          }
+        },
+        grain);
+  } else {
+    CHECK_EQ(inner_size % (8 / num_bits), 0);
+    const int64_t grain = std::max<int64_t>(kDequantizeParallelGrain / inner_size, 1);
+    stream->ParallelFor(
+        0, outer_size * group_size,
+        [&](int64_t begin, int64_t end) {
+          std::vector<float> values(inner_size);
+          for (int64_t row = begin; row < end; ++row) {
+            const int64_t outer_id = row / group_size;
+            const T* scale_row = scale + outer_id * inner_size;
+            const T* zero_row = symmetric ? nullptr : zero + outer_id * inner_size;
+            UnpackQuantized<U, num_bits>(in, row * inner_size, inner_size, values.data());
+            T* out_row = out + row * inner_size;
+            for (int64_t i = 0; i < inner_size; ++i) {
+              const float s = static_cast<float>(scale_row[i]);
+              const float z =
+                  symmetric ? SymmetricZero<U, num_bits>(s) : static_cast<float>(zero_row[i]);
+              out_row[i] = static_cast<T>(values[i] * s + z);
+            }
+          }
+        },
+        grain);
+  }
+}
+
+template<typename T, typename U>
+void DispatchDequantize(ep::CpuStream* stream, int32_t num_bits, bool symmetric,
+                        int64_t outer_size, int64_t group_size, int64_t inner_size, const U* in,
+                        const T* scale, const T* zero, T* out) {
+  if (num_bits == 4) {
+    if (symmetric) {
+      Dequantize<T, U, 4, true>(stream, outer_size, group_size, inner_size, in, scale, zero, out);
+    } else {
+      Dequantize<T, U, 4, false>(stream, outer_size, group_size, inner_size, in, scale, zero, out);
+    }
+  } else if (num_bits == 8) {
+    if (symmetric) {
+      Dequantize<T, U, 8, true>(stream, outer_size, group_size, inner_size, in, scale, zero, out);
+    } else {
+      Dequantize<T, U, 8, false>(stream, outer_size, group_size, inner_size, in, scale, zero, out);
+    }
+  } else {
+    UNIMPLEMENTED();
+  }
+}
+
+template<typename T>
+class GroupwiseDequantizeCpuKernel final : public user_op::OpKernel {
+ public:
+  GroupwiseDequantizeCpuKernel() = default;
+  ~GroupwiseDequantizeCpuKernel() override = default;
+
+ private:
+  using user_op::OpKernel::Compute;
+  void Compute(user_op::KernelComputeContext* ctx) const override {
+    const user_op::Tensor* in = ctx->Tensor4ArgNameAndIndex("in", 0);
+    const user_op::Tensor* scale = ctx->Tensor4ArgNameAndIndex("scale", 0);
+    const user_op::Tensor* zero = nullptr;
+    if (ctx->has_input("zero", 0)) { zero = ctx->Tensor4ArgNameAndIndex("zero", 0); }
+    user_op::Tensor* out = ctx->Tensor4ArgNameAndIndex("out", 0);
+    const int64_t group_size = ctx->Attr<int64_t>("group_size");
+    const int64_t group_dim = ctx->Attr<int64_t>("group_dim");
+    const int32_t num_bits = ctx->Attr<int32_t>("num_bits");
+    const bool symmetric = ctx->Attr<bool>("symmetric");
+    const int64_t num_in_axes = in->shape_view().NumAxes();
+    CHECK_GE(num_in_axes, 1);
+    CHECK_EQ(scale->shape_view().NumAxes(), num_in_axes);
+    if (zero != nullptr) { CHECK_EQ(zero->shape_view().NumAxes(), num_in_axes); }
+    CHECK_EQ(out->shape_view().NumAxes(), num_in_axes);
+    CHECK_GE(group_dim, 0);
+    CHECK_LT(group_dim, num_in_axes);
+    for (int i = 0; i < num_in_axes; ++i) {
+      if (i == num_in_axes - 1) {
+        CHECK_EQ(out->shape_view().At(i), in->shape_view().At(i) * (8 / num_bits));
+      } else {
+        CHECK_EQ(out->shape_view().At(i), in->shape_view().At(i));
+      }
+    }
+    const int64_t group_dim_size = out->shape_view().At(group_dim);
+    CHECK_GT(group_size, 0);
+    CHECK_LE(group_size, group_dim_size);
+    CHECK_EQ(group_dim_size % group_size, 0);
+    const int64_t num_groups = group_dim_size / group_size;
+    for (int i = 0; i < num_in_axes; ++i) {
+      const int64_t expected_dim_size = i == group_dim ? num_groups : out->shape_view().At(i);
+      CHECK_EQ(scale->shape_view().At(i), expected_dim_size);
+      if (zero != nullptr) { CHECK_EQ(zero->shape_view().At(i), expected_dim_size); }
+    }
+    const int64_t outer_size = out->shape_view().Count(0, group_dim) * num_groups;
+    const int64_t inner_size = out->shape_view().Count(group_dim + 1);
+    auto* stream = ctx->stream()->As<ep::CpuStream>();
+    if (in->data_type() == DataType::kUInt8) {
+      DispatchDequantize<T, uint8_t>(stream, num_bits, symmetric, outer_size, group_size,
+                                     inner_size, in->dptr<uint8_t>(), scale->dptr<T>(),
+                                     zero == nullptr ? nullptr : zero->dptr<T>(),
+                                     out->mut_dptr<T>());
+    } else if (in->data_type() == DataType::kInt8) {
+      DispatchDequantize<T, int8_t>(stream, num_bits, symmetric, outer_size, group_size,
+                                    inner_size, in->dptr<int8_t>(), scale->dptr<T>(),
+                                    zero == nullptr ? nullptr : zero->dptr<T>(),
+                                    out->mut_dptr<T>());
+    } else {
+      UNIMPLEMENTED();
+    }
+  }
+
+  bool AlwaysComputeWhenAllOutputsEmpty() const override { return false; }
+};
+
+#define REGISTER_GROUPWISE_DEQUANTIZE_CPU_KERNEL(dtype)               \
+  REGISTER_USER_KERNEL("groupwise_dequantize")                        \
+      .SetCreateFn<GroupwiseDequantizeCpuKernel<dtype>>()             \
+      .SetIsMatchedHob((user_op::HobDeviceType() == DeviceType::kCPU) \
+                       && (user_op::HobDataType("scale", 0) == GetDataType<dtype>::value))
+
+REGISTER_GROUPWISE_DEQUANTIZE_CPU_KERNEL(float);
+REGISTER_GROUPWISE_DEQUANTIZE_CPU_KERNEL(float16);
+
+// Dequantizes rows [n_begin, n_end) of the (n, k) quantized weight into `w`, row-major with
+// leading dimension k.
+template<typename U, int num_bits, bool symmetric>
+void DequantizeWeightRows(int64_t n_begin, int64_t n_end, int64_t k, int64_t group_dim,
+                          int64_t group_size, const U* q, const float* scale, const float* zero,
+                          float* w) {
+  const int64_t num_k_groups = k / group_size;
+  for (int64_t n = n_begin; n < n_end; ++n) {
+    float* w_n = w + (n - n_begin) * k;
+    UnpackQuantized<U, num_bits>(q, n * k, k, w_n);
+    if (group_dim == 0) {
+      const float* scale_n = scale + (n / group_size) * k;
+      const float* zero_n = symmetric ? nullptr : zero + (n / group_size) * k;
+      for (int64_t i = 0; i < k; ++i) {
+        const float z = symmetric ? SymmetricZero<U, num_bits>(scale_n[i]) : zero_n[i];
+        w_n[i] = w_n[i] * scale_n[i] + z;
+      }
+    } else {
+      for (int64_t g = 0; g < num_k_groups; ++g) {
+        const float s = scale[n * num_k_groups + g];
+        const float z = symmetric ? SymmetricZero<U, num_bits>(s)
+                                  : zero[n * num_k_groups + g];
+        float* w_g = w_n + g * group_size;
+        for (int64_t i = 0; i < group_size; ++i) { w_g[i] = w_g[i] * s + z; }
+      }
+    }
+  }
+}
+
+// Computes the rows x cols block out[r][c] = dot(x[r], w[c]) + bias[c] with every accumulator
+// held in registers.
+template<int64_t rows, int64_t cols>
+void GemvMicroKernel(int64_t k, const float* x, int64_t ldx, const float* w, int64_t ldw,
+                     const float* bias, float* out, int64_t ldo) {
+  float acc[rows][cols][kNumLanes] = {};
+  int64_t i = 0;
+  for (; i + kNumLanes <= k; i += kNumLanes) {
+    for (int64_t r = 0; r < rows; ++r) {
+      for (int64_t c = 0; c < cols; ++c) {
+        for (int64_t l = 0; l < kNumLanes; ++l) {
+          acc[r][c][l] += x[r * ldx + i + l] * w[c * ldw + i + l];
+        }
+      }
+    }
+  }
+  for (int64_t r = 0; r < rows; ++r) {
+    for (int64_t c = 0; c < cols; ++c) {
+      float sum = 0;
+      for (int64_t l = 0; l < kNumLanes; ++l) { sum += acc[r][c][l]; }
+      for (int64_t j = i; j < k; ++j) { sum += x[r * ldx + j] * w[c * ldw + j]; }
+      if (bias != nullptr) { sum += bias[c]; }
+      out[r * ldo + c] = sum;
+    }
+  }
+}
+
+template<int64_t rows>
+void DispatchGemvMicroKernelCols(int64_t cols, int64_t k, const float* x, int64_t ldx,
+                                 const float* w, int64_t ldw, const float* bias, float* out,
+                                 int64_t ldo) {
+  static_assert(kColBlock == 4, "");
+  if (cols == 4) {
+    GemvMicroKernel<rows, 4>(k, x, ldx, w, ldw, bias, out, ldo);
+  } else if (cols == 3) {
+    GemvMicroKernel<rows, 3>(k, x, ldx, w, ldw, bias, out, ldo);
+  } else if (cols == 2) {
+    GemvMicroKernel<rows, 2>(k, x, ldx, w, ldw, bias, out, ldo);
+  } else if (cols == 1) {
+    GemvMicroKernel<rows, 1>(k, x, ldx, w, ldw, bias, out, ldo);
+  } else {
+    UNIMPLEMENTED();
+  }
+}
+
+void DispatchGemvMicroKernel(int64_t rows, int64_t cols, int64_t k, const float* x, int64_t ldx,
+                             const float* w, int64_t ldw, const float* bias, float* out,
+                             int64_t ldo) {
+  static_assert(kRowBlock == 4, "");
+  if (rows == 4) {
+    DispatchGemvMicroKernelCols<4>(cols, k, x, ldx, w, ldw, bias, out, ldo);
+  } else if (rows == 3) {
+    DispatchGemvMicroKernelCols<3>(cols, k, x, ldx, w, ldw, bias, out, ldo);
+  } else if (rows == 2) {
+    DispatchGemvMicroKernelCols<2>(cols, k, x, ldx, w, ldw, bias, out, ldo);
+  } else if (rows == 1) {
+    DispatchGemvMicroKernelCols<1>(cols, k, x, ldx, w, ldw, bias, out, ldo);
+  } else {
+    UNIMPLEMENTED();
+  }
+}
+
+template<typename U, int num_bits, bool symmetric>
+void QuantizedGemv(ep::CpuStream* stream, int64_t m, int64_t n, int64_t k, int64_t group_dim,
+                   int64_t group_size, const float* x, const U* w, const float* scale,
+                   const float* zero, const float* bias, float* out) {
+  const int64_t num_col_blocks = RoundUp(n, kColBlock) / kColBlock;
+  // Every task dequantizes its own columns once and reuses them for all rows of x, so the
+  // quantized weight is read exactly once in total.
+  stream->ParallelFor(
+      0, num_col_blocks,
+      [&](int64_t begin, int64_t end) {
+        std::vector<float> w_buf(kColBlock * k);
+        for (int64_t col_block = begin; col_block < end; ++col_block) {
+          const int64_t n_begin = col_block * kColBlock;
+          const int64_t cols = std::min(kColBlock, n - n_begin);
+          DequantizeWeightRows<U, num_bits, symmetric>(n_begin, n_begin + cols, k, group_dim,
+                                                       group_size, w, scale, zero, w_buf.data());
+          for (int64_t m_begin = 0; m_begin < m; m_begin += kRowBlock) {
+            const int64_t rows = std::min(kRowBlock, m - m_begin);
+            DispatchGemvMicroKernel(rows, cols, k, x + m_begin * k, k, w_buf.data(), k,
+                                    bias == nullptr ? nullptr : bias + n_begin,
+                                    out + m_begin * n + n_begin, n);
+          }
+        }
+      },
+      1);
+}
+
+template<typename U, int num_bits, bool symmetric>
+void QuantizedGemm(ep::CpuStream* stream, int64_t m, int64_t n, int64_t k, int64_t group_dim,
+                   int64_t group_size, const float* x, const U* w, const float* scale,
+                   const float* zero, const float* bias, float* out, float* w_buf) {
+  stream->ParallelFor(
+      0, n,
+      [&](int64_t begin, int64_t end) {
+        DequantizeWeightRows<U, num_bits, symmetric>(begin, end, k, group_dim, group_size, w,
+                                                     scale, zero, w_buf + begin * k);
+      },
+      1);
+  auto matmul = ep::primitive::NewPrimitive<ep::primitive::MatmulFactory>(
+      DeviceType::kCPU, DataType::kFloat, ep::primitive::BlasTransposeType::N,
+      ep::primitive::BlasTransposeType::T);
+  CHECK(matmul);
+  matmul->Launch(stream, m, n, k, 1.0, x, w_buf, 0.0, out);
+  if (bias != nullptr) {
+    stream->ParallelFor(0, m, [&](int64_t begin, int64_t end) {
+      for (int64_t i = begin; i < end; ++i) {
+        for (int64_t j = 0; j < n; ++j) { out[i * n + j] += bias[j]; }
+      }
+    });
+  }
+}
+
+template<typename U, int num_bits, bool symmetric>
+void QuantizedMatmulBias(ep::CpuStream* stream, int64_t m, int64_t n, int64_t k,
+                         int64_t group_dim, int64_t group_size, const float* x, const U* w,
+                         const float* scale, const float* zero, const float* bias, float* out,
+                         float* w_buf) {
+  if (m <= kGemvMaxRows) {
+    QuantizedGemv<U, num_bits, symmetric>(stream, m, n, k, group_dim, group_size, x, w, scale,
+                                          zero, bias, out);
+  } else {
+    QuantizedGemm<U, num_bits, symmetric>(stream, m, n, k, group_dim, group_size, x, w, scale,
+                                          zero, bias, out, w_buf);
+  }
+}
+
+template<typename U>
+void DispatchQuantizedMatmulBias(ep::CpuStream* stream, int num_bits, bool symmetric, int64_t m,
+                                 int64_t n, int64_t k, int64_t group_dim, int64_t group_size,
+                                 const float* x, const U* w, const float* scale,
+                                 const float* zero, const float* bias, float* out,
+                                 float* w_buf) {
+  if (num_bits == 4) {
+    if (symmetric) {
+      QuantizedMatmulBias<U, 4, true>(stream, m, n, k, group_dim, group_size, x, w, scale, zero,
+                                      bias, out, w_buf);
+    } else {
+      QuantizedMatmulBias<U, 4, false>(stream, m, n, k, group_dim, group_size, x, w, scale, zero,
+                                       bias, out, w_buf);
+    }
+  } else if (num_bits == 8) {
+    if (symmetric) {
+      QuantizedMatmulBias<U, 8, true>(stream, m, n, k, group_dim, group_size, x, w, scale, zero,
+                                      bias, out, w_buf);
+    } else {
+      QuantizedMatmulBias<U, 8, false>(stream, m, n, k, group_dim, group_size, x, w, scale, zero,
+                                       bias, out, w_buf);
+    }
+  } else {
+    UNIMPLEMENTED();
+  }
+}
+
+class FusedLinearWithGroupwiseQuantizedWeightCpuKernel final : public user_op::OpKernel {
+ public:
+  FusedLinearWithGroupwiseQuantizedWeightCpuKernel() = default;
+  ~FusedLinearWithGroupwiseQuantizedWeightCpuKernel() override = default;
+
+ private:
+  using user_op::OpKernel::Compute;
+  void Compute(user_op::KernelComputeContext* ctx) const override {
+    const user_op::Tensor* x = ctx->Tensor4ArgNameAndIndex("x", 0);
+    const user_op::Tensor* w = ctx->Tensor4ArgNameAndIndex("w", 0);
+    const user_op::Tensor* w_scale = ctx->Tensor4ArgNameAndIndex("w_scale", 0);
+    const user_op::Tensor* b =
+        (ctx->has_input("b", 0)) ? ctx->Tensor4ArgNameAndIndex("b", 0) : nullptr;
+    const user_op::Tensor* w_zero =
+        (ctx->has_input("w_zero", 0)) ? ctx->Tensor4ArgNameAndIndex("w_zero", 0) : nullptr;
+    user_op::Tensor* out = ctx->Tensor4ArgNameAndIndex("out", 0);
+    const int64_t group_size = ctx->Attr<int64_t>("group_size");
+    const int64_t group_dim = ctx->Attr<int64_t>("group_dim");
+    CHECK(group_dim == 0 || group_dim == 1);
+    const int32_t num_bits = ctx->Attr<int32_t>("num_bits");
+    const bool symmetric = ctx->Attr<bool>("symmetric");
+    CHECK_GE(x->shape_view().NumAxes(), 2);
+    const int64_t k = x->shape_view().At(x->shape_view().NumAxes() - 1);
+    const int64_t m = x->shape_view().elem_cnt() / k;
+    CHECK_EQ(w->shape_view().NumAxes(), 2);
+    const int64_t n = w->shape_view().At(0);
+    if (symmetric) {
+      CHECK(w_zero == nullptr);
+    } else {
+      CHECK(w_zero != nullptr);
+    }
+    float* w_buf = nullptr;
+    if (m > kGemvMaxRows) {
+      user_op::Tensor* tmp_buffer = ctx->Tensor4ArgNameAndIndex("tmp_buffer", 0);
+      CHECK_GE(tmp_buffer->shape_view().elem_cnt(), n * k * sizeof(float));
+      w_buf = tmp_buffer->mut_dptr<float>();
+    }
+    auto* stream = ctx->stream()->As<ep::CpuStream>();
+    const DataType quant_type = w->data_type();
+    if (quant_type == DataType::kUInt8) {
+      DispatchQuantizedMatmulBias<uint8_t>(
+          stream, num_bits, symmetric, m, n, k, group_dim, group_size, x->dptr<float>(),
+          w->dptr<uint8_t>(), w_scale->dptr<float>(),
+          w_zero == nullptr ? nullptr : w_zero->dptr<float>(),
+          b == nullptr ? nullptr : b->dptr<float>(), out->mut_dptr<float>(), w_buf);
+    } else if (quant_type == DataType::kInt8) {
+      DispatchQuantizedMatmulBias<int8_t>(
+          stream, num_bits, symmetric, m, n, k, group_dim, group_size, x->dptr<float>(),
+          w->dptr<int8_t>(), w_scale->dptr<float>(),
+          w_zero == nullptr ? nullptr : w_zero->dptr<float>(),
+          b == nullptr ? nullptr : b->dptr<float>(), out->mut_dptr<float>(), w_buf);
+    } else {
+      UNIMPLEMENTED();
+    }
+  }
+
+  bool AlwaysComputeWhenAllOutputsEmpty() const override { return false; }
+};
+
+REGISTER_USER_KERNEL("fused_linear_with_groupwise_quantized_weight")
+    .SetCreateFn<FusedLinearWithGroupwiseQuantizedWeightCpuKernel>()
+    .SetIsMatchedHob((user_op::HobDeviceType() == DeviceType::kCPU)
+                     && (user_op::HobDataType("out", 0) == DataType::kFloat))
+    .SetInferTmpSizeFn([](user_op::InferContext* ctx) -> size_t {
+      const Shape& x_shape = ctx->InputTensorDesc("x", 0).shape();
+      const int64_t k = x_shape.At(x_shape.NumAxes() - 1);
+      if (x_shape.elem_cnt() / k <= kGemvMaxRows) { return 0; }
+      const int64_t n = ctx->InputTensorDesc("w", 0).shape().At(0);
+      return n * k * sizeof(float);
+    });
+
+}  // namespace
+
+}  // namespace oneflow
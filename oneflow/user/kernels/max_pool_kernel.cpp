@@ -14,6 +14,7 @@ See the License for the specific language governing permissions and
 limitations under the License.
 */
 #include "oneflow/user/kernels/max_pool_kernel_util.h"
+#include "oneflow/core/ep/cpu/cpu_stream.h"
 
 namespace oneflow {
 
@@ -42,55 +43,103 @@ std::shared_ptr<PoolOpKernelCache> CreatePoolOpKernelCache(user_op::KernelCacheC
 
 namespace {
 
-template<typename T, typename IDX>
-void Maxpool2dForwardComputeCLast(const NdIndexOffsetHelper<IDX, 4>& index_helper, IDX elem_num,
-                                  const T* src, T* dest, int64_t* indice_ptr,
+// Number of output elements computed by one parallel task.
+constexpr int64_t kPoolParallelGrain = 32768;
+// Channels owned by one parallel task in the channels last backward.
+constexpr int64_t kPoolChannelBlockSize = 64;
+
+// Channels first pooling only reads and writes within a single (n, c) plane, so planes are split
+// among threads. In the backward this also makes every thread the only writer of its dx planes.
+template<typename F>
+void ParallelForPlanes(ep::Stream* stream, int64_t elem_num, int64_t plane_size, const F& f) {
+  if (elem_num == 0 || plane_size == 0) { return; }
+  const int64_t grain = std::max<int64_t>(kPoolParallelGrain / plane_size, 1);
+  stream->As<ep::CpuStream>()->ParallelFor(0, elem_num / plane_size, f, grain);
+}
+
+// Scans each window once for all channels of an output pixel, the innermost loop runs over the
+// contiguous channels and is vectorized.
+template<typename T>
+void Maxpool2dForwardComputeCLast(ep::Stream* stream, const T* src, T* dest, int64_t* indice_ptr,
                                   const int32_t padding_h, const int32_t padding_w,
-                                  const int32_t n_batch, const int32_t n_channel,
-                                  const int32_t x_height, const int32_t x_width,
-                                  const int32_t y_height, const int32_t y_width,
+                                  const int64_t n_batch, const int64_t n_channel,
+                                  const int64_t x_height, const int64_t x_width,
+                                  const int64_t y_height, const int64_t y_width,
                                   const int32_t kernel_size_h, const int32_t kernel_size_w,
                                   const int32_t stride_h, const int32_t stride_w,
                                   const int32_t dilation_h, const int32_t dilation_w) {
-  IDX n = 0, h = 0, w = 0, c = 0;
-  for (IDX num = 0; num < elem_num; ++num) {
-    index_helper.OffsetToNdIndex(num, n, h, w, c);
-
-    const IDX x_start_idx = n * x_height * x_width * n_channel;
-    const IDX y_start_idx = n * y_height * y_width * n_channel;
-    IDX hstart = h * stride_h - padding_h;
-    IDX wstart = w * stride_w - padding_w;
-    const IDX hend = (hstart + (kernel_size_h - 1) * dilation_h + 1) <= x_height
-                         ? (hstart + (kernel_size_h - 1) * dilation_h + 1)
-                         : x_height;
-    const IDX wend = (wstart + (kernel_size_w - 1) * dilation_w + 1) <= x_width
-                         ? (wstart + (kernel_size_w - 1) * dilation_w + 1)
-                         : x_width;
-
-    while (hstart < 0) { hstart += dilation_h; }
-    while (wstart < 0) { wstart += dilation_w; }
-    /* compute max value(src[src_idx]) in kernel box region, and save the value to dest[num] */
-    IDX max_index = hstart * x_width + wstart;
-    IDX src_idx = 0;
-    /* equal to -std::numeric_limits<T>::infinity(); */
-    T max_value = detail::numeric_limits<T>::lower_bound();
-
-    for (IDX i = hstart; i < hend; i += dilation_h) {
-      for (IDX j = wstart; j < wend; j += dilation_w) {
-        const IDX window_idx = i * x_width * n_channel + j * n_channel + c;
-        const IDX search_idx = x_start_idx + window_idx;
-        T val = src[search_idx];
-        if (val > max_value || detail::numerics<T>::isnan(val)) {
-          max_value = val;
-          max_index = window_idx;
-          src_idx = search_idx;
+  const int64_t row_size = y_width * n_channel;
+  stream->As<ep::CpuStream>()->ParallelFor(
+      0, n_batch * y_height,
+      [&](int64_t begin, int64_t end) {
+        for (int64_t row = begin; row < end; ++row) {
+          const int64_t n = row / y_height;
+          const int64_t h = row % y_height;
+          const T* x = src + n * x_height * x_width * n_channel;
+          int64_t hstart = h * stride_h - padding_h;
+          const int64_t hend =
+              std::min<int64_t>(hstart + (kernel_size_h - 1) * dilation_h + 1, x_height);
+          while (hstart < 0) { hstart += dilation_h; }
+          for (int64_t w = 0; w < y_width; ++w) {
+            int64_t wstart = w * stride_w - padding_w;
+            const int64_t wend =
+                std::min<int64_t>(wstart + (kernel_size_w - 1) * dilation_w + 1, x_width);
+            while (wstart < 0) { wstart += dilation_w; }
+            T* y = dest + row * row_size + w * n_channel;
+            int64_t* indice = indice_ptr + row * row_size + w * n_channel;
+            const int64_t first_window_idx = (hstart * x_width + wstart) * n_channel;
+            for (int64_t c = 0; c < n_channel; ++c) {
+              /* equal to -std::numeric_limits<T>::infinity(); */
+              y[c] = detail::numeric_limits<T>::lower_bound();
+              indice[c] = first_window_idx + c;
+            }
+            for (int64_t i = hstart; i < hend; i += dilation_h) {
+              for (int64_t j = wstart; j < wend; j += dilation_w) {
+                const int64_t window_idx = (i * x_width + j) * n_channel;
+                const T* data = x + window_idx;
+                for (int64_t c = 0; c < n_channel; ++c) {
+                  const T val = data[c];
+                  if (val > y[c] || detail::numerics<T>::isnan(val)) {
+                    y[c] = val;
+                    indice[c] = window_idx + c;
+                  }
+                }
+              }
+            }
+          }
         }
-      }
-    }
-    const IDX out_idx = y_start_idx + h * y_width * n_channel + w * n_channel + c;
-    dest[out_idx] = src[src_idx];
-    indice_ptr[out_idx] = max_index;
-  }
+      },
+      std::max<int64_t>(kPoolParallelGrain / std::max<int64_t>(row_size, 1), 1));
+}
+
+// The indices of a channels last max pooling address dx within the same batch and channel, so
+// each task owns a block of channels of one sample and never races with other tasks.
+template<typename T>
+void Maxpool2dBackwardComputeCLast(ep::Stream* stream, const T* src, T* dest,
+                                   const int64_t* indice_ptr, const int64_t n_batch,
+                                   const int64_t n_channel, const int64_t src_plane_size,
+                                   const int64_t dst_plane_size) {
+  const int64_t num_channel_blocks =
+      (n_channel + kPoolChannelBlockSize - 1) / kPoolChannelBlockSize;
+  stream->As<ep::CpuStream>()->ParallelFor(
+      0, n_batch * num_channel_blocks,
+      [&](int64_t begin, int64_t end) {
+        for (int64_t task = begin; task < end; ++task) {
+          const int64_t n = task / num_channel_blocks;
+          const int64_t c_begin = (task % num_channel_blocks) * kPoolChannelBlockSize;
+          const int64_t c_end = std::min(c_begin + kPoolChannelBlockSize, n_channel);
+          const T* dy = src + n * src_plane_size * n_channel;
+          const int64_t* indice = indice_ptr + n * src_plane_size * n_channel;
+          T* dx = dest + n * dst_plane_size * n_channel;
+          for (int64_t i = 0; i < src_plane_size; ++i) {
+            for (int64_t c = c_begin; c < c_end; ++c) {
+              const int64_t offset = i * n_channel + c;
+              dx[indice[offset]] += dy[offset];
+            }
+          }
+        }
+      },
+      1);
 }
 
 }  // namespace
@@ -100,50 +149,73 @@ struct PoolKernelUtil<DeviceType::kCPU, T, IDX> {
   static void Maxpool1dForward(ep::Stream* stream, const NdIndexOffsetHelper<IDX, 2>& index_helper,
                                const IDX elem_num, const T* src, T* dest, int64_t* indice_ptr,
                                const MaxPoolParams3D& params_3d) {
-    Maxpool1dForwardCompute<T, IDX>(
-        index_helper, elem_num, src, dest, indice_ptr, params_3d.padding()[2],
-        params_3d.num_batch(), params_3d.num_channel(), params_3d.GetXShape5D().At(4),
-        params_3d.pool_size_3d()[2], params_3d.stride_3d()[2], params_3d.dilation_3d()[2]);
+    const int64_t x_plane_size = params_3d.GetXShape5D().Count(2);
+    const int64_t y_plane_size = params_3d.GetYShape5D().Count(2);
+    ParallelForPlanes(stream, elem_num, y_plane_size, [&](int64_t begin, int64_t end) {
+      Maxpool1dForwardCompute<T, IDX>(
+          index_helper, (end - begin) * y_plane_size, src + begin * x_plane_size,
+          dest + begin * y_plane_size, indice_ptr + begin * y_plane_size,
+          params_3d.padding()[2], params_3d.num_batch(), params_3d.num_channel(),
+          params_3d.GetXShape5D().At(4), params_3d.pool_size_3d()[2], params_3d.stride_3d()[2],
+          params_3d.dilation_3d()[2]);
+    });
   }
 
   static void Maxpool1dBackward(ep::Stream* stream, const NdIndexOffsetHelper<IDX, 2>& index_helper,
                                 const IDX elem_num, const T* src, T* dest,
                                 const int64_t* indice_ptr, const MaxPoolParams3D& params_3d) {
-    Maxpool1dBackwardCompute<T, IDX>(index_helper, elem_num, src, dest, indice_ptr,
-                                     params_3d.num_batch(), params_3d.num_channel(),
-                                     params_3d.GetYShape5D().At(4), params_3d.GetXShape5D().At(4));
+    const int64_t x_plane_size = params_3d.GetXShape5D().Count(2);
+    const int64_t y_plane_size = params_3d.GetYShape5D().Count(2);
+    ParallelForPlanes(stream, elem_num, y_plane_size, [&](int64_t begin, int64_t end) {
+      Maxpool1dBackwardCompute<T, IDX>(
+          index_helper, (end - begin) * y_plane_size, src + begin * y_plane_size,
+          dest + begin * x_plane_size, indice_ptr + begin * y_plane_size,
+          params_3d.num_batch(), params_3d.num_channel(), params_3d.GetYShape5D().At(4),
+          params_3d.GetXShape5D().At(4));
+    });
   }
 
   static void Maxpool2dForwardCFirst(ep::Stream* stream,
                                      const NdIndexOffsetHelper<IDX, 3>& index_helper,
                                      const IDX elem_num, const T* src, T* dest, int64_t* indice_ptr,
                                      const MaxPoolParams3D& params_3d) {
-    Maxpool2dForwardComputeCFirst<T, IDX>(
-        index_helper, elem_num, src, dest, indice_ptr, params_3d.padding()[1],
-        params_3d.padding()[2], params_3d.num_batch(), params_3d.num_channel(),
-        params_3d.GetXShape5D().At(3), params_3d.GetXShape5D().At(4), params_3d.pool_size_3d()[1],
-        params_3d.pool_size_3d()[2], params_3d.stride_3d()[1], params_3d.stride_3d()[2],
-        params_3d.dilation_3d()[1], params_3d.dilation_3d()[2]);
+    const int64_t x_plane_size = params_3d.GetXShape5D().Count(2);
+    const int64_t y_plane_size = params_3d.GetYShape5D().Count(2);
+    ParallelForPlanes(stream, elem_num, y_plane_size, [&](int64_t begin, int64_t end) {
+      Maxpool2dForwardComputeCFirst<T, IDX>(
+          index_helper, (end - begin) * y_plane_size, src + begin * x_plane_size,
+          dest + begin * y_plane_size, indice_ptr + begin * y_plane_size,
+          params_3d.padding()[1], params_3d.padding()[2], params_3d.num_batch(),
+          params_3d.num_channel(), params_3d.GetXShape5D().At(3), params_3d.GetXShape5D().At(4),
+          params_3d.pool_size_3d()[1], params_3d.pool_size_3d()[2], params_3d.stride_3d()[1],
+          params_3d.stride_3d()[2], params_3d.dilation_3d()[1], params_3d.dilation_3d()[2]);
+    });
   }
 
   static void Maxpool2dBackwardCFirst(ep::Stream* stream,
                                       const NdIndexOffsetHelper<IDX, 3>& index_helper,
                                       const IDX elem_num, const T* src, T* dest,
                                       const int64_t* indice_ptr, const MaxPoolParams3D& params_3d) {
-    Maxpool2dBackwardComputeCFirst<T, IDX>(
-        index_helper, elem_num, src, dest, indice_ptr, params_3d.num_batch(),
-        params_3d.num_channel(), params_3d.GetYShape5D().At(3), params_3d.GetYShape5D().At(4),
-        params_3d.GetXShape5D().At(3), params_3d.GetXShape5D().At(4));
+    const int64_t x_plane_size = params_3d.GetXShape5D().Count(2);
+    const int64_t y_plane_size = params_3d.GetYShape5D().Count(2);
+    ParallelForPlanes(stream, elem_num, y_plane_size, [&](int64_t begin, int64_t end) {
+      Maxpool2dBackwardComputeCFirst<T, IDX>(
+          index_helper, (end - begin) * y_plane_size, src + begin * y_plane_size,
+          dest + begin * x_plane_size, indice_ptr + begin * y_plane_size,
+          params_3d.num_batch(), params_3d.num_channel(), params_3d.GetYShape5D().At(3),
+          params_3d.GetYShape5D().At(4), params_3d.GetXShape5D().At(3),
+          params_3d.GetXShape5D().At(4));
+    });
   }
 
   static void Maxpool2dForwardCLast(ep::Stream* stream,
                                     const NdIndexOffsetHelper<IDX, 4>& index_helper,
                                     const IDX elem_num, const T* src, T* dest, int64_t* indice_ptr,
                                     const MaxPoolParams3D& params_3d) {
-    Maxpool2dForwardComputeCLast<T, IDX>(
-        index_helper, elem_num, src, dest, indice_ptr, params_3d.padding()[1],
-        params_3d.padding()[2], params_3d.num_batch(), params_3d.num_channel(),
-        params_3d.GetXShape5D().At(3), params_3d.GetXShape5D().At(4), params_3d.GetYShape5D().At(3),
+    Maxpool2dForwardComputeCLast<T>(
+        stream, src, dest, indice_ptr, params_3d.padding()[1], params_3d.padding()[2],
+        params_3d.num_batch(), params_3d.num_channel(), params_3d.GetXShape5D().At(3),
+        params_3d.GetXShape5D().At(4), params_3d.GetYShape5D().At(3),
         params_3d.GetYShape5D().At(4), params_3d.pool_size_3d()[1], params_3d.pool_size_3d()[2],
         params_3d.stride_3d()[1], params_3d.stride_3d()[2], params_3d.dilation_3d()[1],
         params_3d.dilation_3d()[2]);
@@ -153,33 +225,42 @@ struct PoolKernelUtil<DeviceType::kCPU, T, IDX> {
                                      const NdIndexOffsetHelper<IDX, 4>& index_helper,
                                      const IDX elem_num, const T* src, T* dest,
                                      const int64_t* indice_ptr, const MaxPoolParams3D& params_3d) {
-    Maxpool2dBackwardComputeCLast<T, IDX>(
-        index_helper, elem_num, src, dest, indice_ptr, params_3d.num_batch(),
-        params_3d.num_channel(), params_3d.GetYShape5D().At(3), params_3d.GetYShape5D().At(4),
-        params_3d.GetXShape5D().At(3), params_3d.GetXShape5D().At(4));
+    Maxpool2dBackwardComputeCLast<T>(stream, src, dest, indice_ptr, params_3d.num_batch(),
+                                     params_3d.num_channel(), params_3d.GetYShape5D().Count(2),
+                                     params_3d.GetXShape5D().Count(2));
   }
 
   static void Maxpool3dForward(ep::Stream* stream, const NdIndexOffsetHelper<IDX, 4>& index_helper,
                                const IDX elem_num, const T* src, T* dest, int64_t* indice_ptr,
                                const MaxPoolParams3D& params_3d) {
-    Maxpool3dForwardCompute<T, IDX>(
-        index_helper, elem_num, src, dest, indice_ptr, params_3d.padding()[0],
-        params_3d.padding()[1], params_3d.padding()[2], params_3d.num_batch(),
-        params_3d.num_channel(), params_3d.GetXShape5D().At(2), params_3d.GetXShape5D().At(3),
-        params_3d.GetXShape5D().At(4), params_3d.pool_size_3d()[0], params_3d.pool_size_3d()[1],
-        params_3d.pool_size_3d()[2], params_3d.stride_3d()[0], params_3d.stride_3d()[1],
-        params_3d.stride_3d()[2], params_3d.dilation_3d()[0], params_3d.dilation_3d()[1],
-        params_3d.dilation_3d()[2]);
+    const int64_t x_plane_size = params_3d.GetXShape5D().Count(2);
+    const int64_t y_plane_size = params_3d.GetYShape5D().Count(2);
+    ParallelForPlanes(stream, elem_num, y_plane_size, [&](int64_t begin, int64_t end) {
+      Maxpool3dForwardCompute<T, IDX>(
+          index_helper, (end - begin) * y_plane_size, src + begin * x_plane_size,
+          dest + begin * y_plane_size, indice_ptr + begin * y_plane_size,
+          params_3d.padding()[0], params_3d.padding()[1], params_3d.padding()[2],
+          params_3d.num_batch(), params_3d.num_channel(), params_3d.GetXShape5D().At(2),
+          params_3d.GetXShape5D().At(3), params_3d.GetXShape5D().At(4),
+          params_3d.pool_size_3d()[0], params_3d.pool_size_3d()[1], params_3d.pool_size_3d()[2],
+          params_3d.stride_3d()[0], params_3d.stride_3d()[1], params_3d.stride_3d()[2],
+          params_3d.dilation_3d()[0], params_3d.dilation_3d()[1], params_3d.dilation_3d()[2]);
+    });
   }
 
   static void Maxpool3dBackward(ep::Stream* stream, const NdIndexOffsetHelper<IDX, 4> index_helper,
                                 const IDX elem_num, const T* src, T* dest,
                                 const int64_t* indice_ptr, const MaxPoolParams3D& params_3d) {
-    Maxpool3dBackwardCompute<T, IDX>(index_helper, elem_num, src, dest, indice_ptr,
-                                     params_3d.num_batch(), params_3d.num_channel(),
-                                     params_3d.GetYShape5D().At(2), params_3d.GetYShape5D().At(3),
-                                     params_3d.GetYShape5D().At(4), params_3d.GetXShape5D().At(2),
-                                     params_3d.GetXShape5D().At(3), params_3d.GetXShape5D().At(4));
+    const int64_t x_plane_size = params_3d.GetXShape5D().Count(2);
+    const int64_t y_plane_size = params_3d.GetYShape5D().Count(2);
+    ParallelForPlanes(stream, elem_num, y_plane_size, [&](int64_t begin, int64_t end) {
+      Maxpool3dBackwardCompute<T, IDX>(
+          index_helper, (end - begin) * y_plane_size, src + begin * y_plane_size,
+          dest + begin * x_plane_size, indice_ptr + begin * y_plane_size, params_3d.num_batch(),
+          params_3d.num_channel(), params_3d.GetYShape5D().At(2), params_3d.GetYShape5D().At(3),
+          params_3d.GetYShape5D().At(4), params_3d.GetXShape5D().At(2),
+          params_3d.GetXShape5D().At(3), params_3d.GetXShape5D().At(4));
+    });
   }
 };
 
@@ -14,15 +14,69 @@ See the License for the specific language governing permissions and
 limitations under the License.
 */
 #include "oneflow/user/kernels/nd_index_slice_kernels.h"
+#include "oneflow/core/ep/cpu/cpu_stream.h"
 
 namespace oneflow {
 
+namespace {
+
+constexpr int64_t kSliceParallelGrain = 32768;
+constexpr int64_t kSliceColBlockSize = 4096;
+
+template<typename I>
+int64_t SliceOffsetInDense(const NdIndexSliceArgs& args, const I* indices, int64_t slice_idx) {
+  return OffsetInSliceToOffsetInDense(args.slice_size, args.index_ndims, args.dense_shape, indices,
+                                      slice_idx * args.slice_size);
+}
+
+// Applies `f(slice_idx, dense_offset, col_begin, col_end)` to every slice. Slices may alias each
+// other in dense, so instead of splitting slices between threads every task owns a block of
+// columns of all slices and visits the slices in order, which keeps the writes race free and the
+// result of duplicated indices the same as a serial loop.
+template<typename I, typename F>
+void ForEachSliceColBlock(ep::Stream* stream, const NdIndexSliceArgs& args, const I* indices,
+                          const F& f) {
+  const int64_t num_slices = args.num_slices;
+  const int64_t slice_size = args.slice_size;
+  if (num_slices == 0 || slice_size == 0) { return; }
+  auto* cpu_stream = stream->As<ep::CpuStream>();
+  std::vector<int64_t> dense_offsets(num_slices);
+  cpu_stream->ParallelFor(
+      0, num_slices,
+      [&](int64_t begin, int64_t end) {
+        for (int64_t i = begin; i < end; ++i) {
+          dense_offsets[i] = SliceOffsetInDense(args, indices, i);
+        }
+      },
+      kSliceParallelGrain);
+  const int64_t num_col_blocks = (slice_size + kSliceColBlockSize - 1) / kSliceColBlockSize;
+  cpu_stream->ParallelFor(
+      0, num_col_blocks,
+      [&](int64_t begin, int64_t end) {
+        const int64_t col_begin = begin * kSliceColBlockSize;
+        const int64_t col_end = std::min(end * kSliceColBlockSize, slice_size);
+        for (int64_t i = 0; i < num_slices; ++i) { f(i, dense_offsets[i], col_begin, col_end); }
+      },
+      1);
+}
+
+}  // namespace
+
 template<typename T, typename I>
 struct GatherNdFunctor<DeviceType::kCPU, T, I> final {
   void operator()(ep::Stream* stream, const NdIndexSliceArgs& args, const I* indices,
                   const T* dense, T* slices) const {
-    DoGatherNd(args.num_slices * args.slice_size, args.slice_size, args.index_ndims,
-               args.dense_shape, indices, dense, slices);
+    const int64_t slice_size = args.slice_size;
+    if (slice_size == 0) { return; }
+    stream->As<ep::CpuStream>()->ParallelFor(
+        0, args.num_slices,
+        [&](int64_t begin, int64_t end) {
+          for (int64_t i = begin; i < end; ++i) {
+            const int64_t dense_offset = SliceOffsetInDense(args, indices, i);
+            std::memcpy(slices + i * slice_size, dense + dense_offset, slice_size * sizeof(T));
+          }
+        },
+        std::max<int64_t>(kSliceParallelGrain / slice_size, 1));
   }
 };
 
@@ -30,8 +84,15 @@ template<typename T, typename I>
 struct ScatterNdAddFunctor<DeviceType::kCPU, T, I> final {
   void operator()(ep::Stream* stream, const NdIndexSliceArgs& args, const I* indices,
                   const T* slices, T* dense) const {
-    DoScatterNdAdd<DeviceType::kCPU>(args.num_slices * args.slice_size, args.slice_size,
-                                     args.index_ndims, args.dense_shape, indices, slices, dense);
+    const int64_t slice_size = args.slice_size;
+    ForEachSliceColBlock(stream, args, indices,
+                         [&](int64_t i, int64_t dense_offset, int64_t col_begin, int64_t col_end) {
+                           const T* src = slices + i * slice_size;
+                           T* dst = dense + dense_offset;
+                           for (int64_t j = col_begin; j < col_end; ++j) {
+                             DeviceAdd<DeviceType::kCPU, T>::Invoke(src + j, dst + j);
+                           }
+                         });
   }
 };
 
@@ -39,8 +100,13 @@ template<typename T, typename I>
 struct ScatterNdUpdateFunctor<DeviceType::kCPU, T, I> final {
   void operator()(ep::Stream* stream, const NdIndexSliceArgs& args, const I* indices,
                   const T* slices, T* dense) const {
-    DoScatterNdUpdate<DeviceType::kCPU>(args.num_slices * args.slice_size, args.slice_size,
-                                        args.index_ndims, args.dense_shape, indices, slices, dense);
+    const int64_t slice_size = args.slice_size;
+    ForEachSliceColBlock(stream, args, indices,
+                         [&](int64_t i, int64_t dense_offset, int64_t col_begin, int64_t col_end) {
+                           std::memcpy(dense + dense_offset + col_begin,
+                                       slices + i * slice_size + col_begin,
+                                       (col_end - col_begin) * sizeof(T));
+                         });
   }
 };
 
@@ -57,8 +123,11 @@ template<typename T, typename I>
 struct FillByNdIndexFunctor<DeviceType::kCPU, T, I> final {
   void operator()(ep::Stream* stream, const NdIndexSliceArgs& args, const I* indices, T* dense,
                   T value) const {
-    DoFillByNdIndex(args.num_slices * args.slice_size, args.slice_size, args.index_ndims,
-                    args.dense_shape, indices, dense, value);
+    ForEachSliceColBlock(stream, args, indices,
+                         [&](int64_t i, int64_t dense_offset, int64_t col_begin, int64_t col_end) {
+                           std::fill(dense + dense_offset + col_begin,
+                                     dense + dense_offset + col_end, value);
+                         });
   }
 };
 
@@ -26,6 +26,7 @@ limitations under the License.
 #include "oneflow/user/kernels/op_kernel_wrapper.h"
 #include "oneflow/user/kernels/random_seed_util.h"
 #include "oneflow/user/image/jpeg_decoder.h"
+#include "oneflow/user/data/ofrecord_feature_view.h"
 
 #include <opencv2/opencv.hpp>
 #include <jpeglib.h>
@@ -35,42 +36,31 @@ namespace oneflow {
 namespace {
 
 template<typename T>
-void DecodeOneRawOFRecord(const Feature& feature, T* dptr, int64_t sample_elem_cnt, bool truncate,
-                          bool dim1_varying_length) {
+void DecodeOneRawOFRecord(const data::OFRecordFeatureView& feature, T* dptr,
+                          int64_t sample_elem_cnt, bool truncate, bool dim1_varying_length) {
   if (feature.has_bytes_list()) {
-    CHECK_EQ(feature.bytes_list().value_size(), 1);
-    const auto& value0 = feature.bytes_list().value(0);
-    auto in_dptr = reinterpret_cast<const int8_t*>(value0.c_str());
-    sample_elem_cnt = std::min<int64_t>(sample_elem_cnt, value0.size());
+    CHECK_EQ(feature.value_size(), 1);
+    auto in_dptr = reinterpret_cast<const int8_t*>(feature.bytes_data());
+    sample_elem_cnt = std::min<int64_t>(sample_elem_cnt, feature.bytes_size());
     std::transform(in_dptr, in_dptr + sample_elem_cnt, dptr,
                    [](int8_t v) { return static_cast<T>(v); });
-  }
-#define DEFINE_ONE_ELIF(PbT, CppT)                                                       \
-  else if (feature.has_##PbT##_list()) {                                                 \
-    const auto& list = feature.PbT##_list();                                             \
-    const CppT* in_dptr = list.value().data();                                           \
-    const int64_t padding_elem_num = truncate ? sample_elem_cnt - list.value_size() : 0; \
-    if (truncate) {                                                                      \
-      sample_elem_cnt = std::min<int64_t>(sample_elem_cnt, list.value_size());           \
-    } else {                                                                             \
-      if (dim1_varying_length) {                                                         \
-        sample_elem_cnt = list.value_size();                                             \
-      } else {                                                                           \
-        CHECK_EQ(sample_elem_cnt, list.value_size());                                    \
-      }                                                                                  \
-    }                                                                                    \
-    std::transform(in_dptr, in_dptr + sample_elem_cnt, dptr,                             \
-                   [](CppT v) { return static_cast<T>(v); });                            \
-    if (padding_elem_num > 0) {                                                          \
-      std::memset(dptr + sample_elem_cnt, 0, padding_elem_num * sizeof(T));              \
-    }                                                                                    \
-  }
-  DEFINE_ONE_ELIF(float, float)
-  DEFINE_ONE_ELIF(double, double)
-  DEFINE_ONE_ELIF(int32, int32_t)
-  DEFINE_ONE_ELIF(int64, int64_t)
-#undef DEFINE_ONE_ELIF
-  else {
+  } else if (feature.has_numeric_list()) {
+    const int64_t value_size = feature.value_size();
+    const int64_t padding_elem_num = truncate ? sample_elem_cnt - value_size : 0;
+    if (truncate) {
+      sample_elem_cnt = std::min<int64_t>(sample_elem_cnt, value_size);
+    } else {
+      if (dim1_varying_length) {
+        sample_elem_cnt = value_size;
+      } else {
+        CHECK_EQ(sample_elem_cnt, value_size);
+      }
+    }
+    feature.CopyValues(dptr, sample_elem_cnt);
+    if (padding_elem_num > 0) {
+      std::memset(dptr + sample_elem_cnt, 0, padding_elem_num * sizeof(T));
+    }
+  } else {
     UNIMPLEMENTED();
   }
 }
@@ -101,9 +91,8 @@ class OFRecordRawDecoderKernel final : public user_op::OpKernel {
     MultiThreadLoop(record_num, [&](size_t i) {
       const OFRecord& record = *(records + i);
       T* dptr = out_dptr + i * sample_elem_cnt;
-      CHECK(record.feature().find(name) != record.feature().end())
-          << "Field " << name << " not found";
-      const Feature& feature = record.feature().at(name);
+      data::OFRecordFeatureView feature(record, name);
+      CHECK(feature.found()) << "Field " << name << " not found";
       DecodeOneRawOFRecord(feature, dptr, sample_elem_cnt, truncate, dim1_varying_length);
     });
   }
@@ -144,14 +133,13 @@ class OFRecordBytesDecoderKernel final : public user_op::OpKernel {
     MultiThreadLoop(num_instances, [&](size_t i) {
       const OFRecord& record = *(records + i);
       TensorBuffer* buffer = buffers + i;
-      auto it = record.feature().find(name);
-      CHECK(it != record.feature().end()) << "Field " << name << " not found";
-      const Feature& feature = it->second;
+      data::OFRecordFeatureView feature(record, name);
+      CHECK(feature.found()) << "Field " << name << " not found";
       CHECK(feature.has_bytes_list());
-      CHECK_EQ(feature.bytes_list().value_size(), 1);
-      const int64_t size = feature.bytes_list().value(0).size();
+      CHECK_EQ(feature.value_size(), 1);
+      const int64_t size = feature.bytes_size();
       buffer->Resize(Shape({size}), DataType::kUInt8);
-      memcpy(buffer->mut_data(), feature.bytes_list().value(0).data(), size);
+      memcpy(buffer->mut_data(), feature.bytes_data(), size);
     });
   }
   bool AlwaysComputeWhenAllOutputsEmpty() const override { return false; }
@@ -168,23 +156,22 @@ namespace {
 void DecodeRandomCropImageFromOneRecord(const OFRecord& record, TensorBuffer* buffer,
                                         const std::string& name, const std::string& color_space,
                                         RandomCropGenerator* random_crop_gen) {
-  CHECK(record.feature().find(name) != record.feature().end()) << "Field " << name << " not found";
-  const Feature& feature = record.feature().at(name);
+  data::OFRecordFeatureView feature(record, name);
+  CHECK(feature.found()) << "Field " << name << " not found";
   CHECK(feature.has_bytes_list());
-  CHECK(feature.bytes_list().value_size() == 1);
-  const std::string& src_data = feature.bytes_list().value(0);
+  CHECK(feature.value_size() == 1);
+  const auto* src_dptr = reinterpret_cast<const unsigned char*>(feature.bytes_data());
+  const size_t src_size = feature.bytes_size();
   cv::Mat image;
 
-  if (JpegPartialDecodeRandomCropImage(reinterpret_cast<const unsigned char*>(src_data.data()),
-                                       src_data.size(), random_crop_gen, nullptr, 0, &image)) {
+  if (JpegPartialDecodeRandomCropImage(src_dptr, src_size, random_crop_gen, nullptr, 0, &image)) {
     // convert color space
     // jpeg decode output RGB
     if (ImageUtil::IsColor(color_space) && color_space != "RGB") {
       ImageUtil::ConvertColor("RGB", image, color_space, image);
     }
   } else {
-    OpenCvPartialDecodeRandomCropImage(reinterpret_cast<const unsigned char*>(src_data.data()),
-                                       src_data.size(), random_crop_gen, color_space, image);
+    OpenCvPartialDecodeRandomCropImage(src_dptr, src_size, random_crop_gen, color_space, image);
     // convert color space
     // opencv decode output BGR
     if (ImageUtil::IsColor(color_space) && color_space != "BGR") {
@@ -280,4 +267,146 @@ REGISTER_USER_KERNEL("ofrecord_image_decoder")
                      && (user_op::HobDataType("in", 0) == DataType::kOFRecord)
                      && (user_op::HobDataType("out", 0) == DataType::kTensorBuffer));
 
+namespace {
+
+class DecodeRandomCropResizeNormalizeKernelState final : public user_op::OpKernelState {
+ public:
+  explicit DecodeRandomCropResizeNormalizeKernelState(user_op::KernelInitContext* ctx)
+      : crop_window_generators_(CreateRandomCropKernelState(ctx, "in")) {
+    const int64_t C = ImageUtil::IsColor(ctx->Attr<std::string>("color_space")) ? 3 : 1;
+    mean_vec_ = ctx->Attr<std::vector<float>>("mean");
+    const std::vector<float>& std_vec = ctx->Attr<std::vector<float>>("std");
+    CHECK(mean_vec_.size() == 1 || mean_vec_.size() == C);
+    CHECK(std_vec.size() == 1 || std_vec.size() == C);
+    for (float elem : std_vec) { inv_std_vec_.emplace_back(1.0f / elem); }
+    if (mean_vec_.size() == 1) { mean_vec_.resize(C, mean_vec_.at(0)); }
+    if (inv_std_vec_.size() == 1) { inv_std_vec_.resize(C, inv_std_vec_.at(0)); }
+  }
+  ~DecodeRandomCropResizeNormalizeKernelState() override = default;
+
+  RandomCropGenerator* GetGenerator(int32_t idx) {
+    return crop_window_generators_->GetGenerator(idx);
+  }
+  const std::vector<float>& mean_vec() const { return mean_vec_; }
+  const std::vector<float>& inv_std_vec() const { return inv_std_vec_; }
+
+ private:
+  std::shared_ptr<RandomCropKernelState> crop_window_generators_;
+  std::vector<float> mean_vec_;
+  std::vector<float> inv_std_vec_;
+};
+
+// Writes the HWC uint8 `image` as (x - mean) / std to `out_dptr` in CHW or HWC order, flipped
+// horizontally if `mirror` and with its channel order reversed (RGB <-> BGR) if `swap_channels`.
+void MirrorNormalizeImage(const cv::Mat& image, bool mirror, bool swap_channels,
+                          bool channels_first, const std::vector<float>& mean_vec,
+                          const std::vector<float>& inv_std_vec, float* out_dptr) {
+  CHECK(image.isContinuous());
+  const int64_t H = image.rows;
+  const int64_t W = image.cols;
+  const int64_t C = image.channels();
+  for (int64_t h = 0; h < H; ++h) {
+    const uint8_t* in_row = image.ptr<uint8_t>(h);
+    for (int64_t w = 0; w < W; ++w) {
+      const uint8_t* in_pixel = in_row + (mirror ? W - 1 - w : w) * C;
+      for (int64_t c = 0; c < C; ++c) {
+        const int64_t out_offset = channels_first ? (c * H + h) * W + w : (h * W + w) * C + c;
+        const uint8_t in_value = in_pixel[swap_channels ? C - 1 - c : c];
+        out_dptr[out_offset] = (static_cast<float>(in_value) - mean_vec[c]) * inv_std_vec[c];
+      }
+    }
+  }
+}
+
+void DecodeRandomCropResizeNormalizeFromOneRecord(
+    const OFRecord& record, const std::string& name, const std::string& color_space,
+    RandomCropGenerator* random_crop_gen, int64_t target_width, int64_t target_height,
+    const std::string& interpolation_type, bool mirror, bool channels_first,
+    const std::vector<float>& mean_vec, const std::vector<float>& inv_std_vec, float* out_dptr) {
+  data::OFRecordFeatureView feature(record, name);
+  CHECK(feature.found()) << "Field " << name << " not found";
+  CHECK(feature.has_bytes_list());
+  CHECK(feature.value_size() == 1);
+  const auto* src_dptr = reinterpret_cast<const unsigned char*>(feature.bytes_data());
+  const size_t src_size = feature.bytes_size();
+  const bool color = ImageUtil::IsColor(color_space);
+  cv::Mat image;
+  std::string decoded_color_space;
+  if (JpegPartialDecodeRandomCropScaledImage(src_dptr, src_size, random_crop_gen, color,
+                                             target_width, target_height, &image)) {
+    // jpeg decode output RGB
+    decoded_color_space = color ? "RGB" : "GRAY";
+  } else {
+    OpenCvPartialDecodeRandomCropImage(src_dptr, src_size, random_crop_gen, color_space, image);
+    // opencv decode output BGR
+    decoded_color_space = color ? "BGR" : "GRAY";
+  }
+  cv::Mat resized;
+  cv::resize(image, resized, cv::Size(target_width, target_height), 0, 0,
+             GetCvInterpolationFlag(interpolation_type, image.cols, image.rows, target_width,
+                                    target_height));
+  CHECK_EQ(resized.channels(), color ? 3 : 1);
+  // RGB <-> BGR is converted while normalizing
+  MirrorNormalizeImage(resized, mirror, decoded_color_space != color_space, channels_first,
+                       mean_vec, inv_std_vec, out_dptr);
+}
+
+}  // namespace
+
+// Decodes, randomly crops, resizes, mirrors and normalizes the images of a batch of OFRecords in a
+// single pass, which is equivalent to ofrecord_image_decoder_random_crop followed by
+// image_resize_to_fixed and crop_mirror_normalize_from_tensorbuffer. No intermediate image is
+// materialized and libjpeg downscales the crop window in the DCT domain while decoding it.
+class OFRecordImageDecoderRandomCropResizeNormalizeKernel final : public user_op::OpKernel {
+ public:
+  OFRecordImageDecoderRandomCropResizeNormalizeKernel() = default;
+  ~OFRecordImageDecoderRandomCropResizeNormalizeKernel() override = default;
+
+  std::shared_ptr<user_op::OpKernelState> CreateOpKernelState(
+      user_op::KernelInitContext* ctx) const override {
+    return std::make_shared<DecodeRandomCropResizeNormalizeKernelState>(ctx);
+  }
+
+ private:
+  void Compute(user_op::KernelComputeContext* ctx, user_op::OpKernelState* state,
+               const user_op::OpKernelCache*) const override {
+    auto* kernel_state = dynamic_cast<DecodeRandomCropResizeNormalizeKernelState*>(state);
+    CHECK_NOTNULL(kernel_state);
+    const user_op::Tensor* in_blob = ctx->Tensor4ArgNameAndIndex("in", 0);
+    const user_op::Tensor* mirror_blob = ctx->Tensor4ArgNameAndIndex("mirror", 0);
+    user_op::Tensor* out_blob = ctx->Tensor4ArgNameAndIndex("out", 0);
+    int64_t record_num = in_blob->shape_view().At(0);
+    CHECK(record_num > 0);
+    CHECK_EQ(out_blob->shape_view().At(0), record_num);
+    if (mirror_blob) { CHECK_EQ(mirror_blob->shape_view().elem_cnt(), record_num); }
+    const OFRecord* records = in_blob->dptr<OFRecord>();
+    const int8_t* mirror = mirror_blob ? mirror_blob->dptr<int8_t>() : nullptr;
+    float* out_dptr = out_blob->mut_dptr<float>();
+    const int64_t out_image_elem_cnt = out_blob->shape_view().Count(1);
+    const std::string& name = ctx->Attr<std::string>("name");
+    const std::string& color_space = ctx->Attr<std::string>("color_space");
+    const int64_t target_width = ctx->Attr<int64_t>("target_width");
+    const int64_t target_height = ctx->Attr<int64_t>("target_height");
+    const std::string& interpolation_type = ctx->Attr<std::string>("interpolation_type");
+    const std::string& output_layout = ctx->Attr<std::string>("output_layout");
+    CHECK(output_layout == "NCHW" || output_layout == "NHWC");
+    const bool channels_first = output_layout == "NCHW";
+
+    MultiThreadLoop(record_num, [&](size_t i) {
+      DecodeRandomCropResizeNormalizeFromOneRecord(
+          *(records + i), name, color_space, kernel_state->GetGenerator(i), target_width,
+          target_height, interpolation_type, mirror != nullptr && mirror[i] != 0, channels_first,
+          kernel_state->mean_vec(), kernel_state->inv_std_vec(),
+          out_dptr + i * out_image_elem_cnt);
+    });
+  }
+  bool AlwaysComputeWhenAllOutputsEmpty() const override { return false; }
+};
+
+REGISTER_USER_KERNEL("ofrecord_image_decoder_random_crop_resize_normalize")
+    .SetCreateFn<OFRecordImageDecoderRandomCropResizeNormalizeKernel>()
+    .SetIsMatchedHob((user_op::HobDeviceType() == DeviceType::kCPU)
+                     && (user_op::HobDataType("in", 0) == DataType::kOFRecord)
+                     && (user_op::HobDataType("out", 0) == DataType::kFloat));
+
 }  // namespace oneflow
@@ -393,7 +393,7 @@ void LookupAndInitMissing(ep::Stream* stream, uint64_t seed, embedding::KeyValue
             reinterpret_cast<uint32_t*>(num_missing_ptr),
             reinterpret_cast<uint32_t*>(missing_indices), reinterpret_cast<T*>(store_values));
   }
-  if (put_to_store) { store->Put(stream, num_unique, unique_ids, store_values); }
+  if (put_to_store) { store->PutUnmodified(stream, num_unique, unique_ids, store_values); }
 }
 
 template<typename T, typename K, typename U, typename IDX>
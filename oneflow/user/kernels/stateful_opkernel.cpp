@@ -25,6 +25,7 @@ limitations under the License.
 #include "oneflow/core/profiler/profiler.h"
 #include "oneflow/core/profiler/profile_manager.h"
 #include "oneflow/core/profiler/event_recorder.h"
+#include "oneflow/core/profiler/op_cost.h"
 #include "oneflow/core/eager/call_context.h"
 
 namespace oneflow {
@@ -574,6 +575,32 @@ class UserKernelComputeContext final : public user_op::KernelComputeContext {
   ep::Stream* stream_;
 };
 
+class UserKernelOpCostContext final : public profiler::OpCostContext {
+ public:
+  UserKernelOpCostContext(const UserKernelComputeContextHelper* helper,
+                          eager::CallContext* call_ctx)
+      : helper_(helper), call_ctx_(call_ctx) {}
+  ~UserKernelOpCostContext() override = default;
+
+  const std::string& op_type_name() const override {
+    return helper_->user_op_conf().op_type_name();
+  }
+  const ArgVec& inputs() const override { return helper_->inputs(); }
+  const ArgVec& outputs() const override { return helper_->outputs(); }
+  const user_op::TensorDesc* TensorDesc4ArgNameAndIndex(const std::string& arg_name,
+                                                        int32_t index) const override {
+    return helper_->TensorDesc4ArgNameAndIndex(call_ctx_, arg_name, index);
+  }
+  const std::shared_ptr<const user_op::AttrVal>& Attr4Name(
+      const std::string& attr_name) const override {
+    return helper_->Attr4Name(call_ctx_, attr_name);
+  }
+
+ private:
+  const UserKernelComputeContextHelper* helper_;
+  eager::CallContext* call_ctx_;
+};
+
 class UserKernelRegContextHelper final {
  public:
   UserKernelRegContextHelper(DeviceType device_type, const user_op::UserOpConfWrapper* user_op_conf,
@@ -982,6 +1009,9 @@ void StatefulOpKernel::Compute(eager::CallContext* call_ctx, ep::Stream* stream,
       [call_ctx]() -> std::pair<std::string, int64_t> {
         const std::string attr_str = call_ctx->composed_attrs().ToString();
         return {attr_str, std::hash<std::string>{}(attr_str)};
+      },
+      [this, call_ctx]() -> profiler::OpCost {
+        return profiler::InferOpCost(UserKernelOpCostContext(compute_ctx_helper_.get(), call_ctx));
       }));
   user_opkernel->Compute(compute_ctx, state, cache);
   CHECK_JUST(compute_ctx->stream()->GetAsyncError());
@@ -15,6 +15,7 @@ limitations under the License.
 */
 #include "oneflow/core/framework/framework.h"
 #include "oneflow/core/common/balanced_splitter.h"
+#include "oneflow/user/image/image_util.h"
 #include "oneflow/core/framework/op_generated.h"
 
 namespace oneflow {
@@ -159,4 +160,63 @@ namespace oneflow {
   return Maybe<void>::Ok();
 }
 
+/* static */ Maybe<void> OfrecordImageDecoderRandomCropResizeNormalizeOp::InferLogicalTensorDesc(
+    user_op::InferContext* ctx) {
+  const user_op::TensorDesc& in_tensor = ctx->InputTensorDesc("in", 0);
+  CHECK_OR_RETURN(in_tensor.shape().NumAxes() == 1 && in_tensor.shape().At(0) >= 1);
+  if (ctx->has_input("mirror", 0)) {
+    const user_op::TensorDesc& mirror_tensor = ctx->InputTensorDesc("mirror", 0);
+    CHECK_OR_RETURN(mirror_tensor.shape().NumAxes() == 1
+                    && in_tensor.shape().At(0) == mirror_tensor.shape().At(0));
+  }
+  const int64_t N = in_tensor.shape().At(0);
+  const int64_t H = ctx->Attr<int64_t>("target_height");
+  const int64_t W = ctx->Attr<int64_t>("target_width");
+  CHECK_OR_RETURN(H > 0 && W > 0);
+  const int64_t C = ImageUtil::IsColor(ctx->Attr<std::string>("color_space")) ? 3 : 1;
+  std::ostringstream err;
+  CHECK_OR_RETURN(CheckInterpolationValid(ctx->Attr<std::string>("interpolation_type"), err))
+      << err.str();
+  user_op::TensorDesc* out_tensor = ctx->MutOutputTensorDesc("out", 0);
+  const std::string& output_layout = ctx->Attr<std::string>("output_layout");
+  if (output_layout == "NCHW") {
+    out_tensor->set_shape(Shape({N, C, H, W}));
+  } else if (output_layout == "NHWC") {
+    out_tensor->set_shape(Shape({N, H, W, C}));
+  } else {
+    return Error::CheckFailedError() << "output_layout: " << output_layout << " is not supported";
+  }
+  return Maybe<void>::Ok();
+}
+
+/*static*/ Maybe<void> OfrecordImageDecoderRandomCropResizeNormalizeOp::InferPhysicalTensorDesc(
+    user_op::InferContext* ctx) {
+  return InferLogicalTensorDesc(ctx);
+}
+
+/* static */ Maybe<void> OfrecordImageDecoderRandomCropResizeNormalizeOp::GetSbp(
+    user_op::SbpContext* ctx) {
+  ctx->NewBuilder().Split(ctx->inputs(), 0).Split(ctx->outputs(), 0).Build();
+  return Maybe<void>::Ok();
+}
+
+/* static */ Maybe<void> OfrecordImageDecoderRandomCropResizeNormalizeOp::ModifyInputArg(
+    const GetInputArgModifier& GetInputArgModifierFn, const user_op::UserOpConfWrapper& conf) {
+  user_op::InputArgModifier* in_modifier = GetInputArgModifierFn("in", 0);
+  CHECK_NOTNULL_OR_RETURN(in_modifier);
+  in_modifier->set_requires_grad(false);
+  return Maybe<void>::Ok();
+}
+
+/* static */ Maybe<void> OfrecordImageDecoderRandomCropResizeNormalizeOp::InferDataType(
+    user_op::InferContext* ctx) {
+  const user_op::TensorDesc& in_tensor = ctx->InputTensorDesc("in", 0);
+  CHECK_OR_RETURN(in_tensor.data_type() == DataType::kOFRecord);
+  if (ctx->has_input("mirror", 0)) {
+    CHECK_EQ_OR_RETURN(ctx->InputTensorDesc("mirror", 0).data_type(), DataType::kInt8);
+  }
+  ctx->MutOutputTensorDesc("out", 0)->set_data_type(DataType::kFloat);
+  return Maybe<void>::Ok();
+}
+
 }  // namespace oneflow
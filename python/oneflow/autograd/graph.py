@@ -95,3 +95,63 @@ class saved_tensors_hooks:
 
     def __exit__(self, *args: Any):
         flow._oneflow_internal.autograd.graph.pop_hooks()
+
+
+class save_on_cpu:
+    """Context-manager under which tensors saved by the forward pass will be
+    stored on cpu, then retrieved for backward.
+
+    When performing operations within this context manager, intermediary
+    results saved in the graph during the forward pass will be copied to host
+    memory on the device to host stream, and copied back to their original
+    device when needed for the backward pass. While backward runs, the next
+    ``prefetch_depth`` saved tensors are copied back ahead of use.
+
+    Args:
+        pin_memory (bool): If ``True`` tensors will be saved to pinned memory
+            so that the copies are asynchronous. Default: ``True``.
+        compress_to_bf16 (bool): If ``True`` floating tensors wider than 16 bits
+            are cast to bfloat16 before being copied, which halves the traffic
+            but is lossy. Default: ``False``.
+        prefetch_depth (int): The number of saved tensors copied back ahead of
+            use in backward. Default: 2.
+        min_bytes (int): Saved tensors smaller than this are kept on device.
+            Default: 0.
+
+    Parameters and tensors already on cpu are never copied. ``num_offloaded``
+    is the number of saved tensors copied to host memory in the context.
+
+    Example::
+
+        >>> a = flow.randn(5, requires_grad=True)
+        >>> b = flow.randn(5, requires_grad=True)
+        >>> with flow.autograd.graph.save_on_cpu():
+        ...     y = (a * b).exp()
+        >>> y.sum().backward()
+    """
+
+    def __init__(
+        self,
+        pin_memory: bool = True,
+        compress_to_bf16: bool = False,
+        prefetch_depth: int = 2,
+        min_bytes: int = 0,
+    ):
+        self.pin_memory = pin_memory
+        self.compress_to_bf16 = compress_to_bf16
+        self.prefetch_depth = prefetch_depth
+        self.min_bytes = min_bytes
+        self._hooks = None
+
+    @property
+    def num_offloaded(self) -> int:
+        return 0 if self._hooks is None else self._hooks.num_offloaded
+
+    def __enter__(self):
+        self._hooks = flow._oneflow_internal.autograd.graph.append_offload_hooks(
+            self.pin_memory, self.compress_to_bf16, self.prefetch_depth, self.min_bytes
+        )
+        return self
+
+    def __exit__(self, *args: Any):
+        flow._oneflow_internal.autograd.graph.pop_hooks()
@@ -14,6 +14,8 @@ See the License for the specific language governing permissions and
 limitations under the License.
 """
 from multiprocessing.reduction import ForkingPickler
+import warnings
+import weakref
 
 import numpy as np
 
@@ -60,6 +62,37 @@ def rebuild_shm_tensor(shm, shape, dtype, requires_grad):
     return t
 
 
+# slabs opened by the receiving process, they are alive while any tensor in
+# them is alive
+_opened_slabs = weakref.WeakValueDictionary()
+
+# the errors of the slab methods, kept here as the storage delete hooks may
+# run at exit
+_OneFlowException = flow._oneflow_internal.exception.Exception
+
+
+def rebuild_slab_tensor(slab_name, slot_id, shape, dtype, requires_grad):
+    slab = _opened_slabs.get(slab_name)
+    if slab is None:
+        slab = shared_memory.SharedMemorySlab(name=slab_name)
+        _opened_slabs[slab_name] = slab
+
+    def release_slot():
+        # the closure keeps the slab mapped until the tensor is deleted
+        try:
+            slab.release_slot(slot_id)
+        except _OneFlowException as e:
+            # e.g. the slot is released twice, the tensor is deleted anyway
+            warnings.warn(f"Failed to release the shared memory slot: {e}")
+
+    arr = np.ndarray(shape, dtype=dtype, buffer=slab.slot_buf(slot_id))
+    t = flow.from_numpy(arr)
+    t._register_storage_delete_hook(release_slot)
+    t.requires_grad = requires_grad
+
+    return t
+
+
 def rebuild_empty_parameter(shape, dtype, requires_grad):
     t = flow.tensor([], dtype=dtype)
     t = t.reshape(*shape)
@@ -83,6 +116,18 @@ def reduce_tensor(tensor):
 
     if tensor_data.nbytes == 0:
         return (rebuild_empty_tensor, (tensor.shape, tensor.dtype, requires_grad))
+    slab_pool = shared_memory.get_slab_pool()
+    slot = slab_pool.acquire(tensor_data.nbytes) if slab_pool is not None else None
+    if slot is not None:
+        slab, slot_id = slot
+        slot_numpy = np.ndarray(
+            tensor_data.shape, dtype=tensor_data.dtype, buffer=slab.slot_buf(slot_id)
+        )
+        slot_numpy[...] = tensor_data
+        return (
+            rebuild_slab_tensor,
+            (slab.name, slot_id, tensor_data.shape, tensor_data.dtype, requires_grad),
+        )
     else:
         shm = shared_memory.SharedMemory(create=True, size=tensor_data.nbytes)
         shm_numpy = np.ndarray(
@@ -13,9 +13,14 @@ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
 See the License for the specific language governing permissions and
 limitations under the License.
 """
+import threading
+
 import oneflow as flow
 
-__all__ = ["SharedMemory"]
+__all__ = ["SharedMemory", "SharedMemorySlab", "SharedMemorySlabPool"]
+
+# the slot sizes of slabs are rounded up to pages, see kSlabPageSize
+_SLAB_PAGE_SIZE = 4096
 
 
 class SharedMemory:
@@ -71,3 +76,126 @@ class SharedMemory:
         called once (and only once) across all processes which have access
         to the shared memory block."""
         return self.shm_.unlink()
+
+
+class SharedMemorySlab:
+    """A shared memory block divided into ``slot_num`` page-aligned slots of
+    ``slot_size`` bytes. The creator acquires the slots and any process which
+    opens the slab by name may release them, so that the slots are reused
+    instead of creating a new shared memory block for every tensor."""
+
+    def __init__(self, name=None, create=False, slot_num=0, slot_size=0):
+        if create:
+            if slot_num <= 0 or slot_size <= 0:
+                raise ValueError("'slot_num' and 'slot_size' must be positive")
+        self.slab_ = flow._oneflow_internal.multiprocessing.SharedMemorySlab(
+            name=name if name is not None else "",
+            create=create,
+            slot_num=slot_num,
+            slot_size=slot_size,
+        )
+
+    def __repr__(self):
+        return (
+            f"{self.__class__.__name__}({self.name!r}, "
+            f"slot_num={self.slot_num}, slot_size={self.slot_size})"
+        )
+
+    @property
+    def name(self):
+        "Unique name that identifies the shared memory block."
+        return self.slab_.name
+
+    @property
+    def slot_num(self):
+        "Number of slots."
+        return self.slab_.slot_num
+
+    @property
+    def slot_size(self):
+        "Size of every slot in bytes, a multiple of the page size."
+        return self.slab_.slot_size
+
+    def acquire_slot(self):
+        """Returns the id of a free slot and marks it as in use, or -1 if all
+        the slots are in use. It is thread safe."""
+        return self.slab_.acquire_slot()
+
+    def release_slot(self, slot_id):
+        "Marks the slot as free so that the creator can reuse it."
+        return self.slab_.release_slot(slot_id)
+
+    def slot_buf(self, slot_id):
+        """A memoryview of contents of the slot. It does not keep the slab
+        alive."""
+        return self.slab_.slot_buf(slot_id)
+
+    def unlink(self):
+        "Requests that the underlying shared memory block be destroyed."
+        return self.slab_.unlink()
+
+
+class SharedMemorySlabPool:
+    """Slabs created on demand by a process which sends many tensors of
+    similar sizes to other processes, e.g. a DataLoader worker.
+
+    A tensor is put into a slab whose slot size is at least its size and at
+    most twice of it, or one page for tensors smaller than half a page since
+    the slot sizes are rounded up to pages. A new slab is created if there is no such slab with a
+    free slot, unless ``max_slab_num`` slabs exist. ``acquire`` returns None
+    for tensors larger than ``max_slot_size`` or if no slot is available, in
+    which case the caller falls back to a dedicated shared memory block.
+    """
+
+    def __init__(self, slot_num, max_slot_size, max_slab_num=8):
+        self.slot_num_ = slot_num
+        self.max_slot_size_ = max_slot_size
+        self.max_slab_num_ = max_slab_num
+        # sorted by slot size
+        self.slabs_ = []
+        # tensors are pickled in the feeder threads of multiprocessing queues
+        self.lock_ = threading.Lock()
+
+    def acquire(self, nbytes):
+        """Returns a ``(slab, slot_id)`` pair whose slot holds at least
+        ``nbytes`` bytes, or None."""
+        if nbytes <= 0 or nbytes > self.max_slot_size_:
+            return None
+        max_slot_size = max(2 * nbytes, _SLAB_PAGE_SIZE)
+        with self.lock_:
+            for slab in self.slabs_:
+                if slab.slot_size < nbytes:
+                    continue
+                if slab.slot_size > max_slot_size:
+                    break
+                slot_id = slab.acquire_slot()
+                if slot_id >= 0:
+                    return slab, slot_id
+            if len(self.slabs_) >= self.max_slab_num_:
+                return None
+            slab = SharedMemorySlab(
+                create=True, slot_num=self.slot_num_, slot_size=nbytes
+            )
+            self.slabs_.append(slab)
+            self.slabs_.sort(key=lambda slab: slab.slot_size)
+            return slab, slab.acquire_slot()
+
+    @property
+    def slab_num(self):
+        "Number of slabs created by the pool."
+        with self.lock_:
+            return len(self.slabs_)
+
+
+_slab_pool = None
+
+
+def set_slab_pool(pool):
+    """Sets the :class:`SharedMemorySlabPool` used to send tensors from this
+    process, None disables it."""
+    global _slab_pool
+    _slab_pool = pool
+
+
+def get_slab_pool():
+    return _slab_pool
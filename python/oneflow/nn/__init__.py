@@ -90,6 +90,7 @@ from oneflow.nn.modules.dataset import (
     CropMirrorNormalize,
     OFRecordImageDecoder,
     OFRecordImageDecoderRandomCrop,
+    OFRecordImageDecoderRandomCropResizeNormalize,
     OFRecordImageGpuDecoderRandomCropResize,
     OFRecordRawDecoder,
     OFRecordRawDecoder as OfrecordRawDecoder,
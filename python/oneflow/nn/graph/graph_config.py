@@ -409,6 +409,37 @@ class GraphConfig(object):
         """
         self.proto.auto_parallel_wait_time = cost
 
+    def set_auto_parallel_cost_database(self, path: str):
+        """
+        Set the cost database recorded by oneflow.profiler.record_auto_parallel_cost for
+        auto-parallel algorithm.
+
+        The measured times of ops and boxing in the database replace their analytic costs, after
+        being scaled to the unit of the analytic costs. The costs which are not measured are still
+        analytic.
+        """
+        self.proto.auto_parallel_cost_database_path = path
+
+    def enable_auto_parallel_concurrent_search(self, mode: bool = True):
+        """
+        Adjust the SBP of independent neighborhoods concurrently in auto-parallel algorithm.
+
+        The nodes are colored so that the neighborhoods of the nodes with the same color do not
+        affect each other, and are adjusted with multiple threads. The result does not depend on
+        the number of threads, but might be different from the sequential search.
+        """
+        self.proto.enable_auto_parallel_concurrent_search = mode
+
+    def enable_auto_parallel_incremental_search(self, mode: bool = True):
+        """
+        Reuse the SBP found by the last auto-parallel search of the same ops in this process.
+
+        Ops with the same name, SBP candidates and costs start from their last SBP, and only the
+        neighborhoods of the other ops are searched. It speeds up the compilation of graphs which
+        only change a part of a previously compiled graph.
+        """
+        self.proto.enable_auto_parallel_incremental_search = mode
+
     def enable_auto_parallel_trunk_algo(self, mode: bool = True):
         """
         Find the trunk of the SBP graph, then reduce the wait time for tributaries.
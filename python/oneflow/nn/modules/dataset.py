@@ -55,11 +55,22 @@ class OFRecordReader(Module):
         placement: flow.placement = None,
         sbp: Union[flow.sbp.sbp, List[flow.sbp.sbp]] = None,
         name: Optional[str] = None,
+        use_index: bool = False,
+        start_sample: int = 0,
     ):
         super().__init__()
 
         if name is not None:
             print("WARNING: name has been deprecated and has NO effect.\n")
+        # With use_index, the records are read at random through the "<part file>.index"
+        # sidecar files, which are built and saved on first use (set the environment
+        # variable ONEFLOW_OFRECORD_SAVE_INDEX=0 for read only directories). The ranks
+        # then share the records evenly, shuffle_after_epoch reads a new permutation of
+        # all the records every epoch, and start_sample (the number of samples read by
+        # all ranks so far) resumes reading.
+        assert start_sample == 0 or use_index, "start_sample requires use_index"
+        self.use_index = use_index
+        self.start_sample = start_sample
         self.ofrecord_dir = ofrecord_dir
         self.batch_size = batch_size
         self.data_part_num = data_part_num
@@ -104,6 +115,8 @@ class OFRecordReader(Module):
                 random_shuffle=self.random_shuffle,
                 shuffle_after_epoch=self.shuffle_after_epoch,
                 seed=self.seed,
+                use_index=self.use_index,
+                start_sample=self.start_sample,
                 sbp=self.sbp,
                 placement=self.placement,
             )
@@ -119,6 +132,8 @@ class OFRecordReader(Module):
                 random_shuffle=self.random_shuffle,
                 shuffle_after_epoch=self.shuffle_after_epoch,
                 seed=self.seed,
+                use_index=self.use_index,
+                start_sample=self.start_sample,
                 device=self.device,
             )
         return res
@@ -464,6 +479,83 @@ class OFRecordImageDecoderRandomCrop(Module):
         return res
 
 
+class OFRecordImageDecoderRandomCropResizeNormalize(Module):
+    """Decodes, randomly crops, resizes to (target_height, target_width), optionally mirrors
+    and normalizes the images of a batch of OFRecords in a single CPU op, which gives the
+    float batch of OFRecordImageDecoderRandomCrop, image.Resize and CropMirrorNormalize
+    without materializing the intermediate images. JPEG images are decoded with libjpeg's
+    DCT domain scaling close to the target size instead of at their full resolution.
+    """
+
+    def __init__(
+        self,
+        blob_name: str,
+        target_width: int,
+        target_height: int,
+        color_space: str = "BGR",
+        output_layout: str = "NCHW",
+        mean: Sequence[float] = [0.0],
+        std: Sequence[float] = [1.0],
+        interpolation_type: str = "bilinear",
+        num_attempts: int = 10,
+        random_seed: Optional[int] = None,
+        random_area: Sequence[float] = [0.08, 1.0],
+        random_aspect_ratio: Sequence[float] = [0.75, 1.333333],
+    ):
+        super().__init__()
+        self.blob_name = blob_name
+        self.target_width = target_width
+        self.target_height = target_height
+        self.color_space = color_space
+        self.output_layout = output_layout
+        self.mean = mean
+        self.std = std
+        self.interpolation_type = interpolation_type
+        self.num_attempts = num_attempts
+        self.random_area = random_area
+        self.random_aspect_ratio = random_aspect_ratio
+        (self.seed, self.has_seed) = local_gen_random_seed(random_seed)
+        self._op_with_mirror = (
+            flow.stateful_op("ofrecord_image_decoder_random_crop_resize_normalize")
+            .Input("in")
+            .Input("mirror")
+            .Output("out")
+            .Build()
+        )
+        self._op_no_mirror = (
+            flow.stateful_op("ofrecord_image_decoder_random_crop_resize_normalize")
+            .Input("in")
+            .Output("out")
+            .Build()
+        )
+
+    def forward(self, input, mirror=None):
+        if mirror is not None:
+            op = self._op_with_mirror
+            inputs = (input, mirror)
+        else:
+            op = self._op_no_mirror
+            inputs = (input,)
+        res = _C.dispatch_ofrecord_image_decoder_random_crop_resize_normalize(
+            op,
+            inputs,
+            name=self.blob_name,
+            target_width=self.target_width,
+            target_height=self.target_height,
+            mean=self.mean,
+            std=self.std,
+            color_space=self.color_space,
+            output_layout=self.output_layout,
+            interpolation_type=self.interpolation_type,
+            random_area=self.random_area,
+            random_aspect_ratio=self.random_aspect_ratio,
+            num_attempts=self.num_attempts,
+            seed=self.seed,
+            has_seed=self.has_seed,
+        )
+        return res
+
+
 class OFRecordImageDecoder(Module):
     def __init__(self, blob_name: str, color_space: str = "BGR"):
         super().__init__()
@@ -174,6 +174,8 @@ class Module(object):
         del state["_load_state_dict_pre_hooks"]
         del state["_is_full_backward_hook"]
         del state["_non_persistent_buffers_set"]
+        # the grad bucket reducer of ddp is created again by __setstate__
+        state.pop("_ddp_reducer", None)
         return state
 
     def __setstate__(self, state):
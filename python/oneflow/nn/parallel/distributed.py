@@ -15,6 +15,7 @@ limitations under the License.
 """
 import warnings
 from collections import OrderedDict
+from typing import Optional
 
 import oneflow as flow
 from oneflow.support.env_var_util import parse_boolean_from_env
@@ -22,46 +23,9 @@ from oneflow.framework.tensor_tuple_util import convert_to_tensor_tuple
 from oneflow.framework.args_tree import ArgsTree
 
 
-def grad_setting_fn(module, param):
-    def grad_setting(grad):
-        if param.grad is None:
-            start = module._param_grad_offset_in_bucket[param]
-            bucket_index = module._bucket_index[param]
-            bucket_tensor = module._bucket_tensors[bucket_index]
-            param.grad = flow._C.slice_view_1d_contiguous(
-                bucket_tensor, start, start + param.numel()
-            ).view(param.shape)
-        return grad
-
-    return grad_setting
-
-
-def allreduce_fn(module, param, use_bucket):
+def allreduce_fn(module, param):
     ddp_state_for_reversed_params = module._ddp_state_for_reversed_params
 
-    def allreduce_with_bucket(grad):
-        buckets = module._buckets
-        bucket_tensors = module._bucket_tensors
-        ddp_state_for_reversed_params[param][0] = True
-        for index, bucket in enumerate(buckets):
-            deleted = all(ddp_state_for_reversed_params[x][1] for x in bucket)
-            if deleted:
-                continue
-
-            assert not any(ddp_state_for_reversed_params[x][1] for x in bucket)
-
-            all_params_in_bucket_ready = all(
-                ddp_state_for_reversed_params[x][0] for x in bucket
-            )
-            if all_params_in_bucket_ready:
-                for x in bucket:
-                    ddp_state_for_reversed_params[x][1] = True
-                # NOTE(jianhao)(higher-order-grad):
-                # local allreduce doesn't have gradient function, higher-order grad may be unsupported
-                flow._C.local_all_reduce(bucket_tensors[index], inplace=True)
-            else:
-                break
-
     def allreduce_without_bucket(grad):
         ddp_state_for_reversed_params[param][0] = True
         for cur_param, (ready, deleted) in ddp_state_for_reversed_params.items():
@@ -77,7 +41,7 @@ def allreduce_fn(module, param, use_bucket):
             else:
                 break
 
-    return allreduce_with_bucket if use_bucket else allreduce_without_bucket
+    return allreduce_without_bucket
 
 
 def DistributedDataParallel(
@@ -87,6 +51,7 @@ def DistributedDataParallel(
     broadcast_parameters: bool = True,
     bucket_size: int = 10,
     use_bucket: bool = True,
+    bucket_cap_mb: Optional[float] = None,
 ):
     assert all(x.dtype == flow.float32 for x in module.parameters())
     if use_bucket and parse_boolean_from_env("ONEFLOW_DISABLE_VIEW", False):
@@ -105,51 +70,17 @@ def DistributedDataParallel(
                 x.requires_grad_(requires_grad)
 
     if use_bucket:
-        all_grad_size = sum([x.numel() for x in module.parameters()])
-        if all_grad_size > 0:
-            device = list(module.parameters())[0].device
-            assert all(x.device == device for x in module.parameters())
-        reversed_param_list = list(
-            reversed(
-                list([param for param in module.parameters() if param.requires_grad])
-            )
+        # The grads are packed into flat buckets in reverse parameter order, each bucket
+        # is scaled and all-reduced by the reducer as soon as all its grads are
+        # accumulated, while backward continues.
+        bucket_cap_bytes = (
+            0 if bucket_cap_mb is None else int(bucket_cap_mb * 1024 * 1024)
+        )
+        module._ddp_reducer = flow._oneflow_internal.GradBucketReducer(
+            [param for param in module.parameters() if param.requires_grad],
+            bucket_size,
+            bucket_cap_bytes,
         )
-        module._param_grad_offset_in_bucket = {}
-
-        def numel_in_bucket(tensor: flow.Tensor):
-            def align(x: int, unit_size: int):
-                return (x + (unit_size - 1)) // unit_size * unit_size
-
-            # tensor memory should be align to 512 bytes for cuda operations,
-            # 4 is the bytes of a float number
-            return align(
-                tensor.numel(), flow._oneflow_internal.max_alignment_size() // 4
-            )
-
-        offset_in_bucket = 0
-        with flow.no_grad():
-            for i, param in enumerate(reversed_param_list):
-                assert param.is_leaf
-                if i % bucket_size == 0:
-                    offset_in_bucket = 0
-                module._param_grad_offset_in_bucket[param] = offset_in_bucket
-                offset_in_bucket += numel_in_bucket(param)
-
-        module._bucket_index = {
-            x: i // bucket_size for i, x in enumerate(reversed_param_list)
-        }
-        module._buckets = [
-            reversed_param_list[i : i + bucket_size]
-            for i in range(0, len(reversed_param_list), bucket_size)
-        ]
-
-        bucket_elems = 0
-        module._bucket_tensors = []
-        for b in module._buckets:
-            bucket_elems = sum([numel_in_bucket(x) for x in b])
-            module._bucket_tensors.append(
-                flow.zeros(bucket_elems, dtype=flow.float32, device=device)
-            )
 
     ddp_state_for_reversed_params = OrderedDict(
         reversed([(x, [False, False]) for x in module.parameters() if x.requires_grad])
@@ -167,19 +98,18 @@ def DistributedDataParallel(
         x.mul_(mul_factor)
         return None
 
-    for param in module.parameters():
-        if param.requires_grad:
-            if use_bucket:
-                param.register_hook(grad_setting_fn(module, param))
-            param._register_post_grad_accumulation_hook(inplace_mul_and_return_none)
-            param._register_post_grad_accumulation_hook(
-                allreduce_fn(module, param, use_bucket)
-            )
+    if not use_bucket:
+        for param in module.parameters():
+            if param.requires_grad:
+                param._register_post_grad_accumulation_hook(inplace_mul_and_return_none)
+                param._register_post_grad_accumulation_hook(allreduce_fn(module, param))
 
     def post_forward_hook(module, input, output):
         ddp_state_for_reversed_params = module._ddp_state_for_reversed_params
         for state in ddp_state_for_reversed_params.values():
             state[0], state[1] = False, False
+        if use_bucket:
+            module._ddp_reducer.reset()
         output = ArgsTree(output).map_leaf(
             lambda x: flow._C.select_top_n(
                 convert_to_tensor_tuple([x, *ddp_state_for_reversed_params.keys()]),
@@ -54,7 +54,7 @@ def _check_initializer(initializer):
 def _check_cache(cache):
     assert isinstance(cache, dict)
     assert cache.__contains__("policy")
-    assert cache["policy"] in ["lru", "full"]
+    assert cache["policy"] in ["lru", "full", "lfu", "tinylfu"]
     cache_memory_budget_mb = 0
     if cache.__contains__("cache_memory_budget_mb"):
         cache_memory_budget_mb = cache["cache_memory_budget_mb"]
@@ -129,6 +129,10 @@ def _init(
     assert isinstance(persistent_table_path, (str, list, tuple))
     if isinstance(persistent_table_path, (list, tuple)):
         assert len(persistent_table_path) == parallel_num
+    if persistent_table.__contains__("value_paths"):
+        assert isinstance(persistent_table["value_paths"], (list, tuple))
+        for value_path in persistent_table["value_paths"]:
+            assert isinstance(value_path, str)
     if persistent_table.__contains__("physical_block_size"):
         assert persistent_table["physical_block_size"] in [512, 4096]
     else:
@@ -138,6 +142,11 @@ def _init(
         persistent_table["capacity_hint"] = (
             persistent_table["capacity_hint"] // parallel_num
         )
+    if persistent_table.__contains__("storage_format"):
+        assert persistent_table["storage_format"] in ["fp32", "fp16", "bf16", "int8"]
+        if not persistent_table.__contains__("reduced_precision_dim"):
+            # optimizer states following the embedding are kept in full precision
+            persistent_table["reduced_precision_dim"] = embedding_dim
     key_value_store_options["kv_store"] = kv_store
     # initializer
     if tables is not None:
@@ -606,6 +615,11 @@ def make_cached_ssd_store_options(
     storage_dim=-1,
     physical_block_size=4096,
     host_cache_budget_mb=0,
+    cache_policy="lru",
+    storage_format="fp32",
+    expiry_ttl_seconds=0,
+    eviction_min_count=0,
+    value_paths=None,
 ):
     """make SSD use GPU and host as cache store_options param of MultiTableEmbedding. If cache_budget_mb > 0 and host_cache_budget_mb > 0, use GPU and host memory as multi-level cache.
 
@@ -617,6 +631,11 @@ def make_cached_ssd_store_options(
         storage_dim (int, optional): number of elements in embedding storage, if set storage_dim, the size_factor param will be invalid. if SGD update, and momentum = 0, storage_dim should be embedding_size*1, if momentum > 0, storage_dim should be embedding_size*2. if Adam, storage_dim should be embedding_size*3. Defaults to -1.
         physical_block_size (int, optional): physical_block_size should be sector size. Defaults to 4096.
         host_cache_budget_mb (int): the MB budget of host memory as cache per rank. Defaults to 0.
+        cache_policy (str, optional): eviction policy of the caches, one of "lru", "lfu" and "tinylfu". "lfu" evicts the least frequently used rows, "tinylfu" additionally only admits a missing row if it is accessed more often than the row it would evict, which keeps one-off ids from evicting hot rows. Defaults to "lru".
+        storage_format (str, optional): format of the embedding stored in persistent_path, one of "fp32", "fp16", "bf16" and "int8" (with a scale per row). Optimizer states are always stored in fp32. Defaults to "fp32".
+        expiry_ttl_seconds (int, optional): when saving a snapshot, rows not updated for expiry_ttl_seconds are deleted from the persistent storage. 0 means rows never expire. Defaults to 0.
+        eviction_min_count (int, optional): when saving a snapshot, rows not updated since the previous snapshot whose update count, halved at every snapshot, is below eviction_min_count are deleted from the persistent storage. 0 disables it. Defaults to 0.
+        value_paths (list, optional): directories on different SSDs the embedding values are striped across, each rank uses a rank_id-num_ranks subdirectory of every path. Index and snapshot files stay in persistent_path. Defaults to None, which stores the values in persistent_path.
 
     Returns:
         dict: SSD use GPU and host as cache store_options param of MultiTableEmbedding
@@ -634,6 +653,10 @@ def make_cached_ssd_store_options(
     """
     assert isinstance(persistent_path, (str, list, tuple))
     assert cache_budget_mb > 0 or host_cache_budget_mb > 0
+    assert cache_policy in ["lru", "lfu", "tinylfu"]
+    assert storage_format in ["fp32", "fp16", "bf16", "int8"]
+    assert expiry_ttl_seconds >= 0
+    assert eviction_min_count >= 0
     if capacity is not None:
         assert capacity > 0
     else:
@@ -643,7 +666,7 @@ def make_cached_ssd_store_options(
     if cache_budget_mb > 0:
         cache_list.append(
             {
-                "policy": "lru",
+                "policy": cache_policy,
                 "cache_memory_budget_mb": cache_budget_mb,
                 "value_memory_kind": "device",
             }
@@ -651,7 +674,7 @@ def make_cached_ssd_store_options(
     if host_cache_budget_mb > 0:
         cache_list.append(
             {
-                "policy": "lru",
+                "policy": cache_policy,
                 "cache_memory_budget_mb": host_cache_budget_mb,
                 "value_memory_kind": "host",
             }
@@ -664,11 +687,17 @@ def make_cached_ssd_store_options(
                 "path": persistent_path,
                 "physical_block_size": physical_block_size,
                 "capacity_hint": int(capacity),
+                "storage_format": storage_format,
+                "expiry_ttl_seconds": int(expiry_ttl_seconds),
+                "eviction_min_count": int(eviction_min_count),
             },
         },
         "size_factor": size_factor,
         "storage_dim": storage_dim,
     }
+    if value_paths is not None:
+        assert isinstance(value_paths, (list, tuple)) and len(value_paths) > 0
+        options["kv_store"]["persistent_table"]["value_paths"] = list(value_paths)
     return options
 
 
@@ -14,7 +14,10 @@ See the License for the specific language governing permissions and
 limitations under the License.
 """
 
+import json
+
 import oneflow._oneflow_internal
+from oneflow.profiler.util import add_roofline_bound
 from oneflow.profiler.profiler import (
     profile,
     record_function,
@@ -34,6 +37,13 @@ __all__ = [
     "kineto_available",
     "tensorboard_trace_handler",
     "ProfilerAction",
+    "actor_trace_start",
+    "actor_trace_stop",
+    "actor_trace_clear",
+    "export_actor_trace",
+    "analyze_graph_execution",
+    "analyze_graph_roofline",
+    "record_auto_parallel_cost",
 ]
 
 
@@ -55,3 +65,87 @@ def profiler_stop():
 
 def kineto_available():
     return True
+
+
+def actor_trace_start():
+    r"""Starts recording the acts, kernel launches and messages of the actors of
+    nn.Graph into per thread ring buffers. It can also be started when oneflow is
+    imported by setting the environment variable ``ONEFLOW_ACTOR_TRACE=1``.
+    """
+    oneflow._oneflow_internal.profiler.EnableActorTrace()
+
+
+def actor_trace_stop():
+    r"""Stops recording the actor trace, the recorded events are kept."""
+    oneflow._oneflow_internal.profiler.DisableActorTrace()
+
+
+def actor_trace_clear():
+    r"""Drops the actor events recorded so far, e.g. before the runs of a graph
+    to analyze with :func:`analyze_graph_execution`.
+    """
+    oneflow._oneflow_internal.profiler.ClearActorTrace()
+
+
+def export_actor_trace(path):
+    r"""Writes the newest recorded actor events of this process to ``path`` in the
+    Chrome trace event format, which can be opened by Perfetto or chrome://tracing.
+    Every thread keeps its last ``ONEFLOW_ACTOR_TRACE_BUFFER_SIZE`` (65536 by
+    default) events.
+    """
+    with open(path, "w") as f:
+        f.write(oneflow._oneflow_internal.profiler.ExportActorTrace())
+
+
+def analyze_graph_execution(graph):
+    r"""Analyzes the acts of the actors of a run ``nn.Graph`` on this rank, which
+    are recorded after :func:`actor_trace_start`, and returns a report as a dict
+    with the keys:
+
+    - ``iterations`` and ``iteration_us``: the number of recorded iterations and
+      the mean time of an iteration.
+    - ``critical_path``: the longest chain of dependent actors by mean act time.
+    - ``streams``: the act time per iteration and utilization of every stream.
+    - ``regst_stalls``: the time producers wait for a free register of their
+      output, with the ``register_num`` which would avoid it.
+    - ``comm_waits``: the time actors wait for the output of communication.
+    - ``suggestions``: changes of register numbers or pipeline stages.
+    """
+    return json.loads(graph._c_nn_graph.analyze_execution())
+
+
+def analyze_graph_roofline(graph, peak_gflops=None, peak_gbps=None):
+    r"""Joins the kernel launches of a run ``nn.Graph`` on this rank, which are
+    recorded after :func:`actor_trace_start`, with the FLOPs and bytes of their
+    ops, and returns a list of the kernels sorted by total time. Every kernel has
+    its mean time, FLOPs, bytes, achieved ``gflops_per_s`` and ``gbps`` and
+    ``arithmetic_intensity``. With the peak GFLOP/s and GB/s of the device, every
+    kernel also has its ``bound`` on the roofline and its ``efficiency``.
+
+    The kernels on CUDA are timed by CUDA events. The kernels on other devices
+    are launched asynchronously, so their times are launch times
+    (``launch_time_only``) unless ``ONEFLOW_DEBUG_KERNEL_SYNC_CHECK=1`` is set.
+    """
+    report = json.loads(graph._c_nn_graph.analyze_roofline())
+    return [
+        add_roofline_bound(kernel, peak_gflops, peak_gbps)
+        for kernel in report["kernels"]
+    ]
+
+
+def record_auto_parallel_cost(graph, path):
+    r"""Adds the kernel times of a run ``nn.Graph`` on this rank, which are
+    recorded after :func:`actor_trace_start`, to the auto parallel cost database
+    at ``path``. Ops are keyed by their type, placement, logical shapes and SBP
+    signature, and nccl send/recv boxing by the logical shape and the placement
+    and SBP of both sides. The times of several graphs and runs are accumulated,
+    e.g. run the same model with different hand-written SBP to measure more
+    candidates. Pass the database to the search of later graphs with
+    ``graph.config.set_auto_parallel_cost_database(path)``.
+
+    The kernels on CUDA are timed by CUDA events, set
+    ``ONEFLOW_DEBUG_KERNEL_SYNC_CHECK=1`` to record the actual times of the
+    kernels on other devices. The ranks of a job may record into the same
+    ``path``, which is locked while it is updated.
+    """
+    graph._c_nn_graph.record_auto_parallel_cost(path)
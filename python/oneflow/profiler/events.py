@@ -21,7 +21,7 @@ from collections import OrderedDict
 from rich import box
 from rich.console import Console
 from rich.table import Table
-from oneflow.profiler.util import format_time
+from oneflow.profiler.util import format_time, add_roofline_bound
 
 
 class EventType(Enum):
@@ -140,11 +140,15 @@ class KernelEvent(EventBase):
         time_total: float,
         memory_size: int,
         description: Dict[str, str],
+        flops: float = -1,
+        bytes: float = -1,
     ) -> None:
         super().__init__(name, time_total, EventType.Kernel)
         self.children: List[CustomEvent] = []
         self.memory_size = memory_size
         self.description = description
+        self.flops = flops
+        self.bytes = bytes
         self._cuda_time_total = 0.0
         self._enable_show_input_shapes = True
         self._enable_show_attributes = True
@@ -157,7 +161,12 @@ class KernelEvent(EventBase):
     @classmethod
     def from_dict(cls, d: dict):
         kernel_event = cls(
-            d.get("name"), d.get("time"), d.get("memory_size"), d.get("description", {})
+            d.get("name"),
+            d.get("time"),
+            d.get("memory_size"),
+            d.get("description", {}),
+            d.get("flops", -1),
+            d.get("bytes", -1),
         )
         if "children" in d.keys():
             children_list = d.get("children")
@@ -213,6 +222,27 @@ class KernelEvent(EventBase):
                 return f"{self.memory_size / (1024.0 * 1024.0 * 1024.0) / (self.cuda_time / (1000 * 1000)):.3f}GB/s"
         return ""
 
+    def has_flops(self) -> bool:
+        return self.flops >= 0
+
+    def roofline(self, peak_gflops=None, peak_gbps=None):
+        # the kernel time on the device if it is recorded
+        time_ns = (self.cuda_time if self.has_cuda_time() else self.cpu_time) * 1000
+        flops = self.flops / self.count
+        bytes = self.bytes / self.count
+        entry = {
+            "name": self._name,
+            "count": self.count,
+            "time_us": time_ns / 1000,
+            "flops": flops,
+            "bytes": bytes,
+            # flops (bytes) per ns are GFLOP/s (GB/s)
+            "gflops_per_s": flops / time_ns if time_ns > 0 else 0.0,
+            "gbps": bytes / time_ns if time_ns > 0 else 0.0,
+            "arithmetic_intensity": flops / bytes if bytes > 0 else 0.0,
+        }
+        return add_roofline_bound(entry, peak_gflops, peak_gbps)
+
     def to_dict(self):
         result = {
             "name": self.name,
@@ -242,6 +272,9 @@ class KernelEvent(EventBase):
         super().update(event)
         if self.has_cuda_time():
             self.cuda_time_total += event.cuda_time_total
+        if self.has_flops() and event.has_flops():
+            self.flops += event.flops
+            self.bytes += event.bytes
 
         for i in range(len(self.children)):
             self.children[i].update(event.children[i])
@@ -308,6 +341,21 @@ class Events(list):
         results.extend(stats.values())
         return results
 
+    def roofline(self, peak_gflops=None, peak_gbps=None):
+        r"""Returns the achieved GFLOP/s, GB/s and arithmetic intensity of every
+        kernel recorded with ``record_flops=True``, sorted by total time. With the
+        peak GFLOP/s and GB/s of the device, every entry also has the ``bound`` of
+        the kernel on the roofline and its ``efficiency`` against that bound.
+        """
+        kernels = [
+            x
+            for x in self.key_averages(group_by_input_shape=True)
+            if isinstance(x, KernelEvent) and x.has_flops()
+        ]
+        entries = [x.roofline(peak_gflops, peak_gbps) for x in kernels]
+        entries.sort(key=lambda x: x["time_us"] * x["count"], reverse=True)
+        return entries
+
     def table(self):
         has_input_shapes = any(
             [
@@ -53,6 +53,7 @@ class profile:
         record_shapes: bool = False,
         record_attrs: bool = False,
         record_bandwidth_for_cuda: bool = False,
+        record_flops: bool = False,
     ) -> None:
         self.activities = set(activities) if activities else supported_activities()
         assert (
@@ -69,6 +70,7 @@ class profile:
                 record_bandwidth_for_cuda == False
             ), "record_bandwidth_for_cuda = True can only work with cuda."
         self.record_bandwidth_for_cuda = record_bandwidth_for_cuda
+        self.record_flops = record_flops
         self.profile_events: Optional[Events] = None
 
     def __enter__(self):
@@ -78,6 +80,7 @@ class profile:
             self.record_shapes,
             self.record_attrs,
             self.record_bandwidth_for_cuda,
+            self.record_flops,
         )
         return self
 
@@ -101,6 +104,10 @@ class profile:
         self.__check_finish()
         return self.profile_events
 
+    def roofline(self, peak_gflops=None, peak_gbps=None):
+        self.__check_finish()
+        return self.profile_events.roofline(peak_gflops, peak_gbps)
+
 
 class record_function:
     def __init__(self, name: str) -> None:
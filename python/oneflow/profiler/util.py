@@ -23,3 +23,20 @@ def format_time(time_us):
     if time_us >= US_IN_MS:
         return "{:.3f}ms".format(time_us / US_IN_MS)
     return "{:.3f}us".format(time_us)
+
+
+def add_roofline_bound(entry, peak_gflops=None, peak_gbps=None):
+    r"""Adds the bound of a kernel on the roofline of a device, given by its peak
+    GFLOP/s and GB/s, to a dict with the ``gflops_per_s``, ``gbps`` and
+    ``arithmetic_intensity`` the kernel achieved.
+    """
+    if peak_gflops is None or peak_gbps is None:
+        return entry
+    intensity = entry["arithmetic_intensity"]
+    attainable_gflops = min(peak_gflops, intensity * peak_gbps)
+    entry["bound"] = "compute" if intensity * peak_gbps >= peak_gflops else "memory"
+    if entry["flops"] > 0:
+        entry["efficiency"] = entry["gflops_per_s"] / attainable_gflops
+    else:
+        entry["efficiency"] = entry["gbps"] / peak_gbps
+    return entry
@@ -0,0 +1,149 @@
+"""
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+"""
+import os
+import unittest
+from unittest import mock
+
+import numpy as np
+
+import oneflow as flow
+import oneflow.unittest
+from oneflow.multiprocessing import reductions, shared_memory
+
+
+class VariableSizeDataset(flow.utils.data.Dataset):
+    def __init__(self, length=24):
+        self.length = length
+
+    def __getitem__(self, index):
+        # the last batch is larger than the max slot size
+        dim = 64 if index // 4 % 2 == 0 else 96
+        if index // 4 == 5:
+            dim = 1024
+        np.random.seed(index)
+        return np.random.randn(dim, dim).astype(np.float32)
+
+    def __len__(self):
+        return self.length
+
+
+class ImageLabelDataset(flow.utils.data.Dataset):
+    def __init__(self, length=32):
+        self.length = length
+
+    def __getitem__(self, index):
+        np.random.seed(index)
+        return np.random.randn(3, 32, 32).astype(np.float32), index % 10
+
+    def __len__(self):
+        return self.length
+
+
+@flow.unittest.skip_unless_1n1d()
+class TestSharedMemorySlab(flow.unittest.TestCase):
+    # the workers read the env when they start
+    SLAB_ENV = {
+        "ONEFLOW_DATALOADER_SHM_SLOT_NUM": "2",
+        "ONEFLOW_DATALOADER_SHM_MAX_SLOT_SIZE": str(1 << 20),
+    }
+
+    def setUp(self):
+        self.saved_env = {name: os.environ.get(name) for name in self.SLAB_ENV}
+        os.environ.update(self.SLAB_ENV)
+
+    def tearDown(self):
+        for name, value in self.saved_env.items():
+            if value is None:
+                os.environ.pop(name, None)
+            else:
+                os.environ[name] = value
+
+    def test_slab_slots(test_case):
+        slab = shared_memory.SharedMemorySlab(create=True, slot_num=2, slot_size=100)
+        test_case.assertEqual(slab.slot_num, 2)
+        test_case.assertEqual(slab.slot_size % 4096, 0)
+        first = slab.acquire_slot()
+        second = slab.acquire_slot()
+        test_case.assertEqual(sorted([first, second]), [0, 1])
+        test_case.assertEqual(slab.acquire_slot(), -1)
+        slab.slot_buf(second)[:3] = b"abc"
+        opened = shared_memory.SharedMemorySlab(name=slab.name)
+        test_case.assertEqual(bytes(opened.slot_buf(second)[:3]), b"abc")
+        opened.release_slot(second)
+        test_case.assertEqual(slab.acquire_slot(), second)
+        slab.unlink()
+
+    def test_dataloader(test_case):
+        dataset = VariableSizeDataset()
+        dataloader = flow.utils.data.DataLoader(dataset, batch_size=4, num_workers=2)
+        # hold all the batches to run out of slots
+        batches = list(dataloader)
+        test_case.assertEqual(len(batches), 6)
+        for i, batch in enumerate(batches):
+            expected = np.stack([dataset[j] for j in range(i * 4, i * 4 + 4)])
+            test_case.assertTrue(np.array_equal(batch.numpy(), expected))
+        # the batches which fit the slots are received through the slabs
+        test_case.assertGreater(len(reductions._opened_slabs), 0)
+        del batches
+        for epoch in range(2):
+            for i, batch in enumerate(dataloader):
+                expected = np.stack([dataset[j] for j in range(i * 4, i * 4 + 4)])
+                test_case.assertTrue(np.array_equal(batch.numpy(), expected))
+
+    def test_image_label_dataloader(test_case):
+        dataset = ImageLabelDataset()
+        num_workers = 2
+        dataloader = flow.utils.data.DataLoader(
+            dataset, batch_size=4, num_workers=num_workers, persistent_workers=True
+        )
+        # the workers are started by the first iterator, before the rebuilds are
+        # recorded in this process
+        iterator = iter(dataloader)
+        rebuild_slab_tensor = reductions.rebuild_slab_tensor
+        slab_names = set()
+        slab_shapes = []
+
+        def recording_rebuild_slab_tensor(slab_name, slot_id, shape, *args):
+            slab_names.add(slab_name)
+            slab_shapes.append(tuple(shape))
+            return rebuild_slab_tensor(slab_name, slot_id, shape, *args)
+
+        num_epochs = 3
+        with mock.patch.object(
+            reductions, "rebuild_slab_tensor", recording_rebuild_slab_tensor
+        ):
+            for epoch in range(num_epochs):
+                if epoch > 0:
+                    iterator = iter(dataloader)
+                for i, (images, labels) in enumerate(iterator):
+                    indices = range(i * 4, i * 4 + 4)
+                    expected = np.stack([dataset[j][0] for j in indices])
+                    test_case.assertTrue(np.array_equal(images.numpy(), expected))
+                    expected = np.array([dataset[j][1] for j in indices])
+                    test_case.assertTrue(np.array_equal(labels.numpy(), expected))
+        del iterator
+        num_batches = num_epochs * len(dataloader)
+        # both the images and the labels smaller than a page keep going through
+        # the slabs, which are reused instead of created for every batch
+        test_case.assertEqual(slab_shapes.count((4, 3, 32, 32)), num_batches)
+        test_case.assertEqual(slab_shapes.count((4,)), num_batches)
+        # a slab of images and a slab of labels per worker, and one more of
+        # each if the batches in flight run out of the slots
+        test_case.assertLessEqual(len(slab_names), num_workers * 4)
+
+
+if __name__ == "__main__":
+    unittest.main()
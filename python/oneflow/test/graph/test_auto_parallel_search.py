@@ -0,0 +1,93 @@
+"""
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+"""
+import unittest
+
+import numpy as np
+
+import oneflow as flow
+import oneflow.unittest
+
+
+class MLP(flow.nn.Module):
+    def __init__(self):
+        super().__init__()
+        self.layers = flow.nn.Sequential(
+            flow.nn.Linear(32, 64),
+            flow.nn.ReLU(),
+            flow.nn.Linear(64, 64),
+            flow.nn.ReLU(),
+            flow.nn.Linear(64, 16),
+        )
+
+    def forward(self, x):
+        return self.layers(x)
+
+
+class MLPGraph(flow.nn.Graph):
+    def __init__(self, model, concurrent, incremental):
+        super().__init__()
+        self.model = model
+        self.config.enable_auto_parallel(True)
+        self.config.enable_auto_parallel_ignore_user_sbp_config(True)
+        self.config.enable_auto_parallel_concurrent_search(concurrent)
+        self.config.enable_auto_parallel_incremental_search(incremental)
+
+    def build(self, x):
+        return self.model(x)
+
+
+def _searched_sbp_signatures(graph):
+    op_name2nd_sbp_signature = (
+        graph._full_graph_proto.job_parallel_view_conf.op_name2nd_sbp_signature_conf
+    )
+    # the ops of the model have the same names in all graphs
+    return {
+        op_name: str(nd_sbp_signature)
+        for op_name, nd_sbp_signature in op_name2nd_sbp_signature.items()
+        if op_name.startswith("model.")
+    }
+
+
+@flow.unittest.skip_unless_1n2d()
+class TestAutoParallelSearch(oneflow.unittest.TestCase):
+    def test_concurrent_and_incremental_search(test_case):
+        placement = flow.placement("cpu", ranks=[0, 1])
+        model = MLP().to_global(placement, flow.sbp.broadcast)
+        x = flow.randn(8, 32).to_global(placement, flow.sbp.broadcast)
+        expected = model(x).numpy()
+
+        def run(concurrent, incremental):
+            graph = MLPGraph(model, concurrent, incremental)
+            test_case.assertTrue(
+                np.allclose(graph(x).numpy(), expected, atol=1e-5, rtol=1e-5)
+            )
+            return _searched_sbp_signatures(graph)
+
+        greedy = run(concurrent=False, incremental=False)
+        test_case.assertGreater(len(greedy), 0)
+        # the concurrent search reaches the same sbp as the sequential one
+        test_case.assertEqual(run(concurrent=True, incremental=False), greedy)
+
+        test_case.assertEqual(run(concurrent=False, incremental=True), greedy)
+        # the second graph of the same model reuses the last search
+        test_case.assertEqual(run(concurrent=True, incremental=True), greedy)
+        test_case.assertGreater(
+            flow._oneflow_internal.GetAutoParallelLastSearchReusedOpNum(), 0
+        )
+
+
+if __name__ == "__main__":
+    unittest.main()
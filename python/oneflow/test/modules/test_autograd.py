@@ -14,6 +14,8 @@ See the License for the specific language governing permissions and
 limitations under the License.
 """
 
+import os
+import threading
 import unittest
 from collections import OrderedDict
 
@@ -226,6 +228,36 @@ class TestAutograd(flow.unittest.TestCase):
         test_case.assertEqual(id_x_grad, id(x.grad))
         test_case.assertEqual(id_y_grad, id(y.grad))
 
+    def test_priority_schedule_backward(test_case):
+        np_x = np.random.rand(4, 5).astype(np.float32)
+        np_w = np.random.rand(5, 5).astype(np.float32)
+
+        def backward():
+            x = flow.tensor(np_x, requires_grad=True)
+            w = flow.tensor(np_w, requires_grad=True)
+            # branches of different depth that join again, with a shared input
+            h = flow.matmul(x, w)
+            a = flow.relu(flow.matmul(h, w)).sin()
+            b = h.exp().mean(dim=1, keepdim=True)
+            c = (a * b + h).tanh()
+            c.retain_grad()
+            (c.sum() + a.sum()).backward()
+            return x.grad.numpy(), w.grad.numpy(), c.grad.numpy()
+
+        fifo_grads = backward()
+        # the schedule is read once per thread, so it is enabled in a fresh thread
+        priority_grads = []
+        os.environ["ONEFLOW_AUTOGRAD_PRIORITY_SCHEDULE"] = "1"
+        try:
+            thread = threading.Thread(target=lambda: priority_grads.extend(backward()))
+            thread.start()
+            thread.join()
+        finally:
+            del os.environ["ONEFLOW_AUTOGRAD_PRIORITY_SCHEDULE"]
+        test_case.assertEqual(len(priority_grads), len(fifo_grads))
+        for fifo_grad, priority_grad in zip(fifo_grads, priority_grads):
+            test_case.assertTrue(np.allclose(fifo_grad, priority_grad, 1e-5, 1e-5))
+
 
 if __name__ == "__main__":
     unittest.main()
@@ -77,6 +77,27 @@ class TestCheckpointing(flow.unittest.TestCase):
         test_case.assertEqual(relu_forward_num, 3)
         test_case.assertEqual(relu_backward_num, 2)
 
+    def test_checkpointing_retain_graph(test_case):
+        forward_num = 0
+
+        def function(x):
+            nonlocal forward_num
+            forward_num += 1
+            return x.sigmoid().exp()
+
+        x1 = flow.randn(4, 5).requires_grad_()
+        x2 = x1.detach().clone().requires_grad_()
+        y1 = flow.utils.checkpoint.checkpoint(function, x1)
+        y2 = function(x2)
+        y2.sum().backward()
+        # the recomputed tensors are kept for the second backward
+        y1.sum().backward(retain_graph=True)
+        test_case.assertTrue(np.allclose(x1.grad, x2.grad))
+        x1.grad = None
+        y1.sum().backward()
+        test_case.assertTrue(np.allclose(x1.grad, x2.grad))
+        test_case.assertEqual(forward_num, 3)
+
 
 if __name__ == "__main__":
     unittest.main()
@@ -1196,6 +1196,77 @@ def _test_conv2d_backward(
     )
 
 
+def _test_conv2d_cpu_channels_last(
+    test_case,
+    batch,
+    in_channels,
+    out_channels,
+    spatial,
+    kernel_size,
+    stride,
+    padding,
+    groups,
+):
+    np_x = np.random.randn(batch, in_channels, spatial, spatial)
+    np_weight = np.random.randn(
+        out_channels, in_channels // groups, kernel_size, kernel_size
+    )
+    np_bias = np.random.randn(out_channels)
+    x = flow.tensor(np_x, dtype=flow.float32)
+    weight = flow.tensor(np_weight, dtype=flow.float32)
+    bias = flow.tensor(np_bias, dtype=flow.float32)
+    nchw_out = flow._C.conv2d(
+        x, weight, bias, stride=stride, padding=padding, groups=groups
+    )
+    nhwc_out = flow._C.conv2d(
+        x.permute(0, 2, 3, 1).contiguous(),
+        weight.permute(0, 2, 3, 1).contiguous(),
+        bias,
+        stride=stride,
+        padding=padding,
+        groups=groups,
+        channel_pos="channels_last",
+    )
+    test_case.assertTrue(
+        np.allclose(nchw_out.numpy(), nhwc_out.permute(0, 3, 1, 2).numpy(), 1e-4, 1e-4)
+    )
+
+
+def _test_conv2d_cpu_onednn(
+    test_case, batch, channel_pos, kernel_size, stride, padding, dilation, with_bias
+):
+    np_x = np.random.randn(batch, 8, 11, 11)
+    np_weight = np.random.randn(12, 8, kernel_size, kernel_size)
+    if channel_pos == "channels_last":
+        np_x = np_x.transpose(0, 2, 3, 1)
+        np_weight = np_weight.transpose(0, 2, 3, 1)
+    x = flow.tensor(np_x, dtype=flow.float32)
+    weight = flow.tensor(np_weight, dtype=flow.float32)
+    bias = flow.tensor(np.random.randn(12), dtype=flow.float32) if with_bias else None
+
+    def conv2d():
+        return flow._C.conv2d(
+            x,
+            weight,
+            bias,
+            stride=stride,
+            padding=padding,
+            dilation=dilation,
+            channel_pos=channel_pos,
+        ).numpy()
+
+    try:
+        os.environ["ONEFLOW_ENABLE_ONEDNN_CONV"] = "1"
+        onednn_out = conv2d()
+        # a second launch reuses the primitive cached in the kernel cache
+        onednn_out_again = conv2d()
+    finally:
+        os.environ["ONEFLOW_ENABLE_ONEDNN_CONV"] = "0"
+    cblas_out = conv2d()
+    test_case.assertTrue(np.allclose(onednn_out, cblas_out, 1e-4, 1e-4))
+    test_case.assertTrue(np.array_equal(onednn_out, onednn_out_again))
+
+
 def _test_conv2d_large_in_channel(test_case, device):
     np_arr = np.array(
         [
@@ -2052,6 +2123,27 @@ class TestConv2d(flow.unittest.TestCase):
         )
         os.environ["ONEFLOW_ENABLE_NHWC"] = "0"
 
+    def test_conv2d_cpu_channels_last(test_case):
+        # pointwise, depthwise and batch parallel im2col paths of the cpu kernels
+        for batch in [1, 5]:
+            _test_conv2d_cpu_channels_last(test_case, batch, 16, 24, 9, 1, 1, 0, 1)
+            _test_conv2d_cpu_channels_last(test_case, batch, 16, 24, 9, 1, 2, 0, 1)
+            _test_conv2d_cpu_channels_last(test_case, batch, 16, 24, 9, 3, 1, 1, 1)
+            _test_conv2d_cpu_channels_last(test_case, batch, 16, 16, 9, 3, 1, 1, 16)
+            _test_conv2d_cpu_channels_last(test_case, batch, 16, 16, 9, 3, 2, 1, 16)
+            _test_conv2d_cpu_channels_last(test_case, batch, 16, 16, 8, 5, 2, 2, 16)
+
+    def test_conv2d_cpu_onednn(test_case):
+        # the opt-in oneDNN path of the float 2d cpu kernel against the im2col and cblas path
+        for channel_pos in ["channels_first", "channels_last"]:
+            for with_bias in [True, False]:
+                _test_conv2d_cpu_onednn(
+                    test_case, 2, channel_pos, 3, 1, 1, 1, with_bias
+                )
+                _test_conv2d_cpu_onednn(
+                    test_case, 2, channel_pos, 3, 2, 2, 2, with_bias
+                )
+
     @profile(torch.nn.functional.conv2d)
     def profile_conv2d(test_case):
         input = torch.ones(8, 128, 28, 28)
@@ -2076,6 +2168,31 @@ class TestConv2d(flow.unittest.TestCase):
             input, weight_5x5_128c, bias=bias, padding=2, stride=2
         )
 
+    @profile(torch.nn.functional.conv2d)
+    def profile_conv2d_resnet50_layers(test_case):
+        # (in_channels, out_channels, spatial, kernel_size, stride) of the resnet50 convolutions
+        layers = [
+            (3, 64, 224, 7, 2),
+            (64, 64, 56, 1, 1),
+            (64, 64, 56, 3, 1),
+            (64, 256, 56, 1, 1),
+            (256, 128, 56, 1, 1),
+            (128, 128, 28, 3, 1),
+            (128, 512, 28, 1, 1),
+            (512, 256, 28, 1, 1),
+            (256, 256, 14, 3, 1),
+            (256, 1024, 14, 1, 1),
+            (1024, 512, 14, 1, 1),
+            (512, 512, 7, 3, 1),
+            (512, 2048, 7, 1, 1),
+        ]
+        for in_channels, out_channels, spatial, kernel_size, stride in layers:
+            input = torch.ones(16, in_channels, spatial, spatial)
+            weight = torch.ones(out_channels, in_channels, kernel_size, kernel_size)
+            torch.nn.functional.conv2d(
+                input, weight, stride=stride, padding=kernel_size // 2
+            )
+
 
 if __name__ == "__main__":
     unittest.main()
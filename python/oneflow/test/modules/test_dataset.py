@@ -367,5 +367,79 @@ class TestOFRecordBytesDecoder(flow.unittest.TestCase):
         test_case.assertTrue(np.array_equal(img, gt_np))
 
 
+@flow.unittest.skip_unless_1n1d()
+class TestOFRecordIndexedReader(flow.unittest.TestCase):
+    def test_indexed_reader(test_case):
+        batch_size = 16
+
+        def make_reader(use_index, start_sample=0):
+            return flow.nn.OFRecordReader(
+                "/dataset/imagenette/ofrecord",
+                batch_size=batch_size,
+                data_part_num=1,
+                part_name_suffix_length=5,
+                shuffle_after_epoch=False,
+                use_index=use_index,
+                start_sample=start_sample,
+            )
+
+        label_decoder = flow.nn.OFRecordRawDecoder(
+            "class/label", shape=(), dtype=flow.int32
+        )
+        reader = make_reader(False)
+        labels = [label_decoder(reader()).numpy() for _ in range(4)]
+        # without shuffling, the records are read in the same order through the index
+        indexed_reader = make_reader(True)
+        for i in range(4):
+            test_case.assertTrue(
+                np.array_equal(label_decoder(indexed_reader()).numpy(), labels[i])
+            )
+        # and reading resumes at start_sample
+        resumed_reader = make_reader(True, start_sample=2 * batch_size)
+        for i in range(2, 4):
+            test_case.assertTrue(
+                np.array_equal(label_decoder(resumed_reader()).numpy(), labels[i])
+            )
+
+
+@flow.unittest.skip_unless_1n1d()
+class TestOFRecordImageDecoderRandomCropResizeNormalize(flow.unittest.TestCase):
+    def test_fused_decoder(test_case):
+        batch_size = 8
+        rgb_mean = [123.68, 116.779, 103.939]
+        rgb_std = [58.393, 57.12, 57.375]
+        record_reader = flow.nn.OFRecordReader(
+            "/dataset/imagenette/ofrecord",
+            batch_size=batch_size,
+            data_part_num=1,
+            part_name_suffix_length=5,
+            shuffle_after_epoch=False,
+        )
+        val_record = record_reader()
+        images = []
+        for output_layout, mirror in [("NCHW", 0), ("NCHW", 1), ("NHWC", 0)]:
+            decoder = flow.nn.OFRecordImageDecoderRandomCropResizeNormalize(
+                "encoded",
+                target_width=224,
+                target_height=160,
+                color_space="RGB",
+                output_layout=output_layout,
+                mean=rgb_mean,
+                std=rgb_std,
+                random_seed=1,
+            )
+            mirror_tensor = flow.tensor([mirror] * batch_size, dtype=flow.int8)
+            images.append(decoder(val_record, mirror_tensor).numpy())
+        test_case.assertEqual(images[0].shape, (batch_size, 3, 160, 224))
+        test_case.assertEqual(images[2].shape, (batch_size, 160, 224, 3))
+        # the same seed gives the same crop windows
+        test_case.assertTrue(np.allclose(images[0], images[1][..., ::-1]))
+        test_case.assertTrue(
+            np.allclose(images[0], np.transpose(images[2], (0, 3, 1, 2)))
+        )
+        pixels = np.transpose(images[0], (0, 2, 3, 1)) * rgb_std + rgb_mean
+        test_case.assertTrue(np.all(pixels > -0.5) and np.all(pixels < 255.5))
+
+
 if __name__ == "__main__":
     unittest.main()
@@ -109,6 +109,47 @@ class TestDDP(flow.unittest.TestCase):
         for dev_type, use_bucket in GenCartesianProduct((test_device, [True, False])):
             test_case._test_ddp_multiple_buckets(dev_type, use_bucket)
 
+    def _test_ddp_bucket_cap(test_case, dev_type):
+        class Mul(flow.nn.Module):
+            def __init__(self):
+                super().__init__()
+                for i in range(10):
+                    self.register_parameter(
+                        f"w{i}", flow.nn.Parameter(flow.Tensor([i % 2 + 1, i % 2 + 1]))
+                    )
+
+            def forward(self, x):
+                for i in range(10):
+                    x = x * getattr(self, f"w{i}")
+                return x
+
+        rank = flow.env.get_rank()
+        x = flow.Tensor([1, 1]) if rank == 0 else flow.Tensor([2, 2])
+        x = x.to(dev_type)
+        m = Mul().to(dev_type)
+        # every grad takes 512 bytes in its bucket because of the alignment
+        m = ddp(m, bucket_cap_mb=1024 / 1024 / 1024)
+        test_case.assertEqual(
+            m._ddp_reducer.buckets, [[9, 8], [7, 6], [5, 4], [3, 2], [1, 0]]
+        )
+
+        for _ in range(2):
+            for i in range(10):
+                getattr(m, f"w{i}").grad = None
+            y = m(x)
+            y.sum().backward()
+            for i in range(10):
+                test_case.assertTrue(
+                    np_allclose_with_shape(
+                        getattr(m, f"w{i}").grad.numpy(),
+                        np.array([48, 48]) if i % 2 == 0 else np.array([24, 24]),
+                    )
+                )
+
+    def test_ddp_bucket_cap(test_case):
+        for dev_type in test_device:
+            test_case._test_ddp_bucket_cap(dev_type)
+
     def _test_ddp_with_unused_param(test_case, dev_type):
         class Model(flow.nn.Module):
             def __init__(self):
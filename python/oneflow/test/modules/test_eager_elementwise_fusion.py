@@ -0,0 +1,95 @@
+"""
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+"""
+import os
+
+# the env is read once per thread, it must be set before oneflow is imported
+os.environ["ONEFLOW_EAGER_ENABLE_ELEMENTWISE_FUSION"] = "1"
+import unittest
+from collections import OrderedDict
+import numpy as np
+from oneflow.test_utils.test_util import GenArgList
+
+import oneflow as flow
+import oneflow.unittest
+
+
+def _np_gelu(x):
+    return 0.5 * x * (1.0 + np.vectorize(np.math.erf)(x / np.sqrt(2.0)))
+
+
+def _test_elementwise_chain(test_case, shape, dtype):
+    np_x = np.random.randn(*shape).astype(dtype)
+    np_bias = np.random.randn(shape[-1]).astype(dtype)
+    np_y = np.random.randn(*shape).astype(dtype)
+    x = flow.tensor(np_x, device="cpu")
+    bias = flow.tensor(np_bias, device="cpu")
+    y = flow.tensor(np_y, device="cpu")
+    # intermediate results are kept alive to check they are still written
+    a = x + bias
+    b = flow.nn.functional.gelu(a)
+    c = b * 2.0 + 1.0
+    d = flow.tanh(c) * y
+    e = flow.relu(d - 0.5)
+    np_a = np_x + np_bias
+    np_b = _np_gelu(np_a)
+    np_c = np_b * 2.0 + 1.0
+    np_d = np.tanh(np_c) * np_y
+    np_e = np.maximum(np_d - 0.5, 0)
+    for out, np_out in [(a, np_a), (b, np_b), (c, np_c), (d, np_d), (e, np_e)]:
+        test_case.assertTrue(np.allclose(out.numpy(), np_out, atol=1e-5, rtol=1e-5))
+
+
+def _fused_instruction_count():
+    return flow._oneflow_internal.eager.fused_elementwise_instruction_count()
+
+
+def _test_inplace_chain(test_case, shape, dtype):
+    np_x = np.random.randn(*shape).astype(dtype)
+    x = flow.tensor(np_x, device="cpu")
+    y = flow.exp(x)
+    y.mul_(0.5)
+    y.add_(y)
+    z = flow.sigmoid(y)
+    np_y = np.exp(np_x) * 0.5
+    np_y = np_y + np_y
+    np_z = 1.0 / (1.0 + np.exp(-np_y))
+    test_case.assertTrue(np.allclose(y.numpy(), np_y, atol=1e-5, rtol=1e-5))
+    test_case.assertTrue(np.allclose(z.numpy(), np_z, atol=1e-5, rtol=1e-5))
+
+
+@flow.unittest.skip_unless_1n1d()
+class TestEagerElementwiseFusion(flow.unittest.TestCase):
+    def test_elementwise_chain(test_case):
+        arg_dict = OrderedDict()
+        arg_dict["test_fun"] = [_test_elementwise_chain, _test_inplace_chain]
+        arg_dict["shape"] = [(7,), (3, 5), (64, 1000), (33, 4097)]
+        arg_dict["dtype"] = [np.float32, np.float64]
+        for arg in GenArgList(arg_dict):
+            arg[0](test_case, *arg[1:])
+
+    def test_elementwise_chain_is_fused(test_case):
+        x = flow.randn(64, 1000)
+        flow._oneflow_internal.eager.Sync()
+        count = _fused_instruction_count()
+        # the vm fuses the instructions pending at the same time, repeat the chain so that
+        # some of them are scheduled together
+        ys = [flow.relu(flow.tanh(x * 2.0 + 1.0) - 0.5) for _ in range(20)]
+        ys[-1].numpy()
+        test_case.assertGreater(_fused_instruction_count(), count)
+
+
+if __name__ == "__main__":
+    unittest.main()
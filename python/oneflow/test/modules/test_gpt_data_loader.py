@@ -15,6 +15,7 @@ limitations under the License.
 """
 import unittest
 import os
+import tempfile
 import numpy as np
 
 import oneflow as flow
@@ -102,5 +103,28 @@ class GPTDataLoaderDistributedTestCase(oneflow.unittest.TestCase):
             )
 
 
+@unittest.skipIf(
+    os.getenv("ONEFLOW_TEST_GITHUB_HOSTED"),
+    "/dataset not available on GitHub hosted servers",
+)
+@flow.unittest.skip_unless_1n1d()
+class GPTDataLoaderIndexCacheTestCase(oneflow.unittest.TestCase):
+    def test_index_cache(test_case):
+        with tempfile.TemporaryDirectory() as cache_dir:
+            os.environ["ONEFLOW_GPT_DATASET_INDEX_CACHE_DIR"] = cache_dir
+            try:
+                # the first loader builds and saves the indices, the second maps them
+                building_loader = GPTDataLoader(batch_size=4, device="cpu")
+                built_tokens = [building_loader().numpy() for _ in range(2)]
+                test_case.assertTrue(
+                    any(f.endswith("_shuffle_idx.bin") for f in os.listdir(cache_dir))
+                )
+                cached_loader = GPTDataLoader(batch_size=4, device="cpu")
+                for tokens in built_tokens:
+                    test_case.assertTrue(np.array_equal(tokens, cached_loader().numpy()))
+            finally:
+                del os.environ["ONEFLOW_GPT_DATASET_INDEX_CACHE_DIR"]
+
+
 if __name__ == "__main__":
     unittest.main()
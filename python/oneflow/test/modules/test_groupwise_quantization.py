@@ -19,6 +19,7 @@ import numpy as np
 from oneflow.test_utils.test_util import GenArgList
 import math
 import os
+import time
 
 import oneflow as flow
 
@@ -115,10 +116,12 @@ def _dequantize(num_bits, symmetric, x, scale, zero, group_dim, group_size):
     )
 
 
-def _test_dequantize(test_case, num_bits, shape, group_dim, group_size):
+def _test_dequantize(
+    test_case, num_bits, shape, group_dim, group_size, device="cuda", dtypes=None
+):
 
-    for dtype in [flow.float, flow.float16]:
-        x = flow.randn(shape, device="cuda", dtype=flow.float,).to(dtype)
+    for dtype in dtypes or [flow.float, flow.float16]:
+        x = flow.randn(shape, device=device, dtype=flow.float,).to(dtype)
         for symmetric in [True, False]:
             for quant_type in [flow.int8, flow.uint8] if symmetric else [flow.uint8]:
                 quantized, scale, zero = _quantize(
@@ -135,11 +138,46 @@ def _test_dequantize(test_case, num_bits, shape, group_dim, group_size):
                 )
 
 
-def _test_fused_linear(test_case, num_bits, m, k, n, group_dim, group_size):
-    for dtype in [flow.float16, flow.float]:
-        x = flow.randn((m, k), device="cuda", dtype=flow.float,).to(dtype) / 10
-        w = flow.randn((n, k), device="cuda", dtype=flow.float,).to(dtype) / 10
-        b = flow.randn((n), device="cuda", dtype=flow.float,).to(dtype) / 10
+def _test_dequantize_half_scale(test_case, num_bits, shape, group_dim, group_size):
+    # the reference is computed in float from the float16 scale and zero
+    x = flow.randn(shape, dtype=flow.float)
+    for symmetric in [True, False]:
+        for quant_type in [flow.int8, flow.uint8] if symmetric else [flow.uint8]:
+            quantized, scale, zero = _quantize(
+                num_bits, symmetric, x, group_dim, group_size, quant_type
+            )
+            scale = scale.to(flow.float16)
+            zero = zero.to(flow.float16) if zero is not None else None
+            dequantized = _dequantize(
+                num_bits, symmetric, quantized, scale, zero, group_dim, group_size
+            )
+            test_case.assertEqual(dequantized.dtype, flow.float16)
+            dequantized_ref = _dequantize_ref(
+                num_bits,
+                symmetric,
+                quantized,
+                scale.float(),
+                zero.float() if zero is not None else None,
+                group_dim,
+                group_size,
+            )
+            test_case.assertTrue(
+                np.allclose(
+                    dequantized_ref.numpy(),
+                    dequantized.float().numpy(),
+                    atol=1e-2,
+                    rtol=1e-2,
+                )
+            )
+
+
+def _test_fused_linear(
+    test_case, num_bits, m, k, n, group_dim, group_size, device="cuda", dtypes=None
+):
+    for dtype in dtypes or [flow.float16, flow.float]:
+        x = flow.randn((m, k), device=device, dtype=flow.float,).to(dtype) / 10
+        w = flow.randn((n, k), device=device, dtype=flow.float,).to(dtype) / 10
+        b = flow.randn((n), device=device, dtype=flow.float,).to(dtype) / 10
 
         for symmetric in [True, False]:
             for quant_type in [flow.int8, flow.uint8] if symmetric else [flow.uint8]:
@@ -220,5 +258,83 @@ class TestGroupWiseQuantization(flow.unittest.TestCase):
         _test_fused_linear(test_case, 4, 1, 256, 512, 1, 64)
 
 
+def _benchmark_fused_linear_cpu(num_bits, m, k, n, group_size, iters=20):
+    x = flow.randn((m, k), dtype=flow.float)
+    w = flow.randn((n, k), dtype=flow.float)
+    w_quantized, w_scale, _ = _quantize(num_bits, True, w, 1, group_size, flow.int8)
+
+    def quantized_linear():
+        return flow._C.fused_linear_with_groupwise_quantized_weight(
+            x=x,
+            w=w_quantized,
+            w_scale=w_scale,
+            num_bits=num_bits,
+            symmetric=True,
+            group_dim=1,
+            group_size=group_size,
+        )
+
+    def fp32_linear():
+        return flow.matmul(x, w.t())
+
+    for fn in [quantized_linear, fp32_linear]:
+        fn().numpy()
+        start = time.perf_counter()
+        for _ in range(iters):
+            fn().numpy()
+        print(
+            f"int{num_bits} m={m} k={k} n={n} {fn.__name__}:"
+            f"{(time.perf_counter() - start) / iters * 1000:.3f}ms"
+        )
+
+
+@flow.unittest.skip_unless_1n1d()
+class TestGroupWiseQuantizationCpu(flow.unittest.TestCase):
+    def test_dequantize(test_case):
+        for num_bits in [8, 4]:
+            _test_dequantize(
+                test_case, num_bits, (128, 256), 0, 32, "cpu", [flow.float]
+            )
+            _test_dequantize(
+                test_case, num_bits, (64, 128, 256), 1, 32, "cpu", [flow.float]
+            )
+            _test_dequantize(
+                test_case, num_bits, (64, 128, 256), 2, 64, "cpu", [flow.float]
+            )
+        _test_dequantize(test_case, 8, (63, 127, 255), 1, 127, "cpu", [flow.float])
+
+    def test_dequantize_half(test_case):
+        for num_bits in [8, 4]:
+            _test_dequantize_half_scale(test_case, num_bits, (128, 256), 0, 32)
+            _test_dequantize_half_scale(test_case, num_bits, (64, 128, 256), 2, 64)
+        # enough groups to be split across threads
+        _test_dequantize_half_scale(test_case, 4, (1024, 4096), 1, 128)
+
+    def test_fused_linear(test_case):
+        for num_bits in [8, 4]:
+            for m in [1, 3, 8, 33]:
+                for group_dim, group_size in [(0, 130), (0, 65), (1, 256), (1, 64)]:
+                    _test_fused_linear(
+                        test_case,
+                        num_bits,
+                        m,
+                        256,
+                        130,
+                        group_dim,
+                        group_size,
+                        "cpu",
+                        [flow.float],
+                    )
+        _test_fused_linear(test_case, 8, 1, 63, 127, 1, 63, "cpu", [flow.float])
+
+    @unittest.skipUnless(
+        os.getenv("ONEFLOW_TEST_BENCHMARK"), "only run when benchmarking"
+    )
+    def test_fused_linear_benchmark(test_case):
+        for num_bits in [8, 4]:
+            for m in [1, 4, 8]:
+                _benchmark_fused_linear_cpu(num_bits, m, 4096, 4096, 128)
+
+
 if __name__ == "__main__":
     unittest.main()
@@ -58,6 +58,29 @@ def _test_maxpool2d_channel_last(
     # )
 
 
+def _test_maxpool2d_channel_last_backward_cpu(test_case, shape, kernel_size, stride):
+    arr = np.random.randn(*shape)
+    os.environ["ONEFLOW_ENABLE_NHWC"] = "1"
+    x1 = flow.tensor(arr, dtype=flow.float64, device="cpu", requires_grad=True)
+    m1 = flow.nn.MaxPool2d(kernel_size=kernel_size, stride=stride)
+    y1 = m1(x1)
+    y1.sum().backward()
+    os.environ["ONEFLOW_ENABLE_NHWC"] = "0"
+
+    x2 = flow.tensor(
+        arr.transpose(0, 3, 1, 2), dtype=flow.float64, device="cpu", requires_grad=True
+    )
+    m2 = flow.nn.MaxPool2d(kernel_size=kernel_size, stride=stride)
+    y2 = m2(x2)
+    y2.sum().backward()
+    test_case.assertTrue(
+        np.allclose(y1.numpy(), y2.numpy().transpose(0, 2, 3, 1), 1e-4, 1e-4)
+    )
+    test_case.assertTrue(
+        np.allclose(x1.grad.numpy(), x2.grad.numpy().transpose(0, 2, 3, 1), 1e-4, 1e-4)
+    )
+
+
 @flow.unittest.skip_unless_1n1d()
 class TestMaxPooling(flow.unittest.TestCase):
     @autotest(n=5, auto_backward=True, check_graph=True)
@@ -183,6 +206,15 @@ class TestMaxPooling(flow.unittest.TestCase):
         for arg in GenArgList(arg_dict):
             arg[0](test_case, *arg[1:])
 
+    def test_maxpool2d_channel_last_backward_cpu(test_case):
+        arg_dict = OrderedDict()
+        arg_dict["test_fun"] = [_test_maxpool2d_channel_last_backward_cpu]
+        arg_dict["shape"] = [(2, 9, 14, 3), (4, 32, 32, 130)]
+        arg_dict["kernel_size"] = [3, (2, 3)]
+        arg_dict["stride"] = [1, 2]
+        for arg in GenArgList(arg_dict):
+            arg[0](test_case, *arg[1:])
+
 
 @flow.unittest.skip_unless_1n1d()
 class TestMaxPoolingFunctional(flow.unittest.TestCase):
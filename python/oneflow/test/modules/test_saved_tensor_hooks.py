@@ -80,6 +80,74 @@ class TestSavedTensorHooks(flow.unittest.TestCase):
         test_case.assertTrue(np.allclose(x.grad, y))
         test_case.assertTrue(np.allclose(y.grad, x))
 
+    def test_save_on_cpu(test_case):
+        def run(x, w, offload, compress_to_bf16=False):
+            x = x.detach().clone().requires_grad_()
+            w = w.detach().clone().requires_grad_()
+            if offload:
+                with flow.autograd.graph.save_on_cpu(
+                    compress_to_bf16=compress_to_bf16, prefetch_depth=2
+                ) as ctx:
+                    y = flow.matmul(x, w).sigmoid().exp() * x
+                # the activations are offloaded, the leaves stay on device
+                test_case.assertGreater(ctx.num_offloaded, 0)
+            else:
+                y = flow.matmul(x, w).sigmoid().exp() * x
+            y.sum().backward()
+            return y.numpy(), x.grad.numpy(), w.grad.numpy()
+
+        x = flow.randn(8, 8).to("cuda")
+        w = flow.randn(8, 8).to("cuda")
+        expected = run(x, w, offload=False)
+        for out, expected_out in zip(run(x, w, offload=True), expected):
+            test_case.assertTrue(np.allclose(out, expected_out, atol=1e-5, rtol=1e-5))
+        for out, expected_out in zip(
+            run(x, w, offload=True, compress_to_bf16=True), expected
+        ):
+            test_case.assertTrue(np.allclose(out, expected_out, atol=1e-1, rtol=5e-2))
+
+    def test_save_on_cpu_min_bytes(test_case):
+        x = flow.randn(8, 8).to("cuda").requires_grad_()
+        with flow.autograd.graph.save_on_cpu(min_bytes=8 * 8 * 4 + 1) as ctx:
+            y = x.sigmoid().exp()
+        test_case.assertEqual(ctx.num_offloaded, 0)
+        with flow.autograd.graph.save_on_cpu(min_bytes=8 * 8 * 4) as ctx:
+            y = x.sigmoid().exp()
+        test_case.assertGreater(ctx.num_offloaded, 0)
+
+    def test_save_on_cpu_retain_graph(test_case):
+        x = flow.randn(8, 8).to("cuda").requires_grad_()
+        with flow.autograd.graph.save_on_cpu(prefetch_depth=1) as ctx:
+            y = x.sigmoid().exp()
+        test_case.assertGreater(ctx.num_offloaded, 0)
+        y.sum().backward(retain_graph=True)
+        grad = x.grad.numpy()
+        x.grad = None
+        y.sum().backward()
+        test_case.assertTrue(np.allclose(x.grad.numpy(), grad, atol=1e-5, rtol=1e-5))
+
+    def test_save_on_cpu_in_saved_tensors_hooks(test_case):
+        x = flow.randn(2, 3).to("cuda").requires_grad_()
+        y = flow.randn(2, 3).to("cuda").requires_grad_()
+        tensor_list = []
+
+        def pack(x):
+            tensor_list.append(x)
+            return len(tensor_list) - 1
+
+        def unpack(x):
+            return tensor_list[x]
+
+        with flow.autograd.graph.saved_tensors_hooks(pack, unpack):
+            with flow.autograd.graph.save_on_cpu():
+                z = x * y
+            w = z * z
+        w.sum().backward()
+        # only the innermost hooks are applied
+        test_case.assertEqual(len(tensor_list), 2)
+        test_case.assertTrue(np.allclose(x.grad, 2 * z * y))
+        test_case.assertTrue(np.allclose(y.grad, 2 * z * x))
+
 
 if __name__ == "__main__":
     unittest.main()
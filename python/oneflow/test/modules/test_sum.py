@@ -69,6 +69,18 @@ def _test_sum_impl(test_case, device, data_type):
     test_case.assertTrue(np.allclose(input.numpy(), of_out.numpy(), 1e-05, 1e-05))
 
 
+def _test_sum_large_cpu(test_case, shape, dim):
+    np_input = np.random.randn(*shape).astype(np.float32)
+    input = flow.tensor(np_input, device="cpu")
+    np_out = np.sum(np_input.astype(np.float64), axis=dim)
+    of_out = flow.sum(input, dim=dim)
+    test_case.assertTrue(np.allclose(of_out.numpy(), np_out, 1e-04, 1e-03))
+    # partial results are combined in an order that only depends on the shape
+    test_case.assertTrue(np.array_equal(of_out.numpy(), flow.sum(input, dim=dim).numpy()))
+    of_max = flow.amax(input, dim=dim)
+    test_case.assertTrue(np.array_equal(of_max.numpy(), np.amax(np_input, axis=dim)))
+
+
 @flow.unittest.skip_unless_1n1d()
 class TestSumModule(flow.unittest.TestCase):
     def test_sum(test_case):
@@ -78,6 +90,18 @@ class TestSumModule(flow.unittest.TestCase):
         for arg in GenArgList(arg_dict):
             _test_sum_impl(test_case, *arg)
 
+    def test_sum_large_cpu(test_case):
+        arg_dict = OrderedDict()
+        arg_dict["shape_and_dim"] = [
+            ((1 << 20,), (0,)),
+            ((3, 100000), (1,)),
+            ((100000, 3), (0,)),
+            ((300, 2500), (0,)),
+            ((64, 33, 1000), (0, 2)),
+        ]
+        for arg in GenArgList(arg_dict):
+            _test_sum_large_cpu(test_case, *arg[0])
+
     @autotest(check_graph=True)
     def test_sum_against_pytorch(test_case):
         device = random_device()
@@ -0,0 +1,87 @@
+"""
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+"""
+import json
+import os
+import tempfile
+import unittest
+
+import oneflow as flow
+import oneflow.unittest
+
+
+class ReluGraph(flow.nn.Graph):
+    def __init__(self):
+        super().__init__()
+
+    def build(self, x):
+        return flow.relu(x) + 1
+
+
+@flow.unittest.skip_unless_1n1d()
+class TestActorTrace(flow.unittest.TestCase):
+    def test_actor_trace(test_case):
+        graph = ReluGraph()
+        x = flow.randn(4, 4)
+        flow.profiler.actor_trace_start()
+        for _ in range(3):
+            graph(x).numpy()
+        flow.profiler.actor_trace_stop()
+        with tempfile.TemporaryDirectory() as d:
+            path = os.path.join(d, "actor_trace.json")
+            flow.profiler.export_actor_trace(path)
+            with open(path) as f:
+                trace = json.load(f)
+        events = trace["traceEvents"]
+        acts = [e for e in events if e.get("cat") == "act"]
+        test_case.assertTrue(len(acts) > 0)
+        for act in acts:
+            test_case.assertEqual(act["ph"], "X")
+            test_case.assertGreaterEqual(act["dur"], 0)
+        act_names = set(act["name"] for act in acts)
+        test_case.assertTrue(any("relu" in name for name in act_names))
+        test_case.assertTrue(any(e.get("name") == "send" for e in events))
+        test_case.assertTrue(any(e.get("name") == "recv" for e in events))
+        # every actor of the relu graph acts once per iteration at least
+        relu_acts = [act for act in acts if "relu" in act["name"]]
+        test_case.assertGreaterEqual(len(relu_acts), 3)
+        test_case.assertTrue(any("wait_us" in act["args"] for act in relu_acts))
+
+    def test_analyze_graph_execution(test_case):
+        graph = ReluGraph()
+        x = flow.randn(4, 4)
+        # the first run compiles the graph, only the runs after it are analyzed
+        graph(x).numpy()
+        flow.profiler.actor_trace_clear()
+        flow.profiler.actor_trace_start()
+        for _ in range(5):
+            graph(x).numpy()
+        flow.profiler.actor_trace_stop()
+        report = flow.profiler.analyze_graph_execution(graph)
+        test_case.assertEqual(report["iterations"], 5)
+        test_case.assertGreater(report["iteration_us"], 0)
+        path = report["critical_path"]
+        test_case.assertGreater(len(path["actors"]), 0)
+        test_case.assertLessEqual(
+            sum(actor["mean_act_us"] for actor in path["actors"]),
+            path["length_us"] * 1.001,
+        )
+        test_case.assertGreater(len(report["streams"]), 0)
+        for key in ["regst_stalls", "comm_waits", "suggestions"]:
+            test_case.assertTrue(isinstance(report[key], list))
+
+
+if __name__ == "__main__":
+    unittest.main()
@@ -0,0 +1,82 @@
+"""
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+"""
+import json
+import os
+import tempfile
+import unittest
+
+import numpy as np
+
+import oneflow as flow
+import oneflow.unittest
+
+
+class LinearGraph(flow.nn.Graph):
+    def __init__(self, linear, cost_database=None):
+        super().__init__()
+        self.linear = linear
+        if cost_database is not None:
+            self.config.enable_auto_parallel(True)
+            self.config.set_auto_parallel_cost_database(cost_database)
+
+    def build(self, x):
+        return flow.relu(self.linear(x))
+
+
+@flow.unittest.skip_unless_1n1d()
+class TestAutoParallelCost(flow.unittest.TestCase):
+    def _test_record_and_search(test_case, device):
+        linear = flow.nn.Linear(32, 16).to(device)
+        x = flow.randn(64, 32, device=device)
+        with tempfile.TemporaryDirectory() as tmp_dir:
+            path = os.path.join(tmp_dir, "cost.json")
+            graph = LinearGraph(linear)
+            flow.profiler.actor_trace_start()
+            for _ in range(3):
+                graph(x).numpy()
+            flow.profiler.actor_trace_stop()
+            flow.profiler.record_auto_parallel_cost(graph, path)
+            with open(path) as f:
+                database = json.load(f)
+            matmuls = [k for k in database["ops"] if k.startswith("matmul|")]
+            test_case.assertEqual(len(matmuls), 1)
+            test_case.assertGreaterEqual(database["ops"][matmuls[0]]["count"], 3)
+            test_case.assertGreater(database["ops"][matmuls[0]]["total_us"], 0)
+
+            # the times are accumulated
+            flow.profiler.record_auto_parallel_cost(graph, path)
+            with open(path) as f:
+                test_case.assertEqual(
+                    json.load(f)["ops"][matmuls[0]]["count"],
+                    2 * database["ops"][matmuls[0]]["count"],
+                )
+
+            auto_graph = LinearGraph(linear, path)
+            test_case.assertTrue(
+                np.allclose(auto_graph(x).numpy(), graph(x).numpy(), atol=1e-5)
+            )
+
+    def test_record_and_search_cpu(test_case):
+        test_case._test_record_and_search("cpu")
+
+    # the kernels on cuda are timed by cuda events, without syncing every kernel
+    @unittest.skipIf(os.getenv("ONEFLOW_TEST_CPU_ONLY"), "only test cpu cases")
+    def test_record_and_search_cuda(test_case):
+        test_case._test_record_and_search("cuda")
+
+
+if __name__ == "__main__":
+    unittest.main()
@@ -0,0 +1,87 @@
+"""
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+"""
+import unittest
+
+import oneflow as flow
+import oneflow.unittest
+
+
+class LinearGraph(flow.nn.Graph):
+    def __init__(self, linear):
+        super().__init__()
+        self.linear = linear
+
+    def build(self, x):
+        return flow.relu(self.linear(x))
+
+
+def _find(entries, name):
+    for entry in entries:
+        if entry["name"] == name:
+            return entry
+    return None
+
+
+@flow.unittest.skip_unless_1n1d()
+class TestRoofline(flow.unittest.TestCase):
+    def test_eager_roofline(test_case):
+        a = flow.randn(64, 32)
+        b = flow.randn(32, 16)
+        x = flow.randn(2, 3, 32, 32)
+        weight = flow.randn(6, 3, 5, 5)
+        with flow.profiler.profile(
+            activities=[flow.profiler.ProfilerActivity.CPU], record_flops=True
+        ) as prof:
+            for _ in range(2):
+                flow.matmul(a, b)
+            flow.nn.functional.conv2d(x, weight)
+        entries = prof.roofline(peak_gflops=1000.0, peak_gbps=100.0)
+        matmul = _find(entries, "matmul")
+        test_case.assertIsNotNone(matmul)
+        test_case.assertEqual(matmul["count"], 2)
+        test_case.assertEqual(matmul["flops"], 2 * 64 * 16 * 32)
+        test_case.assertEqual(matmul["bytes"], 4 * (64 * 32 + 32 * 16 + 64 * 16))
+        test_case.assertGreater(matmul["gflops_per_s"], 0)
+        test_case.assertAlmostEqual(
+            matmul["arithmetic_intensity"], matmul["flops"] / matmul["bytes"]
+        )
+        test_case.assertEqual(matmul["bound"], "memory")
+        conv = _find(entries, "conv2d")
+        test_case.assertIsNotNone(conv)
+        test_case.assertEqual(conv["flops"], 2 * (2 * 6 * 28 * 28) * (3 * 5 * 5))
+
+    def test_graph_roofline(test_case):
+        graph = LinearGraph(flow.nn.Linear(32, 16, bias=False))
+        x = flow.randn(64, 32)
+        flow.profiler.actor_trace_start()
+        for _ in range(3):
+            graph(x).numpy()
+        flow.profiler.actor_trace_stop()
+        kernels = flow.profiler.analyze_graph_roofline(graph, 1000.0, 100.0)
+        test_case.assertGreater(len(kernels), 0)
+        matmuls = [k for k in kernels if k.get("op_type") == "matmul"]
+        test_case.assertEqual(len(matmuls), 1)
+        test_case.assertEqual(matmuls[0]["flops"], 2 * 64 * 16 * 32)
+        test_case.assertGreaterEqual(matmuls[0]["count"], 3)
+        test_case.assertIn(matmuls[0]["bound"], ["compute", "memory"])
+        relus = [k for k in kernels if k.get("op_type") == "relu"]
+        test_case.assertEqual(len(relus), 1)
+        test_case.assertEqual(relus[0]["flops"], 64 * 16)
+        test_case.assertEqual(relus[0]["bytes"], 2 * 4 * 64 * 16)
+
+
+if __name__ == "__main__":
+    unittest.main()
@@ -16,7 +16,6 @@ limitations under the License.
 # This file is mostly copied from PyTorch
 
 import oneflow as flow
-from typing import List, Union
 
 
 def _checkpoint_without_reentrant(function, *args):
@@ -30,35 +29,17 @@ def _checkpoint_without_reentrant(function, *args):
         *args: Arguments to pass in to the given ``function``.
     """
 
-    storage: List[Union[flow.Tensor, None]] = []
-    counter = 0
-
-    def pack(x):
-        nonlocal counter
-        counter += 1
-        return counter - 1
-
+    # The saved tensors are dropped, the first one unpacked by backward re-runs
+    # `function` with grad enabled and takes the tensors saved by that run.
     # TODO(jianhao): support restoring rng state once we have flow.random.fork_rng
-    def unpack(x):
-        if len(storage) == 0:
-
-            def inner_pack(inner):
-                storage.append(inner)
-                return None
-
-            def inner_unpack(packed):
-                raise RuntimeError(
-                    "You are calling backwards on a tensor that is never exposed. Please open an issue."
-                )
-
-            with flow.enable_grad():
-                with flow.autograd.graph.saved_tensors_hooks(inner_pack, inner_unpack):
-                    _unused = function(*args)
-
-        return storage[x]
+    def recompute():
+        function(*args)
 
-    with flow.autograd.graph.saved_tensors_hooks(pack, unpack):
+    flow._oneflow_internal.autograd.graph.append_recompute_hooks(recompute)
+    try:
         output = function(*args)
+    finally:
+        flow._oneflow_internal.autograd.graph.pop_hooks()
 
     return output
 
@@ -26,6 +26,7 @@ from dataclasses import dataclass
 from typing import Union
 from oneflow.multiprocessing import _prctl_pr_set_pdeathsig  # type: ignore[attr-defined]
 from oneflow.multiprocessing import unlink_all_shared_memory
+from oneflow.multiprocessing import shared_memory
 import signal
 
 import oneflow as flow
@@ -268,6 +269,19 @@ def _worker_loop(
         signal.signal(signal.SIGTERM, cleanup_shm_at_exit)
         signal.signal(signal.SIGINT, cleanup_shm_at_exit)
         flow.set_num_threads(1)
+        # Batches are sent through a few shared memory slabs whose slots are
+        # recycled after the main process frees the tensors, instead of a new
+        # shared memory block per tensor. Tensors larger than the max slot
+        # size, or sent while all the slots are in use, fall back to the
+        # latter.
+        shm_slot_num = int(os.getenv("ONEFLOW_DATALOADER_SHM_SLOT_NUM", "0"))
+        if shm_slot_num > 0 and not IS_WINDOWS:
+            shm_max_slot_size = int(
+                os.getenv("ONEFLOW_DATALOADER_SHM_MAX_SLOT_SIZE", str(64 << 20))
+            )
+            shared_memory.set_slab_pool(
+                shared_memory.SharedMemorySlabPool(shm_slot_num, shm_max_slot_size)
+            )
         seed = base_seed + worker_id
         random.seed(seed)
         flow.manual_seed(seed)